@@ -0,0 +1,772 @@
+//
+//  csi_harness.cpp
+//  csi_harness
+//
+//  Runs CSurfIntegrator headless against the REAPER stub and reports what each Run() tick costs.
+//
+//  csi_harness [run | tracks | mirror | startup | midi | latency | osc | bundles | tokenizer | volume] [--ticks N] [--tracks N] [--surfaces N] [--profile]
+//
+
+#include "reaper_stub.h"
+#include "fixture.h"
+#include "../reaper_csurf_integrator/handy_functions.h"
+#include "reference_tokenizer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <unistd.h>
+
+static long long GetNanoseconds() { return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count(); }
+
+static long long GetThreadCPUNanoseconds()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+class Distribution
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+{
+private:
+    vector<double> values_;
+
+public:
+    Distribution() { values_.reserve(100000); }
+
+    void Add(double value) { values_.push_back(value); }
+    void Clear() { values_.clear(); }
+
+    double GetMean()
+    {
+        double total = 0.0;
+        for (auto value : values_)
+            total += value;
+        return values_.size() ? total / values_.size() : 0.0;
+    }
+
+    double GetPercentile(double percentile)
+    {
+        if (values_.size() == 0)
+            return 0.0;
+        vector<double> sorted = values_;
+        sort(sorted.begin(), sorted.end());
+        return sorted[min(sorted.size() - 1, (size_t)(percentile * sorted.size()))];
+    }
+
+    void Print(const char *name, const char *unit)
+    {
+        printf("  %-28s mean %10.2f  p50 %10.2f  p90 %10.2f  p99 %10.2f  max %10.2f %s\n", name, GetMean(), GetPercentile(0.5), GetPercentile(0.9), GetPercentile(0.99), GetPercentile(1.0), unit);
+    }
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+struct HarnessOptions
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+{
+    string scenario = "run";
+    int numTicks = 5000;
+    int numTracks = 64;
+    int numSurfaces = 1;
+    bool isProfiling = false;
+};
+
+static string GetFixtureFolder(const char *name) { return "/tmp/csi_harness_" + to_string(getpid()) + "_" + name; }
+
+static void PrintTopCalls(const map<string, long long> &callCounts, int numTicks, int numShown)
+{
+    vector<pair<long long, string>> sorted;
+    for (auto &callCount : callCounts)
+        if (callCount.second > 0)
+            sorted.push_back(make_pair(callCount.second, callCount.first));
+    sort(sorted.rbegin(), sorted.rend());
+
+    for (int i = 0; i < (int)sorted.size() && i < numShown; ++i)
+        printf("    %-36s %10.2f per tick\n", sorted[i].second.c_str(), (double)sorted[i].first / numTicks);
+}
+
+static long long GetCallCount(const char *name)
+{
+    const map<string, long long> &callCounts = ReaperStub::GetCallCounts();
+    auto it = callCounts.find(name);
+    return it != callCounts.end() ? it->second : 0;
+}
+
+// what a tick sees from the outside world: one fader move from the surface, automation moving a track, meters
+static void SimulateActivity(int tick, int numSurfaces)
+{
+    if (tick % 3 == 0)
+    {
+        int value = (tick * 37) & 0x3fff;
+        ReaperStub::GetMidiInput(tick % numSurfaces)->Queue(0xe0 + tick % 8, value & 0x7f, value >> 7);
+    }
+
+    if (tick % 5 == 0)
+        ReaperStub::SetTrackVolume(tick % ReaperStub::GetNumTracks(), 0.25 + (tick % 100) / 100.0);
+
+    ReaperStub::SetTrackPeaks(0.5 + 0.4 * sin(tick * 0.2));
+    ReaperStub::AdvanceTime(33); // REAPER runs surfaces at about 30Hz
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// run -- tick time, REAPER API calls and allocations per Run()
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void RunScenario(const HarnessOptions &options)
+{
+    FixtureOptions fixtureOptions;
+    fixtureOptions.numMidiSurfaces = options.numSurfaces;
+
+    string resourcePath = WriteFixture(GetFixtureFolder("run"), fixtureOptions);
+
+    ReaperStub::Start();
+    ReaperStub::SetProject(options.numTracks, 2, 64);
+
+    long long startTime = GetNanoseconds();
+    CSurfIntegrator *csi = ReaperStub::CreateCSI(resourcePath);
+    double startupMilliseconds = (GetNanoseconds() - startTime) / 1e6;
+
+    for (int tick = 0; tick < 100; ++tick) // settle the initial full refresh
+    {
+        SimulateActivity(tick, options.numSurfaces);
+        csi->Run();
+    }
+
+    if (options.isProfiling)
+        csi->ToggleProfiling();
+
+    Distribution tickTimes, callsPerTick, allocationsPerTick, messagesPerTick;
+
+    ReaperStub::ResetCallCounts();
+
+    for (int tick = 0; tick < options.numTicks; ++tick)
+    {
+        SimulateActivity(tick, options.numSurfaces);
+
+        long long calls = ReaperStub::GetTotalCalls();
+        long long allocations = AllocationCounter::GetCount();
+        long long messages = 0;
+        for (int i = 0; i < options.numSurfaces; ++i)
+            messages += ReaperStub::GetMidiOutput(i)->GetNumMessages();
+
+        long long start = GetNanoseconds();
+        csi->Run();
+        tickTimes.Add((GetNanoseconds() - start) / 1000.0);
+
+        callsPerTick.Add(ReaperStub::GetTotalCalls() - calls);
+        allocationsPerTick.Add(AllocationCounter::GetCount() - allocations);
+        for (int i = 0; i < options.numSurfaces; ++i)
+            messages -= ReaperStub::GetMidiOutput(i)->GetNumMessages();
+        messagesPerTick.Add(-messages);
+    }
+
+    printf("run: %d ticks, %d tracks, %d MCU surface(s) of 8 channels, startup %.2f ms\n", options.numTicks, options.numTracks, options.numSurfaces, startupMilliseconds);
+    tickTimes.Print("Run()", "us");
+    callsPerTick.Print("REAPER API calls per tick", "");
+    allocationsPerTick.Print("allocations per tick", "");
+    messagesPerTick.Print("MIDI messages per tick", "");
+    printf("  busiest REAPER API calls\n");
+    PrintTopCalls(ReaperStub::GetCallCounts(), options.numTicks, 12);
+
+    if (options.isProfiling)
+    {
+        csi->ToggleProfiling(); // writes CSI/CSIProfile.txt
+        printf("  profile written to %s\n", csi->GetProfileFilePath().c_str());
+    }
+
+    ReaperStub::DestroyCSI(csi);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// tracks -- Run() as the project grows, the surface showing the same 8 tracks throughout
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void TracksScenario(const HarnessOptions &options)
+{
+    string resourcePath = WriteFixture(GetFixtureFolder("tracks"), FixtureOptions());
+
+    ReaperStub::Start();
+
+    printf("tracks: %d ticks each, 1 MCU surface of 8 channels\n", options.numTicks);
+    printf("  %8s %12s %12s %12s %14s %14s %14s\n", "tracks", "Run() mean", "Run() p50", "Run() p99", "calls mean", "calls p50", "calls max");
+
+    for (int numTracks : { 8, 64, 512, 4096 })
+    {
+        ReaperStub::SetProject(numTracks, 2, 64);
+        CSurfIntegrator *csi = ReaperStub::CreateCSI(resourcePath);
+
+        Distribution tickTimes, callsPerTick;
+
+        for (int tick = -100; tick < options.numTicks; ++tick) // the first 100 settle the initial full refresh
+        {
+            if (tick % 3 == 0)
+                ReaperStub::GetMidiInput(0)->Queue(0xe0 + (tick & 7), tick & 0x7f, (tick >> 7) & 0x7f);
+            ReaperStub::SetTrackPeaks(0.5 + 0.4 * sin(tick * 0.2));
+            ReaperStub::AdvanceTime(33);
+
+            long long calls = ReaperStub::GetTotalCalls();
+            long long start = GetNanoseconds();
+            csi->Run();
+
+            if (tick >= 0)
+            {
+                tickTimes.Add((GetNanoseconds() - start) / 1000.0);
+                callsPerTick.Add(ReaperStub::GetTotalCalls() - calls);
+            }
+        }
+
+        printf("  %8d %9.2f us %9.2f us %9.2f us %14.2f %14.0f %14.0f\n", numTracks, tickTimes.GetMean(), tickTimes.GetPercentile(0.5), tickTimes.GetPercentile(0.99),
+               callsPerTick.GetMean(), callsPerTick.GetPercentile(0.5), callsPerTick.GetPercentile(1.0));
+
+        ReaperStub::DestroyCSI(csi);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// mirror -- REAPER API calls per tick as more MCU surfaces show the same 8 tracks
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void MirrorScenario(const HarnessOptions &options)
+{
+    ReaperStub::Start();
+    ReaperStub::SetProject(options.numTracks, 2, 64);
+
+    printf("mirror: %d ticks each, every surface refreshing each tick, automation moving the 8 tracks they show\n", options.numTicks);
+
+    for (int numSurfaces : { 1, 2, 4 })
+    {
+        FixtureOptions fixtureOptions;
+        fixtureOptions.numMidiSurfaces = numSurfaces;
+        fixtureOptions.isMirrored = true;
+
+        CSurfIntegrator *csi = ReaperStub::CreateCSI(WriteFixture(GetFixtureFolder("mirror"), fixtureOptions));
+
+        Distribution callsPerTick;
+
+        for (int tick = -100; tick < options.numTicks; ++tick) // the first 100 settle the initial full refresh
+        {
+            if (tick == 0)
+                ReaperStub::ResetCallCounts();
+
+            ReaperStub::SetTrackVolume(tick & 7, 0.25 + (tick % 100) / 200.0);
+            ReaperStub::SetTrackPeaks(0.5 + 0.4 * sin(tick * 0.2));
+            ReaperStub::AdvanceTime(67); // past MIDISurfaceRefreshRate=15 every tick
+
+            long long calls = ReaperStub::GetTotalCalls();
+            csi->Run();
+
+            if (tick >= 0)
+                callsPerTick.Add(ReaperStub::GetTotalCalls() - calls);
+        }
+
+        // the fields TrackStateCache holds, as against the track list lookups that find the tracks
+        long long trackStateCalls = 0;
+        for (const char *name : { "GetTrackUIVolPan", "GetTrackUIPan", "GetMediaTrackInfo_Value", "GetTrackName", "GetTrackColor" })
+            trackStateCalls += GetCallCount(name);
+
+        char name[64];
+        snprintf(name, sizeof(name), "%d surface(s), API calls", numSurfaces);
+        callsPerTick.Print(name, "per tick");
+        printf("  %-28s mean %10.2f per tick\n", "  of which track state", (double)trackStateCalls / options.numTicks);
+        PrintTopCalls(ReaperStub::GetCallCounts(), options.numTicks, 4);
+
+        ReaperStub::DestroyCSI(csi);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// startup -- CreateCSI() as the FX zone library grows, with MCU surfaces sharing its folder
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void StartupScenario(const HarnessOptions &options)
+{
+    const int numStarts = 5;
+
+    ReaperStub::Start();
+    ReaperStub::SetProject(options.numTracks, 2, 64);
+
+    // most of the wall time that doesn't grow with the zone files is each MCU's display setup, paced out by Midi_ControlSurfaceIO::Flush
+    printf("startup: median of %d, the first start after the fixture is written and a restart, wall and main thread CPU time\n", numStarts);
+    printf("  %10s %10s %14s %14s %14s %14s\n", "zone files", "surfaces", "first start", "CPU", "restart", "CPU");
+
+    for (int numFXZoneFiles : { 0, 100, 1000, 4000 })
+    {
+        for (int numSurfaces : { 1, 4 })
+        {
+            FixtureOptions fixtureOptions;
+            fixtureOptions.numMidiSurfaces = numSurfaces;
+            fixtureOptions.numFXZoneFiles = numFXZoneFiles;
+
+            Distribution startTimes[2], cpuTimes[2];
+
+            for (int i = 0; i < numStarts; ++i)
+            {
+                string resourcePath = WriteFixture(GetFixtureFolder("startup"), fixtureOptions);
+
+                for (int start = 0; start < 2; ++start)
+                {
+                    long long startTime = GetNanoseconds();
+                    long long cpuTime = GetThreadCPUNanoseconds();
+                    CSurfIntegrator *csi = ReaperStub::CreateCSI(resourcePath);
+                    cpuTimes[start].Add((GetThreadCPUNanoseconds() - cpuTime) / 1e6);
+                    startTimes[start].Add((GetNanoseconds() - startTime) / 1e6);
+                    ReaperStub::DestroyCSI(csi);
+                }
+            }
+
+            printf("  %10d %10d %11.2f ms %11.2f ms %11.2f ms %11.2f ms\n", numFXZoneFiles + 3, numSurfaces,
+                   startTimes[0].GetPercentile(0.5), cpuTimes[0].GetPercentile(0.5), startTimes[1].GetPercentile(0.5), cpuTimes[1].GetPercentile(0.5));
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// midi -- MCU traffic replayed into an MCU and 3 extenders, time per event from the input port to its action
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+struct MidiTrafficEvent { int port; unsigned char status, d1, d2; };
+
+// a fader ride with V-Pot and button presses on top, plus what the templates leave unmapped (jog wheel, meters echoed back)
+static vector<MidiTrafficEvent> GetMCUTraffic(int numPorts, int numEvents, bool isUnmappedOnly)
+{
+    vector<MidiTrafficEvent> traffic;
+
+    for (int i = 0; traffic.size() < numEvents; ++i)
+    {
+        int port = (i / 7) % numPorts;
+        int channel = (i * 5) % 8;
+        int kind = isUnmappedOnly ? 9 : i % 10;
+
+        if (kind < 6)
+        {
+            int value = (i * 97) & 0x3fff;
+            traffic.push_back({ port, (unsigned char)(0xe0 + channel), (unsigned char)(value & 0x7f), (unsigned char)(value >> 7) });
+        }
+        else if (kind < 8)
+            traffic.push_back({ port, 0xb0, (unsigned char)(0x10 + channel), (unsigned char)(i & 1 ? 0x01 : 0x41) });
+        else if (kind < 9)
+        {
+            traffic.push_back({ port, 0x90, (unsigned char)(0x10 + channel), 0x7f });
+            traffic.push_back({ port, 0x90, (unsigned char)(0x10 + channel), 0x00 });
+        }
+        else if (i & 1)
+            traffic.push_back({ port, 0xb0, 0x3c, (unsigned char)(i & 2 ? 0x01 : 0x41) });
+        else
+            traffic.push_back({ port, 0xd0, (unsigned char)((channel << 4) | (i & 0x0f)), 0x00 });
+    }
+
+    traffic.resize(numEvents);
+    return traffic;
+}
+
+static void MidiScenario(const HarnessOptions &options)
+{
+    const int numPorts = 4;
+    const int numEventsPerTick = 256;
+
+    FixtureOptions fixtureOptions;
+    fixtureOptions.numMidiSurfaces = numPorts;
+
+    string resourcePath = WriteFixture(GetFixtureFolder("midi"), fixtureOptions);
+
+    ReaperStub::Start();
+    ReaperStub::SetProject(options.numTracks, 2, 64);
+
+    CSurfIntegrator *csi = ReaperStub::CreateCSI(resourcePath);
+
+    for (int tick = 0; tick < 100; ++tick) // settle the initial full refresh
+    {
+        ReaperStub::AdvanceTime(100);
+        csi->Run();
+    }
+
+    printf("midi: %d ticks of %d events over an MCU and %d extenders, %d tracks\n", options.numTicks, numEventsPerTick, numPorts - 1, options.numTracks);
+
+    for (bool isUnmappedOnly : { false, true })
+    {
+        vector<MidiTrafficEvent> traffic = GetMCUTraffic(numPorts, numEventsPerTick, isUnmappedOnly);
+        Distribution busyTicks, idleTicks;
+
+        // busy and idle ticks alternate, the idle ones measure what Run() costs without input; 100ms apart, each one refreshes the surfaces
+        for (int tick = 0; tick < options.numTicks; ++tick)
+        {
+            for (auto &event : traffic)
+                ReaperStub::GetMidiInput(event.port)->Queue(event.status, event.d1, event.d2);
+            ReaperStub::AdvanceTime(100);
+
+            long long start = GetNanoseconds();
+            csi->Run();
+            busyTicks.Add(GetNanoseconds() - start);
+
+            ReaperStub::AdvanceTime(100);
+
+            start = GetNanoseconds();
+            csi->Run();
+            idleTicks.Add(GetNanoseconds() - start);
+        }
+
+        printf("  %-28s %8.1f ns per event (p50 tick %.1f us with input, %.1f us without)\n", isUnmappedOnly ? "unmapped events" : "MCU traffic",
+               (busyTicks.GetPercentile(0.5) - idleTicks.GetPercentile(0.5)) / numEventsPerTick, busyTicks.GetPercentile(0.5) / 1000.0, idleTicks.GetPercentile(0.5) / 1000.0);
+    }
+
+    ReaperStub::DestroyCSI(csi);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// latency -- from the start of the Run() that sees a button press or fader move to the REAPER call it makes
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void LatencyScenario(const HarnessOptions &options)
+{
+    FixtureOptions fixtureOptions;
+    fixtureOptions.numFXZoneFiles = 2;
+
+    string resourcePath = WriteFixture(GetFixtureFolder("latency"), fixtureOptions);
+
+    ReaperStub::Start();
+    ReaperStub::SetProject(options.numTracks, 2, 64);
+
+    CSurfIntegrator *csi = ReaperStub::CreateCSI(resourcePath);
+
+    printf("latency: %d presses and %d fader moves each, %d tracks\n", options.numTicks / 2, options.numTicks / 2, options.numTracks);
+
+    for (bool isFXFocused : { false, true })
+    {
+        // a focused FX zone comes ahead of the Home zone, input for the track widgets has to get past it
+        ReaperStub::SetFocusedFX(isFXFocused ? 0 : -1, 0);
+
+        for (int tick = 0; tick < 100; ++tick) // settle the zone activation and its full refresh
+        {
+            ReaperStub::AdvanceTime(33);
+            csi->Run();
+        }
+
+        Distribution buttonLatencies, faderLatencies;
+
+        for (int tick = 0; tick < options.numTicks; ++tick)
+        {
+            int channel = (tick / 4) % 8;
+
+            if (tick % 4 == 0)
+                ReaperStub::GetMidiInput(0)->Queue(0x90, 0x10 + channel, 0x7f); // Mute pressed
+            else if (tick % 4 == 1)
+                ReaperStub::GetMidiInput(0)->Queue(0x90, 0x10 + channel, 0x00); // and released
+            else
+                ReaperStub::GetMidiInput(0)->Queue(0xe0 + channel, tick & 0x7f, (tick >> 3) & 0x7f);
+
+            ReaperStub::AdvanceTime(33);
+
+            long long start = GetNanoseconds();
+            csi->Run();
+
+            if (tick % 4 == 0)
+                buttonLatencies.Add((ReaperStub::GetLastWriteTime() - start) / 1000.0);
+            else if (tick % 4 > 1)
+                faderLatencies.Add((ReaperStub::GetLastWriteTime() - start) / 1000.0);
+        }
+
+        printf("  %s\n", isFXFocused ? "focused FX zone active" : "Home zone only");
+        buttonLatencies.Print("Mute to OnMuteChange", "us");
+        faderLatencies.Print("Fader to OnVolumeChange", "us");
+    }
+
+    ReaperStub::DestroyCSI(csi);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// osc -- a loopback UDP flood of fader moves, received on the main thread or the OSCReceiveThread
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void OSCScenario(const HarnessOptions &options)
+{
+    ReaperStub::Start();
+    ReaperStub::SetProject(options.numTracks, 2, 64);
+
+    printf("osc: %d ticks, a burst of fader moves before each, one message per datagram, 2ms for them to arrive\n", options.numTicks);
+
+    int pass = 0;
+
+    for (int burstSize : { 100, 1000 })
+    {
+        for (bool isReceiveThread : { false, true })
+        {
+            FixtureOptions fixtureOptions;
+            fixtureOptions.numMidiSurfaces = 0;
+            fixtureOptions.numOSCSurfaces = 1;
+            fixtureOptions.oscReceivePort = 20000 + getpid() % 20000 + pass++;
+            fixtureOptions.isOSCReceiveThread = isReceiveThread;
+
+            CSurfIntegrator *csi = ReaperStub::CreateCSI(WriteFixture(GetFixtureFolder("osc"), fixtureOptions));
+            FakeOSCDevice device(fixtureOptions.oscReceivePort);
+            char address[64];
+
+            Distribution tickTimes;
+            long long numSent = 0;
+            long long numDispatched = GetCallCount("CSurf_OnVolumeChange");
+
+            for (int tick = -10; tick < options.numTicks; ++tick) // the first 10 settle the initial full refresh
+            {
+                for (int i = 0; i < burstSize; ++i)
+                {
+                    snprintf(address, sizeof(address), "/track/%d/volume", i % 8 + 1);
+                    numSent += device.Send(address, ((tick + i) % 1000) / 1000.0f);
+                }
+
+                usleep(2000);
+                ReaperStub::AdvanceTime(33);
+
+                long long start = GetNanoseconds();
+                csi->Run();
+
+                if (tick >= 0)
+                    tickTimes.Add((GetNanoseconds() - start) / 1000.0);
+            }
+
+            for (int tick = 0; tick < 10; ++tick) // what is still queued
+            {
+                usleep(5000);
+                csi->Run();
+            }
+
+            numDispatched = GetCallCount("CSurf_OnVolumeChange") - numDispatched;
+
+            char name[64];
+            snprintf(name, sizeof(name), "%d per burst, %s", burstSize, isReceiveThread ? "thread" : "main thread");
+            tickTimes.Print(name, "us");
+            printf("  %-28s %lld of %lld messages dispatched\n", "", numDispatched, numSent);
+
+            ReaperStub::DestroyCSI(csi);
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// bundles -- OSC feedback for a 32 channel layout, one datagram per message against MaxBundleSize
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void BundlesScenario(const HarnessOptions &options)
+{
+    const int numChannels = 32;
+
+    ReaperStub::Start();
+    ReaperStub::SetProject(numChannels, 2, 64);
+
+    printf("bundles: %d ticks, automation moving all %d faders of an OSC layout, received on localhost\n", options.numTicks, numChannels);
+
+    int pass = 0;
+
+    for (int maxBundleSize : { 0, 1472 })
+    {
+        FixtureOptions fixtureOptions;
+        fixtureOptions.numMidiSurfaces = 0;
+        fixtureOptions.numOSCSurfaces = 1;
+        fixtureOptions.numChannels = numChannels;
+        fixtureOptions.oscReceivePort = 20000 + getpid() % 20000 + pass;
+        fixtureOptions.oscTransmitPort = fixtureOptions.oscReceivePort + 100;
+        fixtureOptions.maxBundleSize = maxBundleSize;
+        pass++;
+
+        CSurfIntegrator *csi = ReaperStub::CreateCSI(WriteFixture(GetFixtureFolder("bundles"), fixtureOptions));
+        FakeOSCDevice device(fixtureOptions.oscReceivePort, fixtureOptions.oscTransmitPort);
+
+        Distribution sendCalls, datagrams, cpuTimes;
+        long long numMessages = 0;
+
+        for (int tick = -10; tick < options.numTicks; ++tick) // the first 10 settle the initial full refresh
+        {
+            for (int i = 0; i < numChannels; ++i)
+                ReaperStub::SetTrackVolume(i, 0.25 + ((tick + i) % 100) / 200.0);
+
+            ReaperStub::AdvanceTime(33);
+            device.Receive();
+
+            long long calls = SendCallCounter::GetCalls();
+            long long sent = SendCallCounter::GetDatagrams();
+            long long messages = device.GetNumMessages();
+            long long start = GetThreadCPUNanoseconds();
+            csi->Run();
+            long long cpuTime = GetThreadCPUNanoseconds() - start;
+            device.Receive();
+
+            if (tick >= 0)
+            {
+                sendCalls.Add(SendCallCounter::GetCalls() - calls);
+                datagrams.Add(SendCallCounter::GetDatagrams() - sent);
+                cpuTimes.Add(cpuTime / 1000.0);
+                numMessages += device.GetNumMessages() - messages;
+            }
+        }
+
+        printf("  MaxBundleSize=%d, %.1f messages received per tick\n", maxBundleSize, (double)numMessages / options.numTicks);
+        sendCalls.Print("send calls per tick", "");
+        datagrams.Print("datagrams per tick", "");
+        cpuTimes.Print("Run() CPU time", "us");
+
+        ReaperStub::DestroyCSI(csi);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// tokenizer -- trimming and tokenizing every line of a 10,000 zone library, LineTokenizer against the reference
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void TokenizerScenario(const HarnessOptions &options)
+{
+    FixtureOptions fixtureOptions;
+    fixtureOptions.numFXZoneFiles = 10000;
+
+    string resourcePath = WriteFixture(GetFixtureFolder("tokenizer"), fixtureOptions);
+
+    string library;
+    for (auto &entry : filesystem::recursive_directory_iterator(resourcePath + "/CSI/Surfaces"))
+        if (entry.is_regular_file())
+            library += string(istreambuf_iterator<char>(ifstream(entry.path(), ios::binary).rdbuf()), istreambuf_iterator<char>());
+
+    long long numLines = count(library.begin(), library.end(), '\n');
+
+    printf("tokenizer: %.1f MB, %lld lines\n", library.size() / 1e6, numLines);
+
+    for (bool isReference : { true, false })
+    {
+        LineTokenizer tokenizer;
+        string line;
+        vector<string> tokens;
+        long long numTokens = 0;
+
+        long long allocations = AllocationCounter::GetCount();
+        long long start = GetNanoseconds();
+
+        for (size_t lineStart = 0, lineEnd; lineStart < library.size(); lineStart = lineEnd + 1)
+        {
+            lineEnd = library.find('\n', lineStart);
+            if (lineEnd == string::npos)
+                lineEnd = library.size();
+
+            if (isReference) // as each parser did it: a copy of the line, trimmed by appending, then istream >> quoted()
+            {
+                line = library.substr(lineStart, lineEnd - lineStart);
+                ReferenceTrimLine(line);
+                if (line.empty())
+                    continue;
+                tokens.clear();
+                ReferenceGetTokens(tokens, line);
+                numTokens += tokens.size();
+            }
+            else
+            {
+                line.assign(library, lineStart, lineEnd - lineStart);
+                TrimLine(line);
+                if (line.empty())
+                    continue;
+                numTokens += tokenizer.Tokenize(line).size();
+            }
+        }
+
+        double milliseconds = (GetNanoseconds() - start) / 1e6;
+
+        printf("  %-28s %8.1f MB/s %8.2f M lines/s %12lld allocations %12lld tokens\n", isReference ? "reference" : "TrimLine + LineTokenizer",
+               library.size() / 1e3 / milliseconds, numLines / 1e3 / milliseconds, AllocationCounter::GetCount() - allocations, numTokens);
+    }
+
+    filesystem::remove_all(GetFixtureFolder("tokenizer"));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// volume -- the fader law table against calling SLIDER2DB / DB2SLIDER for each conversion
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void VolumeScenario(const HarnessOptions &options)
+{
+    ReaperStub::Start();
+    BuildVolumeTable();
+
+    const int numValues = 4096;
+    const int numPasses = 2000;
+
+    vector<double> normalizedValues, vols;
+    for (int i = 0; i < numValues; ++i)
+    {
+        normalizedValues.push_back((i * 2654435761u % 1000003) / 1000003.0); // scattered, as faders and meters are
+        vols.push_back(DB2VAL(SLIDER2DB(normalizedValues.back() * 1000.0)));
+    }
+
+    double sink = 0.0;
+    long long start;
+
+    printf("volume: %d conversions each\n", numValues * numPasses);
+
+    start = GetNanoseconds();
+    for (int pass = 0; pass < numPasses; ++pass)
+        for (int i = 0; i < numValues; ++i)
+            sink += DB2VAL(SLIDER2DB(normalizedValues[i] * 1000.0));
+    printf("  %-44s %8.2f ns\n", "DB2VAL(SLIDER2DB())", (GetNanoseconds() - start) / (double)(numValues * numPasses));
+
+    start = GetNanoseconds();
+    for (int pass = 0; pass < numPasses; ++pass)
+        for (int i = 0; i < numValues; ++i)
+            sink += normalizedToVol(normalizedValues[i]);
+    printf("  %-44s %8.2f ns\n", "normalizedToVol", (GetNanoseconds() - start) / (double)(numValues * numPasses));
+
+    start = GetNanoseconds();
+    for (int pass = 0; pass < numPasses; ++pass)
+        for (int i = 0; i < numValues; ++i)
+            sink += DB2SLIDER(VAL2DB(vols[i])) / 1000.0;
+    printf("  %-44s %8.2f ns\n", "DB2SLIDER(VAL2DB())", (GetNanoseconds() - start) / (double)(numValues * numPasses));
+
+    start = GetNanoseconds();
+    for (int pass = 0; pass < numPasses; ++pass)
+        for (int i = 0; i < numValues; ++i)
+            sink += volToNormalized(vols[i]);
+    printf("  %-44s %8.2f ns\n", "volToNormalized", (GetNanoseconds() - start) / (double)(numValues * numPasses));
+
+    if (sink == 42.0) // keeps the loops from being optimised away
+        printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+    HarnessOptions options;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        string arg = argv[i];
+
+        if (arg == "--ticks" && i + 1 < argc)
+            options.numTicks = atoi(argv[++i]);
+        else if (arg == "--tracks" && i + 1 < argc)
+            options.numTracks = atoi(argv[++i]);
+        else if (arg == "--surfaces" && i + 1 < argc)
+            options.numSurfaces = atoi(argv[++i]);
+        else if (arg == "--profile")
+            options.isProfiling = true;
+        else if (arg[0] != '-')
+            options.scenario = arg;
+        else
+        {
+            fprintf(stderr, "usage: %s [run | tracks | mirror | startup | midi | latency | osc | bundles | tokenizer | volume] [--ticks N] [--tracks N] [--surfaces N] [--profile]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    ReaperStub::SetIsQuiet(true);
+
+    if (options.scenario == "run")
+        RunScenario(options);
+    else if (options.scenario == "tracks")
+        TracksScenario(options);
+    else if (options.scenario == "mirror")
+        MirrorScenario(options);
+    else if (options.scenario == "startup")
+        StartupScenario(options);
+    else if (options.scenario == "midi")
+        MidiScenario(options);
+    else if (options.scenario == "latency")
+        LatencyScenario(options);
+    else if (options.scenario == "osc")
+        OSCScenario(options);
+    else if (options.scenario == "bundles")
+        BundlesScenario(options);
+    else if (options.scenario == "tokenizer")
+        TokenizerScenario(options);
+    else if (options.scenario == "volume")
+        VolumeScenario(options);
+    else
+    {
+        fprintf(stderr, "unknown scenario %s\n", options.scenario.c_str());
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,1104 @@
+//
+//  csi_tests.cpp
+//  csi_harness
+//
+//  Unit tests run against the REAPER stub, see reaper_stub.h.
+//
+//  csi_tests [test name]
+//
+
+#include "reaper_stub.h"
+#include "fixture.h"
+#include "../reaper_csurf_integrator/handy_functions.h"
+#include "reference_tokenizer.h"
+
+#include <fstream>
+#include <random>
+#include <thread>
+#include <unordered_map>
+#include <unistd.h>
+
+static int s_numFailures = 0;
+
+#define CHECK(condition) \
+    do { if ( ! (condition)) { fprintf(stderr, "  %s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); s_numFailures++; } } while (0)
+
+#define CHECK_NEAR(a, b, tolerance) \
+    do { double a_ = (a), b_ = (b); if (fabs(a_ - b_) > (tolerance)) { fprintf(stderr, "  %s:%d: %s = %.9g, %s = %.9g, off by more than %g\n", __FILE__, __LINE__, #a, a_, #b, b_, (double)(tolerance)); s_numFailures++; } } while (0)
+
+static string GetFixtureFolder(const char *name) { return "/tmp/csi_tests_" + to_string(getpid()) + "_" + name; }
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Volume table
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// against whatever SLIDER2DB / DB2SLIDER REAPER installed, here the stub's, not against a law of our own
+static void CheckVolumeTableAgainstReaper()
+{
+    for (int i = 0; i < VolumeTable::SIZE; ++i) // the positions a 14 bit fader sends are exact, to rounding
+    {
+        double normalized = i / (double)(VolumeTable::SIZE - 1);
+        CHECK_NEAR(VAL2DB(normalizedToVol(normalized)), SLIDER2DB(normalized * 1000.0), 1e-9);
+
+        // and so is the way back from each of them
+        const VolumeTable &table = GetVolumeTable();
+        if (i > 0 && table.vols[i] > table.vols[i - 1])
+            CHECK_NEAR(volToNormalized(table.vols[i]), normalized, 1e-12);
+    }
+
+    double maxDBError = 0.0;
+    double maxNormalizedError = 0.0;
+
+    for (int i = 0; i <= 100000; ++i) // and in between, off the table's grid
+    {
+        double normalized = (i + 0.37) / 100001.0;
+
+        double db = SLIDER2DB(normalized * 1000.0);
+        if (db > -100.0) // below that the dB error grows without being audible or visible on a fader
+            maxDBError = max(maxDBError, fabs(VAL2DB(normalizedToVol(normalized)) - db));
+
+        double vol = DB2VAL(db);
+        maxNormalizedError = max(maxNormalizedError, fabs(volToNormalized(vol) - DB2SLIDER(VAL2DB(vol)) / 1000.0));
+    }
+
+    CHECK(maxDBError < 0.01);
+    CHECK(maxNormalizedError <= 1.0 / (VolumeTable::SIZE - 1));
+
+    CHECK(volToNormalized(0.0) == 0.0);
+    CHECK(volToNormalized(100.0) == 1.0);
+    CHECK(normalizedToVol(-1.0) == normalizedToVol(0.0));
+    CHECK(normalizedToVol(2.0) == normalizedToVol(1.0));
+}
+
+static void TestVolumeTable()
+{
+    ReaperStub::SetFaderMaxDB(12.0);
+    CSurfIntegrator *csi = ReaperStub::CreateCSI(WriteFixture(GetFixtureFolder("volume"), FixtureOptions()));
+
+    CHECK_NEAR(VAL2DB(normalizedToVol(1.0)), 12.0, 1e-9);
+    CheckVolumeTableAgainstReaper();
+
+    // the fader range preference changes, REAPER resets the surfaces
+    ReaperStub::SetFaderMaxDB(6.0);
+    csi->Extended(CSURF_EXT_RESET, NULL, NULL, NULL);
+
+    CHECK_NEAR(VAL2DB(normalizedToVol(1.0)), 6.0, 1e-9);
+    CheckVolumeTableAgainstReaper();
+
+    ReaperStub::DestroyCSI(csi);
+    ReaperStub::SetFaderMaxDB(12.0);
+    filesystem::remove_all(GetFixtureFolder("volume"));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Track colors
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Refresh() runs every tick, a 15Hz surface asks for its colors every other one
+static void TestTrackColors()
+{
+    TrackColors colors;
+    StubTrack *stubTrack = ReaperStub::GetTrack(0);
+    MediaTrack *track = ReaperStub::ToMediaTrack(stubTrack);
+
+    stubTrack->color = 0x1000000 | 0x336699;
+    colors.Refresh();
+    CHECK(colors.GetColor(track).b == 0x33);
+
+    unsigned int seenGeneration = colors.GetGeneration();
+
+    for (int tick = 0; tick < 10; ++tick)
+    {
+        ReaperStub::AdvanceTime(33);
+        colors.Refresh();
+
+        if (tick % 2)
+        {
+            CHECK( ! colors.HasChanged(track, seenGeneration));
+            seenGeneration = colors.GetGeneration();
+        }
+    }
+
+    stubTrack->color = 0x1000000 | 0x112233;
+    ReaperStub::AdvanceTime(33);
+    colors.Refresh();
+    CHECK(colors.HasChanged(track, seenGeneration));
+    CHECK(colors.GetColor(track).b == 0x11);
+
+    // nobody asks for the track any more, it stops being polled
+    ReaperStub::AdvanceTime(s_trackColorExpiry + 33);
+    colors.Refresh();
+    ReaperStub::ResetCallCounts();
+    colors.Refresh();
+    CHECK(ReaperStub::GetTotalCalls() == 0);
+
+    stubTrack->color = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// MIDI output scheduler
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+static vector<vector<unsigned char>> DrainScheduler(MidiOutputScheduler &scheduler)
+{
+    vector<vector<unsigned char>> sent;
+    scheduler.DrainUnpaced([&sent](const unsigned char *message, int size) { sent.push_back(vector<unsigned char>(message, message + size)); });
+    return sent;
+}
+
+// a newer message replaces a queued one only when both address the same target
+static void TestMidiOutputScheduler()
+{
+    MidiOutputScheduler scheduler(3125, 100);
+
+    // Faderport 8 scribble strips, four rows of the same length on each of two channels
+    for (int channel = 0; channel < 2; ++channel)
+        for (int row = 0; row < 4; ++row)
+        {
+            unsigned char message[] = { 0xF0, 0x00, 0x01, 0x06, 0x02, 0x12, (unsigned char)channel, (unsigned char)row, 0x00, 'a', (unsigned char)('0' + row), 0xF7 };
+            scheduler.Queue(message, sizeof(message));
+        }
+
+    // Launchpad RGB pads
+    for (int pad = 11; pad < 19; ++pad)
+    {
+        unsigned char message[] = { 0xF0, 0x00, 0x20, 0x29, 0x02, 0x0D, 0x03, 0x03, (unsigned char)pad, 0x7F, 0x00, 0x00, 0xF7 };
+        scheduler.Queue(message, sizeof(message));
+    }
+
+    // SysEx of a layout the scheduler doesn't know, twice the same
+    unsigned char unknown[] = { 0xF0, 0x00, 0x02, 0x38, 0x01, 0x05, 0x10, 0x20, 0x30, 0xF7 };
+    scheduler.Queue(unknown, sizeof(unknown));
+    scheduler.Queue(unknown, sizeof(unknown));
+
+    CHECK(scheduler.GetQueueDepth(MidiOutputScheduler::DisplayLane) == 18);
+    CHECK(DrainScheduler(scheduler).size() == 18);
+    CHECK(scheduler.GetAndResetSupersededCount() == 0);
+    CHECK(scheduler.IsEmpty());
+
+    // the same row, pad and MCU display position again, only the latest of each is sent
+    for (int i = 0; i < 3; ++i)
+    {
+        unsigned char fpRow[] = { 0xF0, 0x00, 0x01, 0x06, 0x02, 0x12, 0x03, 0x01, 0x00, (unsigned char)('0' + i), 0xF7 };
+        unsigned char pad[] = { 0xF0, 0x00, 0x20, 0x29, 0x02, 0x0D, 0x03, 0x03, 0x51, (unsigned char)i, 0x00, 0x00, 0xF7 };
+        unsigned char mcuText[] = { 0xF0, 0x00, 0x00, 0x66, 0x14, 0x12, 0x07, (unsigned char)('0' + i), 0xF7 };
+        unsigned char fader[] = { 0xE2, (unsigned char)i, 0x40 };
+        scheduler.Queue(fpRow, sizeof(fpRow));
+        scheduler.Queue(pad, sizeof(pad));
+        scheduler.Queue(mcuText, sizeof(mcuText));
+        scheduler.Queue(fader, sizeof(fader));
+    }
+
+    vector<vector<unsigned char>> sent = DrainScheduler(scheduler);
+    CHECK(sent.size() == 4);
+    CHECK(scheduler.GetAndResetSupersededCount() == 8);
+    CHECK(sent.size() == 4 && sent[0][1] == 2 && sent[1][9] == '2' && sent[2][9] == 2 && sent[3][7] == '2'); // control lane first
+
+    // queueing and draining a tick's worth runs without touching the heap once the lanes have grown
+    long long allocations = 0;
+
+    for (int tick = 0; tick < 100; ++tick)
+    {
+        if (tick == 10)
+            allocations = AllocationCounter::GetCount();
+
+        for (int channel = 0; channel < 8; ++channel)
+        {
+            unsigned char fpRow[] = { 0xF0, 0x00, 0x01, 0x06, 0x02, 0x12, (unsigned char)channel, 0x00, 0x00, (unsigned char)('0' + tick % 10), 0xF7 };
+            unsigned char fader[] = { (unsigned char)(0xE0 + channel), (unsigned char)tick, 0x40 };
+            scheduler.Queue(fpRow, sizeof(fpRow));
+            scheduler.Queue(fader, sizeof(fader));
+        }
+
+        scheduler.DrainUnpaced([](const unsigned char *message, int size) {});
+    }
+
+    CHECK(AllocationCounter::GetCount() - allocations == 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// OSC address hash collisions
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// the receive thread hands addresses over with their FNV-1a hash, two different ones can share it
+static void FindOSCHashCollision(string &first, string &second)
+{
+    unordered_map<unsigned int, int> indexByHash;
+    char address[64];
+
+    for (int i = 0; ; ++i)
+    {
+        snprintf(address, sizeof(address), "/harness/%d", i);
+        auto result = indexByHash.insert(make_pair(GetOSCAddressHash(address), i));
+
+        if ( ! result.second)
+        {
+            first = "/harness/" + to_string(result.first->second);
+            second = address;
+            return;
+        }
+    }
+}
+
+// runs CSI until the track's volume moves off 1.0 or a second has passed
+static bool WaitForVolumeChange(CSurfIntegrator *csi, int trackIndex)
+{
+    for (int i = 0; i < 1000 && ReaperStub::GetTrack(trackIndex)->volume == 1.0; ++i)
+    {
+        usleep(1000);
+        ReaperStub::AdvanceTime(33);
+        csi->Run();
+    }
+
+    return ReaperStub::GetTrack(trackIndex)->volume != 1.0;
+}
+
+static void CheckOSCHashCollision(const char *fixtureName, int portOffset, const string &sentAddress, const string &faderAddresses)
+{
+    FixtureOptions options;
+    options.numMidiSurfaces = 0;
+    options.numOSCSurfaces = 1;
+    options.oscReceivePort = 20000 + getpid() % 20000 + portOffset;
+    options.isOSCReceiveThread = true;
+
+    string resourcePath = WriteFixture(GetFixtureFolder(fixtureName), options);
+    ofstream(resourcePath + "/CSI/Surfaces/OSC/Surface.txt") << faderAddresses << "Widget Fader3\n\tControl /sentinel\nWidgetEnd\n";
+
+    for (int i = 0; i < 3; ++i)
+        ReaperStub::GetTrack(i)->volume = 1.0;
+
+    CSurfIntegrator *csi = ReaperStub::CreateCSI(resourcePath);
+    FakeOSCDevice device(options.oscReceivePort);
+
+    // the datagrams arrive in order, once the sentinel has moved track 3 the colliding address has been dispatched too
+    CHECK(device.Send(sentAddress.c_str(), 0.3f));
+    CHECK(device.Send("/sentinel", 0.3f));
+    CHECK(WaitForVolumeChange(csi, 2));
+
+    ReaperStub::DestroyCSI(csi);
+    filesystem::remove_all(GetFixtureFolder(fixtureName));
+}
+
+static void TestOSCHashCollision()
+{
+    string first, second;
+    FindOSCHashCollision(first, second);
+
+    CHECK(first != second);
+    CHECK(GetOSCAddressHash(first.c_str()) == GetOSCAddressHash(second.c_str()));
+
+    // an unknown address sharing a known one's hash is dropped
+    CheckOSCHashCollision("osc_unknown", 0, second, "Widget Fader1\n\tControl " + first + "\nWidgetEnd\n\n");
+    CHECK(ReaperStub::GetTrack(0)->volume == 1.0);
+
+    // two known addresses sharing a hash each reach their own widget
+    CheckOSCHashCollision("osc_known", 1, second, "Widget Fader1\n\tControl " + first + "\nWidgetEnd\n\nWidget Fader2\n\tControl " + second + "\nWidgetEnd\n\n");
+    CHECK(ReaperStub::GetTrack(0)->volume == 1.0);
+    CHECK(ReaperStub::GetTrack(1)->volume != 1.0);
+
+    for (int i = 0; i < 3; ++i)
+        ReaperStub::GetTrack(i)->volume = 1.0;
+}
+
+// more than the receive thread's queue holds arrives before the main thread runs, each fader still ends up where it was sent last
+static void TestOSCInputOverflow()
+{
+    FixtureOptions options;
+    options.numMidiSurfaces = 0;
+    options.numOSCSurfaces = 1;
+    options.oscReceivePort = 20000 + getpid() % 20000 + 2;
+    options.isOSCReceiveThread = true;
+
+    CSurfIntegrator *csi = ReaperStub::CreateCSI(WriteFixture(GetFixtureFolder("osc_overflow"), options));
+    FakeOSCDevice device(options.oscReceivePort);
+    char address[64];
+
+    csi->GetProfiler().SetIsEnabled(true);
+
+    auto getValue = [](int i, int track) { return 0.05f + ((i * 7 + track * 13) % 90) / 100.0f; };
+    const int numRounds = 750;
+
+    for (int i = 0; i < numRounds; ++i)
+    {
+        for (int track = 0; track < 8; ++track)
+        {
+            snprintf(address, sizeof(address), "/track/%d/volume", track + 1);
+            CHECK(device.Send(address, getValue(i, track)));
+        }
+
+        if (i % 10 == 0)
+            usleep(1000); // the socket's own buffer doesn't overflow
+    }
+
+    usleep(50000);
+
+    for (int i = 0; i < 5; ++i)
+    {
+        ReaperStub::AdvanceTime(33);
+        csi->Run();
+        usleep(10000);
+    }
+
+    for (int track = 0; track < 8; ++track)
+        CHECK_NEAR(volToNormalized(ReaperStub::GetTrack(track)->volume), getValue(numRounds - 1, track), 0.001);
+
+    CHECK(csi->GetProfiler().GetHistogram("OSCIO/OSC" + to_string(options.oscReceivePort) + "/InputDropsPerTick")->GetMax() > 0);
+
+    csi->GetProfiler().SetIsEnabled(false);
+
+    ReaperStub::DestroyCSI(csi);
+    filesystem::remove_all(GetFixtureFolder("osc_overflow"));
+
+    for (int i = 0; i < 8; ++i)
+        ReaperStub::GetTrack(i)->volume = 1.0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Line tokenizer
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// returns false, after reporting it, at the first line the tokenizer and the reference disagree on
+static bool CheckLineTokenizer(LineTokenizer &tokenizer, const string &line)
+{
+    string trimmed = line, referenceTrimmed = line;
+    TrimLine(trimmed);
+    ReferenceTrimLine(referenceTrimmed);
+
+    vector<string> referenceTokens, referenceFields;
+    ReferenceGetTokens(referenceTokens, line);
+    ReferenceGetTokens(referenceFields, line, '+');
+
+    const vector<string_view> &tokens = tokenizer.Tokenize(line);
+    bool isTerminated = true;
+    for (auto &token : tokens)
+        isTerminated = isTerminated && token.data()[token.size()] == 0;
+    bool isSame = isTerminated && vector<string>(tokens.begin(), tokens.end()) == referenceTokens;
+
+    const vector<string_view> &fields = tokenizer.Split(line, '+');
+    isSame = isSame && vector<string>(fields.begin(), fields.end()) == referenceFields && trimmed == referenceTrimmed;
+
+    if ( ! isSame)
+        fprintf(stderr, "  LineTokenizer and the reference differ on [%s]\n", line.c_str());
+
+    return isSame;
+}
+
+// the same tokens as istream >> quoted(), the same fields as getline(), NUL terminated, on random lines
+static void TestLineTokenizer()
+{
+    LineTokenizer tokenizer;
+
+    const char *lines[] = { "", "   ", "Widget Fader1", "  Zone \"Home\"  // comment", "\"a \\\"b\\\" c\" d", "\"\"", "\"unterminated", "a\\", "Shift+Control+Fader1", "+a++b+", "/track/1/volume 0.5" };
+
+    for (auto line : lines)
+        CHECK(CheckLineTokenizer(tokenizer, line));
+
+    mt19937 random(1);
+    const char alphabet[] = "ab /\"\\\t+=x\r";
+
+    bool isSame = true;
+
+    for (int i = 0; i < 200000 && isSame; ++i)
+    {
+        string line;
+        for (int length = random() % 16; length > 0; --length)
+            line += alphabet[random() % (sizeof(alphabet) - 1)];
+
+        isSame = CheckLineTokenizer(tokenizer, line);
+    }
+
+    CHECK(isSame);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Tokenized file cache
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+static bool GetIsSame(const TokenizedFile &file, const TokenizedFile &other)
+{
+    if (file.lines.size() != other.lines.size() || file.contentHash != other.contentHash)
+        return false;
+
+    for (int i = 0; i < file.lines.size(); ++i)
+    {
+        const TokenizedLine &line = file.lines[i];
+        const TokenizedLine &otherLine = other.lines[i];
+
+        if (line.lineNumber != otherLine.lineNumber || line.line != otherLine.line || line.tokens != otherLine.tokens || line.rawTokens != otherLine.rawTokens)
+            return false;
+    }
+
+    return true;
+}
+
+// what the text parsers made of each line before the cache
+static bool CheckAgainstReference(const TokenizedFile &file, const string &contents)
+{
+    istringstream stream(contents);
+    string rawLine;
+    int lineNumber = 0;
+    int lineIndex = 0;
+
+    while (getline(stream, rawLine))
+    {
+        lineNumber++;
+
+        string line = rawLine;
+        ReferenceTrimLine(line);
+
+        vector<string> tokens;
+        ReferenceGetTokens(tokens, line);
+
+        if (tokens.size() == 0)
+            continue;
+
+        if (lineIndex >= file.lines.size())
+            return false;
+
+        const TokenizedLine &tokenizedLine = file.lines[lineIndex++];
+
+        vector<string> rawTokens;
+        ReferenceGetTokens(rawTokens, rawLine);
+
+        if (tokenizedLine.lineNumber != lineNumber || tokenizedLine.line != line || tokenizedLine.tokens != tokens || tokenizedLine.GetRawTokens() != rawTokens)
+            return false;
+    }
+
+    return lineIndex == file.lines.size();
+}
+
+static string GetCacheFile(const string &cacheFolder)
+{
+    for (auto &entry : filesystem::directory_iterator(cacheFolder))
+        if (entry.path().extension() == ".tok")
+            return entry.path().string();
+
+    return "";
+}
+
+// a cache file loads as what the source parses to, a damaged one is parsed over and a touched but unchanged source still loads
+static void TestTokenizedFileCache()
+{
+    string folder = GetFixtureFolder("tokenized");
+    string cacheFolder = folder + "/Cache/";
+    string filePath = folder + "/Surface.txt";
+
+    const string contents =
+        "// an OSC surface\n"
+        "\n"
+        "Widget Fader1   // first fader\n"
+        "\tControl /track/1/volume\n"
+        "\tFB_Processor  /track/1/volume\n"
+        "WidgetEnd\n"
+        "   \n"
+        "Widget \"Name 1\"\n"
+        "\tFB_Processor /track/1/name\n"
+        "WidgetEnd";
+
+    filesystem::remove_all(folder);
+    filesystem::create_directories(folder);
+    ofstream(filePath) << contents;
+
+    TokenizedFileCache cache;
+    cache.SetCacheFolder(cacheFolder);
+
+    const TokenizedFile &parsed = cache.GetFile(filePath);
+    CHECK(cache.GetNumParsed() == 1);
+    CHECK(CheckAgainstReference(parsed, contents));
+
+    // the OSC address only survives in the raw tokens
+    CHECK(parsed.lines.size() == 7 && parsed.lines[1].tokens == vector<string>({ "Control" }));
+    CHECK(parsed.lines[1].GetRawTokens() == vector<string>({ "Control", "/track/1/volume" }));
+    CHECK(parsed.lines[3].rawTokens.size() == 0); // kept only where trimming changed the tokens
+
+    cache.GetFile(filePath);
+    CHECK(cache.GetNumReused() == 1 && cache.GetNumParsed() == 1);
+
+    // a cold start, from CSI/Cache
+    {
+        TokenizedFileCache coldCache;
+        coldCache.SetCacheFolder(cacheFolder);
+        CHECK(GetIsSame(coldCache.GetFile(filePath), parsed));
+        CHECK(coldCache.GetNumLoaded() == 1 && coldCache.GetNumParsed() == 0);
+    }
+
+    // damaged: cut short anywhere, or any byte changed
+    string cacheFilePath = GetCacheFile(cacheFolder);
+    string cacheContents;
+    {
+        ifstream in(cacheFilePath, ios::binary);
+        cacheContents.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+    }
+
+    CHECK(cacheContents.size() > 0);
+
+    bool isRejected = true;
+
+    for (size_t i = 0; i < cacheContents.size() && isRejected; i += 3)
+    {
+        for (bool isTruncated : { true, false })
+        {
+            string damaged = cacheContents;
+            if (isTruncated)
+                damaged.resize(i);
+            else
+                damaged[i] ^= 0x20;
+
+            ofstream(cacheFilePath, ios::binary | ios::trunc) << damaged;
+
+            TokenizedFileCache coldCache;
+            coldCache.SetCacheFolder(cacheFolder);
+            isRejected = isRejected && GetIsSame(coldCache.GetFile(filePath), parsed) && coldCache.GetNumParsed() == 1;
+        }
+    }
+
+    CHECK(isRejected);
+
+    // touched, not edited -- the content hash vouches for the cache file, which is brought up to date
+    filesystem::last_write_time(filePath, filesystem::last_write_time(filePath) + chrono::seconds(10));
+
+    for (int i = 0; i < 2; ++i)
+    {
+        TokenizedFileCache coldCache;
+        coldCache.SetCacheFolder(cacheFolder);
+        CHECK(GetIsSame(coldCache.GetFile(filePath), parsed));
+        CHECK(coldCache.GetNumLoaded() == 1 && coldCache.GetNumParsed() == 0);
+    }
+
+    // edited, same size
+    string edited = contents;
+    edited.replace(edited.find("Fader1"), 6, "Fader2");
+    ofstream(filePath, ios::trunc) << edited;
+    filesystem::last_write_time(filePath, filesystem::last_write_time(filePath) + chrono::seconds(20));
+
+    {
+        TokenizedFileCache coldCache;
+        coldCache.SetCacheFolder(cacheFolder);
+        const TokenizedFile &file = coldCache.GetFile(filePath);
+        CHECK(coldCache.GetNumParsed() == 1 && CheckAgainstReference(file, edited));
+    }
+
+    CHECK(CheckAgainstReference(cache.GetFile(filePath), edited));
+
+    filesystem::remove_all(folder);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Zone templates
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+#define COUNT_PROPERTY_TYPE(x) + 1
+static const int s_numPropertyTypes = 0 DECLARE_PROPERTY_TYPES(COUNT_PROPERTY_TYPE);
+#undef COUNT_PROPERTY_TYPE
+
+static bool GetIsSame(ActionContext *context, ActionContext *other)
+{
+    for (int type = 1; type <= s_numPropertyTypes; ++type)
+    {
+        const char *property = context->GetWidgetProperties().get_prop((PropertyType)type);
+        const char *otherProperty = other->GetWidgetProperties().get_prop((PropertyType)type);
+
+        if ((property == NULL) != (otherProperty == NULL) || (property != NULL && strcmp(property, otherProperty)))
+            return false;
+    }
+
+    return context->GetAction() == other->GetAction() && context->GetWidget() == other->GetWidget() && context->GetZone() == other->GetZone() &&
+           context->GetParamIndex() == other->GetParamIndex() && context->GetIntParam() == other->GetIntParam() && context->GetCommandId() == other->GetCommandId() &&
+           ! strcmp(context->GetStringParam(), other->GetStringParam()) && ! strcmp(context->GetFXParamDisplayName(), other->GetFXParamDisplayName()) &&
+           context->GetRangeMinimum() == other->GetRangeMinimum() && context->GetRangeMaximum() == other->GetRangeMaximum() &&
+           context->GetDeltaValue() == other->GetDeltaValue() && context->GetSteppedValues() == other->GetSteppedValues() &&
+           context->GetAcceleratedDeltaValues() == other->GetAcceleratedDeltaValues() && context->GetAcceleratedTickCounts() == other->GetAcceleratedTickCounts() &&
+           context->GetProvideFeedback() == other->GetProvideFeedback();
+}
+
+// the zone's contexts, cloned from its template, against contexts made straight from the file's lines as CSI did before templates
+static bool CheckAgainstFile(CSurfIntegrator *csi, ControlSurface *surface, Zone *zone, const string &contents)
+{
+    map<pair<Widget *, int>, vector<ActionContext *>> expected;
+
+    istringstream stream(contents);
+    string line;
+
+    while (getline(stream, line))
+    {
+        ReferenceTrimLine(line);
+
+        vector<string> tokens;
+        ReferenceGetTokens(tokens, line);
+
+        if (tokens.size() < 2 || tokens[0] == "Zone" || tokens[1] == "NullDisplay")
+            continue;
+
+        int modifier = 0;
+        if (tokens[0].compare(0, 6, "Shift+") == 0)
+        {
+            modifier = 4; // ModifierManager's Shift
+            tokens[0].erase(0, 6);
+        }
+
+        Widget *widget = surface->GetWidgetByName(tokens[0]);
+        if (widget == NULL)
+            continue;
+
+        vector<string> params(tokens.begin() + 1, tokens.end());
+        expected[make_pair(widget, modifier)].push_back(csi->GetActionContext(tokens[1].c_str(), widget, zone, params));
+    }
+
+    if (expected.size() == 0)
+        return false;
+
+    for (auto &widgetContexts : expected)
+    {
+        const vector<ActionContext *> &contexts = zone->GetActionContexts(widgetContexts.first.first, widgetContexts.first.second);
+
+        if (contexts.size() != widgetContexts.second.size())
+            return false;
+
+        for (int i = 0; i < contexts.size(); ++i)
+            if ( ! GetIsSame(contexts[i], widgetContexts.second[i]))
+                return false;
+    }
+
+    return true;
+}
+
+// loading a zone again clones the same contexts parsing it would make, and an edited zone file gets a new template
+static void TestZoneTemplate()
+{
+    string resourcePath = WriteFixture(GetFixtureFolder("zonetemplate"), FixtureOptions());
+    string filePath = resourcePath + "/CSI/Surfaces/MCU/FXZones/Template.zon";
+
+    string contents =
+        "Zone \"VST: Template (CSI)\" \"Template\"\n"
+        "\tRotary1 FXParam 0 [ (0.001,0.002,0.004,0.008) ]\n"
+        "\tShift+Rotary1 FXParam 1 [ 0.00 0.50 1.00 ]\n"
+        "\tRotary2 FXParam 2 [ 0.20>0.80 (0.01,0.05) ]\n"
+        "\tRotary2 FXParamValueDisplay 2\n"
+        "\tDisplayUpper1 FXParamNameDisplay 0 \"Cut off\"\n"
+        "\tDisplayLower1 FXParamValueDisplay 0\n"
+        "\tShift+DisplayUpper1 FixedTextDisplay \"Resonance\" 1\n"
+        "\tFader1 FXParam 3 Feedback=No\n"
+        "\tSelect1 NullDisplay\n"
+        "ZoneEnd\n";
+
+    ofstream(filePath) << contents;
+
+    CSurfIntegrator *csi = ReaperStub::CreateCSI(resourcePath);
+
+    ControlSurface *surface = csi->GetCurrentPage()->GetSurfaces()[0];
+    ZoneManager *zoneManager = surface->GetZoneManager();
+    MediaTrack *track = ReaperStub::ToMediaTrack(ReaperStub::GetTrack(0));
+
+    zoneManager->LoadLearnFocusedFXZone(track, "VST: Template (CSI)", 0);
+    CHECK(zoneManager->GetLearnedFocusedFXZone() != NULL);
+    CHECK(CheckAgainstFile(csi, surface, zoneManager->GetLearnedFocusedFXZone(), contents));
+
+    int numZoneTemplates = zoneManager->GetNumZoneTemplates();
+
+    zoneManager->LoadLearnFocusedFXZone(track, "VST: Template (CSI)", 0); // from the template as it is
+    CHECK(CheckAgainstFile(csi, surface, zoneManager->GetLearnedFocusedFXZone(), contents));
+
+    // edited, in place -- same name, new bindings
+    contents.replace(contents.find("Rotary1 FXParam 0"), 17, "Rotary1 FXParam 7");
+    contents.replace(contents.find("\"Cut off\""), 9, "\"Cutoff\"");
+    ofstream(filePath, ios::trunc) << contents;
+    filesystem::last_write_time(filePath, filesystem::last_write_time(filePath) + chrono::seconds(10));
+
+    zoneManager->LoadLearnFocusedFXZone(track, "VST: Template (CSI)", 0);
+    Zone *zone = zoneManager->GetLearnedFocusedFXZone();
+    CHECK(CheckAgainstFile(csi, surface, zone, contents));
+    CHECK(zone->GetActionContexts(surface->GetWidgetByName("Rotary1"), 0).size() == 1 && zone->GetActionContexts(surface->GetWidgetByName("Rotary1"), 0)[0]->GetParamIndex() == 7);
+    CHECK(zoneManager->GetNumZoneTemplates() == numZoneTemplates); // replaced, not added
+
+    zoneManager->ClearLearnFocusedFXZone();
+    ReaperStub::AdvanceTime(67);
+    csi->Run();
+
+    ReaperStub::DestroyCSI(csi);
+    filesystem::remove_all(GetFixtureFolder("zonetemplate"));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Restricted text cache
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// hits, misses and texts pushed out of their slots all give what a fresh cache works out, in the caller's buffer
+static void TestRestrictedTextCache()
+{
+    RestrictedTextCache cache;
+    char buf[MEDBUF];
+
+    CHECK(cache.Get("Volume", 4, buf, sizeof(buf)) == buf && ! strcmp(buf, "Vlm"));
+    CHECK( ! strcmp(cache.Get("Track Name", 6, buf, sizeof(buf)), "TrckNm"));
+    CHECK( ! strcmp(cache.Get("Track Name", 6, buf, sizeof(buf)), "TrckNm"));
+    CHECK( ! strcmp(cache.Get("Track Name", 5, buf, sizeof(buf)), "TrckN"));
+    CHECK( ! strcmp(cache.Get("Track Name", 6, buf, 4), "Trc"));
+
+    mt19937 random(1);
+    const char alphabet[] = "aeiouTrckNm _#:.1";
+
+    vector<string> texts;
+    for (int i = 0; i < 2000; ++i)
+    {
+        string text;
+        for (int length = 1 + random() % 80; length > 0; --length) // some too long to be kept
+            text += alphabet[random() % (sizeof(alphabet) - 1)];
+        texts.push_back(text);
+    }
+
+    bool isSame = true;
+
+    for (int i = 0; i < 20000 && isSame; ++i)
+    {
+        const string &text = texts[random() % (i < 10000 ? 200 : texts.size())]; // mostly hits, then mostly misses
+        int length = 2 + random() % 8;
+
+        RestrictedTextCache freshCache;
+        char expected[MEDBUF];
+        freshCache.Get(text.c_str(), length, expected, sizeof(expected));
+
+        isSame = ! strcmp(cache.Get(text.c_str(), length, buf, sizeof(buf)), expected);
+    }
+
+    CHECK(isSame);
+
+    long long allocations = AllocationCounter::GetCount();
+
+    for (int i = 0; i < 1000; ++i)
+        cache.Get(texts[i].c_str(), 6, buf, sizeof(buf));
+
+    CHECK(AllocationCounter::GetCount() - allocations == 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// MIDI I/O thread rings
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// a stalled port fills the rings, feedback waits its turn instead of being lost and input that doesn't fit is counted
+static void TestMidiRingOverflow()
+{
+    FixtureOptions options;
+    options.isMidiIOThread = true;
+    options.midiPort = 8;
+    CSurfIntegrator *csi = ReaperStub::CreateCSI(WriteFixture(GetFixtureFolder("ringoverflow"), options));
+    FakeMidiOutput *output = ReaperStub::GetMidiOutput(8);
+
+    ReaperStub::AdvanceTime(1000);
+    csi->Run();
+    this_thread::sleep_for(chrono::milliseconds(50));
+
+    output->SetIsBlocked(true);
+
+    // every fader moves on every tick, far more than the output ring holds
+    auto getVolume = [](int i, int track) { return 0.1 + ((i * 7 + track * 13) % 100) / 100.0; };
+    const int numTicks = 1000;
+
+    for (int i = 0; i < numTicks; ++i)
+    {
+        for (int track = 0; track < 8; ++track)
+            ReaperStub::SetTrackVolume(track, getVolume(i, track));
+        ReaperStub::AdvanceTime(67);
+        csi->Run();
+    }
+
+    output->SetIsBlocked(false);
+
+    for (int i = 0; i < 20; ++i)
+    {
+        this_thread::sleep_for(chrono::milliseconds(5));
+        ReaperStub::AdvanceTime(67);
+        csi->Run();
+    }
+
+    for (int track = 0; track < 8; ++track)
+    {
+        int volInt = int(volToNormalized(getVolume(numTicks - 1, track)) * 16383.0);
+        CHECK(output->GetLastMessage(0xe0 + track) == ((volInt & 0x7f) | (volInt >> 7) << 8));
+    }
+
+    // the main thread falls behind by more than the input ring holds
+    csi->GetProfiler().SetIsEnabled(true);
+
+    for (int i = 0; i < 5000; ++i)
+        ReaperStub::GetMidiInput(8)->Queue(0x90, 0x68 + i % 8, i & 1 ? 0x00 : 0x7f); // fader touch
+
+    this_thread::sleep_for(chrono::milliseconds(50));
+    ReaperStub::AdvanceTime(67);
+    csi->Run();
+
+    CHECK(csi->GetProfiler().GetHistogram("MidiIO/MCU1/InputDropsPerTick")->GetMax() > 0);
+    CHECK(csi->GetProfiler().GetHistogram("MidiIO/MCU1/OutputDropsPerTick")->GetMax() == 0);
+
+    // a port that never comes back, the waiting output is capped and what doesn't fit is counted
+    output->SetIsBlocked(true);
+
+    for (int i = 0; i < 4000; ++i)
+    {
+        for (int track = 0; track < 8; ++track)
+            ReaperStub::SetTrackVolume(track, getVolume(i, track));
+        ReaperStub::AdvanceTime(67);
+        csi->Run();
+    }
+
+    CHECK(csi->GetProfiler().GetHistogram("MidiIO/MCU1/OutputDropsPerTick")->GetMax() > 0);
+
+    output->SetIsBlocked(false);
+    csi->GetProfiler().SetIsEnabled(false);
+
+    ReaperStub::DestroyCSI(csi);
+    filesystem::remove_all(GetFixtureFolder("ringoverflow"));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// ChangeDrivenFeedback
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// action updates over a second of ticks once everything is shown, with a second feedback action on each DisplayLower or without
+static double GetIdleActionUpdates(bool isDisplayShared)
+{
+    FixtureOptions options;
+    options.isChangeDrivenFeedback = true;
+    string resourcePath = WriteFixture(GetFixtureFolder("shared_widget"), options);
+
+    if (isDisplayShared)
+    {
+        string zonePath = resourcePath + "/CSI/Surfaces/MCU/Zones/Track.zon";
+        stringstream zone;
+        zone << ifstream(zonePath).rdbuf();
+        string text = zone.str();
+        string line = "\tDisplayLower|  TrackVolumeDisplay\n";
+        text.insert(text.find(line) + line.size(), "\tDisplayLower|  TrackPanDisplay\n");
+        ofstream(zonePath) << text;
+    }
+
+    CSurfIntegrator *csi = ReaperStub::CreateCSI(resourcePath);
+
+    for (int i = 0; i < 30; ++i)
+    {
+        ReaperStub::AdvanceTime(67);
+        csi->Run();
+    }
+
+    csi->GetProfiler().SetIsEnabled(true);
+
+    for (int i = 0; i < 15; ++i)
+    {
+        ReaperStub::AdvanceTime(67);
+        csi->Run();
+    }
+
+    ProfileHistogram *histogram = csi->GetProfiler().GetHistogram("Surface/MCU1/ActionUpdatesPerTick");
+    double numUpdates = histogram->GetMean() * histogram->GetCount();
+
+    csi->GetProfiler().SetIsEnabled(false);
+
+    ReaperStub::DestroyCSI(csi);
+    filesystem::remove_all(GetFixtureFolder("shared_widget"));
+
+    return numUpdates;
+}
+
+// two contexts showing feedback on one widget don't take each other's refresh for a change, so they settle like one does
+static void TestSharedWidgetFeedback()
+{
+    double numUpdates = GetIdleActionUpdates(false);
+    double numSharedUpdates = GetIdleActionUpdates(true);
+
+    // at most the once a second resync of the eight extra contexts
+    CHECK(numSharedUpdates - numUpdates <= 8.5);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Zone lifecycle
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+static bool GetIsIn(const vector<Zone *> &zones, Zone *zone) { return find(zones.begin(), zones.end(), zone) != zones.end(); }
+
+// focused FX, FX slot, selected track FX and Learn zones come and go with input in between, the retired ones are gone by the
+// end of the tick and nothing kept from one tick to the next names one -- run it as csi_tests_asan too, see the Makefile
+static void TestZoneLifecycle()
+{
+    FixtureOptions options;
+    options.numFXZoneFiles = 2;
+    options.numParamsPerFXZone = 16;
+    options.isChangeDrivenFeedback = true;
+    options.feedbackBudget = 200;
+
+    ReaperStub::SetProject(16, 2, 16);
+    CSurfIntegrator *csi = ReaperStub::CreateCSI(WriteFixture(GetFixtureFolder("zonelifecycle"), options));
+
+    ControlSurface *surface = csi->GetCurrentPage()->GetSurfaces()[0];
+    ZoneManager *zoneManager = surface->GetZoneManager();
+
+    auto tick = [csi](int i)
+    {
+        int channel = i % 8;
+        ReaperStub::GetMidiInput(0)->Queue(0xb0, 0x10 + channel, i & 1 ? 0x01 : 0x41); // V-Pot, an FX param while an FX zone has it
+        ReaperStub::GetMidiInput(0)->Queue(0xe0 + channel, i & 0x7f, (i >> 3) & 0x7f); // fader
+        ReaperStub::GetMidiInput(0)->Queue(0x90, 0x10 + channel, i & 1 ? 0x00 : 0x7f); // mute, pressed and released
+        ReaperStub::AdvanceTime(67); // a surface refresh each tick, MIDISurfaceRefreshRate=15
+        csi->Run();
+    };
+
+    auto selectTrack = [csi](int index)
+    {
+        for (int i = 0; i < ReaperStub::GetNumTracks(); ++i)
+            ReaperStub::GetTrack(i)->isSelected = i == index;
+
+        if (index >= 0)
+            csi->OnTrackSelection(ReaperStub::ToMediaTrack(ReaperStub::GetTrack(index)));
+    };
+
+    for (int i = 0; i < 20; ++i)
+        tick(i);
+
+    vector<Zone *> homeZones;
+    zoneManager->GetZones(homeZones);
+
+    int numManagerZones = (int)homeZones.size();
+    int numHomeZones = Zone::GetNumLiveZones();
+    int maxLiveZones = 0;
+    bool isZoneHeld = true;
+    bool isOwnerLive = true;
+    bool isLearnContextLive = true;
+
+    const char *widgetNames[] = { "Rotary1", "Rotary8", "DisplayUpper1", "DisplayLower8", "Fader1", "Mute1" };
+
+    for (int i = 0; i < 1000; ++i)
+    {
+        int track = (i / 5) % 8;
+        int fxSlot = (i / 40) % 2;
+        MediaTrack *mediaTrack = ReaperStub::ToMediaTrack(ReaperStub::GetTrack(track));
+
+        switch (i % 5)
+        {
+            case 0:
+                ReaperStub::SetFocusedFX(track, fxSlot);
+                break;
+
+            case 1:
+                zoneManager->DeclareGoFXSlot(mediaTrack, zoneManager->GetNavigatorForTrack(mediaTrack), fxSlot);
+                break;
+
+            case 2:
+                selectTrack(track);
+                zoneManager->DeclareGoZone("SelectedTrackFX"); // clears the other FX zones too
+                break;
+
+            case 3:
+                zoneManager->LoadLearnFocusedFXZone(mediaTrack, fxSlot ? "VST: Harness1 (CSI)" : "VST: Harness0 (CSI)", fxSlot);
+                break;
+
+            case 4:
+                ReaperStub::SetFocusedFX(-1, 0);
+                if (i % 10 == 4)
+                    zoneManager->ClearLearnFocusedFXZone();
+                break;
+        }
+
+        tick(i);
+
+        vector<Zone *> zones;
+        zoneManager->GetZones(zones);
+
+        vector<Zone *> ownerZones;
+        zoneManager->GetWidgetOwnerZones(ownerZones);
+
+        for (auto zone : ownerZones)
+            isOwnerLive = isOwnerLive && GetIsIn(zones, zone);
+
+        for (auto widgetName : widgetNames) // what the Learn dialog gets from GetFirstContext()
+            for (auto context : zoneManager->GetLearnFocusedFXActionContexts(surface->GetWidgetByName(widgetName), 0))
+                isLearnContextLive = isLearnContextLive && GetIsIn(zones, context->GetZone()) && context->GetAction() != NULL;
+
+        isZoneHeld = isZoneHeld && Zone::GetNumLiveZones() - numHomeZones == (int)zones.size() - numManagerZones; // none leaked
+        maxLiveZones = max(maxLiveZones, Zone::GetNumLiveZones());
+    }
+
+    CHECK(isZoneHeld);
+    CHECK(isOwnerLive);
+    CHECK(isLearnContextLive);
+
+    // at most a focused FX, an FX slot, the two selected track FX and a Learn zone on top of Home at any one time
+    CHECK(maxLiveZones > numHomeZones);
+    CHECK(maxLiveZones <= numHomeZones + 5);
+
+    ReaperStub::SetFocusedFX(-1, 0);
+    selectTrack(-1);
+    zoneManager->DeclareGoZone("SelectedTrackFX");
+    tick(0);
+
+    CHECK(Zone::GetNumLiveZones() == numHomeZones);
+
+    ReaperStub::DestroyCSI(csi);
+    ReaperStub::SetProject(16, 1, 16);
+    filesystem::remove_all(GetFixtureFolder("zonelifecycle"));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Steady state allocations
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// once the surface shows its tracks, a tick of input, feedback and meters runs without touching the heap
+static void TestSteadyStateAllocations()
+{
+    CSurfIntegrator *csi = ReaperStub::CreateCSI(WriteFixture(GetFixtureFolder("allocations"), FixtureOptions()));
+
+    auto tick = [csi](int i)
+    {
+        int value = (i * 37) & 0x3fff;
+        ReaperStub::GetMidiInput(0)->Queue(0xe0 + i % 8, value & 0x7f, value >> 7); // fader
+        ReaperStub::GetMidiInput(0)->Queue(0xb0, 0x10 + i % 8, i & 1 ? 0x01 : 0x41); // V-Pot
+        ReaperStub::GetMidiInput(0)->Queue(0x90, 0x10 + i % 8, i & 1 ? 0x00 : 0x7f); // mute, pressed and released
+        ReaperStub::SetTrackVolume(i % 8, 0.25 + (i % 100) / 100.0); // automation
+        ReaperStub::SetTrackPeaks(0.5 + 0.4 * sin(i * 0.2));
+        ReaperStub::AdvanceTime(33); // twice per MIDISurfaceRefreshRate=15 refresh
+        csi->Run();
+    };
+
+    for (int i = 0; i < 100; ++i)
+        tick(i);
+
+    long long allocations = AllocationCounter::GetCount();
+
+    for (int i = 100; i < 400; ++i)
+        tick(i);
+
+    CHECK(AllocationCounter::GetCount() - allocations == 0);
+
+    ReaperStub::DestroyCSI(csi);
+    filesystem::remove_all(GetFixtureFolder("allocations"));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// main
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+static const struct { const char *name; void (*test)(); } s_tests[] =
+{
+    { "VolumeTable", TestVolumeTable },
+    { "TrackColors", TestTrackColors },
+    { "MidiOutputScheduler", TestMidiOutputScheduler },
+    { "MidiRingOverflow", TestMidiRingOverflow },
+    { "OSCHashCollision", TestOSCHashCollision },
+    { "OSCInputOverflow", TestOSCInputOverflow },
+    { "LineTokenizer", TestLineTokenizer },
+    { "TokenizedFileCache", TestTokenizedFileCache },
+    { "ZoneTemplate", TestZoneTemplate },
+    { "RestrictedTextCache", TestRestrictedTextCache },
+    { "SharedWidgetFeedback", TestSharedWidgetFeedback },
+    { "ZoneLifecycle", TestZoneLifecycle },
+    { "SteadyStateAllocations", TestSteadyStateAllocations },
+};
+
+int main(int argc, char **argv)
+{
+    ReaperStub::SetIsQuiet(true);
+    ReaperStub::Start();
+    ReaperStub::SetProject(16, 1, 16);
+
+    int numRun = 0;
+
+    for (auto &test : s_tests)
+    {
+        if (argc > 1 && strcmp(argv[1], test.name))
+            continue;
+
+        int numFailures = s_numFailures;
+        test.test();
+        numRun++;
+
+        printf("%-40s %s\n", test.name, s_numFailures == numFailures ? "ok" : "FAILED");
+    }
+
+    printf("%d test(s), %d failed check(s)\n", numRun, s_numFailures);
+
+    return s_numFailures == 0 && numRun > 0 ? 0 : 1;
+}
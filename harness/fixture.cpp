@@ -0,0 +1,209 @@
+//
+//  fixture.cpp
+//  csi_harness
+//
+//
+
+#include "fixture.h"
+
+#include <filesystem>
+#include <fstream>
+
+using namespace std;
+
+static void WriteFile(const filesystem::path &path, const string &text)
+{
+    filesystem::create_directories(path.parent_path());
+    ofstream(path) << text;
+}
+
+// MCU layout: faders on pitch bend, V-Pots on CC 0x10+, buttons on the usual notes, scribble strips and meters over sysex / channel pressure
+static string GetMCUSurface(int numChannels)
+{
+    string text;
+    char line[256];
+
+    for (int i = 0; i < numChannels; ++i)
+    {
+        int channel = i % 8;
+
+        snprintf(line, sizeof(line), "Widget Fader%d\n\tFader14Bit e%x 7f 7f\n\tFB_Fader14Bit e%x 7f 7f\nWidgetEnd\n\n", i + 1, channel, channel);
+        text += line;
+        snprintf(line, sizeof(line), "Widget Rotary%d\n\tEncoder b0 %02x 7f\n\tFB_Encoder b0 %02x 7f\nWidgetEnd\n\n", i + 1, 0x10 + channel, 0x30 + channel);
+        text += line;
+
+        static const struct { const char *name; int note; } buttons[] = { { "RecordArm", 0x00 }, { "Solo", 0x08 }, { "Mute", 0x10 }, { "Select", 0x18 } };
+
+        for (auto &button : buttons)
+        {
+            snprintf(line, sizeof(line), "Widget %s%d\n\tPress 90 %02x 7f 90 %02x 00\n\tFB_TwoState 90 %02x 7f 90 %02x 00\nWidgetEnd\n\n",
+                     button.name, i + 1, button.note + channel, button.note + channel, button.note + channel, button.note + channel);
+            text += line;
+        }
+
+        snprintf(line, sizeof(line), "Widget DisplayUpper%d\n\tFB_MCUDisplayUpper %d\nWidgetEnd\n\n", i + 1, channel);
+        text += line;
+        snprintf(line, sizeof(line), "Widget DisplayLower%d\n\tFB_MCUDisplayLower %d\nWidgetEnd\n\n", i + 1, channel);
+        text += line;
+        snprintf(line, sizeof(line), "Widget VUMeter%d\n\tFB_MCUVUMeter %d\nWidgetEnd\n\n", i + 1, channel);
+        text += line;
+    }
+
+    text += "Widget Play\n\tPress 90 5e 7f 90 5e 00\n\tFB_TwoState 90 5e 7f 90 5e 00\nWidgetEnd\n\n";
+    text += "Widget Stop\n\tPress 90 5d 7f 90 5d 00\n\tFB_TwoState 90 5d 7f 90 5d 00\nWidgetEnd\n\n";
+    text += "Widget Record\n\tPress 90 5f 7f 90 5f 00\n\tFB_TwoState 90 5f 7f 90 5f 00\nWidgetEnd\n\n";
+    text += "Widget Shift\n\tPress 90 46 7f 90 46 00\nWidgetEnd\n\n";
+
+    return text;
+}
+
+static string GetOSCSurface(int numChannels)
+{
+    string text;
+    char line[256];
+
+    for (int i = 1; i <= numChannels; ++i)
+    {
+        snprintf(line, sizeof(line), "Widget Fader%d\n\tControl /track/%d/volume\n\tFB_Processor /track/%d/volume\nWidgetEnd\n\n", i, i, i);
+        text += line;
+        snprintf(line, sizeof(line), "Widget Pan%d\n\tControl /track/%d/pan\n\tFB_Processor /track/%d/pan\nWidgetEnd\n\n", i, i, i);
+        text += line;
+        snprintf(line, sizeof(line), "Widget Mute%d\n\tControl /track/%d/mute\n\tFB_Processor /track/%d/mute\nWidgetEnd\n\n", i, i, i);
+        text += line;
+        snprintf(line, sizeof(line), "Widget Name%d\n\tFB_Processor /track/%d/name\nWidgetEnd\n\n", i, i);
+        text += line;
+    }
+
+    return text;
+}
+
+static const char *s_mcuTrackZone =
+    "Zone \"Track\"\n"
+    "\tDisplayUpper|  TrackNameDisplay\n"
+    "\tDisplayLower|  TrackVolumeDisplay\n"
+    "\tVUMeter|       TrackOutputMeterAverageLR\n"
+    "\tFader|         TrackVolume\n"
+    "\tRotary|        TrackPan 0\n"
+    "\tRecordArm|     TrackRecordArm\n"
+    "\tSolo|          TrackSolo\n"
+    "\tMute|          TrackMute\n"
+    "\tSelect|        TrackUniqueSelect\n"
+    "ZoneEnd\n";
+
+static const char *s_oscTrackZone =
+    "Zone \"Track\"\n"
+    "\tFader|  TrackVolume\n"
+    "\tPan|    TrackPan 0\n"
+    "\tMute|   TrackMute\n"
+    "\tName|   TrackNameDisplay\n"
+    "ZoneEnd\n";
+
+static const char *s_buttonsZone =
+    "Zone \"Buttons\"\n"
+    "\tPlay    Play\n"
+    "\tStop    Stop\n"
+    "\tRecord  Record\n"
+    "ZoneEnd\n";
+
+static string GetFXZone(int index, int numChannels, int numParams)
+{
+    static const char *modifiers[] = { "", "Shift+" };
+
+    string text;
+    char line[256];
+
+    snprintf(line, sizeof(line), "Zone \"VST: Harness%d (CSI)\" \"Harness%d\"\n", index, index);
+    text += line;
+
+    for (int param = 0; param < numParams; ++param)
+    {
+        int channel = param % numChannels + 1;
+        const char *modifier = modifiers[(param / numChannels) % 2];
+
+        snprintf(line, sizeof(line), "\t%sRotary%d FXParam %d [ (0.001,0.002,0.004,0.008) ]\n", modifier, channel, param);
+        text += line;
+        snprintf(line, sizeof(line), "\t%sDisplayUpper%d FXParamNameDisplay %d \"Param%d\"\n", modifier, channel, param, param);
+        text += line;
+        snprintf(line, sizeof(line), "\t%sDisplayLower%d FXParamValueDisplay %d\n", modifier, channel, param);
+        text += line;
+    }
+
+    text += "ZoneEnd\n";
+    return text;
+}
+
+string WriteFixture(const string &baseFolder, const FixtureOptions &options)
+{
+    filesystem::remove_all(baseFolder);
+
+    filesystem::path csi = filesystem::path(baseFolder) / "CSI";
+    filesystem::path surfaces = csi / "Surfaces";
+
+    string ini = "Version=7.0\n\n";
+    string pages;
+    char line[512];
+
+    snprintf(line, sizeof(line), "PageName=Home PageFollowsMCP=Yes SynchPages=Yes ScrollLink=No ScrollSynch=No%s", options.isChangeDrivenFeedback ? " ChangeDrivenFeedback=Yes" : "");
+    pages += line;
+    if (options.meterDecay > 0.0)
+    {
+        snprintf(line, sizeof(line), " MeterDecay=%g", options.meterDecay);
+        pages += line;
+    }
+    pages += "\n";
+
+    for (int i = 0; i < options.numMidiSurfaces; ++i)
+    {
+        snprintf(line, sizeof(line), "SurfaceType=MIDI SurfaceName=MCU%d SurfaceChannelCount=%d MidiInput=%d MidiOutput=%d MIDISurfaceRefreshRate=15 MaxMIDIMesssagesPerRun=250",
+                 i + 1, options.numChannels, options.midiPort + i, options.midiPort + i);
+        ini += line;
+
+        if (options.isMidiIOThread)
+            ini += " MIDIIOThread=Yes";
+        if (options.maxMIDIBytesPerSecond > 0)
+            ini += " MaxMIDIBytesPerSecond=" + to_string(options.maxMIDIBytesPerSecond);
+        if (options.feedbackBudget > 0)
+            ini += " FeedbackBudget=" + to_string(options.feedbackBudget);
+        ini += "\n";
+
+        snprintf(line, sizeof(line), "\tSurface=MCU%d SurfaceFolder=MCU ZoneFolder=MCU FXZoneFolder=MCU StartChannel=%d\n", i + 1, options.isMirrored ? 0 : i * options.numChannels);
+        pages += line;
+    }
+
+    for (int i = 0; i < options.numOSCSurfaces; ++i)
+    {
+        // CSI keeps a surface's sockets by its name for as long as the process runs, naming it after its port lets a later CSI bind a new one
+        snprintf(line, sizeof(line), "SurfaceType=OSC SurfaceName=OSC%d SurfaceChannelCount=%d ReceiveOnPort=%d TransmitToPort=%d TransmitToIPAddress=127.0.0.1 MaxPacketsPerRun=0",
+                 options.oscReceivePort + i, options.numChannels, options.oscReceivePort + i, options.oscTransmitPort + i);
+        ini += line;
+
+        if (options.isOSCReceiveThread)
+            ini += " OSCReceiveThread=Yes";
+        if (options.maxBundleSize > 0)
+            ini += " MaxBundleSize=" + to_string(options.maxBundleSize);
+        if (options.feedbackBudget > 0)
+            ini += " FeedbackBudget=" + to_string(options.feedbackBudget);
+        ini += "\n";
+
+        snprintf(line, sizeof(line), "\tSurface=OSC%d SurfaceFolder=OSC ZoneFolder=OSC FXZoneFolder=OSC StartChannel=0\n", options.oscReceivePort + i);
+        pages += line;
+    }
+
+    WriteFile(csi / "CSI.ini", ini + "\n" + pages);
+
+    WriteFile(surfaces / "MCU" / "Surface.txt", GetMCUSurface(options.numChannels));
+    WriteFile(surfaces / "MCU" / "Zones" / "Home.zon", "Zone \"Home\"\n\tIncludedZones\n\t\t\"Track\"\n\t\t\"Buttons\"\n\tIncludedZonesEnd\nZoneEnd\n");
+    WriteFile(surfaces / "MCU" / "Zones" / "Track.zon", s_mcuTrackZone);
+    WriteFile(surfaces / "MCU" / "Zones" / "Buttons.zon", s_buttonsZone);
+    filesystem::create_directories(surfaces / "MCU" / "FXZones");
+
+    for (int i = 0; i < options.numFXZoneFiles; ++i)
+        WriteFile(surfaces / "MCU" / "FXZones" / ("Harness" + to_string(i) + ".zon"), GetFXZone(i, options.numChannels, options.numParamsPerFXZone));
+
+    WriteFile(surfaces / "OSC" / "Surface.txt", GetOSCSurface(options.numChannels));
+    WriteFile(surfaces / "OSC" / "Zones" / "Home.zon", "Zone \"Home\"\n\tIncludedZones\n\t\t\"Track\"\n\tIncludedZonesEnd\nZoneEnd\n");
+    WriteFile(surfaces / "OSC" / "Zones" / "Track.zon", s_oscTrackZone);
+    filesystem::create_directories(surfaces / "OSC" / "FXZones");
+
+    return baseFolder;
+}
@@ -0,0 +1,41 @@
+//
+//  fixture.h
+//  csi_harness
+//
+//  Writes a CSI resource folder -- CSI.ini, surface and zone files -- for the harness to load.
+//
+
+#ifndef fixture_h
+#define fixture_h
+
+#include <string>
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+struct FixtureOptions
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+{
+    int numMidiSurfaces = 1; // an MCU style surface each, on MIDI ports midiPort, midiPort + 1, ...
+    int midiPort = 0; // CSI never lets go of a port, a later CSI in the process needs ports of its own for MIDIIOThread=Yes
+    int numChannels = 8;
+    bool isMirrored = false; // every MIDI surface starts at channel 0 instead of following the one before it
+    bool isMidiIOThread = false;
+    int maxMIDIBytesPerSecond = 0;
+    int feedbackBudget = 0;
+
+    int numOSCSurfaces = 0; // OSC<port> each, listens on oscReceivePort + n and sends to oscTransmitPort + n on localhost
+    int oscReceivePort = 9100;
+    int oscTransmitPort = 9200;
+    bool isOSCReceiveThread = false;
+    int maxBundleSize = 0;
+
+    bool isChangeDrivenFeedback = false;
+    double meterDecay = 0.0;
+
+    int numFXZoneFiles = 0; // extra FX zones, only parsed at startup
+    int numParamsPerFXZone = 32;
+};
+
+// returns the resource path to hand to ReaperStub::SetResourcePath, under baseFolder which is emptied first
+std::string WriteFixture(const std::string &baseFolder, const FixtureOptions &options);
+
+#endif /* fixture_h */
@@ -0,0 +1,1067 @@
+//
+//  reaper_stub.cpp
+//  csi_harness
+//
+//
+
+#include "reaper_stub.h"
+
+#include <chrono>
+#include <thread>
+#include <utility>
+#include <dlfcn.h>
+
+extern "C" int SWELL_dllMain(HINSTANCE hInst, DWORD callMode, LPVOID _GetFunc);
+extern "C" int REAPER_PLUGIN_ENTRYPOINT(REAPER_PLUGIN_HINSTANCE hInstance, reaper_plugin_info_t *reaper_plugin_info);
+
+static std::atomic<long long> s_allocationCount(0);
+static std::atomic<long long> s_allocationBytes(0);
+
+void *operator new(size_t size)
+{
+    s_allocationCount++;
+    s_allocationBytes += size;
+
+    if (void *p = malloc(size ? size : 1))
+        return p;
+
+    throw std::bad_alloc();
+}
+
+void *operator new[](size_t size) { return operator new(size); }
+void *operator new(size_t size, const std::nothrow_t &) noexcept { try { return operator new(size); } catch (...) { return NULL; } }
+void *operator new[](size_t size, const std::nothrow_t &) noexcept { try { return operator new(size); } catch (...) { return NULL; } }
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+void operator delete[](void *p, size_t) noexcept { free(p); }
+
+long long AllocationCounter::GetCount() { return s_allocationCount; }
+long long AllocationCounter::GetBytes() { return s_allocationBytes; }
+
+static std::atomic<long long> s_sendCalls(0);
+static std::atomic<long long> s_sendDatagrams(0);
+
+template <typename Function> static Function GetNextFunction(const char *name) { return (Function)dlsym(RTLD_NEXT, name); }
+
+extern "C" ssize_t send(int fd, const void *buf, size_t len, int flags)
+{
+    static auto next = GetNextFunction<ssize_t (*)(int, const void *, size_t, int)>("send");
+    s_sendCalls++;
+    s_sendDatagrams++;
+    return next(fd, buf, len, flags);
+}
+
+extern "C" ssize_t sendto(int fd, const void *buf, size_t len, int flags, const struct sockaddr *addr, socklen_t addrlen)
+{
+    static auto next = GetNextFunction<ssize_t (*)(int, const void *, size_t, int, const struct sockaddr *, socklen_t)>("sendto");
+    s_sendCalls++;
+    s_sendDatagrams++;
+    return next(fd, buf, len, flags, addr, addrlen);
+}
+
+#ifdef __linux__
+extern "C" int sendmmsg(int fd, struct mmsghdr *msgvec, unsigned int vlen, int flags)
+{
+    static auto next = GetNextFunction<int (*)(int, struct mmsghdr *, unsigned int, int)>("sendmmsg");
+    s_sendCalls++;
+    int sent = next(fd, msgvec, vlen, flags);
+    if (sent > 0)
+        s_sendDatagrams += sent;
+    return sent;
+}
+#endif
+
+long long SendCallCounter::GetCalls() { return s_sendCalls; }
+long long SendCallCounter::GetDatagrams() { return s_sendDatagrams; }
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// StubMidiEventList
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+static int GetRecordInts(int messageSize)
+{
+    return (int)((offsetof(MIDI_event_t, midi_message) + (messageSize > 4 ? messageSize : 4) + sizeof(int) - 1) / sizeof(int));
+}
+
+void StubMidiEventList::AddItem(MIDI_event_t *evt)
+{
+    int recordInts = GetRecordInts(evt->size);
+
+    if (size_ + recordInts > (int)events_.size())
+        events_.resize((size_ + recordInts) * 2);
+
+    memcpy(&events_[size_], evt, offsetof(MIDI_event_t, midi_message) + evt->size);
+    size_ += recordInts;
+}
+
+MIDI_event_t *StubMidiEventList::EnumItems(int *bpos)
+{
+    if (*bpos >= size_)
+        return NULL;
+
+    MIDI_event_t *evt = (MIDI_event_t *)&events_[*bpos];
+    *bpos += GetRecordInts(evt->size);
+    return evt;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// FakeMidiInput
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+void FakeMidiInput::SwapBufs(unsigned int timestamp)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    read_.Empty();
+
+    int bpos = 0;
+    while (MIDI_event_t *evt = pending_.EnumItems(&bpos))
+        read_.AddItem(evt);
+
+    pending_.Empty();
+}
+
+void FakeMidiInput::Queue(unsigned char status, unsigned char d1, unsigned char d2)
+{
+    MIDI_event_t evt = { 0, 3, { status, d1, d2 } };
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_.AddItem(&evt);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// FakeMidiOutput
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+void FakeMidiOutput::SendMsg(MIDI_event_t *msg, int frame_offset)
+{
+    while (isBlocked_)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    numMessages_++;
+    numBytes_ += msg->size;
+}
+
+void FakeMidiOutput::Send(unsigned char status, unsigned char d1, unsigned char d2, int frame_offset)
+{
+    while (isBlocked_)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    numMessages_++;
+    numBytes_ += 3;
+    lastMessages_[status] = d1 | d2 << 8;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// FakeOSCDevice
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+FakeOSCDevice::FakeOSCDevice(int csiReceiveOnPort, int csiTransmitToPort)
+{
+    outSocket_.connectTo("127.0.0.1", csiReceiveOnPort);
+
+    if (csiTransmitToPort != 0)
+        inSocket_.bindTo(csiTransmitToPort);
+}
+
+bool FakeOSCDevice::Send(const char *address, float value)
+{
+    message_.init(address).pushFloat(value);
+    packetWriter_.init().addMessage(message_);
+    return outSocket_.sendPacket(packetWriter_.packetData(), packetWriter_.packetSize());
+}
+
+void FakeOSCDevice::Receive()
+{
+    if ( ! inSocket_.isOk())
+        return;
+
+    while (inSocket_.receiveNextPacket(0))
+    {
+        numDatagrams_++;
+        packetReader_.init(inSocket_.packetData(), inSocket_.packetSize());
+
+        while (packetReader_.isOk() && packetReader_.popMessage() != 0)
+            numMessages_++;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Project model
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+static string s_resourcePath;
+static IReaperControlSurface *s_surface = NULL;
+static vector<StubTrack *> s_tracks;
+static StubTrack s_masterTrack;
+static int s_project = 0; // only its address is used, as a ReaProject *
+static int s_focusedFXTrack = -1;
+static int s_focusedFXIndex = 0;
+static double s_faderMaxDB = 12.0;
+static int s_playState = 0;
+static int s_scrubMode = 0;
+static DWORD s_timeOffset = 0;
+static long long s_lastWriteTime = 0;
+static bool s_isQuiet = false;
+static int s_numConsoleMessages = 0;
+static map<int, FakeMidiInput *> s_midiInputs;
+static map<int, FakeMidiOutput *> s_midiOutputs;
+
+static map<string, long long> s_callCounts; // never erased, the stubs keep references into it
+
+#define COUNT_CALL(name) static long long &callCount = s_callCounts[name]; callCount++
+
+static void OnWrite() { s_lastWriteTime = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count(); }
+
+static StubTrack *ToStubTrack(MediaTrack *track)
+{
+    if ((StubTrack *)track == &s_masterTrack)
+        return &s_masterTrack;
+
+    for (auto stubTrack : s_tracks)
+        if ((StubTrack *)track == stubTrack)
+            return stubTrack;
+
+    return NULL;
+}
+
+static int GetTrackIndex(StubTrack *track)
+{
+    for (int i = 0; i < (int)s_tracks.size(); ++i)
+        if (s_tracks[i] == track)
+            return i;
+
+    return -1;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// REAPER API
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+static ReaProject *Stub_EnumProjects(int idx, char *projfn, int projfn_sz)
+{
+    COUNT_CALL("EnumProjects");
+    if (projfn && projfn_sz > 0)
+        projfn[0] = 0;
+    return idx <= 0 ? (ReaProject *)&s_project : NULL;
+}
+
+static const char *Stub_GetResourcePath() { COUNT_CALL("GetResourcePath"); return s_resourcePath.c_str(); }
+
+static const char *Stub_get_ini_file()
+{
+    COUNT_CALL("get_ini_file");
+    static string iniFile;
+    iniFile = s_resourcePath + "/reaper.ini";
+    return iniFile.c_str();
+}
+
+static void Stub_ShowConsoleMsg(const char *msg)
+{
+    COUNT_CALL("ShowConsoleMsg");
+    s_numConsoleMessages++;
+    if ( ! s_isQuiet)
+        fputs(msg, stderr);
+}
+
+static int Stub_RecursiveCreateDirectory(const char *path, size_t ignored)
+{
+    COUNT_CALL("RecursiveCreateDirectory");
+    std::error_code error;
+    filesystem::create_directories(path, error);
+    return 1;
+}
+
+static void *Stub_get_config_var(const char *name, int *szOut)
+{
+    COUNT_CALL("get_config_var");
+    if (strcmp(name, "scrubmode"))
+        return NULL;
+    if (szOut)
+        *szOut = sizeof(s_scrubMode);
+    return &s_scrubMode;
+}
+
+static double Stub_SLIDER2DB(double y)
+{
+    COUNT_CALL("SLIDER2DB");
+    if (y <= 0.0)
+        return -150.0;
+    double db = s_faderMaxDB + 60.0 * log10(y / 1000.0);
+    return db < -150.0 ? -150.0 : db;
+}
+
+static double Stub_DB2SLIDER(double x)
+{
+    COUNT_CALL("DB2SLIDER");
+    if (x <= -150.0)
+        return 0.0;
+    double y = 1000.0 * pow(10.0, (x - s_faderMaxDB) / 60.0);
+    return y > 1000.0 ? 1000.0 : y;
+}
+
+static int Stub_GetNumTracks() { COUNT_CALL("GetNumTracks"); return (int)s_tracks.size(); }
+static int Stub_CSurf_NumTracks(bool mcpView) { COUNT_CALL("CSurf_NumTracks"); return (int)s_tracks.size(); }
+
+static MediaTrack *Stub_GetTrack(ReaProject *proj, int trackidx)
+{
+    COUNT_CALL("GetTrack");
+    return trackidx >= 0 && trackidx < (int)s_tracks.size() ? (MediaTrack *)s_tracks[trackidx] : NULL;
+}
+
+static MediaTrack *Stub_GetMasterTrack(ReaProject *proj) { COUNT_CALL("GetMasterTrack"); return (MediaTrack *)&s_masterTrack; }
+
+static MediaTrack *Stub_CSurf_TrackFromID(int idx, bool mcpView)
+{
+    COUNT_CALL("CSurf_TrackFromID");
+    if (idx == 0)
+        return (MediaTrack *)&s_masterTrack;
+    return idx > 0 && idx <= (int)s_tracks.size() ? (MediaTrack *)s_tracks[idx - 1] : NULL;
+}
+
+static int Stub_CSurf_TrackToID(MediaTrack *track, bool mcpView)
+{
+    COUNT_CALL("CSurf_TrackToID");
+    if ((StubTrack *)track == &s_masterTrack)
+        return 0;
+    int index = GetTrackIndex((StubTrack *)track);
+    return index < 0 ? -1 : index + 1;
+}
+
+static bool Stub_ValidatePtr(void *pointer, const char *ctypename)
+{
+    COUNT_CALL("ValidatePtr");
+    if ( ! strcmp(ctypename, "MediaTrack*"))
+        return ToStubTrack((MediaTrack *)pointer) != NULL;
+    return pointer != NULL;
+}
+
+static bool Stub_IsTrackVisible(MediaTrack *track, bool mixer) { COUNT_CALL("IsTrackVisible"); return true; }
+
+static GUID *Stub_GetTrackGUID(MediaTrack *tr)
+{
+    COUNT_CALL("GetTrackGUID");
+    StubTrack *track = ToStubTrack(tr);
+    return track ? &track->guid : NULL;
+}
+
+static int Stub_GetTrackColor(MediaTrack *tr)
+{
+    COUNT_CALL("GetTrackColor");
+    StubTrack *track = ToStubTrack(tr);
+    return track ? track->color : 0;
+}
+
+static void Stub_ColorFromNative(int col, int *rOut, int *gOut, int *bOut)
+{
+    COUNT_CALL("ColorFromNative");
+    *rOut = col & 0xff;
+    *gOut = (col >> 8) & 0xff;
+    *bOut = (col >> 16) & 0xff;
+}
+
+static bool Stub_GetTrackName(MediaTrack *tr, char *bufOut, int bufOut_sz)
+{
+    COUNT_CALL("GetTrackName");
+    StubTrack *track = ToStubTrack(tr);
+    snprintf(bufOut, bufOut_sz, "%s", track ? track->name.c_str() : "");
+    return track != NULL;
+}
+
+static double Stub_GetMediaTrackInfo_Value(MediaTrack *tr, const char *parmname)
+{
+    COUNT_CALL("GetMediaTrackInfo_Value");
+    StubTrack *track = ToStubTrack(tr);
+    if (track == NULL)
+        return 0.0;
+
+    if ( ! strcmp(parmname, "D_VOL"))          return track->volume;
+    if ( ! strcmp(parmname, "D_PAN"))          return track->pan;
+    if ( ! strcmp(parmname, "D_WIDTH"))        return track->width;
+    if ( ! strcmp(parmname, "D_DUALPANL"))     return track->dualPanL;
+    if ( ! strcmp(parmname, "D_DUALPANR"))     return track->dualPanR;
+    if ( ! strcmp(parmname, "B_MUTE"))         return track->isMuted;
+    if ( ! strcmp(parmname, "I_SOLO"))         return track->solo;
+    if ( ! strcmp(parmname, "I_RECARM"))       return track->recordArm;
+    if ( ! strcmp(parmname, "I_SELECTED"))     return track->isSelected;
+    if ( ! strcmp(parmname, "B_PHASE"))        return track->isPhaseInverted;
+    if ( ! strcmp(parmname, "I_AUTOMODE"))     return track->autoMode;
+    if ( ! strcmp(parmname, "I_RECMON"))       return track->recordMonitor;
+    if ( ! strcmp(parmname, "I_RECMONITEMS"))  return track->recordMonitorItems;
+    if ( ! strcmp(parmname, "I_FXEN"))         return 1.0;
+    if ( ! strcmp(parmname, "IP_TRACKNUMBER")) return track == &s_masterTrack ? -1.0 : GetTrackIndex(track) + 1;
+
+    return 0.0;
+}
+
+static void *Stub_GetSetMediaTrackInfo(MediaTrack *tr, const char *parmname, void *setNewValue)
+{
+    COUNT_CALL("GetSetMediaTrackInfo");
+    StubTrack *track = ToStubTrack(tr);
+    if (track == NULL)
+        return NULL;
+
+    if ( ! strcmp(parmname, "P_NAME"))
+    {
+        if (setNewValue)
+            track->name = (const char *)setNewValue;
+        return (void *)track->name.c_str();
+    }
+
+    void *value = NULL;
+    size_t size = 0;
+
+    if ( ! strcmp(parmname, "D_WIDTH"))             { value = &track->width; size = sizeof(double); }
+    else if ( ! strcmp(parmname, "D_DUALPANL"))     { value = &track->dualPanL; size = sizeof(double); }
+    else if ( ! strcmp(parmname, "D_DUALPANR"))     { value = &track->dualPanR; size = sizeof(double); }
+    else if ( ! strcmp(parmname, "B_PHASE"))        { value = &track->isPhaseInverted; size = sizeof(bool); }
+    else if ( ! strcmp(parmname, "I_AUTOMODE"))     { value = &track->autoMode; size = sizeof(int); }
+    else if ( ! strcmp(parmname, "I_RECMON"))       { value = &track->recordMonitor; size = sizeof(int); }
+    else if ( ! strcmp(parmname, "I_RECMONITEMS"))  { value = &track->recordMonitorItems; size = sizeof(int); }
+    else if ( ! strcmp(parmname, "I_CUSTOMCOLOR"))  { value = &track->color; size = sizeof(int); }
+
+    if (value && setNewValue)
+    {
+        memcpy(value, setNewValue, size);
+        OnWrite();
+    }
+
+    return value;
+}
+
+static bool Stub_GetTrackUIVolPan(MediaTrack *tr, double *volumeOut, double *panOut)
+{
+    COUNT_CALL("GetTrackUIVolPan");
+    StubTrack *track = ToStubTrack(tr);
+    if (track == NULL)
+        return false;
+    *volumeOut = track->volume;
+    *panOut = track->pan;
+    return true;
+}
+
+static bool Stub_GetTrackUIPan(MediaTrack *tr, double *pan1Out, double *pan2Out, int *panmodeOut)
+{
+    COUNT_CALL("GetTrackUIPan");
+    StubTrack *track = ToStubTrack(tr);
+    if (track == NULL)
+        return false;
+    *pan1Out = track->pan;
+    *pan2Out = track->width;
+    *panmodeOut = 3;
+    return true;
+}
+
+static bool Stub_GetTrackUIMute(MediaTrack *tr, bool *muteOut)
+{
+    COUNT_CALL("GetTrackUIMute");
+    StubTrack *track = ToStubTrack(tr);
+    if (track == NULL)
+        return false;
+    *muteOut = track->isMuted;
+    return true;
+}
+
+static double Stub_Track_GetPeakInfo(MediaTrack *tr, int channel)
+{
+    COUNT_CALL("Track_GetPeakInfo");
+    StubTrack *track = ToStubTrack(tr);
+    return track ? track->peak : 0.0;
+}
+
+static bool Stub_AnyTrackSolo(ReaProject *proj)
+{
+    COUNT_CALL("AnyTrackSolo");
+    for (auto track : s_tracks)
+        if (track->solo)
+            return true;
+    return false;
+}
+
+static int Stub_CountSelectedTracks2(ReaProject *proj, bool wantmaster)
+{
+    COUNT_CALL("CountSelectedTracks2");
+    int count = wantmaster && s_masterTrack.isSelected ? 1 : 0;
+    for (auto track : s_tracks)
+        if (track->isSelected)
+            count++;
+    return count;
+}
+
+static MediaTrack *Stub_GetSelectedTrack(ReaProject *proj, int seltrackidx)
+{
+    COUNT_CALL("GetSelectedTrack");
+    for (auto track : s_tracks)
+        if (track->isSelected && seltrackidx-- == 0)
+            return (MediaTrack *)track;
+    return NULL;
+}
+
+static void Stub_SetOnlyTrackSelected(MediaTrack *tr)
+{
+    COUNT_CALL("SetOnlyTrackSelected");
+    for (auto track : s_tracks)
+    {
+        int isSelected = (MediaTrack *)track == tr;
+        if (track->isSelected != isSelected)
+        {
+            track->isSelected = isSelected;
+            if (s_surface)
+                s_surface->SetSurfaceSelected((MediaTrack *)track, isSelected);
+        }
+    }
+    OnWrite();
+}
+
+static double Stub_CSurf_OnVolumeChange(MediaTrack *tr, double volume, bool relative)
+{
+    COUNT_CALL("CSurf_OnVolumeChange");
+    StubTrack *track = ToStubTrack(tr);
+    if (track == NULL)
+        return 0.0;
+    track->volume = relative ? track->volume + volume : volume;
+    if (track->volume < 0.0)
+        track->volume = 0.0;
+    OnWrite();
+    return track->volume;
+}
+
+static double Stub_CSurf_OnPanChange(MediaTrack *tr, double pan, bool relative)
+{
+    COUNT_CALL("CSurf_OnPanChange");
+    StubTrack *track = ToStubTrack(tr);
+    if (track == NULL)
+        return 0.0;
+    track->pan = relative ? track->pan + pan : pan;
+    track->pan = track->pan < -1.0 ? -1.0 : track->pan > 1.0 ? 1.0 : track->pan;
+    OnWrite();
+    return track->pan;
+}
+
+static double Stub_CSurf_OnWidthChange(MediaTrack *tr, double width, bool relative)
+{
+    COUNT_CALL("CSurf_OnWidthChange");
+    StubTrack *track = ToStubTrack(tr);
+    if (track == NULL)
+        return 0.0;
+    track->width = relative ? track->width + width : width;
+    track->width = track->width < -1.0 ? -1.0 : track->width > 1.0 ? 1.0 : track->width;
+    OnWrite();
+    return track->width;
+}
+
+// the toggles take a negative value to mean "flip it"
+static bool Stub_CSurf_OnMuteChange(MediaTrack *tr, int mute)
+{
+    COUNT_CALL("CSurf_OnMuteChange");
+    StubTrack *track = ToStubTrack(tr);
+    if (track == NULL)
+        return false;
+    track->isMuted = mute < 0 ? ! track->isMuted : mute != 0;
+    OnWrite();
+    return track->isMuted;
+}
+
+static bool Stub_CSurf_OnSoloChange(MediaTrack *tr, int solo)
+{
+    COUNT_CALL("CSurf_OnSoloChange");
+    StubTrack *track = ToStubTrack(tr);
+    if (track == NULL)
+        return false;
+    track->solo = solo < 0 ? ! track->solo : solo;
+    OnWrite();
+    return track->solo != 0;
+}
+
+static bool Stub_CSurf_OnRecArmChange(MediaTrack *tr, int recarm)
+{
+    COUNT_CALL("CSurf_OnRecArmChange");
+    StubTrack *track = ToStubTrack(tr);
+    if (track == NULL)
+        return false;
+    track->recordArm = recarm < 0 ? ! track->recordArm : recarm;
+    OnWrite();
+    return track->recordArm != 0;
+}
+
+static bool Stub_CSurf_OnSelectedChange(MediaTrack *tr, int selected)
+{
+    COUNT_CALL("CSurf_OnSelectedChange");
+    StubTrack *track = ToStubTrack(tr);
+    if (track == NULL)
+        return false;
+    track->isSelected = selected < 0 ? ! track->isSelected : selected;
+    OnWrite();
+    return track->isSelected != 0;
+}
+
+static void Stub_CSurf_SetSurfaceVolume(MediaTrack *tr, double volume, IReaperControlSurface *ignoresurf)
+{
+    COUNT_CALL("CSurf_SetSurfaceVolume");
+    if (s_surface && s_surface != ignoresurf)
+        s_surface->SetSurfaceVolume(tr, volume);
+}
+
+static void Stub_CSurf_SetSurfacePan(MediaTrack *tr, double pan, IReaperControlSurface *ignoresurf)
+{
+    COUNT_CALL("CSurf_SetSurfacePan");
+    if (s_surface && s_surface != ignoresurf)
+        s_surface->SetSurfacePan(tr, pan);
+}
+
+static void Stub_CSurf_SetSurfaceMute(MediaTrack *tr, bool mute, IReaperControlSurface *ignoresurf)
+{
+    COUNT_CALL("CSurf_SetSurfaceMute");
+    if (s_surface && s_surface != ignoresurf)
+        s_surface->SetSurfaceMute(tr, mute);
+}
+
+static void Stub_CSurf_SetSurfaceSolo(MediaTrack *tr, bool solo, IReaperControlSurface *ignoresurf)
+{
+    COUNT_CALL("CSurf_SetSurfaceSolo");
+    if (s_surface && s_surface != ignoresurf)
+        s_surface->SetSurfaceSolo(tr, solo);
+}
+
+static void Stub_CSurf_SetSurfaceRecArm(MediaTrack *tr, bool recarm, IReaperControlSurface *ignoresurf)
+{
+    COUNT_CALL("CSurf_SetSurfaceRecArm");
+    if (s_surface && s_surface != ignoresurf)
+        s_surface->SetSurfaceRecArm(tr, recarm);
+}
+
+static void Stub_CSurf_SetSurfaceSelected(MediaTrack *tr, bool selected, IReaperControlSurface *ignoresurf)
+{
+    COUNT_CALL("CSurf_SetSurfaceSelected");
+    if (s_surface && s_surface != ignoresurf)
+        s_surface->SetSurfaceSelected(tr, selected);
+}
+
+static void Stub_CSurf_OnPlay() { COUNT_CALL("CSurf_OnPlay"); s_playState = 1; OnWrite(); }
+static void Stub_CSurf_OnStop() { COUNT_CALL("CSurf_OnStop"); s_playState = 0; OnWrite(); }
+static void Stub_CSurf_OnRecord() { COUNT_CALL("CSurf_OnRecord"); s_playState = 5; OnWrite(); }
+static int Stub_GetPlayState() { COUNT_CALL("GetPlayState"); return s_playState; }
+static double Stub_GetPlayPosition() { COUNT_CALL("GetPlayPosition"); return 0.0; }
+static double Stub_GetCursorPosition() { COUNT_CALL("GetCursorPosition"); return 0.0; }
+static double Stub_GetProjectLength(ReaProject *proj) { COUNT_CALL("GetProjectLength"); return 0.0; }
+static double Stub_GetTrackSendInfo_Value(MediaTrack *tr, int category, int sendidx, const char *parmname) { COUNT_CALL("GetTrackSendInfo_Value"); return 0.0; }
+
+static double Stub_TimeMap2_timeToBeats(ReaProject *proj, double tpos, int *measuresOut, int *cmlOut, double *fullbeatsOut, int *cdenomOut)
+{
+    COUNT_CALL("TimeMap2_timeToBeats");
+    if (measuresOut) *measuresOut = 0;
+    if (cmlOut) *cmlOut = 4;
+    if (fullbeatsOut) *fullbeatsOut = 0.0;
+    if (cdenomOut) *cdenomOut = 4;
+    return 0.0;
+}
+
+static void Stub_format_timestr_pos(double tpos, char *buf, int buf_sz, int modeoverride)
+{
+    COUNT_CALL("format_timestr_pos");
+    snprintf(buf, buf_sz, "0:00.000");
+}
+
+static bool Stub_GetTouchedOrFocusedFX(int mode, int *trackidxOut, int *itemidxOut, int *takeidxOut, int *fxidxOut, int *parmOut)
+{
+    COUNT_CALL("GetTouchedOrFocusedFX");
+    *trackidxOut = s_focusedFXTrack;
+    *itemidxOut = -1;
+    *takeidxOut = -1;
+    *fxidxOut = s_focusedFXIndex;
+    *parmOut = 0;
+    return mode == 1 && s_focusedFXTrack >= 0;
+}
+
+static bool Stub_GetLastTouchedFX(int *tracknumberOut, int *fxnumberOut, int *paramnumberOut) { COUNT_CALL("GetLastTouchedFX"); return false; }
+
+static StubFX *GetStubFX(MediaTrack *tr, int fx)
+{
+    StubTrack *track = ToStubTrack(tr);
+    return track && fx >= 0 && fx < (int)track->fx.size() ? &track->fx[fx] : NULL;
+}
+
+static int Stub_TrackFX_GetCount(MediaTrack *tr)
+{
+    COUNT_CALL("TrackFX_GetCount");
+    StubTrack *track = ToStubTrack(tr);
+    return track ? (int)track->fx.size() : 0;
+}
+
+static bool Stub_TrackFX_GetFXName(MediaTrack *tr, int fx, char *bufOut, int bufOut_sz)
+{
+    COUNT_CALL("TrackFX_GetFXName");
+    StubFX *stubFX = GetStubFX(tr, fx);
+    snprintf(bufOut, bufOut_sz, "%s", stubFX ? stubFX->name.c_str() : "");
+    return stubFX != NULL;
+}
+
+static int Stub_TrackFX_GetNumParams(MediaTrack *tr, int fx)
+{
+    COUNT_CALL("TrackFX_GetNumParams");
+    StubFX *stubFX = GetStubFX(tr, fx);
+    return stubFX ? (int)stubFX->params.size() : 0;
+}
+
+static double Stub_TrackFX_GetParam(MediaTrack *tr, int fx, int param, double *minvalOut, double *maxvalOut)
+{
+    COUNT_CALL("TrackFX_GetParam");
+    if (minvalOut) *minvalOut = 0.0;
+    if (maxvalOut) *maxvalOut = 1.0;
+    StubFX *stubFX = GetStubFX(tr, fx);
+    return stubFX && param >= 0 && param < (int)stubFX->params.size() ? stubFX->params[param] : 0.0;
+}
+
+static bool Stub_TrackFX_SetParam(MediaTrack *tr, int fx, int param, double val)
+{
+    COUNT_CALL("TrackFX_SetParam");
+    StubFX *stubFX = GetStubFX(tr, fx);
+    if (stubFX == NULL || param < 0 || param >= (int)stubFX->params.size())
+        return false;
+    stubFX->params[param] = val;
+    OnWrite();
+    return true;
+}
+
+static bool Stub_TrackFX_GetParamName(MediaTrack *tr, int fx, int param, char *bufOut, int bufOut_sz)
+{
+    COUNT_CALL("TrackFX_GetParamName");
+    snprintf(bufOut, bufOut_sz, "Param %d", param);
+    return GetStubFX(tr, fx) != NULL;
+}
+
+static bool Stub_TrackFX_GetFormattedParamValue(MediaTrack *tr, int fx, int param, char *bufOut, int bufOut_sz)
+{
+    COUNT_CALL("TrackFX_GetFormattedParamValue");
+    StubFX *stubFX = GetStubFX(tr, fx);
+    snprintf(bufOut, bufOut_sz, "%.2f", stubFX && param >= 0 && param < (int)stubFX->params.size() ? stubFX->params[param] : 0.0);
+    return stubFX != NULL;
+}
+
+static bool Stub_TrackFX_GetNamedConfigParm(MediaTrack *tr, int fx, const char *parmname, char *bufOut, int bufOut_sz)
+{
+    COUNT_CALL("TrackFX_GetNamedConfigParm");
+    if (bufOut && bufOut_sz > 0)
+        bufOut[0] = 0;
+    return false;
+}
+
+static bool Stub_TrackFX_GetParameterStepSizes(MediaTrack *tr, int fx, int param, double *stepOut, double *smallstepOut, double *largestepOut, bool *istoggleOut)
+{
+    COUNT_CALL("TrackFX_GetParameterStepSizes");
+    return false;
+}
+
+static bool Stub_TrackFX_GetEnabled(MediaTrack *tr, int fx)
+{
+    COUNT_CALL("TrackFX_GetEnabled");
+    StubFX *stubFX = GetStubFX(tr, fx);
+    return stubFX && stubFX->isEnabled;
+}
+
+static midi_Input *Stub_CreateMIDIInput(int dev) { COUNT_CALL("CreateMIDIInput"); return ReaperStub::GetMidiInput(dev); }
+static midi_Output *Stub_CreateMIDIOutput(int dev, bool streamMode, int *msoffset100) { COUNT_CALL("CreateMIDIOutput"); return ReaperStub::GetMidiOutput(dev); }
+
+static const char *Stub_localizeFunc(const char *str, const char *subctx, int flags) { return str; }
+static int Stub_Register(const char *name, void *infostruct) { return 1; }
+
+// every other function REAPER exports returns zero, through a trampoline of its own so the calls still get counted
+static vector<string> s_zeroStubNames;
+static long long s_zeroStubCounts[1024];
+
+template <size_t N> static intptr_t ZeroStub() { s_zeroStubCounts[N]++; return 0; }
+
+template <size_t... N> static vector<void *> GetZeroStubs(std::index_sequence<N...>) { return { (void *)&ZeroStub<N>... }; }
+
+static void *ReaperGetFunc(const char *name)
+{
+    static map<string, void *> stubs =
+    {
+        { "EnumProjects", (void *)Stub_EnumProjects },
+        { "GetResourcePath", (void *)Stub_GetResourcePath },
+        { "get_ini_file", (void *)Stub_get_ini_file },
+        { "ShowConsoleMsg", (void *)Stub_ShowConsoleMsg },
+        { "RecursiveCreateDirectory", (void *)Stub_RecursiveCreateDirectory },
+        { "get_config_var", (void *)Stub_get_config_var },
+        { "SLIDER2DB", (void *)Stub_SLIDER2DB },
+        { "DB2SLIDER", (void *)Stub_DB2SLIDER },
+        { "GetNumTracks", (void *)Stub_GetNumTracks },
+        { "CSurf_NumTracks", (void *)Stub_CSurf_NumTracks },
+        { "GetTrack", (void *)Stub_GetTrack },
+        { "GetMasterTrack", (void *)Stub_GetMasterTrack },
+        { "CSurf_TrackFromID", (void *)Stub_CSurf_TrackFromID },
+        { "CSurf_TrackToID", (void *)Stub_CSurf_TrackToID },
+        { "ValidatePtr", (void *)Stub_ValidatePtr },
+        { "IsTrackVisible", (void *)Stub_IsTrackVisible },
+        { "GetTrackGUID", (void *)Stub_GetTrackGUID },
+        { "GetTrackColor", (void *)Stub_GetTrackColor },
+        { "ColorFromNative", (void *)Stub_ColorFromNative },
+        { "GetTrackName", (void *)Stub_GetTrackName },
+        { "GetMediaTrackInfo_Value", (void *)Stub_GetMediaTrackInfo_Value },
+        { "GetSetMediaTrackInfo", (void *)Stub_GetSetMediaTrackInfo },
+        { "GetTrackUIVolPan", (void *)Stub_GetTrackUIVolPan },
+        { "GetTrackUIPan", (void *)Stub_GetTrackUIPan },
+        { "GetTrackUIMute", (void *)Stub_GetTrackUIMute },
+        { "Track_GetPeakInfo", (void *)Stub_Track_GetPeakInfo },
+        { "AnyTrackSolo", (void *)Stub_AnyTrackSolo },
+        { "CountSelectedTracks2", (void *)Stub_CountSelectedTracks2 },
+        { "GetSelectedTrack", (void *)Stub_GetSelectedTrack },
+        { "SetOnlyTrackSelected", (void *)Stub_SetOnlyTrackSelected },
+        { "CSurf_OnVolumeChange", (void *)Stub_CSurf_OnVolumeChange },
+        { "CSurf_OnPanChange", (void *)Stub_CSurf_OnPanChange },
+        { "CSurf_OnWidthChange", (void *)Stub_CSurf_OnWidthChange },
+        { "CSurf_OnMuteChange", (void *)Stub_CSurf_OnMuteChange },
+        { "CSurf_OnSoloChange", (void *)Stub_CSurf_OnSoloChange },
+        { "CSurf_OnRecArmChange", (void *)Stub_CSurf_OnRecArmChange },
+        { "CSurf_OnSelectedChange", (void *)Stub_CSurf_OnSelectedChange },
+        { "CSurf_SetSurfaceVolume", (void *)Stub_CSurf_SetSurfaceVolume },
+        { "CSurf_SetSurfacePan", (void *)Stub_CSurf_SetSurfacePan },
+        { "CSurf_SetSurfaceMute", (void *)Stub_CSurf_SetSurfaceMute },
+        { "CSurf_SetSurfaceSolo", (void *)Stub_CSurf_SetSurfaceSolo },
+        { "CSurf_SetSurfaceRecArm", (void *)Stub_CSurf_SetSurfaceRecArm },
+        { "CSurf_SetSurfaceSelected", (void *)Stub_CSurf_SetSurfaceSelected },
+        { "CSurf_OnPlay", (void *)Stub_CSurf_OnPlay },
+        { "CSurf_OnStop", (void *)Stub_CSurf_OnStop },
+        { "CSurf_OnRecord", (void *)Stub_CSurf_OnRecord },
+        { "GetPlayState", (void *)Stub_GetPlayState },
+        { "GetPlayPosition", (void *)Stub_GetPlayPosition },
+        { "GetCursorPosition", (void *)Stub_GetCursorPosition },
+        { "GetProjectLength", (void *)Stub_GetProjectLength },
+        { "GetTrackSendInfo_Value", (void *)Stub_GetTrackSendInfo_Value },
+        { "TimeMap2_timeToBeats", (void *)Stub_TimeMap2_timeToBeats },
+        { "format_timestr_pos", (void *)Stub_format_timestr_pos },
+        { "GetTouchedOrFocusedFX", (void *)Stub_GetTouchedOrFocusedFX },
+        { "GetLastTouchedFX", (void *)Stub_GetLastTouchedFX },
+        { "TrackFX_GetCount", (void *)Stub_TrackFX_GetCount },
+        { "TrackFX_GetFXName", (void *)Stub_TrackFX_GetFXName },
+        { "TrackFX_GetNumParams", (void *)Stub_TrackFX_GetNumParams },
+        { "TrackFX_GetParam", (void *)Stub_TrackFX_GetParam },
+        { "TrackFX_SetParam", (void *)Stub_TrackFX_SetParam },
+        { "TrackFX_GetParamName", (void *)Stub_TrackFX_GetParamName },
+        { "TrackFX_GetFormattedParamValue", (void *)Stub_TrackFX_GetFormattedParamValue },
+        { "TrackFX_GetNamedConfigParm", (void *)Stub_TrackFX_GetNamedConfigParm },
+        { "TrackFX_GetParameterStepSizes", (void *)Stub_TrackFX_GetParameterStepSizes },
+        { "TrackFX_GetEnabled", (void *)Stub_TrackFX_GetEnabled },
+        { "CreateMIDIInput", (void *)Stub_CreateMIDIInput },
+        { "CreateMIDIOutput", (void *)Stub_CreateMIDIOutput },
+        { "__localizeFunc", (void *)Stub_localizeFunc },
+    };
+
+    static vector<void *> zeroStubs = GetZeroStubs(std::make_index_sequence<sizeof(s_zeroStubCounts) / sizeof(s_zeroStubCounts[0])>());
+
+    auto it = stubs.find(name);
+    if (it != stubs.end())
+        return it->second;
+
+    if (s_zeroStubNames.size() >= zeroStubs.size())
+        return NULL; // REAPERAPI_LoadAPI reports it
+
+    s_zeroStubNames.push_back(name);
+    return zeroStubs[s_zeroStubNames.size() - 1];
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// SWELL
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+static DWORD Stub_GetTickCount()
+{
+    return (DWORD)(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count()) + s_timeOffset;
+}
+
+static void Stub_Sleep(int ms) { std::this_thread::sleep_for(std::chrono::milliseconds(ms)); }
+
+static int Stub_MessageBox(HWND hwndParent, const char *text, const char *caption, int type)
+{
+    s_numConsoleMessages++;
+    if ( ! s_isQuiet)
+        fprintf(stderr, "%s: %s\n", caption, text);
+    return IDOK;
+}
+
+static DWORD Stub_GetPrivateProfileString(const char *appname, const char *keyname, const char *def, char *ret, int retsize, const char *fn)
+{
+    snprintf(ret, retsize, "%s", def ? def : "");
+    return (DWORD)strlen(ret);
+}
+
+static LRESULT Stub_SendMessage(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) { COUNT_CALL("SendMessage"); return 0; }
+
+static intptr_t SwellZeroStub() { return 0; }
+
+static void *SwellGetFunc(const char *name)
+{
+    if ( ! strcmp(name, "GetTickCount")) return (void *)Stub_GetTickCount;
+    if ( ! strcmp(name, "Sleep")) return (void *)Stub_Sleep;
+    if ( ! strcmp(name, "MessageBox")) return (void *)Stub_MessageBox;
+    if ( ! strcmp(name, "GetPrivateProfileString")) return (void *)Stub_GetPrivateProfileString;
+    if ( ! strcmp(name, "SendMessage")) return (void *)Stub_SendMessage;
+    return (void *)SwellZeroStub;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// ReaperStub
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+void ReaperStub::Start()
+{
+    static bool isStarted = false;
+    if (isStarted)
+        return;
+    isStarted = true;
+
+    s_masterTrack.name = "MASTER";
+
+    SWELL_dllMain(NULL, DLL_PROCESS_ATTACH, (void *)SwellGetFunc);
+
+    reaper_plugin_info_t info = {};
+    info.caller_version = REAPER_PLUGIN_VERSION;
+    info.GetFunc = ReaperGetFunc;
+    info.Register = Stub_Register;
+
+    if ( ! REAPER_PLUGIN_ENTRYPOINT(NULL, &info))
+    {
+        fprintf(stderr, "the plugin refused to load against the REAPER stub\n");
+        exit(1);
+    }
+}
+
+CSurfIntegrator *ReaperStub::CreateCSI(const string &resourcePath)
+{
+    Start();
+    SetResourcePath(resourcePath);
+
+    CSurfIntegrator *csi = new CSurfIntegrator();
+    SetControlSurface(csi);
+    csi->Extended(CSURF_EXT_RESET, NULL, NULL, NULL);
+    return csi;
+}
+
+void ReaperStub::DestroyCSI(CSurfIntegrator *csi)
+{
+    SetControlSurface(NULL);
+    delete csi;
+}
+
+void ReaperStub::SetResourcePath(const string &resourcePath) { s_resourcePath = resourcePath; }
+const string &ReaperStub::GetResourcePath() { return s_resourcePath; }
+
+void ReaperStub::SetControlSurface(IReaperControlSurface *surface) { s_surface = surface; }
+
+void ReaperStub::SetProject(int numTracks, int numFXPerTrack, int numParamsPerFX)
+{
+    for (auto track : s_tracks)
+        delete track;
+    s_tracks.clear();
+
+    for (int i = 0; i < numTracks; ++i)
+    {
+        StubTrack *track = new StubTrack();
+        memset(&track->guid, 0, sizeof(track->guid));
+        memcpy(&track->guid, &i, sizeof(i));
+        track->name = "Track " + to_string(i + 1);
+        track->volume = 1.0;
+        track->color = (i * 0x2f5a17) & 0xffffff;
+
+        for (int j = 0; j < numFXPerTrack; ++j)
+        {
+            StubFX fx;
+            fx.name = "VST: Harness" + to_string(j) + " (CSI)";
+            fx.params.resize(numParamsPerFX, 0.5);
+            track->fx.push_back(fx);
+        }
+
+        s_tracks.push_back(track);
+    }
+
+    memset(&s_masterTrack.guid, 0xff, sizeof(s_masterTrack.guid));
+    s_focusedFXTrack = -1;
+
+    if (s_surface)
+        s_surface->SetTrackListChange();
+}
+
+int ReaperStub::GetNumTracks() { return (int)s_tracks.size(); }
+StubTrack *ReaperStub::GetTrack(int index) { return s_tracks[index]; }
+StubTrack *ReaperStub::GetMasterTrack() { return &s_masterTrack; }
+
+void ReaperStub::SetTrackVolume(int index, double volume)
+{
+    s_tracks[index]->volume = volume;
+    if (s_surface)
+        s_surface->SetSurfaceVolume((MediaTrack *)s_tracks[index], volume);
+}
+
+void ReaperStub::SetTrackName(int index, const string &name)
+{
+    s_tracks[index]->name = name;
+    if (s_surface)
+        s_surface->SetTrackTitle((MediaTrack *)s_tracks[index], name.c_str());
+}
+
+void ReaperStub::SetTrackPeaks(double peak)
+{
+    for (auto track : s_tracks)
+        track->peak = peak;
+    s_masterTrack.peak = peak;
+}
+
+void ReaperStub::SetFocusedFX(int trackIndex, int fxIndex)
+{
+    s_focusedFXTrack = trackIndex;
+    s_focusedFXIndex = fxIndex;
+}
+
+void ReaperStub::SetFaderMaxDB(double maxDB) { s_faderMaxDB = maxDB; }
+double ReaperStub::GetFaderMaxDB() { return s_faderMaxDB; }
+
+FakeMidiInput *ReaperStub::GetMidiInput(int port)
+{
+    FakeMidiInput *&input = s_midiInputs[port];
+    if (input == NULL)
+        input = new FakeMidiInput();
+    return input;
+}
+
+FakeMidiOutput *ReaperStub::GetMidiOutput(int port)
+{
+    FakeMidiOutput *&output = s_midiOutputs[port];
+    if (output == NULL)
+        output = new FakeMidiOutput();
+    return output;
+}
+
+void ReaperStub::AdvanceTime(DWORD milliseconds) { s_timeOffset += milliseconds; }
+
+long long ReaperStub::GetLastWriteTime() { return s_lastWriteTime; }
+
+const map<string, long long> &ReaperStub::GetCallCounts()
+{
+    static map<string, long long> callCounts;
+
+    callCounts = s_callCounts;
+
+    for (int i = 0; i < (int)s_zeroStubNames.size(); ++i)
+        if (s_zeroStubCounts[i] > 0)
+            callCounts[s_zeroStubNames[i]] = s_zeroStubCounts[i];
+
+    return callCounts;
+}
+
+long long ReaperStub::GetTotalCalls()
+{
+    long long total = 0;
+
+    for (auto &callCount : s_callCounts)
+        total += callCount.second;
+
+    for (int i = 0; i < (int)s_zeroStubNames.size(); ++i)
+        total += s_zeroStubCounts[i];
+
+    return total;
+}
+
+void ReaperStub::ResetCallCounts()
+{
+    for (auto &callCount : s_callCounts)
+        callCount.second = 0;
+
+    memset(s_zeroStubCounts, 0, sizeof(s_zeroStubCounts));
+}
+
+bool ReaperStub::GetIsQuiet() { return s_isQuiet; }
+void ReaperStub::SetIsQuiet(bool isQuiet) { s_isQuiet = isQuiet; }
+int ReaperStub::GetNumConsoleMessages() { return s_numConsoleMessages; }
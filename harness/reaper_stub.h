@@ -0,0 +1,215 @@
+//
+//  reaper_stub.h
+//  csi_harness
+//
+//  Stands in for REAPER so CSurfIntegrator can run headless: an in-memory project, the API functions CSI imports
+//  (each call counted), fake MIDI ports and OSC device, and global allocation and socket send counters.
+//
+
+#ifndef reaper_stub_h
+#define reaper_stub_h
+
+#include "../reaper_csurf_integrator/control_surface_integrator.h"
+
+#include <atomic>
+#include <mutex>
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+struct StubFX
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+{
+    string name;
+    vector<double> params;
+    bool isEnabled = true;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+struct StubTrack
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+{
+    GUID guid;
+    string name;
+    double volume = 1.0;
+    double pan = 0.0;
+    double width = 1.0;
+    double dualPanL = -1.0;
+    double dualPanR = 1.0;
+    bool isMuted = false;
+    int solo = 0;
+    int recordArm = 0;
+    int isSelected = 0;
+    bool isPhaseInverted = false;
+    int autoMode = 0;
+    int recordMonitor = 0;
+    int recordMonitorItems = 0;
+    int color = 0;
+    double peak = 0.0;
+    vector<StubFX> fx;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+class StubMidiEventList : public MIDI_eventlist
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+{
+private:
+    vector<int> events_; // MIDI_event_t records back to back, each padded to whole ints
+    int size_ = 0; // in ints
+
+public:
+    StubMidiEventList() { events_.reserve(4096); }
+    virtual ~StubMidiEventList() {}
+
+    void AddItem(MIDI_event_t *evt) override;
+    MIDI_event_t *EnumItems(int *bpos) override;
+    void DeleteItem(int bpos) override {}
+    int GetSize() override { return size_ * (int)sizeof(int); }
+    void Empty() override { size_ = 0; }
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+class FakeMidiInput : public midi_Input
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+{
+private:
+    std::mutex mutex_;
+    StubMidiEventList pending_;
+    StubMidiEventList read_;
+
+public:
+    virtual ~FakeMidiInput() {}
+
+    void start() override {}
+    void stop() override {}
+    void SwapBufs(unsigned int timestamp) override;
+    MIDI_eventlist *GetReadBuf() override { return &read_; }
+
+    // what the device would send, seen by the next SwapBufs
+    void Queue(unsigned char status, unsigned char d1, unsigned char d2);
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+class FakeMidiOutput : public midi_Output
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+{
+private:
+    std::atomic<long long> numMessages_;
+    std::atomic<long long> numBytes_;
+    std::atomic<bool> isBlocked_;
+    std::atomic<int> lastMessages_[256]; // the last short message per status byte, d1 | d2 << 8, -1 for none yet
+
+public:
+    FakeMidiOutput() : numMessages_(0), numBytes_(0), isBlocked_(false) { ResetLastMessages(); }
+    virtual ~FakeMidiOutput() {}
+
+    void SendMsg(MIDI_event_t *msg, int frame_offset) override;
+    void Send(unsigned char status, unsigned char d1, unsigned char d2, int frame_offset) override;
+
+    long long GetNumMessages() { return numMessages_; }
+    long long GetNumBytes() { return numBytes_; }
+
+    // a stalled port, sends wait until unblocked -- with MIDIIOThread=Yes that stalls the I/O thread and the rings fill up
+    void SetIsBlocked(bool isBlocked) { isBlocked_ = isBlocked; }
+
+    int GetLastMessage(unsigned char status) { return lastMessages_[status]; }
+    void ResetLastMessages() { for (auto &lastMessage : lastMessages_) lastMessage = -1; }
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+class FakeOSCDevice
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+{
+    // TouchOSC on localhost, over real UDP, as CSI's OSC sockets aren't stubbed
+private:
+    oscpkt::UdpSocket outSocket_;
+    oscpkt::UdpSocket inSocket_;
+    oscpkt::PacketWriter packetWriter_;
+    oscpkt::PacketReader packetReader_;
+    oscpkt::Message message_;
+    long long numDatagrams_ = 0;
+    long long numMessages_ = 0;
+
+public:
+    // listens for CSI's feedback too when given its TransmitToPort
+    FakeOSCDevice(int csiReceiveOnPort, int csiTransmitToPort = 0);
+
+    // one message per datagram, as TouchOSC sends them
+    bool Send(const char *address, float value);
+
+    // reads whatever feedback is waiting, a bundle counts as one datagram and each of its messages
+    void Receive();
+    long long GetNumDatagrams() { return numDatagrams_; }
+    long long GetNumMessages() { return numMessages_; }
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+class ReaperStub
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+{
+public:
+    // loads the SWELL and REAPER function pointers the way REAPER does, once per process
+    static void Start();
+
+    // a CSurfIntegrator registered with the stub and initialised from resourcePath, as REAPER does at startup
+    static CSurfIntegrator *CreateCSI(const string &resourcePath);
+    static void DestroyCSI(CSurfIntegrator *csi);
+
+    static void SetResourcePath(const string &resourcePath);
+    static const string &GetResourcePath();
+
+    // REAPER forwards CSurf_SetSurface* to the registered surfaces, as it does here
+    static void SetControlSurface(IReaperControlSurface *surface);
+
+    static void SetProject(int numTracks, int numFXPerTrack, int numParamsPerFX);
+    static int GetNumTracks();
+    static StubTrack *GetTrack(int index);
+    static StubTrack *GetMasterTrack();
+    static MediaTrack *ToMediaTrack(StubTrack *track) { return (MediaTrack *)track; }
+
+    // as if changed in REAPER itself, so CSI hears about it through the IReaperControlSurface callbacks
+    static void SetTrackVolume(int index, double volume);
+    static void SetTrackName(int index, const string &name);
+    static void SetTrackPeaks(double peak);
+
+    static void SetFocusedFX(int trackIndex, int fxIndex); // trackIndex -1 for none
+
+    static void SetFaderMaxDB(double maxDB); // REAPER's fader range preference
+    static double GetFaderMaxDB();
+
+    static FakeMidiInput *GetMidiInput(int port);
+    static FakeMidiOutput *GetMidiOutput(int port);
+
+    static void AdvanceTime(DWORD milliseconds); // GetTickCount runs on the wall clock plus this
+
+    // steady_clock nanoseconds of the latest call that changed the project
+    static long long GetLastWriteTime();
+
+    static const map<string, long long> &GetCallCounts();
+    static long long GetTotalCalls();
+    static void ResetCallCounts();
+
+    static bool GetIsQuiet();
+    static void SetIsQuiet(bool isQuiet); // drop ShowConsoleMsg and MessageBox output
+    static int GetNumConsoleMessages();
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+class AllocationCounter
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+{
+public:
+    // every operator new in the process, from any thread
+    static long long GetCount();
+    static long long GetBytes();
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+class SendCallCounter
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+{
+public:
+    // every send, sendto and sendmmsg in the process, and the datagrams they carried
+    static long long GetCalls();
+    static long long GetDatagrams();
+};
+
+#endif /* reaper_stub_h */
@@ -0,0 +1,59 @@
+//
+//  reference_tokenizer.h
+//  csi_harness
+//
+//  The line trimming and tokenizing CSI did before LineTokenizer, kept to check the new one against and to time it.
+//
+
+#ifndef reference_tokenizer_h
+#define reference_tokenizer_h
+
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+
+static inline void ReferenceTrimLine(std::string &line)
+{
+    const std::string tmp = line;
+    const char *p = tmp.c_str();
+
+    line.clear();
+
+    for (;;)
+    {
+        while (*p > 0 && isspace(*p))
+            p++;
+
+        if ( ! *p || p[0] == '/')
+            return;
+
+        if (line.length())
+            line.append(" ", 1);
+
+        while (*p && (*p < 0 || ! isspace(*p)))
+        {
+            if (p[0] == '/' && p[1] == '/')
+                return;
+            line.append(p++, 1);
+        }
+    }
+}
+
+static inline void ReferenceGetTokens(std::vector<std::string> &tokens, const std::string &line)
+{
+    std::istringstream iss(line);
+    std::string token;
+    while (iss >> std::quoted(token))
+        tokens.push_back(token);
+}
+
+static inline void ReferenceGetTokens(std::vector<std::string> &tokens, const std::string &line, char delimiter)
+{
+    std::istringstream iss(line);
+    std::string token;
+    while (getline(iss, token, delimiter))
+        tokens.push_back(token);
+}
+
+#endif /* reference_tokenizer_h */
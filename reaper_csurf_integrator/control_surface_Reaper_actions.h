@@ -374,15 +374,12 @@ class TrackVolume : public Action
 {
 public:
     virtual const char *GetName() override { return "TrackVolume"; }
+    virtual TrackProperty GetTrackProperty() override { return TrackProperty_Volume; }
     
     virtual double GetCurrentNormalizedValue(ActionContext *context) override
     {
         if (MediaTrack *track = context->GetTrack())
-        {
-            double vol, pan = 0.0;
-            GetTrackUIVolPan(track, &vol, &pan);
-            return volToNormalized(vol);
-        }
+            return volToNormalized(context->GetCSI()->GetTrackStateCache().GetVolume(track));
         else
             return 0.0;
     }
@@ -467,15 +464,12 @@ class TrackVolumeDB : public Action
 {
 public:
     virtual const char *GetName() override { return "TrackVolumeDB"; }
+    virtual TrackProperty GetTrackProperty() override { return TrackProperty_Volume; }
     
     virtual double GetCurrentDBValue(ActionContext *context) override
     {
         if (MediaTrack *track = context->GetTrack())
-        {
-            double vol, pan = 0.0;
-            GetTrackUIVolPan(track, &vol, &pan);
-            return VAL2DB(vol);
-        }
+            return VAL2DB(context->GetCSI()->GetTrackStateCache().GetVolume(track));
         else
             return 0.0;
     }
@@ -508,17 +502,16 @@ class TrackPan : public Action
 {
 public:
     virtual const char *GetName() override { return "TrackPan"; }
+    virtual TrackProperty GetTrackProperty() override { return TrackProperty_Pan; }
     
     virtual double GetCurrentNormalizedValue(ActionContext *context) override
     {
         if (MediaTrack *track = context->GetTrack())
         {
-            if (GetPanMode(track) != 6)
-            {
-                double vol, pan = 0.0;
-                GetTrackUIVolPan(track, &vol, &pan);
-                return panToNormalized(pan);
-            }
+            TrackStateCache &trackStateCache = context->GetCSI()->GetTrackStateCache();
+            
+            if (trackStateCache.GetPanMode(track) != 6)
+                return panToNormalized(trackStateCache.GetPan(track));
         }
         
         return 0.0;
@@ -558,17 +551,16 @@ class TrackPanPercent : public Action
 {
 public:
     virtual const char *GetName() override { return "TrackPanPercent"; }
+    virtual TrackProperty GetTrackProperty() override { return TrackProperty_Pan; }
 
     virtual void RequestUpdate(ActionContext *context) override
     {
         if (MediaTrack *track = context->GetTrack())
         {
-            if (GetPanMode(track) != 6)
-            {
-                double vol, pan = 0.0;
-                GetTrackUIVolPan(track, &vol, &pan);
-                context->UpdateWidgetValue(pan  *100.0);
-            }
+            TrackStateCache &trackStateCache = context->GetCSI()->GetTrackStateCache();
+            
+            if (trackStateCache.GetPanMode(track) != 6)
+                context->UpdateWidgetValue(trackStateCache.GetPan(track)  *100.0);
         }
         else
             context->ClearWidget();
@@ -985,11 +977,12 @@ class TrackRecordArm : public Action
 {
 public:
     virtual const char *GetName() override { return "TrackRecordArm"; }
+    virtual TrackProperty GetTrackProperty() override { return TrackProperty_RecordArm; }
 
     virtual double GetCurrentNormalizedValue(ActionContext *context) override
     {
         if (MediaTrack *track = context->GetTrack())
-            return GetMediaTrackInfo_Value(track, "I_RECARM");
+            return context->GetCSI()->GetTrackStateCache().GetIsRecordArmed(track);
         else
             return 0.0;
     }
@@ -1019,15 +1012,12 @@ class TrackMute : public Action
 {
 public:
     virtual const char *GetName() override { return "TrackMute"; }
+    virtual TrackProperty GetTrackProperty() override { return TrackProperty_Mute; }
 
     virtual double GetCurrentNormalizedValue(ActionContext *context) override
     {
         if (MediaTrack *track = context->GetTrack())
-        {
-            bool mute = false;
-            GetTrackUIMute(track, &mute);
-            return mute;
-        }
+            return context->GetCSI()->GetTrackStateCache().GetIsMuted(track);
         else
             return 0.0;
     }
@@ -1059,11 +1049,12 @@ class TrackSolo : public Action
 {
 public:
     virtual const char *GetName() override { return "TrackSolo"; }
+    virtual TrackProperty GetTrackProperty() override { return TrackProperty_Solo; }
     
     virtual double GetCurrentNormalizedValue(ActionContext *context) override
     {
         if (MediaTrack *track = context->GetTrack())
-            return GetMediaTrackInfo_Value(track, "I_SOLO") > 0 ? 1 : 0;
+            return context->GetCSI()->GetTrackStateCache().GetIsSoloed(track);
         else
             return 0.0;
     }
@@ -1140,11 +1131,12 @@ class TrackSelect : public Action
 {
 public:
     virtual const char *GetName() override { return "TrackSelect"; }
+    virtual TrackProperty GetTrackProperty() override { return TrackProperty_Selected; }
 
     virtual double GetCurrentNormalizedValue(ActionContext *context) override
     {
         if (MediaTrack *track = context->GetTrack())
-            return GetMediaTrackInfo_Value(track, "I_SELECTED");
+            return context->GetCSI()->GetTrackStateCache().GetIsSelected(track);
         else
             return 0.0;
     }
@@ -1175,11 +1167,12 @@ class TrackUniqueSelect : public Action
 {
 public:
     virtual const char *GetName() override { return "TrackUniqueSelect"; }
+    virtual TrackProperty GetTrackProperty() override { return TrackProperty_Selected; }
 
     virtual double GetCurrentNormalizedValue(ActionContext *context) override
     {
         if (MediaTrack *track = context->GetTrack())
-            return GetMediaTrackInfo_Value(track, "I_SELECTED");
+            return context->GetCSI()->GetTrackStateCache().GetIsSelected(track);
         else
             return 0.0;
     }
@@ -1210,11 +1203,12 @@ class TrackRangeSelect : public Action
 {
 public:
     virtual const char *GetName() override { return "TrackRangeSelect"; }
+    virtual TrackProperty GetTrackProperty() override { return TrackProperty_Selected; }
 
     virtual double GetCurrentNormalizedValue(ActionContext *context) override
     {
         if (MediaTrack *track = context->GetTrack())
-            return GetMediaTrackInfo_Value(track, "I_SELECTED");
+            return context->GetCSI()->GetTrackStateCache().GetIsSelected(track);
         else
             return 0.0;
     }
@@ -2496,17 +2490,12 @@ class TrackNameDisplay : public Action
 {
 public:
     virtual const char *GetName() override { return "TrackNameDisplay"; }
+    virtual TrackProperty GetTrackProperty() override { return TrackProperty_Name; }
 
     virtual void RequestUpdate(ActionContext *context) override
     {
         if (MediaTrack *track = context->GetTrack())
-        {
-            char buf[MEDBUF];
-            
-            GetTrackName(track, buf, sizeof(buf));
-            
-            context->UpdateWidgetValue(buf);
-        }
+            context->UpdateWidgetValue(context->GetCSI()->GetTrackStateCache().GetName(track));
         else
             context->ClearWidget();
     }
@@ -2617,16 +2606,14 @@ class TrackVolumeDisplay : public Action
 {
 public:
     virtual const char *GetName() override { return "TrackVolumeDisplay"; }
+    virtual TrackProperty GetTrackProperty() override { return TrackProperty_Volume; }
 
     virtual void RequestUpdate(ActionContext *context) override
     {
         if (MediaTrack *track = context->GetTrack())
         {
-            double vol, pan = 0.0;
-            GetTrackUIVolPan(track, &vol, &pan);
-
             char trackVolume[128];
-            snprintf(trackVolume, sizeof(trackVolume), "%7.2lf", VAL2DB(vol));
+            snprintf(trackVolume, sizeof(trackVolume), "%7.2lf", VAL2DB(context->GetCSI()->GetTrackStateCache().GetVolume(track)));
             context->UpdateWidgetValue(trackVolume);
         }
         else
@@ -2640,16 +2627,14 @@ class TrackPanDisplay : public Action
 {
 public:
     virtual const char *GetName() override { return "TrackPanDisplay"; }
+    virtual TrackProperty GetTrackProperty() override { return TrackProperty_Pan; }
 
     virtual void RequestUpdate(ActionContext *context) override
     {
         if (MediaTrack *track = context->GetTrack())
         {
-            double vol, pan = 0.0;
-            GetTrackUIVolPan(track, &vol, &pan);
-
             char tmp[MEDBUF];
-            context->UpdateWidgetValue(context->GetPanValueString(pan, "", tmp, sizeof(tmp)));
+            context->UpdateWidgetValue(context->GetPanValueString(context->GetCSI()->GetTrackStateCache().GetPan(track), "", tmp, sizeof(tmp)));
         }
         else
             context->ClearWidget();
@@ -3119,7 +3104,7 @@ public:
     virtual void RequestUpdate(ActionContext *context) override
     {
         if (MediaTrack *track = context->GetTrack())
-            context->UpdateWidgetValue(context->GetPage()->GetAutoModeDisplayName((int)GetMediaTrackInfo_Value(track, "I_AUTOMODE")));
+            context->UpdateWidgetValue(context->GetPage()->GetAutoModeDisplayName(context->GetCSI()->GetTrackStateCache().GetAutoMode(track)));
     }
     
     virtual void Do(ActionContext *context, double value) override
@@ -3202,7 +3187,7 @@ public:
     virtual void RequestUpdate(ActionContext *context) override
     {
         if (MediaTrack *track = context->GetTrack())
-            context->UpdateWidgetValue(context->GetPage()->GetAutoModeDisplayName((int)GetMediaTrackInfo_Value(track, "I_AUTOMODE")));
+            context->UpdateWidgetValue(context->GetPage()->GetAutoModeDisplayName(context->GetCSI()->GetTrackStateCache().GetAutoMode(track)));
     }
 };
 
@@ -3378,10 +3363,12 @@ public:
     {
         if (MediaTrack *track = context->GetTrack())
         {           
-            if (AnyTrackSolo(NULL) && ! GetMediaTrackInfo_Value(track, "I_SOLO"))
+            TrackMeterSampler &meterSampler = context->GetPage()->GetMeterSampler();
+            
+            if (meterSampler.GetIsSilencedBySolo(track))
                 context->ClearWidget();
             else
-                context->UpdateWidgetValue(volToNormalized(Track_GetPeakInfo(track, context->GetIntParam())));
+                context->UpdateWidgetValue(meterSampler.GetNormalizedPeak(track, context->GetIntParam()));
         }
         else
             context->ClearWidget();
@@ -3399,12 +3386,12 @@ public:
     {
         if (MediaTrack *track = context->GetTrack())
         {
-            double lrVol = (Track_GetPeakInfo(track, 0) + Track_GetPeakInfo(track, 1)) / 2.0;
+            TrackMeterSampler &meterSampler = context->GetPage()->GetMeterSampler();
             
-            if (AnyTrackSolo(NULL) && ! GetMediaTrackInfo_Value(track, "I_SOLO"))
+            if (meterSampler.GetIsSilencedBySolo(track))
                 context->ClearWidget();
             else
-                context->UpdateWidgetValue(volToNormalized(lrVol));
+                context->UpdateWidgetValue(meterSampler.GetNormalizedAverageLR(track));
         }
         else
             context->ClearWidget();
@@ -3421,11 +3408,7 @@ public:
     virtual double GetCurrentNormalizedValue(ActionContext *context) override
     {
         if (MediaTrack *track = context->GetTrack())
-        {
-            double vol, pan = 0.0;
-            GetTrackUIVolPan(track, &vol, &pan);
-            return volToNormalized(vol);
-        }
+            return volToNormalized(context->GetCSI()->GetTrackStateCache().GetVolume(track));
         else
             return 0.0;
     }
@@ -3445,12 +3428,12 @@ public:
         {
             if (MediaTrack *track = context->GetTrack())
             {
-                double lrVol = (Track_GetPeakInfo(track, 0) + Track_GetPeakInfo(track, 1)) / 2.0;
+                TrackMeterSampler &meterSampler = context->GetPage()->GetMeterSampler();
                 
-                if (AnyTrackSolo(NULL) && ! GetMediaTrackInfo_Value(track, "I_SOLO"))
+                if (meterSampler.GetIsSilencedBySolo(track))
                     context->ClearWidget();
                 else
-                    context->UpdateWidgetValue(volToNormalized(lrVol));
+                    context->UpdateWidgetValue(meterSampler.GetNormalizedAverageLR(track));
             }
             else
                 context->ClearWidget();
@@ -3482,15 +3465,12 @@ public:
     {
         if (MediaTrack *track = context->GetTrack())
         {
-            double lVol = Track_GetPeakInfo(track, 0);
-            double rVol = Track_GetPeakInfo(track, 1);
-            
-            double lrVol =  lVol > rVol ? lVol : rVol;
+            TrackMeterSampler &meterSampler = context->GetPage()->GetMeterSampler();
             
-            if (AnyTrackSolo(NULL) && ! GetMediaTrackInfo_Value(track, "I_SOLO"))
+            if (meterSampler.GetIsSilencedBySolo(track))
                 context->ClearWidget();
             else
-                context->UpdateWidgetValue(volToNormalized(lrVol));
+                context->UpdateWidgetValue(meterSampler.GetNormalizedMaxPeakLR(track));
         }
         else
             context->ClearWidget();
@@ -3507,11 +3487,7 @@ public:
     virtual double GetCurrentNormalizedValue(ActionContext *context) override
     {
         if (MediaTrack *track = context->GetTrack())
-        {
-            double vol, pan = 0.0;
-            GetTrackUIVolPan(track, &vol, &pan);
-            return volToNormalized(vol);
-        }
+            return volToNormalized(context->GetCSI()->GetTrackStateCache().GetVolume(track));
         else
             return 0.0;
     }
@@ -3531,15 +3507,12 @@ public:
         {
             if (MediaTrack *track = context->GetTrack())
             {
-                double lVol = Track_GetPeakInfo(track, 0);
-                double rVol = Track_GetPeakInfo(track, 1);
-                
-                double lrVol =  lVol > rVol ? lVol : rVol;
+                TrackMeterSampler &meterSampler = context->GetPage()->GetMeterSampler();
                 
-                if (AnyTrackSolo(NULL) && ! GetMediaTrackInfo_Value(track, "I_SOLO"))
+                if (meterSampler.GetIsSilencedBySolo(track))
                     context->ClearWidget();
                 else
-                    context->UpdateWidgetValue(volToNormalized(lrVol));
+                    context->UpdateWidgetValue(meterSampler.GetNormalizedMaxPeakLR(track));
             }
             else
                 context->ClearWidget();
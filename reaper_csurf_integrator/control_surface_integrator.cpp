@@ -26,39 +26,47 @@ bool g_surfaceInDisplay;
 bool g_surfaceOutDisplay;
 bool g_fxParamsWrite;
 
-void GetPropertiesFromTokens(int start, int finish, const vector<string> &tokens, PropertyList &properties)
+void GetPropertyFromToken(const char *tok, PropertyList &properties)
 {
-    for (int i = start; i < finish; ++i)
+    const char *eq = strstr(tok,"=");
+    if (eq != NULL && strstr(eq+1, "=") == NULL /* legacy behavior, don't allow = in value */)
     {
-        const char *tok = tokens[i].c_str();
-        const char *eq = strstr(tok,"=");
-        if (eq != NULL && strstr(eq+1, "=") == NULL /* legacy behavior, don't allow = in value */)
-        {
-            char tmp[128];
-            int pnlen = (int) (eq-tok) + 1; // +1 is for the null character to be added to tmp
-            if (WDL_NOT_NORMALLY(pnlen > sizeof(tmp))) // if this asserts on a valid property name, increase tmp size
-                pnlen = sizeof(tmp);
-            lstrcpyn_safe(tmp, tok, pnlen);
+        char tmp[128];
+        int pnlen = (int) (eq-tok) + 1; // +1 is for the null character to be added to tmp
+        if (WDL_NOT_NORMALLY(pnlen > sizeof(tmp))) // if this asserts on a valid property name, increase tmp size
+            pnlen = sizeof(tmp);
+        lstrcpyn_safe(tmp, tok, pnlen);
 
-            PropertyType prop = PropertyList::prop_from_string(tmp);
-            if (prop != PropertyType_Unknown)
-            {
-                properties.set_prop(prop, eq+1);
-            }
-            else
-            {
-                properties.set_prop(prop, tok); // unknown properties are preserved as Unknown, key=value pair
+        PropertyType prop = PropertyList::prop_from_string(tmp);
+        if (prop != PropertyType_Unknown)
+        {
+            properties.set_prop(prop, eq+1);
+        }
+        else
+        {
+            properties.set_prop(prop, tok); // unknown properties are preserved as Unknown, key=value pair
 
-                char buffer[250];
-                snprintf(buffer, sizeof(buffer), "CSI does not support property named %s\n", tok);
-                ShowConsoleMsg(buffer);
-                
-               // WDL_ASSERT(false);
-            }
+            char buffer[250];
+            snprintf(buffer, sizeof(buffer), "CSI does not support property named %s\n", tok);
+            ShowConsoleMsg(buffer);
+            
+           // WDL_ASSERT(false);
         }
     }
 }
 
+void GetPropertiesFromTokens(int start, int finish, const vector<string> &tokens, PropertyList &properties)
+{
+    for (int i = start; i < finish; ++i)
+        GetPropertyFromToken(tokens[i].c_str(), properties);
+}
+
+void GetPropertiesFromTokens(int start, int finish, const vector<string_view> &tokens, PropertyList &properties)
+{
+    for (int i = start; i < finish; ++i)
+        GetPropertyFromToken(tokens[i].data(), properties);
+}
+
 void GetSteppedValues(const vector<string> &params, int start_idx, double &deltaValue, vector<double> &acceleratedDeltaValues, double &rangeMinimum, double &rangeMaximum, vector<double> &steppedValues, vector<int> &acceleratedTickValues)
 {
     int openSquareIndex = -1, closeSquareIndex = -1;
@@ -174,13 +182,14 @@ void GetParamStepsValues(vector<double> &outputVector, int numSteps)
 
 void TrimLine(string &line)
 {
-    const string tmp = line;
-    const char *p = tmp.c_str();
-
     // remove leading and trailing spaces
     // condense whitespace to single whitespace
     // stop copying at "//" (comment)
-    line.clear();
+    // done in place, the output never gets ahead of the input
+    char *out = &line[0];
+    const char *p = out;
+    char *q = out;
+    
     for (;;)
     {
         // advance over whitespace
@@ -188,18 +197,19 @@ void TrimLine(string &line)
             p++;
 
         // a single / at the beginning of a line indicates a comment
-        if (!*p || p[0] == '/') return;
+        if (!*p || p[0] == '/') break;
 
-        if (line.length())
-            line.append(" ",1);
+        if (q > out)
+            *q++ = ' ';
 
         // copy non-whitespace to output
-        while (*p && (*p < 0 || !isspace(*p)))
-        {
-           if (p[0] == '/' && p[1] == '/') return; // existing behavior, maybe not ideal, but a comment can start anywhere
-           line.append(p++,1);
-        }
+        while (*p && (*p < 0 || !isspace(*p)) && ! (p[0] == '/' && p[1] == '/'))
+           *q++ = *p++;
+        
+        if (p[0] == '/' && p[1] == '/') break; // existing behavior, maybe not ideal, but a comment can start anywhere
     }
+    
+    line.resize(q - out);
 }
 
 void ReplaceAllWith(string &output, const char *charsToReplace, const char *replacement)
@@ -207,9 +217,13 @@ void ReplaceAllWith(string &output, const char *charsToReplace, const char *repl
     // replace all occurences of
     // any char in charsToReplace
     // with replacement string
+    if (strpbrk(output.c_str(), charsToReplace) == NULL)
+        return;
+    
     const string tmp = output;
     const char *p = tmp.c_str();
     output.clear();
+    output.reserve(tmp.size());
 
     while (*p)
     {
@@ -223,20 +237,111 @@ void ReplaceAllWith(string &output, const char *charsToReplace, const char *repl
     }
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// LineTokenizer
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+const vector<string_view> &LineTokenizer::Tokenize(string_view line)
+{
+    tokens_.clear();
+    buffer_.assign(line.data(), line.size());
+    
+    char *p = &buffer_[0];
+    char *end = p + buffer_.size();
+    
+    for (;;)
+    {
+        while (p < end && isspace((unsigned char)*p))
+            p++;
+        
+        if (p == end)
+            break;
+        
+        char *token = p;
+        
+        if (*p != '"')
+        {
+            while (p < end && ! isspace((unsigned char)*p))
+                p++;
+            
+            tokens_.push_back(string_view(token, p - token));
+            
+            if (p < end)
+                *p++ = 0; // the separator becomes the terminator
+            
+            continue;
+        }
+        
+        // unescape in place, the closing quote leaves room for the terminator
+        char *out = token;
+        bool isClosed = false;
+        
+        for (p++; p < end; p++)
+        {
+            if (*p == '"')
+            {
+                isClosed = true;
+                p++;
+                break;
+            }
+            
+            if (*p == '\\' && ++p == end)
+                break;
+            
+            *out++ = *p;
+        }
+        
+        if ( ! isClosed)
+            break; // like istream >> quoted(), an unterminated token ends the line without being returned
+        
+        *out = 0;
+        tokens_.push_back(string_view(token, out - token));
+    }
+    
+    return tokens_;
+}
+
+const vector<string_view> &LineTokenizer::Split(string_view line, char delimiter)
+{
+    tokens_.clear();
+    buffer_.assign(line.data(), line.size());
+    
+    char *p = &buffer_[0];
+    char *end = p + buffer_.size();
+    
+    while (p < end)
+    {
+        char *field = p;
+        
+        while (p < end && *p != delimiter)
+            p++;
+        
+        tokens_.push_back(string_view(field, p - field));
+        
+        if (p < end)
+            *p++ = 0;
+    }
+    
+    return tokens_;
+}
+
 void GetTokens(vector<string> &tokens, const string &line)
 {
-    istringstream iss(line);
-    string token;
-    while (iss >> quoted(token))
-        tokens.push_back(token);
+    static thread_local LineTokenizer s_tokenizer; // zone file headers are read on worker threads
+    
+    const vector<string_view> &lineTokens = s_tokenizer.Tokenize(line);
+    
+    for (int i = 0; i < lineTokens.size(); ++i)
+        tokens.push_back(string(lineTokens[i]));
 }
 
 void GetTokens(vector<string> &tokens, const string &line, char delimiter)
 {
-    istringstream iss(line);
-    string token;
-    while (getline(iss, token, delimiter))
-        tokens.push_back(token);
+    static thread_local LineTokenizer s_tokenizer;
+    
+    const vector<string_view> &lineTokens = s_tokenizer.Split(line, delimiter);
+    
+    for (int i = 0; i < lineTokens.size(); ++i)
+        tokens.push_back(string(lineTokens[i]));
 }
 
 int strToHex(string &valueStr)
@@ -250,8 +355,9 @@ struct MidiPort
 {
     int port, refcnt;
     void *dev;
+    MidiOutputShadow *outputShadow; // outputs only
     
-    MidiPort(int portidx, void *devptr) : port(portidx), refcnt(1), dev(devptr) { };
+    MidiPort(int portidx, void *devptr) : port(portidx), refcnt(1), dev(devptr), outputShadow(NULL) { };
 };
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -283,7 +389,8 @@ void ReleaseMidiOutput(midi_Output *output)
             if (!--s_midiOutputs[i].refcnt)
             {
                 delete output;
-                s_midiOutputs.erase(s_midiInputs.begin() + i);
+                delete s_midiOutputs[i].outputShadow;
+                s_midiOutputs.erase(s_midiOutputs.begin() + i);
                 break;
             }
         }
@@ -291,7 +398,7 @@ void ReleaseMidiOutput(midi_Output *output)
 
 static midi_Input *GetMidiInputForPort(int inputPort)
 {
-    for (auto midiInput : s_midiInputs)
+    for (auto &midiInput : s_midiInputs)
         if (midiInput.port == inputPort)
         {
             midiInput.refcnt++;
@@ -312,7 +419,7 @@ static midi_Input *GetMidiInputForPort(int inputPort)
 
 static midi_Output *GetMidiOutputForPort(int outputPort)
 {
-    for (auto midiOutput : s_midiOutputs)
+    for (auto &midiOutput : s_midiOutputs)
         if (midiOutput.port == outputPort)
         {
             midiOutput.refcnt++;
@@ -324,12 +431,31 @@ static midi_Output *GetMidiOutputForPort(int outputPort)
     if (newOutput)
     {
         MidiPort midiOutputPort(outputPort, newOutput);
+        midiOutputPort.outputShadow = new MidiOutputShadow();
         s_midiOutputs.push_back(midiOutputPort);
     }
     
     return newOutput;
 }
 
+static int GetMidiPortRefCount(const vector<MidiPort> &ports, void *device)
+{
+    for (auto &port : ports)
+        if (port.dev == device)
+            return port.refcnt;
+    
+    return 0;
+}
+
+MidiOutputShadow *GetMidiOutputShadow(midi_Output *output)
+{
+    for (auto &midiOutput : s_midiOutputs)
+        if (midiOutput.dev == (void *)output)
+            return midiOutput.outputShadow;
+    
+    return NULL;
+}
+
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 struct OSCSurfaceSocket
 ////////////////////////////////7/////////////////////////////////////////////////////////////////////////////////////////
@@ -418,116 +544,532 @@ static oscpkt::UdpSocket *GetOutputSocketForAddressAndPort(const string &surface
     return NULL;
 }
 
-// files
-static void listFilesOfType(const string &path, vector<string> &results, const string &type)
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// ZoneFileIndex
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// the Zone line comes first, so a bounded read nearly always finds it -- only a file with a long comment block at the top is read in full
+void ZoneFileIndex::ReadHeader(ZoneFileHeader &header)
 {
-    filesystem::path zonePath { path };
+    header.name.clear();
+    header.alias.clear();
+    header.hasError = false;
     
-    if (filesystem::exists(path) && filesystem::is_directory(path))
-        for (auto &file : filesystem::recursive_directory_iterator(path))
-            if (file.path().extension() == type)
-                results.push_back(file.path().string());
+    try
+    {
+        char buf[4096];
+        size_t size = 0;
+        
+        if (FILE *file = fopenUTF8(header.filePath.c_str(), "rb"))
+        {
+            size = fread(buf, 1, sizeof(buf), file);
+            fclose(file);
+        }
+        
+        bool isWholeFile = size < sizeof(buf);
+        string line;
+        LineTokenizer tokenizer;
+        
+        for (size_t start = 0; start < size; )
+        {
+            const char *end = (const char *)memchr(buf + start, '\n', size - start);
+            
+            if (end == NULL && ! isWholeFile)
+                break; // the line runs past the bounded read
+            
+            size_t length = end ? end - (buf + start) : size - start;
+            line.assign(buf + start, length);
+            start += length + 1;
+            
+            TrimLine(line);
+            
+            if (line == "" || line[0] == '/') // ignore blank lines and comment lines
+                continue;
+            
+            const vector<string_view> &tokens = tokenizer.Tokenize(line);
+            
+            if (tokens.size() > 1 && tokens[0] == "Zone")
+            {
+                header.name = tokens[1];
+                header.alias = tokens.size() > 2 ? tokens[2] : tokens[1];
+            }
+            
+            return;
+        }
+        
+        if (isWholeFile)
+            return;
+        
+        ifstream file(header.filePath);
+        
+        for (getline(file, line); file; getline(file, line))
+        {
+            TrimLine(line);
+            
+            if (line == "" || line[0] == '/')
+                continue;
+            
+            const vector<string_view> &tokens = tokenizer.Tokenize(line);
+            
+            if (tokens.size() > 1 && tokens[0] == "Zone")
+            {
+                header.name = tokens[1];
+                header.alias = tokens.size() > 2 ? tokens[2] : tokens[1];
+            }
+            
+            return;
+        }
+    }
+    catch (exception)
+    {
+        header.hasError = true; // reported by GetHeaders(), this runs on worker threads
+    }
 }
 
-//////////////////////////////////////////////////////////////////////////////
-// Midi_ControlSurface
-//////////////////////////////////////////////////////////////////////////////
-void Midi_ControlSurface::ProcessMidiWidget(int &lineNumber, ifstream &surfaceTemplateFile, const vector<string> &in_tokens)
+const vector<ZoneFileIndex::ZoneFileHeader> &ZoneFileIndex::GetHeaders(const string &folderPath)
 {
-    if (in_tokens.size() < 2)
-        return;
+    Folder &folder = folders_[folderPath];
     
-    const string &widgetName = in_tokens[1];
+    if (folder.isCurrent)
+        return folder.headers;
     
-    string widgetClass;
+    folder.isCurrent = true;
     
-    if (in_tokens.size() > 2)
-        widgetClass = in_tokens[2];
-      
-    AddWidget(this, widgetName.c_str());
+    map<string, ZoneFileHeader> previousHeaders;
+    for (auto &header : folder.headers)
+        previousHeaders[header.filePath] = header;
+    
+    folder.headers.clear();
+    
+    vector<int> headersToRead;
+    
+    error_code errorCode;
+    if (filesystem::is_directory(folderPath, errorCode))
+    {
+        for (auto &entry : filesystem::recursive_directory_iterator(folderPath, errorCode))
+        {
+            if (entry.path().extension() != ".zon")
+                continue;
+            
+            ZoneFileHeader header;
+            header.filePath = entry.path().string();
+            header.modifiedTime = entry.last_write_time(errorCode);
+            
+            auto previous = previousHeaders.find(header.filePath);
+            if (previous != previousHeaders.end() && previous->second.modifiedTime == header.modifiedTime && ! errorCode)
+                header = previous->second;
+            else
+                headersToRead.push_back((int)folder.headers.size());
+            
+            folder.headers.push_back(header);
+        }
+    }
+    
+    numFilesListed_ += (int)folder.headers.size();
+    numFilesRead_ += (int)headersToRead.size();
+    
+    // a large FX zone library is thousands of small files, so overlap the reads
+    int numThreads = wdl_min((int)thread::hardware_concurrency(), 4);
+    if (headersToRead.size() < 64 || numThreads < 2)
+        numThreads = 1;
+    
+    atomic<int> next(0);
+    auto readHeaders = [&]()
+    {
+        for (int i = next++; i < headersToRead.size(); i = next++)
+            ReadHeader(folder.headers[headersToRead[i]]);
+    };
+    
+    vector<thread> workers;
+    for (int i = 1; i < numThreads; ++i)
+        workers.push_back(thread(readHeaders));
+    
+    readHeaders();
+    
+    for (auto &worker : workers)
+        worker.join();
+    
+    for (int index : headersToRead)
+    {
+        if (folder.headers[index].hasError)
+        {
+            char buffer[250];
+            snprintf(buffer, sizeof(buffer), "Trouble in %s, around line %d\n", folder.headers[index].filePath.c_str(), 1);
+            ShowConsoleMsg(buffer);
+        }
+    }
+    
+    return folder.headers;
+}
 
-    Widget *widget = GetWidgetByName(in_tokens[1]);
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// TokenizedFileCache
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+static const char s_tokenizedFileMagic[8] = { 'C', 'S', 'I', 'T', 'O', 'K', '0', '2' }; // bump the digits when the layout changes
+
+string TokenizedFileCache::GetCacheFilePath(const string &filePath)
+{
+    char name[64];
+    snprintf(name, sizeof(name), "%016llx.tok", (unsigned long long)GetTextHash64(filePath.c_str()));
+    return cacheFolder_ + name;
+}
+
+bool TokenizedFileCache::ReadSource(const string &filePath, string &contents)
+{
+    contents.clear();
     
-    if (widget == NULL)
-        return;
+    FILE *file = fopenUTF8(filePath.c_str(), "rb");
+    if (file == NULL)
+        return false;
+    
+    char buf[16384];
+    size_t size;
+    while ((size = fread(buf, 1, sizeof(buf), file)) > 0)
+        contents.append(buf, size);
+    
+    fclose(file);
+    return true;
+}
 
-    vector<vector<string>> tokenLines;
+// the same skipping and trimming the text parsers always did, once per file
+void TokenizedFileCache::Tokenize(const string &contents, TokenizedFile &file)
+{
+    file.lines.clear();
     
-    for (string line; getline(surfaceTemplateFile, line) ; )
+    LineTokenizer tokenizer, rawTokenizer;
+    string line;
+    
+    int lineNumber = 0;
+    
+    for (size_t start = 0; start < contents.size(); )
     {
-        TrimLine(line);
+        size_t end = contents.find('\n', start);
+        if (end == string::npos)
+            end = contents.size();
+        
+        string_view rawLine(contents.data() + start, end - start);
+        start = end + 1;
         
         lineNumber++;
         
-        if (line == "" || line[0] == '\r' || line[0] == '/') // ignore comment lines and blank lines
+        line.assign(rawLine.data(), rawLine.size());
+        TrimLine(line);
+        
+        if (line == "" || line[0] == '/') // ignore blank lines and comment lines
             continue;
         
-        vector<string> tokens;
-        GetTokens(tokens, line);
-
-        if (tokens[0] == "WidgetEnd")    // Widget list complete
-            break;
+        const vector<string_view> &tokens = tokenizer.Tokenize(line);
         
-        tokenLines.push_back(tokens);
-    }
-    
-    if (tokenLines.size() < 1)
-        return;
-    
-    for (int i = 0; i < tokenLines.size(); ++i)
-    {
-        int size = (int)tokenLines[i].size();
+        if (tokens.size() == 0)
+            continue;
         
-        const string widgetType = tokenLines[i][0];
-
-        MIDI_event_ex_t *message1 = NULL;
-        MIDI_event_ex_t *message2 = NULL;
-
-        int oneByteKey = 0;
-        int twoByteKey = 0;
-        int threeByteKey = 0;
-        int threeByteKeyMsg2 = 0;
+        file.lines.push_back(TokenizedLine());
+        TokenizedLine &tokenizedLine = file.lines.back();
+        tokenizedLine.lineNumber = lineNumber;
+        tokenizedLine.line = line;
         
-        if (size > 3)
-        {
-            message1 = new MIDI_event_ex_t(strToHex(tokenLines[i][1]), strToHex(tokenLines[i][2]), strToHex(tokenLines[i][3]));
-            
-            if (message1)
-            {
-                oneByteKey = message1->midi_message[0] * 0x10000;
-                twoByteKey = message1->midi_message[0] * 0x10000 + message1->midi_message[1] * 0x100;
-                threeByteKey = message1->midi_message[0] * 0x10000 + message1->midi_message[1] * 0x100 + message1->midi_message[2];
-            }
-        }
-        if (size > 6)
-        {
-            message2 = new MIDI_event_ex_t(strToHex(tokenLines[i][4]), strToHex(tokenLines[i][5]), strToHex(tokenLines[i][6]));
-            
-            if (message2)
-                threeByteKeyMsg2 = message2->midi_message[0] * 0x10000 + message2->midi_message[1] * 0x100 + message2->midi_message[2];
-        }
-        // Control Signal Generators
+        tokenizedLine.tokens.reserve(tokens.size());
+        for (int i = 0; i < tokens.size(); ++i)
+            tokenizedLine.tokens.push_back(string(tokens[i]));
         
-        if (widgetType == "AnyPress" && (size == 4 || size == 7) && message1)
-            AddCSIMessageGenerator(twoByteKey, new AnyPress_Midi_CSIMessageGenerator(csi_, widget, message1));
-        else if (widgetType == "Press" && size == 4 && message1)
-            AddCSIMessageGenerator(threeByteKey, new PressRelease_Midi_CSIMessageGenerator(csi_, widget, message1));
-        else if (widgetType == "Press" && size == 7 && message1 && message2)
+        // only kept when trimming changed the tokens, which is rare
+        if (rawLine != line && rawTokenizer.Tokenize(rawLine) != tokens)
         {
-            AddCSIMessageGenerator(threeByteKey, new PressRelease_Midi_CSIMessageGenerator(csi_, widget, message1, message2));
-            AddCSIMessageGenerator(threeByteKeyMsg2, new PressRelease_Midi_CSIMessageGenerator(csi_, widget, message1, message2));
+            const vector<string_view> &rawTokens = rawTokenizer.GetTokens();
+            
+            for (int i = 0; i < rawTokens.size(); ++i)
+                tokenizedLine.rawTokens.push_back(string(rawTokens[i]));
         }
-        else if (widgetType == "Fader14Bit" && size == 4)
-            AddCSIMessageGenerator(oneByteKey, new Fader14Bit_Midi_CSIMessageGenerator(csi_, widget));
-        else if (widgetType == "FaderportClassicFader14Bit" && size == 7 && message1 && message2)
-            AddCSIMessageGenerator(oneByteKey, new FaderportClassicFader14Bit_Midi_CSIMessageGenerator(csi_, widget, message1, message2));
-        else if (widgetType == "Fader7Bit" && size== 4)
-            AddCSIMessageGenerator(twoByteKey, new Fader7Bit_Midi_CSIMessageGenerator(csi_, widget));
-        else if (widgetType == "Encoder" && widgetClass == "RotaryWidgetClass")
-            AddCSIMessageGenerator(twoByteKey, new AcceleratedPreconfiguredEncoder_Midi_CSIMessageGenerator(csi_, widget));
-        else if (widgetType == "Encoder" && size == 4)
-            AddCSIMessageGenerator(twoByteKey, new Encoder_Midi_CSIMessageGenerator(csi_, widget));
-        else if (widgetType == "MFTEncoder" && size > 4)
+    }
+}
+
+// layout: magic, size, mtime, content hash, line count, then per line its number, text, tokens and raw tokens, and last
+// the FNV-64 of all that -- strings are a 64 bit length and the bytes, all integers in native byte order as the cache never leaves the machine
+static void AppendInt(string &out, long long value) { out.append((const char *)&value, sizeof(value)); }
+
+static void AppendString(string &out, const string &value)
+{
+    AppendInt(out, (long long)value.size());
+    out.append(value);
+}
+
+static void AppendStrings(string &out, const vector<string> &values)
+{
+    AppendInt(out, (long long)values.size());
+    for (auto &value : values)
+        AppendString(out, value);
+}
+
+static bool ReadInt(const char *&p, const char *end, long long &value)
+{
+    if (end - p < (long long)sizeof(value))
+        return false;
+    memcpy(&value, p, sizeof(value));
+    p += sizeof(value);
+    return true;
+}
+
+static bool ReadString(const char *&p, const char *end, string &value)
+{
+    long long size;
+    if ( ! ReadInt(p, end, size) || size < 0 || end - p < size)
+        return false;
+    value.assign(p, (size_t)size);
+    p += size;
+    return true;
+}
+
+static bool ReadStrings(const char *&p, const char *end, vector<string> &values)
+{
+    long long count;
+    if ( ! ReadInt(p, end, count) || count < 0 || count > end - p)
+        return false;
+    values.resize((size_t)count);
+    for (auto &value : values)
+        if ( ! ReadString(p, end, value))
+            return false;
+    return true;
+}
+
+bool TokenizedFileCache::ReadCacheFile(const string &filePath, TokenizedFile &file)
+{
+    string contents;
+    if (cacheFolder_ == "" || ! ReadSource(GetCacheFilePath(filePath), contents))
+        return false;
+    
+    const char *p = contents.c_str();
+    const char *end = p + contents.size();
+    
+    if (end - p < sizeof(s_tokenizedFileMagic) + sizeof(long long) || memcmp(p, s_tokenizedFileMagic, sizeof(s_tokenizedFileMagic)))
+        return false;
+    
+    // a damaged file whose lengths still line up would otherwise load as wrong text
+    long long checksum;
+    end -= sizeof(checksum);
+    memcpy(&checksum, end, sizeof(checksum));
+    if ((WDL_UINT64)checksum != WDL_FNV64(WDL_FNV64_IV, (const unsigned char *)p, (int)(end - p)))
+        return false;
+    
+    p += sizeof(s_tokenizedFileMagic);
+    
+    string cachedFilePath;
+    long long size, modifiedTime, contentHash, count;
+    
+    if ( ! ReadString(p, end, cachedFilePath) || cachedFilePath != filePath)
+        return false;
+    
+    if ( ! ReadInt(p, end, size) || ! ReadInt(p, end, modifiedTime) || ! ReadInt(p, end, contentHash) || ! ReadInt(p, end, count))
+        return false;
+    
+    if (size != file.size || count < 0 || count > end - p)
+        return false;
+    
+    if (modifiedTime != file.modifiedTime)
+    {
+        // touched or copied but maybe not edited -- reading the source is still much cheaper than tokenizing it
+        string source;
+        if ( ! ReadSource(filePath, source) || (WDL_UINT64)contentHash != WDL_FNV64(WDL_FNV64_IV, (const unsigned char *)source.c_str(), (int)source.size()))
+            return false;
+    }
+    
+    file.contentHash = (WDL_UINT64)contentHash;
+    file.lines.resize((size_t)count);
+    
+    for (auto &line : file.lines)
+    {
+        long long lineNumber;
+        if ( ! ReadInt(p, end, lineNumber) || ! ReadString(p, end, line.line) || ! ReadStrings(p, end, line.tokens) || ! ReadStrings(p, end, line.rawTokens))
+        {
+            file.lines.clear();
+            return false;
+        }
+        line.lineNumber = (int)lineNumber;
+    }
+    
+    if (p != end)
+    {
+        file.lines.clear();
+        return false;
+    }
+    
+    if (modifiedTime != file.modifiedTime)
+        WriteCacheFile(filePath, file);
+    
+    return true;
+}
+
+void TokenizedFileCache::WriteCacheFile(const string &filePath, const TokenizedFile &file)
+{
+    if (cacheFolder_ == "")
+        return;
+    
+    error_code errorCode;
+    filesystem::create_directories(cacheFolder_, errorCode);
+    
+    string out;
+    out.append(s_tokenizedFileMagic, sizeof(s_tokenizedFileMagic));
+    AppendString(out, filePath);
+    AppendInt(out, file.size);
+    AppendInt(out, file.modifiedTime);
+    AppendInt(out, (long long)file.contentHash);
+    AppendInt(out, (long long)file.lines.size());
+    
+    for (auto &line : file.lines)
+    {
+        AppendInt(out, line.lineNumber);
+        AppendString(out, line.line);
+        AppendStrings(out, line.tokens);
+        AppendStrings(out, line.rawTokens);
+    }
+    
+    AppendInt(out, (long long)WDL_FNV64(WDL_FNV64_IV, (const unsigned char *)out.c_str(), (int)out.size()));
+    
+    // write then rename, so a crash or a second REAPER instance never sees half a file
+    string cacheFilePath = GetCacheFilePath(filePath);
+    string tmpFilePath = cacheFilePath + ".tmp";
+    
+    FILE *cacheFile = fopenUTF8(tmpFilePath.c_str(), "wb");
+    if (cacheFile == NULL)
+        return;
+    
+    bool isWritten = fwrite(out.c_str(), 1, out.size(), cacheFile) == out.size();
+    fclose(cacheFile);
+    
+    if (isWritten)
+        filesystem::rename(tmpFilePath, cacheFilePath, errorCode);
+    else
+        filesystem::remove(tmpFilePath, errorCode);
+}
+
+const TokenizedFile &TokenizedFileCache::GetFile(const string &filePath)
+{
+    TokenizedFile &file = files_[filePath];
+    
+    error_code errorCode;
+    long long size = (long long)filesystem::file_size(filePath, errorCode);
+    if (errorCode)
+        size = -1;
+    long long modifiedTime = (long long)filesystem::last_write_time(filePath, errorCode).time_since_epoch().count();
+    
+    if (size >= 0 && size == file.size && modifiedTime == file.modifiedTime)
+    {
+        numReused_++;
+        return file;
+    }
+    
+    file.size = size;
+    file.modifiedTime = modifiedTime;
+    
+    if (size >= 0 && ReadCacheFile(filePath, file))
+    {
+        numLoaded_++;
+        return file;
+    }
+    
+    numParsed_++;
+    
+    string contents;
+    ReadSource(filePath, contents);
+    
+    file.contentHash = WDL_FNV64(WDL_FNV64_IV, (const unsigned char *)contents.c_str(), (int)contents.size());
+    Tokenize(contents, file);
+    
+    if (size >= 0)
+        WriteCacheFile(filePath, file);
+    
+    return file;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Midi_ControlSurface
+//////////////////////////////////////////////////////////////////////////////
+void Midi_ControlSurface::ProcessMidiWidget(const vector<TokenizedLine> &lines, int &lineIndex, const vector<string> &in_tokens)
+{
+    if (in_tokens.size() < 2)
+        return;
+    
+    const string &widgetName = in_tokens[1];
+    
+    string widgetClass;
+    
+    if (in_tokens.size() > 2)
+        widgetClass = in_tokens[2];
+      
+    AddWidget(this, widgetName.c_str());
+
+    Widget *widget = GetWidgetByName(in_tokens[1]);
+    
+    if (widget == NULL)
+        return;
+
+    vector<vector<string>> tokenLines;
+    
+    while (++lineIndex < lines.size())
+    {
+        const vector<string> &tokens = lines[lineIndex].tokens;
+
+        if (tokens[0] == "WidgetEnd")    // Widget list complete
+            break;
+        
+        tokenLines.push_back(tokens);
+    }
+    
+    if (tokenLines.size() < 1)
+        return;
+    
+    for (int i = 0; i < tokenLines.size(); ++i)
+    {
+        int size = (int)tokenLines[i].size();
+        
+        const string widgetType = tokenLines[i][0];
+
+        MIDI_event_ex_t *message1 = NULL;
+        MIDI_event_ex_t *message2 = NULL;
+
+        int oneByteKey = 0;
+        int twoByteKey = 0;
+        int threeByteKey = 0;
+        int threeByteKeyMsg2 = 0;
+        
+        if (size > 3)
+        {
+            message1 = new MIDI_event_ex_t(strToHex(tokenLines[i][1]), strToHex(tokenLines[i][2]), strToHex(tokenLines[i][3]));
+            
+            if (message1)
+            {
+                oneByteKey = message1->midi_message[0] * 0x10000;
+                twoByteKey = message1->midi_message[0] * 0x10000 + message1->midi_message[1] * 0x100;
+                threeByteKey = message1->midi_message[0] * 0x10000 + message1->midi_message[1] * 0x100 + message1->midi_message[2];
+            }
+        }
+        if (size > 6)
+        {
+            message2 = new MIDI_event_ex_t(strToHex(tokenLines[i][4]), strToHex(tokenLines[i][5]), strToHex(tokenLines[i][6]));
+            
+            if (message2)
+                threeByteKeyMsg2 = message2->midi_message[0] * 0x10000 + message2->midi_message[1] * 0x100 + message2->midi_message[2];
+        }
+        // Control Signal Generators
+        
+        if (widgetType == "AnyPress" && (size == 4 || size == 7) && message1)
+            AddCSIMessageGenerator(twoByteKey, new AnyPress_Midi_CSIMessageGenerator(csi_, widget, message1));
+        else if (widgetType == "Press" && size == 4 && message1)
+            AddCSIMessageGenerator(threeByteKey, new PressRelease_Midi_CSIMessageGenerator(csi_, widget, message1));
+        else if (widgetType == "Press" && size == 7 && message1 && message2)
+        {
+            AddCSIMessageGenerator(threeByteKey, new PressRelease_Midi_CSIMessageGenerator(csi_, widget, message1, message2));
+            AddCSIMessageGenerator(threeByteKeyMsg2, new PressRelease_Midi_CSIMessageGenerator(csi_, widget, message1, message2));
+        }
+        else if (widgetType == "Fader14Bit" && size == 4)
+            AddCSIMessageGenerator(oneByteKey, new Fader14Bit_Midi_CSIMessageGenerator(csi_, widget));
+        else if (widgetType == "FaderportClassicFader14Bit" && size == 7 && message1 && message2)
+            AddCSIMessageGenerator(oneByteKey, new FaderportClassicFader14Bit_Midi_CSIMessageGenerator(csi_, widget, message1, message2));
+        else if (widgetType == "Fader7Bit" && size== 4)
+            AddCSIMessageGenerator(twoByteKey, new Fader7Bit_Midi_CSIMessageGenerator(csi_, widget));
+        else if (widgetType == "Encoder" && widgetClass == "RotaryWidgetClass")
+            AddCSIMessageGenerator(twoByteKey, new AcceleratedPreconfiguredEncoder_Midi_CSIMessageGenerator(csi_, widget));
+        else if (widgetType == "Encoder" && size == 4)
+            AddCSIMessageGenerator(twoByteKey, new Encoder_Midi_CSIMessageGenerator(csi_, widget));
+        else if (widgetType == "MFTEncoder" && size > 4)
             AddCSIMessageGenerator(twoByteKey, new MFT_AcceleratedEncoder_Midi_CSIMessageGenerator(csi_, widget, tokenLines[i]));
         else if (widgetType == "EncoderPlain" && size == 4)
             AddCSIMessageGenerator(twoByteKey, new EncoderPlain_Midi_CSIMessageGenerator(csi_, widget));
@@ -750,7 +1292,7 @@ void Midi_ControlSurface::ProcessMidiWidget(int &lineNumber, ifstream &surfaceTe
 //////////////////////////////////////////////////////////////////////////////
 // OSC_ControlSurface
 //////////////////////////////////////////////////////////////////////////////
-void OSC_ControlSurface::ProcessOSCWidget(int &lineNumber, ifstream &surfaceTemplateFile, const vector<string> &in_tokens)
+void OSC_ControlSurface::ProcessOSCWidget(const vector<TokenizedLine> &lines, int &lineIndex, const vector<string> &in_tokens)
 {
     if (in_tokens.size() < 2)
         return;
@@ -764,15 +1306,9 @@ void OSC_ControlSurface::ProcessOSCWidget(int &lineNumber, ifstream &surfaceTemp
     
     vector<vector<string>> tokenLines;
 
-    for (string line; getline(surfaceTemplateFile, line) ; )
+    while (++lineIndex < lines.size())
     {
-        lineNumber++;
-        
-        if (line == "" || line[0] == '\r' || line[0] == '/') // ignore comment lines and blank lines
-            continue;
-        
-        vector<string> tokens;
-        GetTokens(tokens, line);
+        const vector<string> &tokens = lines[lineIndex].GetRawTokens(); // untrimmed, OSC addresses start with '/'
 
         if (tokens[0] == "WidgetEnd")    // Widget list complete
             break;
@@ -884,19 +1420,13 @@ void Midi_ControlSurface::ProcessMIDIWidgetFile(const string &filePath, Midi_Con
 
     try
     {
-        ifstream file(filePath);
+        const vector<TokenizedLine> &lines = csi_->GetTokenizedFileCache().GetFile(filePath).lines;
         
-        for (string line; getline(file, line) ; )
+        for (int lineIndex = 0; lineIndex < lines.size(); ++lineIndex)
         {
-            TrimLine(line);
-            
-            lineNumber++;
+            lineNumber = lines[lineIndex].lineNumber;
             
-            if (line == "" || line[0] == '\r' || line[0] == '/') // ignore comment lines and blank lines
-                continue;
-            
-            vector<string> tokens;
-            GetTokens(tokens, line.c_str());
+            const vector<string> &tokens = lines[lineIndex].tokens;
 
             if (tokens.size() > 0 && tokens[0] != "Widget")
                 valueLines.push_back(tokens);
@@ -905,7 +1435,7 @@ void Midi_ControlSurface::ProcessMIDIWidgetFile(const string &filePath, Midi_Con
                 ProcessValues(valueLines);
 
             if (tokens.size() > 0 && (tokens[0] == "Widget"))
-                ProcessMidiWidget(lineNumber, file, tokens);
+                ProcessMidiWidget(lines, lineIndex, tokens);
         }
     }
     catch (exception)
@@ -931,19 +1461,13 @@ void OSC_ControlSurface::ProcessOSCWidgetFile(const string &filePath)
 
     try
     {
-        ifstream file(filePath);
+        const vector<TokenizedLine> &lines = csi_->GetTokenizedFileCache().GetFile(filePath).lines;
         
-        for (string line; getline(file, line) ; )
+        for (int lineIndex = 0; lineIndex < lines.size(); ++lineIndex)
         {
-            TrimLine(line);
-            
-            lineNumber++;
-            
-            if (line == "" || line[0] == '\r' || line[0] == '/') // ignore comment lines and blank lines
-                continue;
+            lineNumber = lines[lineIndex].lineNumber;
             
-            vector<string> tokens;
-            GetTokens(tokens, line);
+            const vector<string> &tokens = lines[lineIndex].tokens;
 
             if (tokens.size() > 0 && tokens[0] != "Widget")
                 valueLines.push_back(tokens);
@@ -952,7 +1476,7 @@ void OSC_ControlSurface::ProcessOSCWidgetFile(const string &filePath)
                 ProcessValues(valueLines);
 
             if (tokens.size() > 0 && (tokens[0] == "Widget"))
-                ProcessOSCWidget(lineNumber, file, tokens);
+                ProcessOSCWidget(lines, lineIndex, tokens);
         }
     }
     catch (exception)
@@ -997,6 +1521,9 @@ void CSurfIntegrator::InitActionsDictionary()
     actions_["ToggleFollowMCP"] = new ToggleFollowMCP();
     actions_["ToggleScrollLink"] = new ToggleScrollLink();
     actions_["ToggleRestrictTextLength"] = new ToggleRestrictTextLength();
+    actions_["ToggleProfiler"] = new ToggleProfiler();
+    actions_["ReportMemoryUsage"] = new ReportMemoryUsage();
+    actions_["ResyncSurfaces"] = new ResyncSurfaces();
     actions_["CSINameDisplay"] = new CSINameDisplay();
     actions_["CSIVersionDisplay"] = new CSIVersionDisplay();
     actions_["GlobalModeDisplay"] = new GlobalModeDisplay();
@@ -1137,6 +1664,12 @@ void CSurfIntegrator::Init()
     
     isInitialized_ = true;
     
+    long long startTime = CSIProfiler::GetMicroseconds();
+    
+    zoneFileIndex_.Invalidate();
+    tokenizedFileCache_.SetCacheFolder(string(GetResourcePath()) + "/CSI/Cache/");
+    tokenizedFileCache_.ResetCounts();
+    
     pages_.clear();
     
     string currentBroadcaster;
@@ -1171,6 +1704,8 @@ void CSurfIntegrator::Init()
     try
     {
         ifstream iniFile(iniFilePath);
+        
+        LineTokenizer tokenizer;
                
         for (string line; getline(iniFile, line) ; )
         {
@@ -1179,9 +1714,7 @@ void CSurfIntegrator::Init()
             if (lineNumber == 0)
             {
                 PropertyList pList;
-                vector<string> properties;
-                properties.push_back(line.c_str());
-                GetPropertiesFromTokens(0, 1, properties, pList);
+                GetPropertyFromToken(line.c_str(), pList);
 
                 const char *versionProp = pList.get_prop(PropertyType_Version);
                 if (versionProp)
@@ -1215,8 +1748,7 @@ void CSurfIntegrator::Init()
             if (line == "" || line[0] == '\r' || line[0] == '/') // ignore comment lines and blank lines
                 continue;
             
-            vector<string> tokens;
-            GetTokens(tokens, line.c_str());
+            const vector<string_view> &tokens = tokenizer.Tokenize(line);
             
             if (tokens.size() > 0) // ignore comment lines and blank lines
             {
@@ -1231,7 +1763,7 @@ void CSurfIntegrator::Init()
                         {
                             int channelCount = atoi(channelCountProp);
                             
-                            if ( ! strcmp(typeProp, s_MidiSurfaceToken) && tokens.size() == 7)
+                            if ( ! strcmp(typeProp, s_MidiSurfaceToken) && tokens.size() >= 7 && tokens.size() <= 10)
                             {
                                 if (pList.get_prop(PropertyType_MidiInput) != NULL &&
                                     pList.get_prop(PropertyType_MidiOutput) != NULL &&
@@ -1242,11 +1774,26 @@ void CSurfIntegrator::Init()
                                     int midiOut = atoi(pList.get_prop(PropertyType_MidiOutput));
                                     int surfaceRefreshRate = atoi(pList.get_prop(PropertyType_MIDISurfaceRefreshRate));
                                     int maxMIDIMesssagesPerRun = atoi(pList.get_prop(PropertyType_MaxMIDIMesssagesPerRun));
+                                    int maxMIDIBytesPerSecond = 0;
+                                    
+                                    if (const char *maxMIDIBytesPerSecondProp = pList.get_prop(PropertyType_MaxMIDIBytesPerSecond))
+                                        maxMIDIBytesPerSecond = atoi(maxMIDIBytesPerSecondProp);
+                                    
+                                    Midi_ControlSurfaceIO *midiSurfaceIO = new Midi_ControlSurfaceIO(this, nameProp, channelCount, GetMidiInputForPort(midiIn), GetMidiOutputForPort(midiOut), surfaceRefreshRate, maxMIDIMesssagesPerRun, maxMIDIBytesPerSecond);
+                                    
+                                    if (const char *midiIOThreadProp = pList.get_prop(PropertyType_MIDIIOThread))
+                                    {
+                                        if ( ! strcmp(midiIOThreadProp, "Yes"))
+                                            midiSurfaceIO->RequestIOThread();
+                                    }
                                     
-                                    midiSurfacesIO_.push_back(new Midi_ControlSurfaceIO(this, nameProp, channelCount, GetMidiInputForPort(midiIn), GetMidiOutputForPort(midiOut), surfaceRefreshRate, maxMIDIMesssagesPerRun));
+                                    if (const char *feedbackBudgetProp = pList.get_prop(PropertyType_FeedbackBudget))
+                                        midiSurfaceIO->SetFeedbackBudget(atoi(feedbackBudgetProp));
+                                    
+                                    midiSurfacesIO_.push_back(midiSurfaceIO);
                                 }
                             }
-                            else if (( ! strcmp(typeProp, s_OSCSurfaceToken) || ! strcmp(typeProp, s_OSCX32SurfaceToken)) && tokens.size() == 7)
+                            else if (( ! strcmp(typeProp, s_OSCSurfaceToken) || ! strcmp(typeProp, s_OSCX32SurfaceToken)) && tokens.size() >= 7 && tokens.size() <= 10)
                             {
                                 if (pList.get_prop(PropertyType_ReceiveOnPort) != NULL &&
                                     pList.get_prop(PropertyType_TransmitToPort) != NULL &&
@@ -1257,11 +1804,31 @@ void CSurfIntegrator::Init()
                                     const char *transmitToPort = pList.get_prop(PropertyType_TransmitToPort);
                                     const char *transmitToIPAddress = pList.get_prop(PropertyType_TransmitToIPAddress);
                                     int maxPacketsPerRun = atoi(pList.get_prop(PropertyType_MaxPacketsPerRun));
+                                    int maxBundleSize = 0;
+                                    
+                                    if (const char *maxBundleSizeProp = pList.get_prop(PropertyType_MaxBundleSize))
+                                        maxBundleSize = atoi(maxBundleSizeProp);
+                                    
+                                    OSC_ControlSurfaceIO *oscSurfaceIO = NULL;
                                     
                                     if ( ! strcmp(typeProp, s_OSCSurfaceToken))
-                                        oscSurfacesIO_.push_back(new OSC_ControlSurfaceIO(this, nameProp, channelCount, receiveOnPort, transmitToPort, transmitToIPAddress, maxPacketsPerRun));
+                                        oscSurfaceIO = new OSC_ControlSurfaceIO(this, nameProp, channelCount, receiveOnPort, transmitToPort, transmitToIPAddress, maxPacketsPerRun, maxBundleSize);
                                     else if ( ! strcmp(typeProp, s_OSCX32SurfaceToken))
-                                        oscSurfacesIO_.push_back(new OSC_X32ControlSurfaceIO(this, nameProp, channelCount, receiveOnPort, transmitToPort, transmitToIPAddress, maxPacketsPerRun));
+                                        oscSurfaceIO = new OSC_X32ControlSurfaceIO(this, nameProp, channelCount, receiveOnPort, transmitToPort, transmitToIPAddress, maxPacketsPerRun, maxBundleSize);
+                                    
+                                    if (oscSurfaceIO != NULL)
+                                    {
+                                        if (const char *oscReceiveThreadProp = pList.get_prop(PropertyType_OSCReceiveThread))
+                                        {
+                                            if ( ! strcmp(oscReceiveThreadProp, "Yes"))
+                                                oscSurfaceIO->StartReceiveThread();
+                                        }
+                                        
+                                        if (const char *feedbackBudgetProp = pList.get_prop(PropertyType_FeedbackBudget))
+                                            oscSurfaceIO->SetFeedbackBudget(atoi(feedbackBudgetProp));
+                                        
+                                        oscSurfacesIO_.push_back(oscSurfaceIO);
+                                    }
                                 }
                             }
                         }
@@ -1273,6 +1840,7 @@ void CSurfIntegrator::Init()
                     bool synchPages = true;
                     bool isScrollLinkEnabled = false;
                     bool isScrollSynchEnabled = false;
+                    bool isChangeDrivenFeedback = false;
 
                     currentPage = NULL;
                     
@@ -1302,7 +1870,25 @@ void CSurfIntegrator::Init()
                                 isScrollSynchEnabled = true;
                         }
                         
-                        currentPage = new Page(this, pageNameProp, followMCP, synchPages, isScrollLinkEnabled, isScrollSynchEnabled);
+                        if (const char *changeDrivenFeedbackProp = pList.get_prop(PropertyType_ChangeDrivenFeedback))
+                        {
+                            if ( ! strcmp(changeDrivenFeedbackProp, "Yes"))
+                                isChangeDrivenFeedback = true;
+                        }
+                        
+                        currentPage = new Page(this, pageNameProp, followMCP, synchPages, isScrollLinkEnabled, isScrollSynchEnabled, isChangeDrivenFeedback);
+                        
+                        double meterDecay = 0.0;
+                        int meterPeakHold = 0;
+                        
+                        if (const char *meterDecayProp = pList.get_prop(PropertyType_MeterDecay))
+                            meterDecay = atof(meterDecayProp);
+                        
+                        if (const char *meterPeakHoldProp = pList.get_prop(PropertyType_MeterPeakHold))
+                            meterPeakHold = atoi(meterPeakHoldProp);
+                        
+                        currentPage->GetMeterSampler().SetBallistics(meterDecay, meterPeakHold);
+                        
                         pages_.push_back(currentPage);
                     }
                 }
@@ -1404,7 +1990,9 @@ void CSurfIntegrator::Init()
                                     if ( ! strcmp(surfaceProp, io->GetName()))
                                     {
                                         foundIt = true;
-                                        currentPage->AddSurface(new Midi_ControlSurface(this, currentPage, surfaceProp, startChannel, surfaceFile.c_str(), zoneFolder.c_str(), fxZoneFolder.c_str(), io));
+                                        ControlSurface *surface = new Midi_ControlSurface(this, currentPage, surfaceProp, startChannel, surfaceFile.c_str(), zoneFolder.c_str(), fxZoneFolder.c_str(), io);
+                                        surface->SetFeedbackBudget(io->GetFeedbackBudget());
+                                        currentPage->AddSurface(surface);
                                         break;
                                     }
                                 }
@@ -1418,7 +2006,9 @@ void CSurfIntegrator::Init()
                                         if ( ! strcmp(surfaceProp, io->GetName()))
                                         {
                                             foundIt = true;
-                                            currentPage->AddSurface(new OSC_ControlSurface(this, currentPage, surfaceProp, startChannel, surfaceFile.c_str(), zoneFolder.c_str(), fxZoneFolder.c_str(), io));
+                                            ControlSurface *surface = new OSC_ControlSurface(this, currentPage, surfaceProp, startChannel, surfaceFile.c_str(), zoneFolder.c_str(), fxZoneFolder.c_str(), io);
+                                            surface->SetFeedbackBudget(io->GetFeedbackBudget());
+                                            currentPage->AddSurface(surface);
                                             break;
                                         }
                                     }
@@ -1440,7 +2030,12 @@ void CSurfIntegrator::Init()
     }
     
     if (pages_.size() == 0)
-        pages_.push_back(new Page(this, "Home", false, false, false, false));
+        pages_.push_back(new Page(this, "Home", false, false, false, false, false));
+    
+    // only now are the port refcounts final, a later surface line may share a port with an earlier one
+    for (auto midiSurfaceIO : midiSurfacesIO_)
+        if (midiSurfaceIO->GetIsIOThreadRequested())
+            midiSurfaceIO->StartIOThread();
     
     for (auto page : pages_)
     {
@@ -1449,6 +2044,12 @@ void CSurfIntegrator::Init()
 
         page->OnInitialization();
     }
+    
+    char note[MEDBUF];
+    snprintf(note, sizeof(note), "%.1f ms, %d zone files listed, %d read, templates and zones: %d parsed, %d from CSI/Cache, %d reused",
+             (CSIProfiler::GetMicroseconds() - startTime) / 1000.0, zoneFileIndex_.GetNumFilesListed(), zoneFileIndex_.GetNumFilesRead(),
+             tokenizedFileCache_.GetNumParsed(), tokenizedFileCache_.GetNumLoaded(), tokenizedFileCache_.GetNumReused());
+    profiler_.SetNote("Startup/Init", note);
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -1707,8 +2308,53 @@ void ActionContext::RunDeferredActions()
 
 void ActionContext::RequestUpdate()
 {
-    if (provideFeedback_)
-        action_->RequestUpdate(this);
+    if ( ! provideFeedback_)
+        return;
+    
+    ProfileHistogram *histogram = csi_->GetProfiler().GetHistogram(action_->requestUpdateHistogram_, "Action", action_->GetName(), "RequestUpdate");
+    ProfileScope profileScope(histogram);
+    
+    TrackProperty property = action_->GetTrackProperty();
+    
+    if (property == TrackProperty_None || supportsTrackColor_ || ! GetPage()->GetIsChangeDrivenFeedback())
+    {
+        if (histogram)
+            GetSurface()->CountProfiledActionUpdate();
+        
+        RefreshWidget();
+        return;
+    }
+    
+    // ChangeDrivenFeedback -- only refresh when REAPER has pushed a change for (track, property),
+    // the context now points at a different track, or something else has written to the Widget since our last refresh
+    TrackPropertyChanges &changes = csi_->GetTrackPropertyChanges();
+    MediaTrack *track = GetTrack();
+    DWORD now = GetTickCount();
+    
+    if (track == lastUpdateTrack_ &&
+        widget_->GetFeedbackSerial() == lastUpdateWidgetSerial_ &&
+        now - lastUpdateTime_ < s_changeDrivenFeedbackResyncInterval &&
+        ! changes.HasChanged(track, property, lastUpdateChangeGeneration_))
+        return;
+    
+    if (histogram)
+        GetSurface()->CountProfiledActionUpdate();
+    
+    RefreshWidget();
+    
+    lastUpdateTrack_ = track;
+    lastUpdateChangeGeneration_ = changes.GetGeneration();
+    lastUpdateWidgetSerial_ = widget_->GetFeedbackSerial();
+    lastUpdateTime_ = now;
+}
+
+// what a context writes while refreshing its own feedback leaves the Widget's serials alone, otherwise two contexts
+// sharing a Widget would each see the other's refresh as a change and keep retriggering one another
+void ActionContext::RefreshWidget()
+{
+    widget_->SetIsRefreshing(true);
+    action_->RequestUpdate(this);
+    widget_->SetIsRefreshing(false);
 }
 
 void ActionContext::ClearWidget()
@@ -1752,8 +2398,19 @@ void ActionContext::UpdateTrackColor()
 {
     if (MediaTrack *track = zone_->GetNavigator()->GetTrack())
     {
-        rgba_color color = DAW::GetTrackColor(track);
-        widget_->UpdateColorValue(color);
+        TrackColors &trackColors = csi_->GetTrackColors();
+        
+        // nothing to do unless the color, the track, or something else writing colors to the Widget has changed
+        if (track == lastColorTrack_ &&
+            widget_->GetColorSerial() == lastColorWidgetSerial_ &&
+            ! trackColors.HasChanged(track, lastColorGeneration_))
+            return;
+        
+        widget_->UpdateColorValue(trackColors.GetColor(track));
+        
+        lastColorTrack_ = track;
+        lastColorGeneration_ = trackColors.GetGeneration();
+        lastColorWidgetSerial_ = widget_->GetColorSerial();
     }
 }
 
@@ -1834,6 +2491,8 @@ void ActionContext::DoRangeBoundAction(double value)
     if (isValueInverted_)
         value = 1.0 - value;
     
+    ProfileScope profileScope(csi_->GetProfiler().GetHistogram(action_->doHistogram_, "Action", action_->GetName(), "Do"));
+    
     action_->Do(this, value);
 }
 
@@ -2020,28 +2679,83 @@ void ActionContext::GetSteppedValues(Widget *widget, Action *action,  Zone *zone
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
-// Zone
-///////////////////////////////////////////////////////////////////////////////////////////////////////
-void Zone::InitSubZones(const vector<string> &subZones, const char *widgetSuffix)
+// ZoneArena
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+void *ZoneArena::Allocate(size_t size, size_t alignment)
 {
-    map<const string, CSIZoneInfo> &zoneInfo = zoneManager_->GetZoneInfo();
-
-    for (int i = 0; i < (int)subZones.size(); ++i)
+    size_t offset = (blockUsed_ + alignment - 1) & ~(alignment - 1);
+    
+    if (offset + size > BLOCK_SIZE)
     {
-        if (zoneInfo.find(subZones[i]) != zoneInfo.end())
+        if (size > BLOCK_SIZE) // gets a block of its own, the current one stays current
         {
-            SubZone *subZone = new SubZone(csi_, zoneManager_, GetNavigator(), GetSlotIndex(), subZones[i], zoneInfo[subZones[i]].alias, zoneInfo[subZones[i]].filePath, this);
-            zoneManager_->LoadZoneFile(subZone, widgetSuffix);
-            subZones_.push_back(subZone);
+            char *block = (char *)malloc(size);
+            if (block == NULL)
+                throw bad_alloc();
+            
+            blocks_.insert(blocks_.begin(), block);
+            bytesReserved_ += size;
+            bytesUsed_ += size;
+            
+            return block;
         }
+        
+        char *block = (char *)malloc(BLOCK_SIZE);
+        if (block == NULL)
+            throw bad_alloc();
+        
+        blocks_.push_back(block);
+        bytesReserved_ += BLOCK_SIZE;
+        offset = 0;
     }
+    
+    blockUsed_ = offset + size;
+    bytesUsed_ += size;
+    
+    return blocks_.back() + offset;
 }
 
-int Zone::GetSlotIndex()
+void ZoneArena::Release()
 {
-    if (name_ == "TrackSend")
-        return zoneManager_->GetTrackSendOffset();
-    if (name_ == "TrackReceive")
+    for (int i = (int)destructors_.size() - 1; i >= 0; --i)
+        destructors_[i].destroy(destructors_[i].object);
+    
+    destructors_.clear();
+    
+    for (auto block : blocks_)
+        free(block);
+    
+    blocks_.clear();
+    blockUsed_ = BLOCK_SIZE;
+    bytesUsed_ = 0;
+    bytesReserved_ = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Zone
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+int Zone::numLiveZones_ = 0;
+
+void Zone::InitSubZones(const vector<string> &subZones, const char *widgetSuffix)
+{
+    map<const string, CSIZoneInfo> &zoneInfo = zoneManager_->GetZoneInfo();
+
+    for (int i = 0; i < (int)subZones.size(); ++i)
+    {
+        if (zoneInfo.find(subZones[i]) != zoneInfo.end())
+        {
+            SubZone *subZone = new SubZone(csi_, zoneManager_, GetNavigator(), GetSlotIndex(), subZones[i], zoneInfo[subZones[i]].alias, zoneInfo[subZones[i]].filePath, this);
+            zoneManager_->LoadZoneFile(subZone, widgetSuffix);
+            subZones_.push_back(subZone);
+        }
+    }
+}
+
+int Zone::GetSlotIndex()
+{
+    if (name_ == "TrackSend")
+        return zoneManager_->GetTrackSendOffset();
+    if (name_ == "TrackReceive")
         return zoneManager_->GetTrackReceiveOffset();
     if (name_ == "TrackFXMenu")
         return zoneManager_->GetTrackFXMenuOffset();
@@ -2061,7 +2775,10 @@ int Zone::GetSlotIndex()
 void Zone::AddWidget(Widget *widget)
 {
     if (find(widgets_.begin(), widgets_.end(), widget) == widgets_.end())
+    {
         widgets_.push_back(widget);
+        zoneManager_->InvalidateWidgetOwners();
+    }
 }
 
 void Zone::Activate()
@@ -2079,6 +2796,8 @@ void Zone::Activate()
 
     isActive_ = true;
     
+    zoneManager_->InvalidateWidgetOwners();
+    
     if (!strcmp(GetName(), "VCA"))
         zoneManager_->GetSurface()->GetPage()->VCAModeActivated();
     else if (!strcmp(GetName(), "Folder"))
@@ -2111,6 +2830,8 @@ void Zone::Deactivate()
 
     isActive_ = false;
     
+    zoneManager_->InvalidateWidgetOwners();
+    
     if (!strcmp(GetName(), "VCA"))
         zoneManager_->GetSurface()->GetPage()->VCAModeDeactivated();
     else if (!strcmp(GetName(), "Folder"))
@@ -2130,6 +2851,9 @@ void Zone::RequestUpdate()
     if (! isActive_)
         return;
     
+    // inclusive of sub and included Zones
+    ProfileScope profileScope(csi_->GetProfiler().GetHistogram(requestUpdateHistogram_, "Zone", zoneManager_->GetSurface()->GetName(), name_.c_str()));
+    
     for (int i = 0; i < subZones_.size(); ++i)
         subZones_[i]->RequestUpdate();
 
@@ -2141,7 +2865,7 @@ void Zone::RequestUpdate()
         if ( ! widget->GetHasBeenUsedByUpdate())
         {
             widget->SetHasBeenUsedByUpdate();
-            RequestUpdateWidget(widget);
+            zoneManager_->GetSurface()->RequestWidgetUpdate(this, widget);
         }
     }
 }
@@ -2158,140 +2882,124 @@ void Zone::RestoreXTouchDisplayColors()
         widget->RestoreXTouchDisplayColors();
 }
 
-void Zone::DoAction(Widget *widget, bool &isUsed, double value)
+Zone *Zone::GetOwningZone(Widget *widget)
 {
-    if (! isActive_ || isUsed)
-        return;
-        
+    // Same precedence the input used to walk at dispatch time: subZones first, then this Zone, then includedZones
+    if (! isActive_)
+        return NULL;
+    
     for (int i = 0; i < subZones_.size(); ++i)
-        subZones_[i]->DoAction(widget, isUsed, value);
-
-    if (isUsed)
-        return;
-
+        if (Zone *zone = subZones_[i]->GetOwningZone(widget))
+            return zone;
+    
     if (find(widgets_.begin(), widgets_.end(), widget) != widgets_.end())
-    {
-        if (g_surfaceInDisplay)
-        {
-            char buffer[250];
-            snprintf(buffer, sizeof(buffer), "Zone -- %s\n\n", sourceFilePath_.c_str());
-            ShowConsoleMsg(buffer);
-        }
+        return this;
+    
+    for (int i = 0; i < includedZones_.size(); ++i)
+        if (Zone *zone = includedZones_[i]->GetOwningZone(widget))
+            return zone;
+    
+    return NULL;
+}
 
-        isUsed = true;
-        
-        for (auto actionContext : GetActionContexts(widget))
-            actionContext->DoAction(value);
-    }
-    else
+void Zone::DoAction(Widget *widget, double value)
+{
+    if (g_surfaceInDisplay)
     {
-        for (int i = 0; i < includedZones_.size(); ++i)
-            includedZones_[i]->DoAction(widget, isUsed, value);
+        char buffer[250];
+        snprintf(buffer, sizeof(buffer), "Zone -- %s\n\n", sourceFilePath_.c_str());
+        ShowConsoleMsg(buffer);
     }
+
+    for (auto actionContext : GetActionContexts(widget))
+        actionContext->DoAction(value);
 }
 
-void Zone::DoRelativeAction(Widget *widget, bool &isUsed, double delta)
+void Zone::DoRelativeAction(Widget *widget, double delta)
 {
-    if (! isActive_ || isUsed)
-        return;
-    
-    for (int i = 0; i < subZones_.size(); ++i)
-        subZones_[i]->DoRelativeAction(widget, isUsed, delta);
+    if (g_surfaceInDisplay)
+    {
+        char buffer[250];
+        snprintf(buffer, sizeof(buffer), "Zone -- %s\n\n", sourceFilePath_.c_str());
+        ShowConsoleMsg(buffer);
+    }
 
-    if (isUsed)
-        return;
+    for (auto actionContext : GetActionContexts(widget))
+        actionContext->DoRelativeAction(delta);
+}
 
-    if (find(widgets_.begin(), widgets_.end(), widget) != widgets_.end())
+void Zone::DoRelativeAction(Widget *widget, int accelerationIndex, double delta)
+{
+    if (g_surfaceInDisplay)
     {
-        if (g_surfaceInDisplay)
-        {
-            char buffer[250];
-            snprintf(buffer, sizeof(buffer), "Zone -- %s\n\n", sourceFilePath_.c_str());
-            ShowConsoleMsg(buffer);
-        }
+        char buffer[250];
+        snprintf(buffer, sizeof(buffer), "Zone -- %s\n\n", sourceFilePath_.c_str());
+        ShowConsoleMsg(buffer);
+    }
 
-        isUsed = true;
+    for (auto actionContext : GetActionContexts(widget))
+        actionContext->DoRelativeAction(accelerationIndex, delta);
+}
 
-        for (auto actionContext : GetActionContexts(widget))
-            actionContext->DoRelativeAction(delta);
-    }
-    else
+void Zone::DoTouch(Widget *widget, double value)
+{
+    if (g_surfaceInDisplay)
     {
-        for (int i = 0; i < includedZones_.size(); ++i)
-            includedZones_[i]->DoRelativeAction(widget, isUsed, delta);
+        char buffer[250];
+        snprintf(buffer, sizeof(buffer), "Zone -- %s\n\n", sourceFilePath_.c_str());
+        ShowConsoleMsg(buffer);
     }
+
+    for (auto actionContext : GetActionContexts(widget))
+        actionContext->DoTouch(value);
 }
 
-void Zone::DoRelativeAction(Widget *widget, bool &isUsed, int accelerationIndex, double delta)
+void Zone::OnTrackDeselection()
 {
-    if (! isActive_ || isUsed)
-        return;
-
-    for (int i = 0; i < subZones_.size(); ++i)
-        subZones_[i]->DoRelativeAction(widget, isUsed, accelerationIndex, delta);
+    isActive_ = true;
     
-    if (isUsed)
-        return;
-
-    if (find(widgets_.begin(), widgets_.end(), widget) != widgets_.end())
-    {
-        if (g_surfaceInDisplay)
-        {
-            char buffer[250];
-            snprintf(buffer, sizeof(buffer), "Zone -- %s\n\n", sourceFilePath_.c_str());
-            ShowConsoleMsg(buffer);
-        }
-
-        isUsed = true;
+    zoneManager_->InvalidateWidgetOwners();
+    
+    for (int i = 0; i < includedZones_.size(); ++i)
+        includedZones_[i]->Activate();
+}
 
-        for (auto actionContext : GetActionContexts(widget))
-            actionContext->DoRelativeAction(accelerationIndex, delta);
-    }
-    else
-    {
-        for (int i = 0; i < includedZones_.size(); ++i)
-            includedZones_[i]->DoRelativeAction(widget, isUsed, accelerationIndex, delta);
-    }
+void Zone::AddActionContext(Widget *widget, int modifier, ActionContext *actionContext)
+{
+    actionContextDictionary_[widget][modifier].push_back(actionContext);
+    
+    if (widget->GetIndex() < currentActionContexts_.size())
+        currentActionContexts_[widget->GetIndex()].isResolved = false;
 }
 
-void Zone::DoTouch(Widget *widget, const char *widgetName, bool &isUsed, double value)
+void Zone::AddMemoryUsage(ZoneMemoryUsage &usage)
 {
-    if (! isActive_ || isUsed)
-        return;
+    usage.numZones++;
+    usage.numActionContexts += arena_.GetNumObjects();
+    usage.arenaBytesUsed += arena_.GetBytesUsed();
+    usage.arenaBytesReserved += arena_.GetBytesReserved();
+}
 
-    for (int i = 0; i < subZones_.size(); ++i)
-        subZones_[i]->DoTouch(widget, widgetName, isUsed, value);
+void Zone::AddZones(vector<Zone *> &zones)
+{
+    zones.push_back(this);
     
-    if (isUsed)
-        return;
+    for (auto includedZone : includedZones_)
+        includedZone->AddZones(zones);
     
-    if (find(widgets_.begin(), widgets_.end(), widget) != widgets_.end())
-    {
-        if (g_surfaceInDisplay)
-        {
-            char buffer[250];
-            snprintf(buffer, sizeof(buffer), "Zone -- %s\n\n", sourceFilePath_.c_str());
-            ShowConsoleMsg(buffer);
-        }
-
-        isUsed = true;
-
-        for (auto actionContext : GetActionContexts(widget))
-            actionContext->DoTouch(value);
-    }
-    else
-    {
-        for (int i = 0; i < includedZones_.size(); ++i)
-            includedZones_[i]->DoTouch(widget, widgetName, isUsed, value);
-    }
+    for (auto subZone : subZones_)
+        subZone->AddZones(zones);
 }
 
 void Zone::UpdateCurrentActionContextModifiers()
 {
+    for (auto &currentActionContexts : currentActionContexts_)
+        currentActionContexts.isResolved = false;
+    
     for (auto widget : widgets_)
     {
         UpdateCurrentActionContextModifier(widget);
-        widget->Configure(GetActionContexts(widget, currentActionContextModifiers_[widget]));
+        widget->Configure(GetActionContexts(widget, currentActionContexts_[widget->GetIndex()].modifier));
     }
     
     for (int i = 0; i < includedZones_.size(); ++i)
@@ -2303,50 +3011,78 @@ void Zone::UpdateCurrentActionContextModifiers()
 
 void Zone::UpdateCurrentActionContextModifier(Widget *widget)
 {
-    for(int i = 0; i < (int)widget->GetSurface()->GetModifiers().size(); ++i)
+    if (widget->GetIndex() >= currentActionContexts_.size())
+        currentActionContexts_.resize(widget->GetIndex() + 1);
+    
+    CurrentActionContexts &current = currentActionContexts_[widget->GetIndex()];
+    
+    current.isResolved = true;
+    
+    for (int i = 0; i < NUM_ELEM(current.contexts); ++i)
+        current.contexts[i] = &emptyContexts_;
+    
+    auto widgetContexts = actionContextDictionary_.find(widget);
+    
+    if (widgetContexts == actionContextDictionary_.end())
+        return;
+    
+    map<int, vector<ActionContext *> > &contexts = widgetContexts->second;
+    const vector<int> &modifiers = widget->GetSurface()->GetModifiers();
+    
+    for(int i = 0; i < (int)modifiers.size(); ++i)
     {
-        if(actionContextDictionary_[widget].count(widget->GetSurface()->GetModifiers()[i]) > 0)
+        if(contexts.count(modifiers[i]) > 0)
         {
-            currentActionContextModifiers_[widget] = widget->GetSurface()->GetModifiers()[i];
+            current.modifier = modifiers[i];
             break;
         }
     }
+    
+    auto unmodified = contexts.find(current.modifier);
+    auto touched = contexts.find(current.modifier + 1);
+    auto toggled = contexts.find(current.modifier + 2);
+    auto touchedAndToggled = contexts.find(current.modifier + 3);
+    
+    if (unmodified != contexts.end())
+        current.contexts[0] = current.contexts[1] = current.contexts[2] = current.contexts[3] = &unmodified->second;
+    
+    if (toggled != contexts.end())
+        current.contexts[2] = current.contexts[3] = &toggled->second;
+
+    if (touched != contexts.end())
+        current.contexts[1] = current.contexts[3] = &touched->second;
+    
+    if (touchedAndToggled != contexts.end())
+        current.contexts[3] = &touchedAndToggled->second;
 }
 
 const vector<ActionContext *> &Zone::GetActionContexts(Widget *widget)
 {
-    if(currentActionContextModifiers_.count(widget) == 0)
+    if (widget->GetIndex() >= currentActionContexts_.size() || ! currentActionContexts_[widget->GetIndex()].isResolved)
         UpdateCurrentActionContextModifier(widget);
     
-    bool isTouched = false;
-    bool isToggled = false;
+    int touchToggleState = 0;
     
     if(widget->GetSurface()->GetIsChannelTouched(widget->GetChannelNumber()))
-        isTouched = true;
+        touchToggleState |= 1;
 
     if(widget->GetSurface()->GetIsChannelToggled(widget->GetChannelNumber()))
-        isToggled = true;
+        touchToggleState |= 2;
     
-    if(currentActionContextModifiers_.count(widget) > 0 && actionContextDictionary_.count(widget) > 0)
-    {
-        int modifier = currentActionContextModifiers_[widget];
-        
-        if(isTouched && isToggled && actionContextDictionary_[widget].count(modifier + 3) > 0)
-            return actionContextDictionary_[widget][modifier + 3];
-        else if(isTouched && actionContextDictionary_[widget].count(modifier + 1) > 0)
-            return actionContextDictionary_[widget][modifier + 1];
-        else if(isToggled && actionContextDictionary_[widget].count(modifier + 2) > 0)
-            return actionContextDictionary_[widget][modifier + 2];
-        else if(actionContextDictionary_[widget].count(modifier) > 0)
-            return actionContextDictionary_[widget][modifier];
-    }
-
-    return emptyContexts_;
+    return *currentActionContexts_[widget->GetIndex()].contexts[touchToggleState];
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Widget
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
+Widget::~Widget()
+{
+    for (auto feedbackProcessor : feedbackProcessors_)
+        delete feedbackProcessor;
+    
+    feedbackProcessors_.clear();
+}
+
 ZoneManager *Widget::GetZoneManager()
 {
     return surface_->GetZoneManager();
@@ -2354,24 +3090,32 @@ ZoneManager *Widget::GetZoneManager()
 
 void Widget::Configure(const vector<ActionContext *> &contexts)
 {
+    CountWrite(true);
+
     for (auto feedbackProcessor : feedbackProcessors_)
         feedbackProcessor->Configure(contexts);
 }
 
 void  Widget::UpdateValue(const PropertyList &properties, double value)
 {
+    CountWrite(false);
+
     for (auto feedbackProcessor : feedbackProcessors_)
         feedbackProcessor->SetValue(properties, value);
 }
 
 void  Widget::UpdateValue(const PropertyList &properties, const char * const &value)
 {
+    CountWrite(false);
+
     for (auto feedbackProcessor : feedbackProcessors_)
         feedbackProcessor->SetValue(properties, value);
 }
 
 void  Widget::ForceValue(const PropertyList &properties, const char * const &value)
 {
+    CountWrite(false);
+
     for (auto feedbackProcessor : feedbackProcessors_)
         feedbackProcessor->ForceValue(properties, value);
 }
@@ -2384,28 +3128,51 @@ void Widget::RunDeferredActions()
 
 void  Widget::UpdateColorValue(const rgba_color &color)
 {
+    CountWrite(true);
+
     for (auto feedbackProcessor : feedbackProcessors_)
         feedbackProcessor->SetColorValue(color);
 }
 
 void Widget::SetXTouchDisplayColors(const char *colors)
 {
+    CountWrite(true);
+
     for (auto feedbackProcessor : feedbackProcessors_)
         feedbackProcessor->SetXTouchDisplayColors(colors);
 }
 
 void Widget::RestoreXTouchDisplayColors()
 {
+    CountWrite(true);
+
     for (auto feedbackProcessor : feedbackProcessors_)
         feedbackProcessor->RestoreXTouchDisplayColors();
 }
 
+bool Widget::GetIsMotorized()
+{
+    for (auto feedbackProcessor : feedbackProcessors_)
+        if (feedbackProcessor->GetIsMotorized())
+            return true;
+    
+    return false;
+}
+
 void  Widget::ForceClear()
 {
+    CountWrite(true);
+
     for (auto feedbackProcessor : feedbackProcessors_)
         feedbackProcessor->ForceClear();
 }
 
+void Widget::ResetFeedbackDedup()
+{
+    for (auto feedbackProcessor : feedbackProcessors_)
+        feedbackProcessor->ResetDedup();
+}
+
 void Widget::LogInput(double value)
 {
     if (g_surfaceInDisplay)
@@ -2462,7 +3229,7 @@ void OSC_FeedbackProcessor::ForceValue(const PropertyList &properties, double va
 
 void OSC_FeedbackProcessor::ForceValue(const PropertyList &properties, const char * const &value)
 {
-    lastStringValue_ = value;
+    lastStringValue_.Set(value);
     char tmp[MEDBUF];
     surface_->SendOSCMessage(this, oscAddress_.c_str(), GetWidget()->GetSurface()->GetRestrictedLengthText(value,tmp,sizeof(tmp)));
 }
@@ -2472,7 +3239,7 @@ void OSC_FeedbackProcessor::ForceClear()
     lastDoubleValue_ = 0.0;
     surface_->SendOSCMessage(this, oscAddress_.c_str(), 0.0);
     
-    lastStringValue_ = "";
+    lastStringValue_.Set("");
     surface_->SendOSCMessage(this, oscAddress_.c_str(), "");
 }
 
@@ -2529,76 +3296,54 @@ void ZoneManager::Initialize()
     homeZone_->Activate();
 }
 
-void ZoneManager::PreProcessZoneFile(const string &filePath)
-{
-    try
-    {
-        ifstream file(filePath);
-        
-        CSIZoneInfo info;
-        info.filePath = filePath;
-                 
-        for (string line; getline(file, line) ; )
-        {
-            TrimLine(line);
-            
-            if (line == "" || (line.size() > 0 && line[0] == '/')) // ignore blank lines and comment lines
-                continue;
-            
-            vector<string> tokens;
-            GetTokens(tokens, line);
-
-            if (tokens[0] == "Zone" && tokens.size() > 1)
-            {
-                info.alias = tokens.size() > 2 ? tokens[2] : tokens[1];
-                AddZoneFilePath(tokens[1], info);
-            }
-
-            break;
-        }
-    }
-    catch (exception)
-    {
-        char buffer[250];
-        snprintf(buffer, sizeof(buffer), "Trouble in %s, around line %d\n", filePath.c_str(), 1);
-        ShowConsoleMsg(buffer);
-    }
-}
-
 static ModifierManager s_modifierManager(NULL);
 
-void ZoneManager::GetWidgetNameAndModifiers(const string &line, string &baseWidgetName, int &modifier, bool &isValueInverted, bool &isFeedbackInverted, double &holdDelayAmount, bool &isDecrease, bool &isIncrease)
+void ZoneManager::GetWidgetNameAndModifiers(string_view line, string &baseWidgetName, int &modifier, bool &isValueInverted, bool &isFeedbackInverted, double &holdDelayAmount, bool &isDecrease, bool &isIncrease)
 {
-    vector<string> tokens;
-    GetTokens(tokens, line, '+');
+    // Shift+Touch+Fader1 -- the last field is the widget, like getline() a trailing '+' makes no empty field
+    if (line.size() > 0 && line.back() == '+')
+        line.remove_suffix(1);
     
-    baseWidgetName = tokens[tokens.size() - 1];
-
-    if (tokens.size() > 1)
+    size_t lastPlus = line.rfind('+');
+    
+    if (lastPlus == string_view::npos)
     {
-        for (int i = 0; i < tokens.size() - 1; ++i)
-        {
-            if (tokens[i].find("Touch") != string::npos)
-                modifier += 1;
-            else if (tokens[i] == "Toggle")
-                modifier += 2;
-
-            else if (tokens[i] == "Invert")
-                isValueInverted = true;
-            else if (tokens[i] == "InvertFB")
-                isFeedbackInverted = true;
-            else if (tokens[i] == "Hold")
-                holdDelayAmount = holdDelayAmount_;
-            else if (tokens[i] == "Decrease")
-                isDecrease = true;
-            else if (tokens[i] == "Increase")
-                isIncrease = true;
-        }
+        baseWidgetName.assign(line.data(), line.size());
+        return;
     }
     
-    tokens.erase(tokens.begin() + tokens.size() - 1);
+    baseWidgetName.assign(line.data() + lastPlus + 1, line.size() - lastPlus - 1);
+    
+    string_view modifiers = line.substr(0, lastPlus);
     
-    modifier += s_modifierManager.GetModifierValue(tokens);
+    for (string_view fields = modifiers; ; )
+    {
+        size_t plus = fields.find('+');
+        string_view field = fields.substr(0, plus);
+        
+        if (field.find("Touch") != string_view::npos)
+            modifier += 1;
+        else if (field == "Toggle")
+            modifier += 2;
+
+        else if (field == "Invert")
+            isValueInverted = true;
+        else if (field == "InvertFB")
+            isFeedbackInverted = true;
+        else if (field == "Hold")
+            holdDelayAmount = holdDelayAmount_;
+        else if (field == "Decrease")
+            isDecrease = true;
+        else if (field == "Increase")
+            isIncrease = true;
+        
+        if (plus == string_view::npos)
+            break;
+        
+        fields.remove_prefix(plus + 1);
+    }
+    
+    modifier += s_modifierManager.GetModifierValue(modifiers);
 }
 
 void ZoneManager::GetNavigatorsForZone(const char *zoneName, const char *navigatorName, vector<Navigator *> &navigators)
@@ -2683,13 +3428,51 @@ void ZoneManager::LoadZones(vector<Zone *> &zones, vector<string> &zoneList)
     }
 }
 
+void ZoneManager::LoadZoneMetadata(const char *filePath, vector<string> &metadata)
+{
+    int lineNumber = 0;
+    
+    try
+    {
+        for (auto &tokenizedLine : csi_->GetTokenizedFileCache().GetFile(filePath).lines)
+        {
+            lineNumber = tokenizedLine.lineNumber;
+            
+            const vector<string> &tokens = tokenizedLine.tokens;
+            
+            if (tokens[0] == "Zone" || tokens[0] == "ZoneEnd")
+                continue;
+            
+            metadata.push_back(tokenizedLine.line);
+        }
+    }
+    catch (exception)
+    {
+        char buffer[250];
+        snprintf(buffer, sizeof(buffer), "Trouble in %s, around line %d\n", filePath, lineNumber);
+        ShowConsoleMsg(buffer);
+    }
+}
+
 void ZoneManager::LoadZoneFile(Zone *zone, const char *widgetSuffix)
 {
     LoadZoneFile(zone, zone->GetSourceFilePath(), widgetSuffix);
 }
 
-void ZoneManager::LoadZoneFile(Zone *zone, const char *filePath, const char *widgetSuffix)
+ZoneManager::ZoneTemplate *ZoneManager::GetZoneTemplate(const char *filePath, const char *widgetSuffix)
 {
+    const TokenizedFile &file = csi_->GetTokenizedFileCache().GetFile(filePath);
+    
+    ZoneTemplate *&zoneTemplate = zoneTemplates_[string(filePath) + "|" + widgetSuffix];
+    
+    if (zoneTemplate != NULL && zoneTemplate->size == file.size && zoneTemplate->modifiedTime == file.modifiedTime)
+        return zoneTemplate;
+    
+    delete zoneTemplate;
+    zoneTemplate = new ZoneTemplate();
+    zoneTemplate->size = file.size;
+    zoneTemplate->modifiedTime = file.modifiedTime;
+    
     int lineNumber = 0;
     bool isInIncludedZonesSection = false;
     vector<string> includedZonesList;
@@ -2698,26 +3481,32 @@ void ZoneManager::LoadZoneFile(Zone *zone, const char *filePath, const char *wid
 
     try
     {
-        ifstream file(filePath);
-        
-        for (string line; getline(file, line) ; )
+        for (auto &tokenizedLine : file.lines)
         {
-            TrimLine(line);
-            
-            lineNumber++;
+            lineNumber = tokenizedLine.lineNumber;
             
-            if (line == "" || (line.size() > 0 && line[0] == '/')) // ignore blank lines and comment lines
+            if (tokenizedLine.line == s_BeginAutoSection || tokenizedLine.line == s_EndAutoSection)
                 continue;
             
-            if (line == s_BeginAutoSection || line == s_EndAutoSection)
-                continue;
-            
-            ReplaceAllWith(line, "|", widgetSuffix);
-            
             vector<string> tokens;
-            GetTokens(tokens, line);
             
-            if (tokens[0] == "Zone" || tokens[0] == "ZoneEnd")
+            for (auto &token : tokenizedLine.tokens)
+            {
+                if (token.find('|') == string::npos)
+                    tokens.push_back(token);
+                else
+                {
+                    string replaced = token;
+                    ReplaceAllWith(replaced, "|", widgetSuffix);
+                    if (replaced != "") // as if replaced before tokenizing, when a lone | would have vanished
+                        tokens.push_back(replaced);
+                }
+            }
+            
+            if (tokens.size() == 0)
+                continue;
+            
+            if (tokens[0] == "Zone" || tokens[0] == "ZoneEnd")
                 continue;
             
             else if (tokens[0] == "SubZones")
@@ -2725,7 +3514,12 @@ void ZoneManager::LoadZoneFile(Zone *zone, const char *filePath, const char *wid
             else if (tokens[0] == "SubZonesEnd")
             {
                 isInSubZonesSection = false;
-                zone->InitSubZones(subZonesList, widgetSuffix);
+                
+                ZoneTemplate::Step step;
+                step.type = ZoneTemplate::Step::SubZones;
+                step.lineNumber = lineNumber;
+                step.zoneNames = subZonesList;
+                zoneTemplate->steps.push_back(step);
             }
             else if (isInSubZonesSection)
                 subZonesList.push_back(tokens[0]);
@@ -2735,7 +3529,12 @@ void ZoneManager::LoadZoneFile(Zone *zone, const char *filePath, const char *wid
             else if (tokens[0] == "IncludedZonesEnd")
             {
                 isInIncludedZonesSection = false;
-                LoadZones(zone->GetIncludedZones(), includedZonesList);
+                
+                ZoneTemplate::Step step;
+                step.type = ZoneTemplate::Step::IncludedZones;
+                step.lineNumber = lineNumber;
+                step.zoneNames = includedZonesList;
+                zoneTemplate->steps.push_back(step);
             }
             else if (isInIncludedZonesSection)
                 includedZonesList.push_back(tokens[0]);
@@ -2750,14 +3549,17 @@ void ZoneManager::LoadZoneFile(Zone *zone, const char *filePath, const char *wid
                 bool isDecrease = false;
                 bool isIncrease = false;
                 
-                GetWidgetNameAndModifiers(tokens[0].c_str(), widgetName, modifier, isValueInverted, isFeedbackInverted, holdDelayAmount,isDecrease, isIncrease);
+                GetWidgetNameAndModifiers(tokens[0], widgetName, modifier, isValueInverted, isFeedbackInverted, holdDelayAmount,isDecrease, isIncrease);
                 
                 Widget *widget = GetSurface()->GetWidgetByName(widgetName);
                                             
                 if (widget == NULL)
                     continue;
 
-                zone->AddWidget(widget);
+                ZoneTemplate::Step step;
+                step.lineNumber = lineNumber;
+                step.widget = widget;
+                step.modifier = modifier;
 
                 vector<string> memberParams;
 
@@ -2766,9 +3568,12 @@ void ZoneManager::LoadZoneFile(Zone *zone, const char *filePath, const char *wid
                 
                 // For legacy .zon definitions
                 if (tokens[1] == "NullDisplay")
+                {
+                    zoneTemplate->steps.push_back(step);
                     continue;
+                }
                 
-                ActionContext *context = csi_->GetActionContext(tokens[1].c_str(), widget, zone, memberParams);
+                ActionContext *context = csi_->GetActionContext(tokens[1].c_str(), widget, NULL, memberParams);
                 
                 if (isValueInverted)
                     context->SetIsValueInverted();
@@ -2794,7 +3599,43 @@ void ZoneManager::LoadZoneFile(Zone *zone, const char *filePath, const char *wid
                     context->SetRange(range);
                 }
                 
-                zone->AddActionContext(widget, modifier, context);
+                step.prototype = context;
+                zoneTemplate->steps.push_back(step);
+            }
+        }
+    }
+    catch (exception)
+    {
+        char buffer[250];
+        snprintf(buffer, sizeof(buffer), "Trouble in %s, around line %d\n", filePath, lineNumber);
+        ShowConsoleMsg(buffer);
+    }
+    
+    return zoneTemplate;
+}
+
+void ZoneManager::LoadZoneFile(Zone *zone, const char *filePath, const char *widgetSuffix)
+{
+    ZoneTemplate *zoneTemplate = GetZoneTemplate(filePath, widgetSuffix);
+    
+    int lineNumber = 0;
+
+    try
+    {
+        for (auto &step : zoneTemplate->steps)
+        {
+            lineNumber = step.lineNumber;
+            
+            if (step.type == ZoneTemplate::Step::SubZones)
+                zone->InitSubZones(step.zoneNames, widgetSuffix);
+            else if (step.type == ZoneTemplate::Step::IncludedZones)
+                LoadZones(zone->GetIncludedZones(), step.zoneNames);
+            else
+            {
+                zone->AddWidget(step.widget);
+                
+                if (step.prototype != NULL)
+                    zone->AddActionContext(step.widget, step.modifier, zone->GetArena().New<ActionContext>(*step.prototype, zone));
             }
         }
     }
@@ -2806,6 +3647,73 @@ void ZoneManager::LoadZoneFile(Zone *zone, const char *filePath, const char *wid
     }
 }
 
+Zone *ZoneManager::ActivateFXZone(Navigator *navigator, int fxSlot, const char *fxName)
+{
+    ProfileScope profileScope(csi_->GetProfiler().GetHistogram(fxZoneActivationHistogram_, "Surface", surface_->GetName(), "FXZoneActivation"));
+    
+    Zone *zone = new Zone(csi_, this, navigator, fxSlot, fxName, zoneInfo_[fxName].alias, zoneInfo_[fxName].filePath);
+    LoadZoneFile(zone, "");
+    zone->Activate();
+    
+    return zone;
+}
+
+void ZoneManager::DeleteRetiredZones()
+{
+    if (zonesToBeDeleted_.size() == 0)
+        return;
+    
+    for (auto zone : zonesToBeDeleted_)
+        delete zone;
+    
+    zonesToBeDeleted_.clear();
+    
+    // a stale owner is never read, but don't keep the deleted zones' addresses around for a new zone to turn up at
+    for (auto &owner : widgetOwners_)
+        owner = WidgetOwner();
+    
+    InvalidateWidgetOwners();
+}
+
+void ZoneManager::GetZones(vector<Zone *> &zones)
+{
+    Zone *topZones[] = { homeZone_, lastTouchedFXParamZone_, focusedFXZone_, fxSlotZone_, learnFocusedFXZone_ };
+    
+    for (auto zone : topZones)
+        if (zone != NULL)
+            zone->AddZones(zones);
+    
+    for (auto zone : goZones_)
+        zone->AddZones(zones);
+    
+    for (auto zone : selectedTrackFXZones_)
+        zone->AddZones(zones);
+    
+    for (auto zone : zonesToBeDeleted_)
+        zone->AddZones(zones);
+}
+
+void ZoneManager::GetWidgetOwnerZones(vector<Zone *> &zones)
+{
+    for (auto &owner : widgetOwners_)
+    {
+        if (owner.zone != NULL)
+            zones.push_back(owner.zone);
+        
+        if (owner.touchZone != NULL)
+            zones.push_back(owner.touchZone);
+    }
+}
+
+void ZoneManager::GetMemoryUsage(ZoneMemoryUsage &usage)
+{
+    vector<Zone *> zones;
+    GetZones(zones);
+    
+    for (auto zone : zones)
+        zone->AddMemoryUsage(usage);
+}
+
 void ZoneManager::AddListener(ControlSurface *surface)
 {
     listeners_.push_back(surface->GetZoneManager());
@@ -2885,17 +3793,17 @@ void ZoneManager::CheckFocusedFXState()
             ClearFocusedFX();
         
         if (zoneInfo_.find(fxName) != zoneInfo_.end())
-        {
-            focusedFXZone_ = new Zone(csi_, this, GetFocusedFXNavigator(), fxSlot, fxName, zoneInfo_[fxName].alias, zoneInfo_[fxName].filePath.c_str());
-            LoadZoneFile(focusedFXZone_, "");
-            focusedFXZone_->Activate();
-        }            
+            focusedFXZone_ = ActivateFXZone(GetFocusedFXNavigator(), fxSlot, fxName);
     }
 }
 
 void ZoneManager::GoSelectedTrackFX()
 {
+    for (auto selectedTrackFXZone : selectedTrackFXZones_)
+        RetireZone(selectedTrackFXZone);
+    
     selectedTrackFXZones_.clear();
+    InvalidateWidgetOwners();
     
     if (MediaTrack *selectedTrack = surface_->GetPage()->GetSelectedTrack())
     {
@@ -2906,12 +3814,7 @@ void ZoneManager::GoSelectedTrackFX()
             TrackFX_GetFXName(selectedTrack, i, fxName, sizeof(fxName));
             
             if (zoneInfo_.find(fxName) != zoneInfo_.end())
-            {
-                Zone *zone = new Zone(csi_, this, GetSelectedTrackNavigator(), i, fxName, zoneInfo_[fxName].alias, zoneInfo_[fxName].filePath);
-                LoadZoneFile(zone, "");
-                selectedTrackFXZones_.push_back(zone);
-                zone->Activate();
-            }
+                selectedTrackFXZones_.push_back(ActivateFXZone(GetSelectedTrackNavigator(), i, fxName));
         }
     }
 }
@@ -2928,16 +3831,16 @@ void ZoneManager::GoFXSlot(MediaTrack *track, Navigator *navigator, int fxSlot)
     if (zoneInfo_.find(fxName) != zoneInfo_.end())
     {
         ClearFXSlot();        
-        fxSlotZone_ = new Zone(csi_, this, navigator, fxSlot, fxName, zoneInfo_[fxName].alias, zoneInfo_[fxName].filePath);
-        LoadZoneFile(fxSlotZone_, "");
-        fxSlotZone_->Activate();
+        fxSlotZone_ = ActivateFXZone(navigator, fxSlot, fxName);
     }
     else
         TrackFX_SetOpen(track, fxSlot, true);
 }
 
 void ZoneManager::UpdateCurrentActionContextModifiers()
-{  
+{
+    InvalidateWidgetOwners();
+    
     if (learnFocusedFXZone_ != NULL)
         learnFocusedFXZone_->UpdateCurrentActionContextModifiers();
 
@@ -2971,11 +3874,11 @@ void ZoneManager::PreProcessZones()
         return;
     }
     
-    vector<string>  zoneFilesToProcess;
+    ZoneFileIndex &zoneFileIndex = csi_->GetZoneFileIndex();
     
-    listFilesOfType(zoneFolder_ + "/", zoneFilesToProcess, ".zon"); // recursively find all .zon files, starting at zoneFolder
+    const vector<ZoneFileIndex::ZoneFileHeader> &zoneFiles = zoneFileIndex.GetHeaders(zoneFolder_ + "/"); // all .zon files, recursively, starting at zoneFolder
        
-    if (zoneFilesToProcess.size() == 0)
+    if (zoneFiles.size() == 0)
     {
         char tmp[2048];
         snprintf(tmp, sizeof(tmp), __LOCALIZE_VERFMT("Please check your installation, cannot find Zone files for %s in:\r\n\r\n%s","csi_mbox"), GetSurface()->GetName(), zoneFolder_.c_str());
@@ -2984,10 +3887,21 @@ void ZoneManager::PreProcessZones()
         return;
     }
           
-    listFilesOfType(fxZoneFolder_ + "/", zoneFilesToProcess, ".zon"); // recursively find all .zon files, starting at fxZoneFolder
-     
-    for (const string &zoneFile : zoneFilesToProcess)
-        PreProcessZoneFile(zoneFile);
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        const vector<ZoneFileIndex::ZoneFileHeader> &headers = pass == 0 ? zoneFiles : zoneFileIndex.GetHeaders(fxZoneFolder_ + "/");
+        
+        for (auto &header : headers)
+        {
+            if (header.name == "")
+                continue;
+            
+            CSIZoneInfo info;
+            info.filePath = header.filePath;
+            info.alias = header.alias;
+            AddZoneFilePath(header.name, info);
+        }
+    }
 }
 
 void ZoneManager::DoAction(Widget *widget, double value)
@@ -2999,49 +3913,61 @@ void ZoneManager::DoAction(Widget *widget, double value)
     DoAction(widget, value, isUsed);
 }
     
-void ZoneManager::DoAction(Widget *widget, double value, bool &isUsed)
+const ZoneManager::WidgetOwner &ZoneManager::GetWidgetOwner(Widget *widget)
 {
-    if (surface_->GetModifiers().size() > 0)
-        WidgetMoved(this, widget, surface_->GetModifiers()[0]);
+    if (widget->GetIndex() >= widgetOwners_.size())
+        widgetOwners_.resize(widget->GetIndex() + 1);
     
-    if (learnFocusedFXZone_ != NULL)
-        learnFocusedFXZone_->DoAction(widget, isUsed, value);
+    WidgetOwner &owner = widgetOwners_[widget->GetIndex()];
+    
+    if (owner.generation == widgetOwnersGeneration_)
+        return owner;
+    
+    owner.generation = widgetOwnersGeneration_;
+    owner.touchZone = NULL;
     
-    if (isUsed)
-        return;
-
     if (lastTouchedFXParamZone_ != NULL && isLastTouchedFXParamMappingEnabled_)
-        lastTouchedFXParamZone_->DoAction(widget, isUsed, value);
+        owner.touchZone = lastTouchedFXParamZone_->GetOwningZone(widget);
 
-    if (isUsed)
-        return;
-
-    if (focusedFXZone_ != NULL)
-        focusedFXZone_->DoAction(widget, isUsed, value);
+    if (owner.touchZone == NULL && focusedFXZone_ != NULL)
+        owner.touchZone = focusedFXZone_->GetOwningZone(widget);
     
-    if (isUsed)
-        return;
+    for (int i = 0; owner.touchZone == NULL && i < selectedTrackFXZones_.size(); ++i)
+        owner.touchZone = selectedTrackFXZones_[i]->GetOwningZone(widget);
     
-    for (int i = 0; i < selectedTrackFXZones_.size(); ++i)
-        selectedTrackFXZones_[i]->DoAction(widget, isUsed, value);
+    if (owner.touchZone == NULL && fxSlotZone_ != NULL)
+        owner.touchZone = fxSlotZone_->GetOwningZone(widget);
     
-    if (isUsed)
-        return;
-
-    if (fxSlotZone_ != NULL)
-        fxSlotZone_->DoAction(widget, isUsed, value);
+    for (int i = 0; owner.touchZone == NULL && i < goZones_.size(); ++i)
+        owner.touchZone = goZones_[i]->GetOwningZone(widget);
     
-    if (isUsed)
-        return;
-
-    for (int i = 0; i < goZones_.size(); ++i)
-        goZones_[i]->DoAction(widget, isUsed, value);
+    if (owner.touchZone == NULL && homeZone_ != NULL)
+        owner.touchZone = homeZone_->GetOwningZone(widget);
+    
+    owner.zone = NULL;
+    
+    if (learnFocusedFXZone_ != NULL)
+        owner.zone = learnFocusedFXZone_->GetOwningZone(widget);
+    
+    if (owner.zone == NULL)
+        owner.zone = owner.touchZone;
+    
+    return owner;
+}
 
+void ZoneManager::DoAction(Widget *widget, double value, bool &isUsed)
+{
+    if (surface_->GetModifiers().size() > 0)
+        WidgetMoved(this, widget, surface_->GetModifiers()[0]);
+    
     if (isUsed)
         return;
-
-    if (homeZone_ != NULL)
-        homeZone_->DoAction(widget, isUsed, value);
+    
+    if (Zone *zone = GetWidgetOwner(widget).zone)
+    {
+        isUsed = true;
+        zone->DoAction(widget, value);
+    }
 }
 
 void ZoneManager::DoRelativeAction(Widget *widget, double delta)
@@ -3058,44 +3984,14 @@ void ZoneManager::DoRelativeAction(Widget *widget, double delta, bool &isUsed)
     if (surface_->GetModifiers().size() > 0)
         WidgetMoved(this, widget, surface_->GetModifiers()[0]);
 
-    if (learnFocusedFXZone_ != NULL)
-        learnFocusedFXZone_->DoRelativeAction(widget, isUsed, delta);
-
-    if (isUsed)
-        return;
-
-    if (lastTouchedFXParamZone_ != NULL && isLastTouchedFXParamMappingEnabled_)
-        lastTouchedFXParamZone_->DoRelativeAction(widget, isUsed, delta);
-
-    if (isUsed)
-        return;
-
-    if (focusedFXZone_ != NULL)
-        focusedFXZone_->DoRelativeAction(widget, isUsed, delta);
-    
-    if (isUsed)
-        return;
-    
-    for (int i = 0; i < selectedTrackFXZones_.size(); ++i)
-        selectedTrackFXZones_[i]->DoRelativeAction(widget, isUsed, delta);
-    
-    if (isUsed)
-        return;
-
-    if (fxSlotZone_ != NULL)
-        fxSlotZone_->DoRelativeAction(widget, isUsed, delta);
-    
     if (isUsed)
         return;
-
-    for (int i = 0; i < goZones_.size(); ++i)
-        goZones_[i]->DoRelativeAction(widget, isUsed, delta);
     
-    if (isUsed)
-        return;
-
-    if (homeZone_ != NULL)
-        homeZone_->DoRelativeAction(widget, isUsed, delta);
+    if (Zone *zone = GetWidgetOwner(widget).zone)
+    {
+        isUsed = true;
+        zone->DoRelativeAction(widget, delta);
+    }
 }
 
 void ZoneManager::DoRelativeAction(Widget *widget, int accelerationIndex, double delta)
@@ -3112,44 +4008,14 @@ void ZoneManager::DoRelativeAction(Widget *widget, int accelerationIndex, double
     if (surface_->GetModifiers().size() > 0)
         WidgetMoved(this, widget, surface_->GetModifiers()[0]);
 
-    if (learnFocusedFXZone_ != NULL)
-        learnFocusedFXZone_->DoRelativeAction(widget, isUsed, accelerationIndex, delta);
-
-    if (isUsed)
-        return;
-
-    if (lastTouchedFXParamZone_ != NULL && isLastTouchedFXParamMappingEnabled_)
-        lastTouchedFXParamZone_->DoRelativeAction(widget, isUsed, accelerationIndex, delta);
-    
-    if (isUsed)
-        return;
-
-    if (focusedFXZone_ != NULL)
-        focusedFXZone_->DoRelativeAction(widget, isUsed, accelerationIndex, delta);
-    
-    if (isUsed)
-        return;
-    
-    for (int i = 0; i < selectedTrackFXZones_.size(); ++i)
-        selectedTrackFXZones_[i]->DoRelativeAction(widget, isUsed, accelerationIndex, delta);
-    
     if (isUsed)
         return;
-
-    if (fxSlotZone_ != NULL)
-        fxSlotZone_->DoRelativeAction(widget, isUsed, accelerationIndex, delta);
     
-    if (isUsed)
-        return;
-
-    for (int i = 0; i < goZones_.size(); ++i)
-        goZones_[i]->DoRelativeAction(widget, isUsed, accelerationIndex, delta);
-
-    if (isUsed)
-        return;
-
-    if (homeZone_ != NULL)
-        homeZone_->DoRelativeAction(widget, isUsed, accelerationIndex, delta);
+    if (Zone *zone = GetWidgetOwner(widget).zone)
+    {
+        isUsed = true;
+        zone->DoRelativeAction(widget, accelerationIndex, delta);
+    }
 }
 
 void ZoneManager::DoTouch(Widget *widget, double value)
@@ -3169,44 +4035,14 @@ void ZoneManager::DoTouch(Widget *widget, double value, bool &isUsed)
     //if (surface_->GetModifiers().GetSize() > 0 && value != 0.0) // ignore touch releases for Learn mode
         //WidgetMoved(this, widget, surface_->GetModifiers().Get()[0]);
 
-    //if (learnFocusedFXZone_ != NULL)
-        //learnFocusedFXZone_->DoTouch(widget, widget->GetName(), isUsed, value);
-
-    if (isUsed)
-        return;
-
-    if (lastTouchedFXParamZone_ != NULL && isLastTouchedFXParamMappingEnabled_)
-        lastTouchedFXParamZone_->DoTouch(widget, widget->GetName(), isUsed, value);
-    
-    if (isUsed)
-        return;
-
-    if (focusedFXZone_ != NULL)
-        focusedFXZone_->DoTouch(widget, widget->GetName(), isUsed, value);
-    
-    if (isUsed)
-        return;
-
-    for (int i = 0; i < selectedTrackFXZones_.size(); ++i)
-        selectedTrackFXZones_[i]->DoTouch(widget, widget->GetName(), isUsed, value);
-    
-    if (isUsed)
-        return;
-
-    if (fxSlotZone_ != NULL)
-        fxSlotZone_->DoTouch(widget, widget->GetName(), isUsed, value);
-    
-    if (isUsed)
-        return;
-
-    for (int i = 0; i < goZones_.size(); ++i)
-        goZones_[i]->DoTouch(widget, widget->GetName(), isUsed, value);
-
     if (isUsed)
         return;
 
-    if (homeZone_ != NULL)
-        homeZone_->DoTouch(widget, widget->GetName(), isUsed, value);
+    if (Zone *zone = GetWidgetOwner(widget).touchZone)
+    {
+        isUsed = true;
+        zone->DoTouch(widget, value);
+    }
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -3298,9 +4134,6 @@ void TrackNavigationManager::RebuildTracks()
         for (int i = oldTracksSize; i > tracks_.size(); i--)
             page_->ForceClearTrack(i - trackOffset_);
     }
-    
-    if (tracks_.size() != oldTracksSize)
-        page_->ForceUpdateTrackColors();
 }
 
 void TrackNavigationManager::RebuildSelectedTracks()
@@ -3320,9 +4153,33 @@ void TrackNavigationManager::RebuildSelectedTracks()
         for (int i = oldTracksSize; i > selectedTracks_.size(); i--)
             page_->ForceClearTrack(i - selectedTracksOffset_);
     }
+}
+
+void TrackNavigationManager::RebuildTrackListsIfNeeded()
+{
+    // The rebuilds walk every track in the project, so they only run when a REAPER notification has bumped the generation.
+    // Track and selection counts are cheap to poll, and the periodic resync picks up what REAPER doesn't notify (folder depth, VCA groups).
+    DWORD now = GetTickCount();
+    DWORD resyncInterval = min(s_maxTrackListResyncInterval, s_trackListResyncInterval * max(1, builtNumTracks_ / s_trackListResyncTracks));
     
-    if (selectedTracks_.size() != oldTracksSize)
-        page_->ForceUpdateTrackColors();
+    if (GetNumTracks() != builtNumTracks_ || (now - lastTrackListResyncTime_) > resyncInterval)
+        InvalidateTrackList();
+    else if (currentTrackVCAFolderMode_ == 3 && CountSelectedTracks2(NULL, false) != selectedTracks_.size())
+        InvalidateTrackList();
+    
+    if (builtTrackListGeneration_ == trackListGeneration_)
+        return;
+    
+    builtTrackListGeneration_ = trackListGeneration_;
+    builtNumTracks_ = GetNumTracks();
+    lastTrackListResyncTime_ = now;
+    
+    ProfileScope profileScope(csi_->GetProfiler().GetHistogram(rebuildHistogram_, "Page", page_->GetName(), "RebuildTrackLists"));
+    
+    RebuildTracks();
+    RebuildVCASpill();
+    RebuildFolderTracks();
+    RebuildSelectedTracks();
 }
 
 void TrackNavigationManager::AdjustSelectedTrackBank(int amount)
@@ -3351,33 +4208,265 @@ void TrackNavigationManager::AdjustSelectedTrackBank(int amount)
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
-// ControlSurface
+// Page
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
-void ControlSurface::Stop()
+void Page::Run()
 {
-    if (isRewinding_ || isFastForwarding_) // set the cursor to the Play position
-        CSurf_OnPlay();
- 
-    page_->SignalStop();
-    CancelRewindAndFastForward();
-    CSurf_OnStop();
+    TrackStateCache &trackStateCache = csi_->GetTrackStateCache();
+    
+    trackNavigationManager_->RebuildTrackListsIfNeeded();
+    
+    // input goes first, the meter and color polls only feed the updates and would otherwise add to every button's latency
+    trackStateCache.Invalidate();
+    
+    for (auto surface : surfaces_)
+        surface->ProfileHandleExternalInput();
+    
+    meterSampler_.Sample();
+    csi_->GetTrackColors().Refresh();
+    trackStateCache.Invalidate(); // input may have changed anything, not only what REAPER reports back
+    
+    unsigned int fetchCount = trackStateCache.GetFetchCount();
+    unsigned int readCount = trackStateCache.GetReadCount();
+    
+    for (auto surface : surfaces_)
+        surface->ProfileRequestUpdate();
+    
+    // REAPER calls the cache made for the surfaces' updates, against the reads it served
+    if (ProfileHistogram *histogram = csi_->GetProfiler().GetHistogram(trackStateFetchesHistogram_, "Page", name_.c_str(), "TrackStateFetchesPerTick"))
+        histogram->Add(trackStateCache.GetFetchCount() - fetchCount);
+    
+    if (ProfileHistogram *histogram = csi_->GetProfiler().GetHistogram(trackStateReadsHistogram_, "Page", name_.c_str(), "TrackStateReadsPerTick"))
+        histogram->Add(trackStateCache.GetReadCount() - readCount);
 }
 
-void ControlSurface::Play()
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// TrackMeterSampler
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+int TrackMeterSampler::GetIndex(MediaTrack *track)
 {
-    page_->SignalPlay();
-    CancelRewindAndFastForward();
-    CSurf_OnPlay();
+    auto it = indexByTrack_.find(track);
+    
+    if (it != indexByTrack_.end())
+    {
+        requestTimes_[it->second] = lastSampleTime_;
+        return it->second;
+    }
+    
+    // first request for this track, sample it now and with the others from the next tick on
+    int index = (int)tracks_.size();
+    indexByTrack_[track] = index;
+    tracks_.push_back(track);
+    requestTimes_.push_back(lastSampleTime_);
+    isSilencedBySolo_.push_back(false);
+    peaks_.resize(peaks_.size() + NUM_PEAKS, 0.0);
+    decayLevels_.resize(decayLevels_.size() + NUM_PEAKS, 0.0);
+    holdLevels_.resize(holdLevels_.size() + NUM_PEAKS, 0.0);
+    holdTimes_.resize(holdTimes_.size() + NUM_PEAKS, 0);
+    levels_.resize(levels_.size() + NUM_PEAKS, 0.0);
+    normalized_.resize(normalized_.size() + NUM_VALUES, 0.0);
+    
+    ReadTracks(index, index + 1);
+    ApplyBallistics(index, index + 1, GetTickCount(), 0.0);
+    Normalize(index, index + 1);
+    
+    return index;
 }
 
-void ControlSurface::Record()
+void TrackMeterSampler::Sample()
 {
-    page_->SignalRecord();
-    CancelRewindAndFastForward();
-    CSurf_OnRecord();
-}
-
-void ControlSurface::OnTrackSelection(MediaTrack *track)
+    DWORD now = GetTickCount();
+    double elapsedSeconds = (now - lastSampleTime_) / 1000.0;
+    lastSampleTime_ = now;
+    
+    // drop the tracks nobody has asked for lately
+    int count = 0;
+    
+    for (int i = 0; i < (int)tracks_.size(); ++i)
+    {
+        if (now - requestTimes_[i] > s_meterTrackExpiry)
+            continue;
+        
+        if (count != i)
+        {
+            tracks_[count] = tracks_[i];
+            requestTimes_[count] = requestTimes_[i];
+            for (int j = 0; j < NUM_PEAKS; ++j)
+            {
+                decayLevels_[count * NUM_PEAKS + j] = decayLevels_[i * NUM_PEAKS + j];
+                holdLevels_[count * NUM_PEAKS + j] = holdLevels_[i * NUM_PEAKS + j];
+                holdTimes_[count * NUM_PEAKS + j] = holdTimes_[i * NUM_PEAKS + j];
+            }
+        }
+        
+        count++;
+    }
+    
+    if (count != (int)tracks_.size())
+    {
+        tracks_.resize(count);
+        requestTimes_.resize(count);
+        isSilencedBySolo_.resize(count);
+        peaks_.resize(count * NUM_PEAKS);
+        decayLevels_.resize(count * NUM_PEAKS);
+        holdLevels_.resize(count * NUM_PEAKS);
+        holdTimes_.resize(count * NUM_PEAKS);
+        levels_.resize(count * NUM_PEAKS);
+        normalized_.resize(count * NUM_VALUES);
+        
+        indexByTrack_.clear();
+        for (int i = 0; i < count; ++i)
+            indexByTrack_[tracks_[i]] = i;
+    }
+    
+    isAnyTrackSoloed_ = AnyTrackSolo(NULL);
+    
+    ReadTracks(0, count);
+    ApplyBallistics(0, count, now, elapsedSeconds);
+    Normalize(0, count);
+}
+
+void TrackMeterSampler::Clear()
+{
+    indexByTrack_.clear();
+    tracks_.clear();
+    requestTimes_.clear();
+    isSilencedBySolo_.clear();
+    peaks_.clear();
+    decayLevels_.clear();
+    holdLevels_.clear();
+    holdTimes_.clear();
+    levels_.clear();
+    normalized_.clear();
+}
+
+void TrackMeterSampler::ReadTracks(int first, int last)
+{
+    for (int i = first; i < last; ++i)
+    {
+        MediaTrack *track = tracks_[i];
+        
+        peaks_[i * NUM_PEAKS] = Track_GetPeakInfo(track, 0);
+        peaks_[i * NUM_PEAKS + 1] = Track_GetPeakInfo(track, 1);
+        isSilencedBySolo_[i] = isAnyTrackSoloed_ && ! GetMediaTrackInfo_Value(track, "I_SOLO");
+    }
+}
+
+void TrackMeterSampler::ApplyBallistics(int first, int last, DWORD now, double elapsedSeconds)
+{
+    double decayFactor = decayDBPerSecond_ > 0.0 ? DB2VAL(-decayDBPerSecond_ * elapsedSeconds) : 0.0;
+    
+    for (int i = first * NUM_PEAKS; i < last * NUM_PEAKS; ++i)
+    {
+        double level = peaks_[i];
+        
+        if (decayDBPerSecond_ > 0.0)
+        {
+            level = wdl_max(level, decayLevels_[i] * decayFactor);
+            decayLevels_[i] = level;
+        }
+        
+        if (peakHoldMilliseconds_ > 0)
+        {
+            if (level >= holdLevels_[i] || now - holdTimes_[i] > (DWORD)peakHoldMilliseconds_)
+            {
+                holdLevels_[i] = level;
+                holdTimes_[i] = now;
+            }
+            else
+                level = holdLevels_[i];
+        }
+        
+        levels_[i] = level;
+    }
+}
+
+void TrackMeterSampler::Normalize(int first, int last)
+{
+    for (int i = first; i < last; ++i)
+    {
+        double left = levels_[i * NUM_PEAKS];
+        double right = levels_[i * NUM_PEAKS + 1];
+        
+        normalized_[i * NUM_VALUES] = volToNormalized(left);
+        normalized_[i * NUM_VALUES + 1] = volToNormalized(right);
+        normalized_[i * NUM_VALUES + 2] = volToNormalized((left + right) / 2.0);
+        normalized_[i * NUM_VALUES + 3] = volToNormalized(left > right ? left : right);
+    }
+}
+
+double TrackMeterSampler::GetNormalizedPeak(MediaTrack *track, int channel)
+{
+    if (channel == 0 || channel == 1)
+        return normalized_[GetIndex(track) * NUM_VALUES + channel];
+    else
+        return volToNormalized(Track_GetPeakInfo(track, channel)); // surround channels are rare enough to read directly
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// ControlSurface
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+void ControlSurface::ProfileHandleExternalInput()
+{
+    ProfileHistogram *histogram = csi_->GetProfiler().GetHistogram(handleExternalInputHistogram_, "Surface", name_.c_str(), "HandleExternalInput");
+    long long start = histogram ? CSIProfiler::GetMicroseconds() : 0;
+    
+    HandleExternalInput();
+    
+    if (histogram)
+    {
+        profiledInputTime_ = CSIProfiler::GetMicroseconds() - start;
+        histogram->Add((unsigned int)profiledInputTime_);
+    }
+}
+
+void ControlSurface::ProfileRequestUpdate()
+{
+    ProfileHistogram *histogram = csi_->GetProfiler().GetHistogram(requestUpdateHistogram_, "Surface", name_.c_str(), "RequestUpdate");
+    long long start = histogram ? CSIProfiler::GetMicroseconds() : 0;
+    
+    RequestUpdate();
+    
+    if (histogram == NULL)
+        return;
+    
+    long long duration = CSIProfiler::GetMicroseconds() - start;
+    histogram->Add((unsigned int)duration);
+    csi_->GetProfiler().GetHistogram(tickHistogram_, "Surface", name_.c_str(), "Tick")->Add((unsigned int)(profiledInputTime_ + duration));
+    
+    // proxies for the REAPER API and wire traffic each tick costs
+    csi_->GetProfiler().GetHistogram(actionUpdatesHistogram_, "Surface", name_.c_str(), "ActionUpdatesPerTick")->Add(profiledActionUpdates_);
+    csi_->GetProfiler().GetHistogram(messagesHistogram_, "Surface", name_.c_str(), "MessagesPerTick")->Add(profiledMessages_);
+    csi_->GetProfiler().GetHistogram(suppressedMessagesHistogram_, "Surface", name_.c_str(), "SuppressedMessagesPerTick")->Add(profiledSuppressedMessages_);
+    csi_->GetProfiler().GetHistogram(deferredUpdatesHistogram_, "Surface", name_.c_str(), "DeferredWidgetsPerTick")->Add(profiledDeferredUpdates_);
+    ResetProfiledCounts();
+}
+
+void ControlSurface::Stop()
+{
+    if (isRewinding_ || isFastForwarding_) // set the cursor to the Play position
+        CSurf_OnPlay();
+ 
+    page_->SignalStop();
+    CancelRewindAndFastForward();
+    CSurf_OnStop();
+}
+
+void ControlSurface::Play()
+{
+    page_->SignalPlay();
+    CancelRewindAndFastForward();
+    CSurf_OnPlay();
+}
+
+void ControlSurface::Record()
+{
+    page_->SignalRecord();
+    CancelRewindAndFastForward();
+    CSurf_OnRecord();
+}
+
+void ControlSurface::OnTrackSelection(MediaTrack *track)
 {
     string onTrackSelection("OnTrackSelection");
     
@@ -3416,17 +4505,107 @@ rgba_color ControlSurface::GetTrackColorForChannel(int channel)
         return white;
     
     if (MediaTrack *track = page_->GetNavigatorForChannel(channel + channelOffset_)->GetTrack())
-        return DAW::GetTrackColor(track);
+        return csi_->GetTrackColors().GetColor(track);
     else
         return white;
 }
 
+// called every tick -- the track color feedback processors only hear about it when a channel's color has changed,
+// whether the track's color was edited or the channel now shows a different track
+void ControlSurface::UpdateTrackColors()
+{
+    if (trackColorFeedbackProcessors_.size() == 0)
+        return;
+    
+    bool hasChanged = lastChannelColors_.size() != numChannels_;
+    
+    lastChannelColors_.resize(numChannels_);
+    
+    for (int i = 0; i < numChannels_; ++i)
+    {
+        rgba_color color = GetTrackColorForChannel(i);
+        
+        if (color != lastChannelColors_[i])
+        {
+            lastChannelColors_[i] = color;
+            hasChanged = true;
+        }
+    }
+    
+    if (hasChanged)
+        ForceUpdateTrackColors();
+}
+
+void ControlSurface::RequestWidgetUpdate(Zone *zone, Widget *widget)
+{
+    if (feedbackBudget_ == 0)
+        zone->RequestUpdateWidget(widget);
+    else if (GetIsPriorityUpdate(widget))
+        priorityUpdates_.push_back({ zone, widget });
+    else
+        deferrableUpdates_.push_back({ zone, widget });
+}
+
+// what the user is handling, or will see move, can't wait its turn
+bool ControlSurface::GetIsPriorityUpdate(Widget *widget)
+{
+    if (GetIsChannelTouched(widget->GetChannelNumber()))
+        return true;
+    
+    if (GetTickCount() - widget->GetLastIncomingMessageTime() < 1000) // recently changed from the surface
+        return true;
+    
+    return widget->GetIsMotorized();
+}
+
+// priority Widgets are always updated, the rest take turns until the tick's FeedbackBudget is spent -- at least one runs per tick
+void ControlSurface::RunWidgetUpdates()
+{
+    if (priorityUpdates_.size() == 0 && deferrableUpdates_.size() == 0)
+        return;
+    
+    long long start = CSIProfiler::GetMicroseconds();
+    
+    for (auto &update : priorityUpdates_)
+        update.zone->RequestUpdateWidget(update.widget);
+    
+    int count = (int)deferrableUpdates_.size();
+    int served = 0;
+    
+    if (nextDeferrableUpdate_ >= count)
+        nextDeferrableUpdate_ = 0;
+    
+    while (served < count)
+    {
+        WidgetUpdate &update = deferrableUpdates_[(nextDeferrableUpdate_ + served) % count];
+        update.zone->RequestUpdateWidget(update.widget);
+        served++;
+        
+        if (CSIProfiler::GetMicroseconds() - start >= feedbackBudget_)
+            break;
+    }
+    
+    if (count > 0)
+        nextDeferrableUpdate_ = (nextDeferrableUpdate_ + served) % count;
+    
+    profiledDeferredUpdates_ += count - served;
+    
+    priorityUpdates_.clear();
+    deferrableUpdates_.clear();
+}
+
 void ControlSurface::RequestUpdate()
 {
     for (auto widget : widgets_)
         widget->ClearHasBeenUsedByUpdate();
 
     zoneManager_->RequestUpdate();
+    
+    RunWidgetUpdates();
+    
+    zoneManager_->DeleteRetiredZones(); // only now, the queued updates above may name them
+    
+    UpdateTrackColors();
 
     const PropertyList properties;
     
@@ -3779,143 +4958,603 @@ void ControlSurface::ClearModifiers()
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Midi_ControlSurfaceIO
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
-void Midi_ControlSurfaceIO::HandleExternalInput(Midi_ControlSurface *surface)
-{
-    if (midiInput_)
-    {
-        midiInput_->SwapBufsPrecise(GetTickCount(), GetTickCount());
-        MIDI_eventlist *list = midiInput_->GetReadBuf();
-        int bpos = 0;
-        MIDI_event_t *evt;
-        while ((evt = list->EnumItems(&bpos)))
-            surface->ProcessMidiMessage((MIDI_event_ex_t*)evt);
-    }
-}
-
-////////////////////////////////////////////////////////////////////////////////////////////////////////
-// Midi_ControlSurface
-////////////////////////////////////////////////////////////////////////////////////////////////////////
-Midi_ControlSurface::Midi_ControlSurface(CSurfIntegrator *const csi, Page *page, const char *name, int channelOffset, const char *surfaceFile, const char *zoneFolder, const char *fxZoneFolder, Midi_ControlSurfaceIO *surfaceIO)
-: ControlSurface(csi, page, name, surfaceIO->GetChannelCount(), channelOffset), surfaceIO_(surfaceIO)
-{
-    ProcessMIDIWidgetFile(surfaceFile, this);
-    InitHardwiredWidgets(this);
-    InitializeMeters();
-    InitZoneManager(csi_, this, zoneFolder, fxZoneFolder);
-}
-
-void Midi_ControlSurface::ProcessMidiMessage(const MIDI_event_ex_t *evt)
+void Midi_ControlSurfaceIO::StartIOThread()
 {
-    if (g_surfaceRawInDisplay)
+    if (isIOThreadRunning_)
+        return;
+    
+    // the thread swaps the input buffers and writes the output itself, another surface on the port would race it
+    if (GetMidiPortRefCount(s_midiInputs, midiInput_) > 1 || GetMidiPortRefCount(s_midiOutputs, midiOutput_) > 1)
     {
         char buffer[250];
-        snprintf(buffer, sizeof(buffer), "IN <- %s %02x  %02x  %02x \n", name_.c_str(), evt->midi_message[0], evt->midi_message[1], evt->midi_message[2]);
+        snprintf(buffer, sizeof(buffer), "CSI: %s shares a MIDI port with another surface, MIDIIOThread=Yes is ignored\n", name_.c_str());
         ShowConsoleMsg(buffer);
+        return;
     }
-
-    int threeByteKey = evt->midi_message[0]  * 0x10000 + evt->midi_message[1]  * 0x100 + evt->midi_message[2];
-    int twoByteKey = evt->midi_message[0]  * 0x10000 + evt->midi_message[1]  * 0x100;
-    int oneByteKey = evt->midi_message[0] * 0x10000;
-
-    // At this point we don't know how much of the message comprises the key, so try all three
-    if (Midi_CSIMessageGeneratorsByMessage_.find(threeByteKey) != Midi_CSIMessageGeneratorsByMessage_.end())
-        Midi_CSIMessageGeneratorsByMessage_[threeByteKey]->ProcessMidiMessage(evt);
-    else if (Midi_CSIMessageGeneratorsByMessage_.find(twoByteKey) != Midi_CSIMessageGeneratorsByMessage_.end())
-        Midi_CSIMessageGeneratorsByMessage_[twoByteKey]->ProcessMidiMessage(evt);
-    else if (Midi_CSIMessageGeneratorsByMessage_.find(oneByteKey) != Midi_CSIMessageGeneratorsByMessage_.end())
-        Midi_CSIMessageGeneratorsByMessage_[oneByteKey]->ProcessMidiMessage(evt);
+    
+    inputRing_ = new MidiEventRing();
+    outputRing_ = new MidiEventRing();
+    sysExOutputRing_ = new MidiEventRing();
+    
+    isIOThreadRunning_ = true;
+    ioThread_ = std::thread(&Midi_ControlSurfaceIO::RunIOThread, this);
 }
 
-void Midi_ControlSurface::SendMidiSysExMessage(MIDI_event_ex_t *midiMessage)
+void Midi_ControlSurfaceIO::StopIOThread()
 {
-    surfaceIO_->QueueMidiSysExMessage(midiMessage);
+    if ( ! isIOThreadRunning_)
+        return;
     
-    if (g_surfaceOutDisplay)
+    isIOThreadRunning_ = false;
+    ioThread_.join();
+    
+    // send anything still pending right away, this runs at shutdown after the final clear and nothing would pick it up later
+    MidiEventBuffer buffer;
+    long long timestamp;
+    
+    while (outputRing_->Read(&buffer.evt, timestamp))
+        SendRingMessage(&buffer.evt);
+    
+    while (sysExOutputRing_->Read(&buffer.evt, timestamp))
+        SendMidiSysexMessage(&buffer.evt);
+    
+    WDL_Queue *overflows[] = { &outputOverflow_, &sysExOutputOverflow_ };
+    
+    for (WDL_Queue *overflow : overflows)
     {
-        string output = "OUT->";
-        
-        output += name_ + " ";
-
-        char buf[32];
-
-        for (int i = 0; i < midiMessage->size; ++i)
+        while (overflow->Available() >= (int)sizeof(int))
         {
-            snprintf(buf, sizeof(buf), "%02x ", midiMessage->midi_message[i]);
-            output += buf;
+            memcpy(&buffer.evt.size, overflow->Get(), sizeof(int));
+            memcpy(buffer.evt.midi_message, (const char *)overflow->Get() + sizeof(int), buffer.evt.size);
+            overflow->Advance(sizeof(int) + buffer.evt.size);
+            SendRingMessage(&buffer.evt);
         }
         
-        output + "\n";
-
-        ShowConsoleMsg(output.c_str());
+        overflow->Clear();
     }
+    
+    delete inputRing_;
+    delete outputRing_;
+    delete sysExOutputRing_;
+    inputRing_ = NULL;
+    outputRing_ = NULL;
+    sysExOutputRing_ = NULL;
 }
 
-void Midi_ControlSurface::SendMidiMessage(int first, int second, int third)
+void Midi_ControlSurfaceIO::SendRingMessage(MIDI_event_ex_t *evt)
 {
-    surfaceIO_->SendMidiMessage(first, second, third);
-    
-    if (g_surfaceOutDisplay)
-    {
-        char buffer[250];
-        snprintf(buffer, sizeof(buffer), "%s  %02x  %02x  %02x \n", ("OUT->" + name_).c_str(), first, second, third);
-        ShowConsoleMsg(buffer);
-    }
+    if (evt->size > 3)
+        SendMidiSysexMessage(evt);
+    else if (midiOutput_)
+        midiOutput_->Send(evt->midi_message[0], evt->midi_message[1], evt->midi_message[2], -1);
 }
 
- ////////////////////////////////////////////////////////////////////////////////////////////////////////
- // OSC_ControlSurfaceIO
- ////////////////////////////////////////////////////////////////////////////////////////////////////////
-
-OSC_X32ControlSurfaceIO::OSC_X32ControlSurfaceIO(CSurfIntegrator *const csi, const char *surfaceName, int channelCount, const char *receiveOnPort, const char *transmitToPort, const char *transmitToIpAddress, int maxPacketsPerRun) : OSC_ControlSurfaceIO(csi, surfaceName, channelCount, receiveOnPort, transmitToPort, transmitToIpAddress, maxPacketsPerRun) {}
+// what waits in front of a full output ring before it counts as dropped, a thread that lets this much pile up has stalled
+static const int s_maxMidiOverflowBytes = 65536;
 
-OSC_ControlSurfaceIO::OSC_ControlSurfaceIO(CSurfIntegrator *const csi, const char *surfaceName, int channelCount, const char *receiveOnPort, const char *transmitToPort, const char *transmitToIpAddress, int maxPacketsPerRun) : csi_(csi), name_(surfaceName), channelCount_(channelCount)
+bool Midi_ControlSurfaceIO::WriteOverflow(MidiEventRing *ring, WDL_Queue &overflow)
 {
-    // private:
-    maxPacketsPerRun_ = maxPacketsPerRun < 0 ? 0 : maxPacketsPerRun;
-
-    if (strcmp(receiveOnPort, transmitToPort))
-    {
-        inSocket_  = GetInputSocketForPort(surfaceName, atoi(receiveOnPort));
-        outSocket_ = GetOutputSocketForAddressAndPort(surfaceName, transmitToIpAddress, atoi(transmitToPort));
-    }
-    else // WHEN INPUT AND OUTPUT SOCKETS ARE THE SAME -- DO MAGIC :)
+    if (overflow.Available() == 0)
+        return true;
+    
+    while (overflow.Available() >= (int)sizeof(int))
     {
-        oscpkt::UdpSocket *inSocket = GetInputSocketForPort(surfaceName, atoi(receiveOnPort));
-
-        struct addrinfo hints;
-        struct addrinfo *addressInfo;
-        memset(&hints, 0, sizeof(struct addrinfo));
-        hints.ai_family = AF_INET;      // IPV4
-        hints.ai_socktype = SOCK_DGRAM; // UDP
-        hints.ai_flags = 0x00000001;    // socket address is intended for bind
-        getaddrinfo(transmitToIpAddress, transmitToPort, &hints, &addressInfo);
-        memcpy(&(inSocket->remote_addr), (void*)(addressInfo->ai_addr), addressInfo->ai_addrlen);
-
-        inSocket_  = inSocket;
-        outSocket_ = inSocket;
+        int size;
+        memcpy(&size, overflow.Get(), sizeof(int));
+        if ( ! ring->Write((const unsigned char *)overflow.Get() + sizeof(int), size, 0))
+            break;
+        overflow.Advance(sizeof(int) + size);
     }
- }
+    
+    overflow.Compact();
+    
+    return overflow.Available() == 0;
+}
 
-OSC_ControlSurfaceIO::~OSC_ControlSurfaceIO()
+void Midi_ControlSurfaceIO::WriteRing(MidiEventRing *ring, WDL_Queue &overflow, const unsigned char *message, int size)
 {
-    Sleep(33);
+    if (WriteOverflow(ring, overflow) && ring->Write(message, size, 0))
+        return;
     
-    int count = 0;
-    while (packetQueue_.GetSize()>=sizeof(int) && ++count < 100)
+    if (overflow.Available() + (int)sizeof(int) + size > s_maxMidiOverflowBytes)
     {
-        BeginRun();
-        if (count) Sleep(33);
+        // the shadow already has it as sent, forget it so the next update for that target goes out again
+        outputShadow_->Forget(message, size);
+        numOutputDrops_++;
+        return;
     }
+    
+    overflow.Add(&size, sizeof(int));
+    overflow.Add(message, size);
+}
 
-    if (inSocket_)
+void Midi_ControlSurfaceIO::RunIOThread()
+{
+    // Input is timestamped and handed to the main thread as it arrives, output is sent as soon as it is queued.
+    // SysEx keeps the MaxMIDIMesssagesPerRun budget per surface refresh period, but no longer waits on the main thread's timer.
+    // Scheduler output, sysEx included, comes through the output ring and is not limited again, the scheduler has already paced it.
+    MidiEventBuffer buffer;
+    long long timestamp;
+    DWORD lastSysExRunTime = 0;
+    
+    while (isIOThreadRunning_)
     {
-        for (int x = 0; x < s_inputSockets.size(); ++x)
+        if (midiInput_)
         {
-            if (s_inputSockets[x]->socket == inSocket_)
-            {
-                if (!--s_inputSockets[x]->refcnt)
-                    s_inputSockets.erase(s_inputSockets.begin() + x);
-                break;
+            midiInput_->SwapBufsPrecise(GetTickCount(), GetTickCount());
+            MIDI_eventlist *list = midiInput_->GetReadBuf();
+            int bpos = 0;
+            MIDI_event_t *evt;
+            long long now = CSIProfiler::GetMicroseconds();
+            while ((evt = list->EnumItems(&bpos)))
+                if ( ! inputRing_->Write(evt->midi_message, evt->size, now))
+                    numInputDrops_++;
+        }
+        
+        while (outputRing_->Read(&buffer.evt, timestamp))
+            SendRingMessage(&buffer.evt);
+        
+        DWORD now = GetTickCount();
+        
+        bool isFlushRequested = isFlushRequested_;
+        
+        if (isFlushRequested || (now - lastSysExRunTime) >= (DWORD)(1000 / max(surfaceRefreshRate_, 1)))
+        {
+            lastSysExRunTime = now;
+            
+            int numSent = 0;
+            
+            while ((isFlushRequested || maxMesssagesPerRun_ == 0 || numSent < maxMesssagesPerRun_) && sysExOutputRing_->Read(&buffer.evt, timestamp))
+            {
+                SendMidiSysexMessage(&buffer.evt);
+                numSent++;
+            }
+        }
+        
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+void Midi_ControlSurfaceIO::HandleExternalInput(Midi_ControlSurface *surface)
+{
+    if (inputRing_)
+    {
+        MidiEventBuffer buffer;
+        long long timestamp;
+        ProfileHistogram *inputLatencyHistogram = csi_->GetProfiler().GetHistogram(inputLatencyHistogram_, "MidiIO", name_.c_str(), "InputLatency");
+        
+        while (inputRing_->Read(&buffer.evt, timestamp))
+        {
+            if (inputLatencyHistogram)
+                inputLatencyHistogram->Add((unsigned int)(CSIProfiler::GetMicroseconds() - timestamp));
+            
+            if (buffer.evt.size <= 3)
+                outputShadow_->InvalidateFromInput(buffer.evt.midi_message[0], buffer.evt.midi_message[1]);
+            
+            surface->ProcessMidiMessage(&buffer.evt);
+        }
+    }
+    else if (midiInput_)
+    {
+        midiInput_->SwapBufsPrecise(GetTickCount(), GetTickCount());
+        MIDI_eventlist *list = midiInput_->GetReadBuf();
+        int bpos = 0;
+        MIDI_event_t *evt;
+        while ((evt = list->EnumItems(&bpos)))
+        {
+            if (evt->size <= 3)
+                outputShadow_->InvalidateFromInput(evt->midi_message[0], evt->midi_message[1]);
+            
+            surface->ProcessMidiMessage((MIDI_event_ex_t*)evt);
+        }
+    }
+}
+
+void Midi_ControlSurfaceIO::Run()
+{
+    if (outputRing_)
+    {
+        WriteOverflow(outputRing_, outputOverflow_);
+        WriteOverflow(sysExOutputRing_, sysExOutputOverflow_);
+        
+        if (csi_->GetProfiler().GetIsEnabled())
+        {
+            if (ProfileHistogram *histogram = csi_->GetProfiler().GetHistogram(inputDropsHistogram_, "MidiIO", name_.c_str(), "InputDropsPerTick"))
+                histogram->Add(numInputDrops_.exchange(0));
+            
+            if (ProfileHistogram *histogram = csi_->GetProfiler().GetHistogram(outputDropsHistogram_, "MidiIO", name_.c_str(), "OutputDropsPerTick"))
+                histogram->Add(numOutputDrops_);
+            
+            numOutputDrops_ = 0;
+        }
+    }
+    
+    if (outputScheduler_)
+    {
+        outputScheduler_->Drain(MidiOutputScheduler::DisplayLane, maxMesssagesPerRun_, [this](const unsigned char *queued, int size) { SendScheduledMessage(queued, size); });
+        
+        if (csi_->GetProfiler().GetIsEnabled())
+        {
+            static const char *const laneNames[MidiOutputScheduler::NUM_LANES] = { "ControlQueueDepth", "MeterQueueDepth", "DisplayQueueDepth" };
+            
+            for (int lane = 0; lane < MidiOutputScheduler::NUM_LANES; ++lane)
+                if (ProfileHistogram *histogram = csi_->GetProfiler().GetHistogram(queueDepthHistograms_[lane], "MidiIO", name_.c_str(), laneNames[lane]))
+                    histogram->Add(outputScheduler_->GetQueueDepth((MidiOutputScheduler::Lane)lane));
+            
+            if (ProfileHistogram *histogram = csi_->GetProfiler().GetHistogram(supersededHistogram_, "MidiIO", name_.c_str(), "SupersededPerTick"))
+                histogram->Add(outputScheduler_->GetAndResetSupersededCount());
+        }
+        
+        return;
+    }
+    
+    if (sysExOutputRing_) // paced by the I/O thread
+        return;
+    
+    int numSent = 0;
+    
+    while ((maxMesssagesPerRun_ == 0 || numSent < maxMesssagesPerRun_) && messageQueue_.Available() >= 1)
+    {
+        const unsigned char *msg = (const unsigned char *)messageQueue_.Get();
+        const int msg_len = (int) *msg;
+        if (WDL_NOT_NORMALLY(messageQueue_.Available() < 1 + msg_len)) // not enough data in queue, should not happen
+            break;
+        
+        struct
+        {
+            MIDI_event_ex_t evt;
+            char data[256];
+        } midiSysExData;
+
+        midiSysExData.evt.frame_offset = 0;
+        midiSysExData.evt.size = msg_len;
+        memcpy(midiSysExData.evt.midi_message, msg + 1, msg_len);
+        messageQueue_.Advance(1 + msg_len);
+        SendMidiSysexMessage(&midiSysExData.evt);
+        numSent++;
+    }
+    
+    messageQueue_.Compact();
+}
+
+// page changes and shutdown -- paced output gets at most s_maxMidiFlushMilliseconds, whatever is left then goes out unpaced
+static const DWORD s_maxMidiFlushMilliseconds = 500;
+
+void Midi_ControlSurfaceIO::Flush()
+{
+    DWORD startTime = GetTickCount();
+    
+    if (outputScheduler_)
+    {
+        auto send = [this](const unsigned char *queued, int size) { SendScheduledMessage(queued, size); };
+        
+        while ( ! outputScheduler_->IsEmpty() && GetTickCount() - startTime < s_maxMidiFlushMilliseconds)
+        {
+            outputScheduler_->Drain(MidiOutputScheduler::DisplayLane, 0, send);
+            
+            if ( ! outputScheduler_->IsEmpty())
+                Sleep(5);
+        }
+        
+        outputScheduler_->DrainUnpaced(send);
+    }
+    
+    if (sysExOutputRing_)
+    {
+        // the I/O thread drops its pacing while asked to flush, anything it has not sent by the deadline it still sends afterwards
+        isFlushRequested_ = true;
+        
+        while (( ! sysExOutputRing_->IsEmpty() || ! outputRing_->IsEmpty() || outputOverflow_.Available() || sysExOutputOverflow_.Available()) && GetTickCount() - startTime < s_maxMidiFlushMilliseconds)
+        {
+            Sleep(1);
+            WriteOverflow(outputRing_, outputOverflow_);
+            WriteOverflow(sysExOutputRing_, sysExOutputOverflow_);
+        }
+        
+        isFlushRequested_ = false;
+    }
+    
+    while (messageQueue_.Available() >= 1)
+    {
+        Sleep(2);
+        
+        const unsigned char *msg = (const unsigned char *)messageQueue_.Get();
+        const int msg_len = (int) *msg;
+        if (WDL_NOT_NORMALLY(messageQueue_.Available() < 1 + msg_len)) // not enough data in queue, should not happen
+            break;
+        
+        struct
+        {
+            MIDI_event_ex_t evt;
+            char data[256];
+        } midiSysExData;
+
+        midiSysExData.evt.frame_offset = 0;
+        midiSysExData.evt.size = msg_len;
+        memcpy(midiSysExData.evt.midi_message, msg + 1, msg_len);
+        messageQueue_.Advance(1 + msg_len);
+        SendMidiSysexMessage(&midiSysExData.evt);
+    }
+}
+
+void Midi_ControlSurfaceIO::SendScheduledMessage(const unsigned char *message, int size)
+{
+    if (outputRing_) // in order with the short messages, the sysEx ring would limit it a second time
+        WriteRing(outputRing_, outputOverflow_, message, size);
+    else if (message[0] == 0xF0)
+    {
+        struct
+        {
+            MIDI_event_ex_t evt;
+            char data[256];
+        } midiSysExData;
+
+        midiSysExData.evt.frame_offset = 0;
+        midiSysExData.evt.size = size;
+        memcpy(midiSysExData.evt.midi_message, message, size);
+        SendMidiSysexMessage(&midiSysExData.evt);
+    }
+    else if (midiOutput_)
+        midiOutput_->Send(message[0], message[1], message[2], -1);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Midi_ControlSurface
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+Midi_ControlSurface::Midi_ControlSurface(CSurfIntegrator *const csi, Page *page, const char *name, int channelOffset, const char *surfaceFile, const char *zoneFolder, const char *fxZoneFolder, Midi_ControlSurfaceIO *surfaceIO)
+: ControlSurface(csi, page, name, surfaceIO->GetChannelCount(), channelOffset), surfaceIO_(surfaceIO)
+{
+    ProcessMIDIWidgetFile(surfaceFile, this);
+    InitHardwiredWidgets(this);
+    InitializeMeters();
+    InitZoneManager(csi_, this, zoneFolder, fxZoneFolder);
+}
+
+void Midi_ControlSurface::ProcessMidiMessage(const MIDI_event_ex_t *evt)
+{
+    if (g_surfaceRawInDisplay)
+    {
+        char buffer[250];
+        snprintf(buffer, sizeof(buffer), "IN <- %s %02x  %02x  %02x \n", name_.c_str(), evt->midi_message[0], evt->midi_message[1], evt->midi_message[2]);
+        ShowConsoleMsg(buffer);
+    }
+
+    if (Midi_CSIMessageGenerator *messageGenerator = Midi_CSIMessageGenerators_.GetGenerator(evt))
+        messageGenerator->ProcessMidiMessage(evt);
+}
+
+void Midi_ControlSurface::SendMidiSysExMessage(MIDI_event_ex_t *midiMessage)
+{
+    if ( ! surfaceIO_->GetOutputShadow().UpdateSysEx(midiMessage->midi_message, midiMessage->size))
+    {
+        profiledSuppressedMessages_++;
+        return;
+    }
+    
+    surfaceIO_->QueueMidiSysExMessage(midiMessage);
+    profiledMessages_++;
+    
+    if (g_surfaceOutDisplay)
+    {
+        string output = "OUT->";
+        
+        output += name_ + " ";
+
+        char buf[32];
+
+        for (int i = 0; i < midiMessage->size; ++i)
+        {
+            snprintf(buf, sizeof(buf), "%02x ", midiMessage->midi_message[i]);
+            output += buf;
+        }
+        
+        output + "\n";
+
+        ShowConsoleMsg(output.c_str());
+    }
+}
+
+void Midi_ControlSurface::QueueMCUDisplayText(int displayType, int displayRow, int position, const char *text, int length)
+{
+    if (position < 0 || position + length > (int)sizeof(MCUDisplayFrame::text))
+    {
+        SendMCUDisplayText(displayType, displayRow, position, text, length); // can't be addressed as part of a span
+        return;
+    }
+    
+    MCUDisplayFrame *frame = NULL;
+    
+    for (auto displayFrame : mcuDisplayFrames_)
+    {
+        if (displayFrame->displayType == displayType && displayFrame->displayRow == displayRow)
+        {
+            frame = displayFrame;
+            break;
+        }
+    }
+    
+    if (frame == NULL)
+    {
+        frame = new MCUDisplayFrame();
+        memset(frame, 0, sizeof(MCUDisplayFrame));
+        frame->displayType = displayType;
+        frame->displayRow = displayRow;
+        mcuDisplayFrames_.push_back(frame);
+    }
+    
+    for (int i = position; i < position + length; ++i)
+    {
+        frame->text[i] = *text++;
+        frame->isKnown[i] = true;
+        frame->isDirty[i] = true;
+    }
+    
+    frame->hasDirty = true;
+}
+
+void Midi_ControlSurface::FlushMCUDisplayFrames()
+{
+    // a new sysex costs 8 bytes of header and trailer, so resending up to that many unchanged characters is cheaper than splitting the span
+    const int maxResentGap = 8;
+    const int frameSize = sizeof(MCUDisplayFrame::text);
+    
+    for (auto frame : mcuDisplayFrames_)
+    {
+        if ( ! frame->hasDirty)
+            continue;
+        
+        int spanStart = -1;
+        int spanEnd = -1; // one past the last dirty character in the span
+        
+        for (int i = 0; i <= frameSize; ++i)
+        {
+            if (i < frameSize && ! frame->isDirty[i])
+                continue;
+            
+            if (spanStart >= 0)
+            {
+                bool canJoin = i < frameSize && i - spanEnd <= maxResentGap;
+                
+                for (int j = spanEnd; canJoin && j < i; ++j)
+                    if ( ! frame->isKnown[j])
+                        canJoin = false;
+                
+                if ( ! canJoin)
+                {
+                    SendMCUDisplayText(frame->displayType, frame->displayRow, spanStart, frame->text + spanStart, spanEnd - spanStart);
+                    spanStart = -1;
+                }
+            }
+            
+            if (i < frameSize)
+            {
+                if (spanStart < 0)
+                    spanStart = i;
+                spanEnd = i + 1;
+                frame->isDirty[i] = false;
+            }
+        }
+        
+        frame->hasDirty = false;
+    }
+    
+    // one strip refresh stands in for each queued processor's own, the last one not held by SetXTouchDisplayColors() would have been the one to stick
+    for (int i = (int)pendingTrackColorsFeedbackProcessors_.size() - 1; i >= 0; --i)
+    {
+        if ( ! pendingTrackColorsFeedbackProcessors_[i]->GetIsTrackColorsUpdatePrevented())
+        {
+            pendingTrackColorsFeedbackProcessors_[i]->ForceUpdateTrackColors();
+            break;
+        }
+    }
+    
+    pendingTrackColorsFeedbackProcessors_.clear();
+}
+
+void Midi_ControlSurface::SendMCUDisplayText(int displayType, int displayRow, int position, const char *text, int length)
+{
+    struct
+    {
+        MIDI_event_ex_t evt;
+        char data[256];
+    } midiSysExData;
+    midiSysExData.evt.frame_offset=0;
+    midiSysExData.evt.size=0;
+    midiSysExData.evt.midi_message[midiSysExData.evt.size++] = 0xF0;
+    midiSysExData.evt.midi_message[midiSysExData.evt.size++] = 0x00;
+    midiSysExData.evt.midi_message[midiSysExData.evt.size++] = 0x00;
+    midiSysExData.evt.midi_message[midiSysExData.evt.size++] = 0x66;
+    midiSysExData.evt.midi_message[midiSysExData.evt.size++] = displayType;
+    midiSysExData.evt.midi_message[midiSysExData.evt.size++] = displayRow;
+    midiSysExData.evt.midi_message[midiSysExData.evt.size++] = position;
+    
+    for (int i = 0; i < length && midiSysExData.evt.size < 250; ++i)
+        midiSysExData.evt.midi_message[midiSysExData.evt.size++] = text[i];
+    
+    midiSysExData.evt.midi_message[midiSysExData.evt.size++] = 0xF7;
+    
+    SendMidiSysExMessage(&midiSysExData.evt);
+}
+
+void Midi_ControlSurface::SendMidiMessage(int first, int second, int third)
+{
+    // MCU meters decay on the device, repeating a level is what keeps them up
+    bool isMCUMeter = hasMCUMeters_ && (first & 0xF0) == 0xD0;
+    
+    if ( ! surfaceIO_->GetOutputShadow().Update(first, second, third) && ! isMCUMeter)
+    {
+        profiledSuppressedMessages_++;
+        return;
+    }
+    
+    surfaceIO_->SendMidiMessage(first, second, third);
+    profiledMessages_++;
+    
+    if (g_surfaceOutDisplay)
+    {
+        char buffer[250];
+        snprintf(buffer, sizeof(buffer), "%s  %02x  %02x  %02x \n", ("OUT->" + name_).c_str(), first, second, third);
+        ShowConsoleMsg(buffer);
+    }
+}
+
+ ////////////////////////////////////////////////////////////////////////////////////////////////////////
+ // OSC_ControlSurfaceIO
+ ////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+OSC_X32ControlSurfaceIO::OSC_X32ControlSurfaceIO(CSurfIntegrator *const csi, const char *surfaceName, int channelCount, const char *receiveOnPort, const char *transmitToPort, const char *transmitToIpAddress, int maxPacketsPerRun, int maxBundleSize) : OSC_ControlSurfaceIO(csi, surfaceName, channelCount, receiveOnPort, transmitToPort, transmitToIpAddress, maxPacketsPerRun, maxBundleSize) {}
+
+OSC_ControlSurfaceIO::OSC_ControlSurfaceIO(CSurfIntegrator *const csi, const char *surfaceName, int channelCount, const char *receiveOnPort, const char *transmitToPort, const char *transmitToIpAddress, int maxPacketsPerRun, int maxBundleSize) : csi_(csi), name_(surfaceName), channelCount_(channelCount), isReceiveThreadRunning_(false), numInputDrops_(0)
+{
+    // private:
+    maxPacketsPerRun_ = maxPacketsPerRun < 0 ? 0 : maxPacketsPerRun;
+    maxBundleSize_ = maxBundleSize < 0 ? 0 : wdl_min(maxBundleSize, s_oscMaxBundleSize);
+
+    if (strcmp(receiveOnPort, transmitToPort))
+    {
+        inSocket_  = GetInputSocketForPort(surfaceName, atoi(receiveOnPort));
+        outSocket_ = GetOutputSocketForAddressAndPort(surfaceName, transmitToIpAddress, atoi(transmitToPort));
+    }
+    else // WHEN INPUT AND OUTPUT SOCKETS ARE THE SAME -- DO MAGIC :)
+    {
+        oscpkt::UdpSocket *inSocket = GetInputSocketForPort(surfaceName, atoi(receiveOnPort));
+
+        struct addrinfo hints;
+        struct addrinfo *addressInfo;
+        memset(&hints, 0, sizeof(struct addrinfo));
+        hints.ai_family = AF_INET;      // IPV4
+        hints.ai_socktype = SOCK_DGRAM; // UDP
+        hints.ai_flags = 0x00000001;    // socket address is intended for bind
+        getaddrinfo(transmitToIpAddress, transmitToPort, &hints, &addressInfo);
+        memcpy(&(inSocket->remote_addr), (void*)(addressInfo->ai_addr), addressInfo->ai_addrlen);
+
+        inSocket_  = inSocket;
+        outSocket_ = inSocket;
+    }
+ }
+
+OSC_ControlSurfaceIO::~OSC_ControlSurfaceIO()
+{
+    StopReceiveThread();
+    
+    Sleep(33);
+    
+    int count = 0;
+    while (packetQueue_.GetSize()>=sizeof(int) && ++count < 100)
+    {
+        BeginRun();
+        if (count) Sleep(33);
+    }
+
+    if (inSocket_)
+    {
+        for (int x = 0; x < s_inputSockets.size(); ++x)
+        {
+            if (s_inputSockets[x]->socket == inSocket_)
+            {
+                if (!--s_inputSockets[x]->refcnt)
+                    s_inputSockets.erase(s_inputSockets.begin() + x);
+                break;
             }
         }
     }
@@ -3933,75 +5572,366 @@ OSC_ControlSurfaceIO::~OSC_ControlSurfaceIO()
     }
 }
 
+void OSC_ControlSurfaceIO::BeginRun()
+{
+    sentPacketCount_ = 0;
+    sendCallCount_ = 0;
+    
+    SendQueuedPackets(); // send any latent packets first
+    
+    isInRun_ = true;
+}
+
+void OSC_ControlSurfaceIO::Run()
+{
+    QueueOSCMessage(NULL); // flush any latent bundles
+    
+    isInRun_ = false;
+    
+    SendQueuedPackets();
+    
+    if (ProfileHistogram *histogram = csi_->GetProfiler().GetHistogram(sendCallsHistogram_, "OSCIO", name_.c_str(), "SendCallsPerTick"))
+        histogram->Add(sendCallCount_);
+    if (ProfileHistogram *histogram = csi_->GetProfiler().GetHistogram(packetsHistogram_, "OSCIO", name_.c_str(), "PacketsPerTick"))
+        histogram->Add(sentPacketCount_);
+}
+
+void OSC_ControlSurfaceIO::SendQueuedPackets()
+{
+    if (WDL_NOT_NORMALLY(outSocket_ == NULL))
+    {
+        packetQueue_.Clear();
+        return;
+    }
+    
+    while (packetQueue_.GetSize() >= sizeof(int))
+    {
+        if (maxPacketsPerRun_ != 0 && sentPacketCount_ >= maxPacketsPerRun_)
+            break;
+        
+#ifdef __linux__
+        // hand up to BATCH_SIZE datagrams to the kernel in one call
+        enum { BATCH_SIZE = 64 };
+        struct mmsghdr messages[BATCH_SIZE];
+        struct iovec iovecs[BATCH_SIZE];
+        int count = 0;
+        int offset = 0;
+        bool isCorrupt = false;
+        
+        while (count < BATCH_SIZE && packetQueue_.GetSize() - offset >= (int)sizeof(int) && (maxPacketsPerRun_ == 0 || sentPacketCount_ + count < maxPacketsPerRun_))
+        {
+            int sza;
+            memcpy(&sza, (char *)packetQueue_.Get() + offset, sizeof(int));
+            if (WDL_NOT_NORMALLY(sza < 0 || packetQueue_.GetSize() - offset - (int)sizeof(int) < sza))
+            {
+                isCorrupt = true;
+                break;
+            }
+            
+            iovecs[count].iov_base = (char *)packetQueue_.Get() + offset + sizeof(int);
+            iovecs[count].iov_len = sza;
+            
+            memset(&messages[count], 0, sizeof(messages[count]));
+            messages[count].msg_hdr.msg_iov = &iovecs[count];
+            messages[count].msg_hdr.msg_iovlen = 1;
+            if (outSocket_->isBound())
+            {
+                messages[count].msg_hdr.msg_name = &outSocket_->remote_addr.addr();
+                messages[count].msg_hdr.msg_namelen = (socklen_t)outSocket_->remote_addr.actualLen();
+            }
+            
+            offset += sizeof(int) + sza;
+            count++;
+        }
+        
+        if (count > 0)
+        {
+            int sent = sendmmsg(outSocket_->socketHandle(), messages, count, 0);
+            sendCallCount_++;
+            
+            // anything the kernel did not take goes out one by one, like the unbatched path
+            for (int i = sent < 0 ? 0 : sent; i < count; ++i)
+            {
+                outSocket_->sendPacket(iovecs[i].iov_base, iovecs[i].iov_len);
+                sendCallCount_++;
+            }
+            
+            packetQueue_.Advance(offset);
+            sentPacketCount_ += count;
+        }
+        
+        if (isCorrupt)
+            packetQueue_.Clear();
+#else
+        int sza;
+        memcpy(&sza, packetQueue_.Get(), sizeof(int));
+        packetQueue_.Advance(sizeof(int));
+        if (WDL_NOT_NORMALLY(sza < 0 || packetQueue_.GetSize() < sza))
+        {
+            packetQueue_.Clear();
+        }
+        else
+        {
+            outSocket_->sendPacket(packetQueue_.Get(), sza);
+            sendCallCount_++;
+            packetQueue_.Advance(sza);
+            sentPacketCount_++;
+        }
+#endif
+    }
+    packetQueue_.Compact();
+}
+
+bool OSC_ControlSurfaceIO::DecodeMessage(oscpkt::Message *message, string &address, double &value)
+{
+    if (message->arg().isFloat())
+    {
+        float floatValue = 0;
+        message->arg().popFloat(floatValue);
+        value = floatValue;
+    }
+    else if (message->arg().isInt32())
+    {
+        int intValue;
+        message->arg().popInt32(intValue);
+        value = intValue;
+    }
+    else
+        return false;
+    
+    address = message->addressPattern();
+    return true;
+}
+
+bool OSC_X32ControlSurfaceIO::DecodeMessage(oscpkt::Message *message, string &address, double &value)
+{
+    if (message->arg().isInt32() && message->addressPattern() == "/-stat/selidx")
+    {
+        int intValue;
+        message->arg().popInt32(intValue);
+        
+        string x32Select = message->addressPattern() + "/";
+        
+        if (intValue < 10)
+            x32Select += "0";
+
+        char buf[64];
+        snprintf(buf, sizeof(buf), "%d", intValue);
+        x32Select += buf;
+        
+        address = x32Select;
+        value = 1.0;
+        return true;
+    }
+    
+    return OSC_ControlSurfaceIO::DecodeMessage(message, address, value);
+}
+
 void OSC_ControlSurfaceIO::HandleExternalInput(OSC_ControlSurface *surface)
 {
-   if (inSocket_ != NULL && inSocket_->isOk())
-   {
-       while (inSocket_->receiveNextPacket(0))  // timeout, in ms
-       {
-           packetReader_.init(inSocket_->packetData(), inSocket_->packetSize());
-           oscpkt::Message *message;
-           
-           while (packetReader_.isOk() && (message = packetReader_.popMessage()) != 0)
-           {
-               if (message->arg().isFloat())
-               {
-                   float value = 0;
-                   message->arg().popFloat(value);
-                   surface->ProcessOSCMessage(message->addressPattern().c_str(), value);
-               }
-               else if (message->arg().isInt32())
-               {
-                   int value;
-                   message->arg().popInt32(value);
-                   surface->ProcessOSCMessage(message->addressPattern().c_str(), value);
-               }
-           }
-       }
-   }
-}
-
-void OSC_X32ControlSurfaceIO::HandleExternalInput(OSC_ControlSurface *surface)
-{
-   if (inSocket_ != NULL && inSocket_->isOk())
-   {
-       while (inSocket_->receiveNextPacket(0))  // timeout, in ms
-       {
-           packetReader_.init(inSocket_->packetData(), inSocket_->packetSize());
-           oscpkt::Message *message;
-           
-           while (packetReader_.isOk() && (message = packetReader_.popMessage()) != 0)
-           {
-               if (message->arg().isFloat())
-               {
-                   float value = 0;
-                   message->arg().popFloat(value);
-                   surface->ProcessOSCMessage(message->addressPattern().c_str(), value);
-               }
-               else if (message->arg().isInt32())
-               {
-                   int value;
-                   message->arg().popInt32(value);
-                   
-                   if (message->addressPattern() == "/-stat/selidx")
-                   {
-                       string x32Select = message->addressPattern() + "/";
-                       
-                       if (value < 10)
-                           x32Select + "0";
-
-                       char buf[64];
-                       snprintf(buf, sizeof(buf), "%d", value);
-                       x32Select + buf;
-                                              
-                       surface->ProcessOSCMessage(x32Select.c_str(), 1.0);
-                   }
-                   else
-                       surface->ProcessOSCMessage(message->addressPattern().c_str(), value);
-               }
-           }
-       }
-   }
+    if (inputQueue_)
+    {
+        ProfileHistogram *inputLatencyHistogram = csi_->GetProfiler().GetHistogram(inputLatencyHistogram_, "OSCIO", name_.c_str(), "InputLatency");
+        OSCInputMessage *inputMessage;
+        
+        while ((inputMessage = inputQueue_->BeginRead()) != NULL)
+        {
+            if (inputLatencyHistogram)
+                inputLatencyHistogram->Add((unsigned int)(CSIProfiler::GetMicroseconds() - inputMessage->timestamp));
+            
+            surface->ProcessOSCMessage(inputMessage->address, inputMessage->addressHash, inputMessage->value);
+            inputQueue_->EndRead();
+        }
+        
+        if (ProfileHistogram *inputDropsHistogram = csi_->GetProfiler().GetHistogram(inputDropsHistogram_, "OSCIO", name_.c_str(), "InputDropsPerTick"))
+            inputDropsHistogram->Add(numInputDrops_.exchange(0));
+    }
+    else if (inSocket_ != NULL && inSocket_->isOk())
+    {
+        while (inSocket_->receiveNextPacket(0))  // timeout, in ms
+        {
+            packetReader_.init(inSocket_->packetData(), inSocket_->packetSize());
+            oscpkt::Message *message;
+            double value;
+            
+            while (packetReader_.isOk() && (message = packetReader_.popMessage()) != 0)
+                if (DecodeMessage(message, inputAddress_, value))
+                    surface->ProcessOSCMessage(inputAddress_.c_str(), value);
+        }
+    }
+}
+
+void OSC_ControlSurfaceIO::StartReceiveThread()
+{
+    if (isReceiveThreadRunning_ || inSocket_ == NULL || ! inSocket_->isOk())
+        return;
+    
+    inputQueue_ = new SPSCQueue<OSCInputMessage>(4096);
+    pendingInput_.reserve(MAX_PENDING_INPUT);
+    
+    isReceiveThreadRunning_ = true;
+    receiveThread_ = std::thread(&OSC_ControlSurfaceIO::RunReceiveThread, this);
+}
+
+void OSC_ControlSurfaceIO::StopReceiveThread()
+{
+    if ( ! isReceiveThreadRunning_)
+        return;
+    
+    isReceiveThreadRunning_ = false;
+    receiveThread_.join();
+    
+    delete inputQueue_;
+    inputQueue_ = NULL;
+    pendingInput_.clear();
+}
+
+bool OSC_ControlSurfaceIO::WritePendingInput()
+{
+    int numWritten = 0;
+    
+    for (; numWritten < (int)pendingInput_.size(); ++numWritten)
+    {
+        OSCInputMessage *inputMessage = inputQueue_->BeginWrite();
+        if (inputMessage == NULL)
+            break;
+        
+        *inputMessage = pendingInput_[numWritten];
+        inputQueue_->EndWrite();
+    }
+    
+    if (numWritten > 0)
+        pendingInput_.erase(pendingInput_.begin(), pendingInput_.begin() + numWritten);
+    
+    return pendingInput_.empty();
+}
+
+void OSC_ControlSurfaceIO::QueueInputPacket(oscpkt::PacketReader &packetReader, string &address, const void *packetData, int packetSize)
+{
+    long long timestamp = CSIProfiler::GetMicroseconds();
+    
+    packetReader.init(packetData, packetSize);
+    oscpkt::Message *message;
+    double value;
+    
+    while (packetReader.isOk() && (message = packetReader.popMessage()) != 0)
+    {
+        if ( ! DecodeMessage(message, address, value))
+            continue;
+        
+        if (address.size() >= sizeof(OSCInputMessage::address))
+            continue; // can't match a widget anyway
+        
+        unsigned int addressHash = GetOSCAddressHash(address.c_str());
+        
+        OSCInputMessage *inputMessage = WritePendingInput() ? inputQueue_->BeginWrite() : NULL;
+        
+        if (inputMessage != NULL)
+        {
+            memcpy(inputMessage->address, address.c_str(), address.size() + 1);
+            inputMessage->addressHash = addressHash;
+            inputMessage->value = value;
+            inputMessage->timestamp = timestamp;
+            inputQueue_->EndWrite();
+            continue;
+        }
+        
+        // the main thread is not keeping up, a fader only needs its latest position
+        OSCInputMessage *pending = NULL;
+        
+        for (auto &pendingInput : pendingInput_)
+        {
+            if (pendingInput.addressHash == addressHash && ! strcmp(pendingInput.address, address.c_str()))
+            {
+                pending = &pendingInput;
+                break;
+            }
+        }
+        
+        if (pending != NULL)
+            numInputDrops_++; // the value it was holding is lost
+        else
+        {
+            if (pendingInput_.size() >= MAX_PENDING_INPUT)
+            {
+                pendingInput_.erase(pendingInput_.begin()); // the oldest goes
+                numInputDrops_++;
+            }
+            
+            pendingInput_.emplace_back();
+            pending = &pendingInput_.back();
+            memcpy(pending->address, address.c_str(), address.size() + 1);
+            pending->addressHash = addressHash;
+        }
+        
+        pending->value = value;
+        pending->timestamp = timestamp;
+    }
+}
+
+void OSC_ControlSurfaceIO::RunReceiveThread()
+{
+    // receives into private buffers and never touches the socket's remote_addr, which the main thread uses for sending
+    oscpkt::PacketReader packetReader;
+    string address;
+    int handle = inSocket_->socketHandle();
+    
+#ifdef __linux__
+    // drain everything that is waiting with as few system calls as possible
+    enum { BATCH_SIZE = 16, DATAGRAM_SIZE = 16384 };
+    vector<char> buffers(BATCH_SIZE * DATAGRAM_SIZE);
+    struct mmsghdr messages[BATCH_SIZE];
+    struct iovec iovecs[BATCH_SIZE];
+    
+    memset(messages, 0, sizeof(messages));
+    for (int i = 0; i < BATCH_SIZE; ++i)
+    {
+        iovecs[i].iov_base = &buffers[i * DATAGRAM_SIZE];
+        iovecs[i].iov_len = DATAGRAM_SIZE;
+        messages[i].msg_hdr.msg_iov = &iovecs[i];
+        messages[i].msg_hdr.msg_iovlen = 1;
+    }
+#else
+    vector<char> buffer(1024 * 128);
+    struct sockaddr_storage senderAddress;
+#endif
+
+    while (isReceiveThreadRunning_)
+    {
+        // wake up regularly so StopReceiveThread() doesn't have to wait on a quiet socket
+        struct timeval tv;
+        tv.tv_sec = 0;
+        tv.tv_usec = 5000;
+        
+        fd_set readset;
+        FD_ZERO(&readset);
+        FD_SET(handle, &readset);
+        
+        if (select(handle + 1, &readset, 0, 0, &tv) <= 0)
+        {
+            WritePendingInput();
+            continue;
+        }
+        
+#ifdef __linux__
+        int count;
+        while ((count = recvmmsg(handle, messages, BATCH_SIZE, MSG_DONTWAIT, NULL)) > 0)
+        {
+            for (int i = 0; i < count; ++i)
+                if ( ! (messages[i].msg_hdr.msg_flags & MSG_TRUNC))
+                    QueueInputPacket(packetReader, address, &buffers[i * DATAGRAM_SIZE], (int)messages[i].msg_len);
+            
+            if (count < BATCH_SIZE)
+                break;
+        }
+#else
+        socklen_t len = sizeof(senderAddress);
+        int nread = (int)recvfrom(handle, &buffer[0], (int)buffer.size(), 0, (struct sockaddr *)&senderAddress, &len);
+        
+        if (nread > 0)
+            QueueInputPacket(packetReader, address, &buffer[0], nread);
+#endif
+    }
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -4028,6 +5958,83 @@ void OSC_ControlSurface::ProcessOSCMessage(const char *message, double value)
     }
 }
 
+void OSC_ControlSurface::AddCSIMessageGenerator(const string &message, CSIMessageGenerator *messageGenerator)
+{
+    ControlSurface::AddCSIMessageGenerator(message, messageGenerator);
+    
+    if (messageGenerator == NULL)
+        return;
+    
+    if ((numHashedMessageGenerators_ + 1) * 2 > (int)CSIMessageGeneratorsByHash_.size())
+    {
+        vector<HashedMessageGenerator> hashedGenerators(max(64, (int)CSIMessageGeneratorsByHash_.size() * 2));
+        hashedGenerators.swap(CSIMessageGeneratorsByHash_);
+        numHashedMessageGenerators_ = 0;
+        
+        for (auto &hashedGenerator : hashedGenerators)
+            if (hashedGenerator.isUsed)
+                AddHashedMessageGenerator(hashedGenerator);
+    }
+    
+    auto it = CSIMessageGeneratorsByMessage_.find(message);
+    AddHashedMessageGenerator({ GetOSCAddressHash(message.c_str()), true, it->first.c_str(), it->second });
+}
+
+void OSC_ControlSurface::AddHashedMessageGenerator(const HashedMessageGenerator &hashedGenerator)
+{
+    unsigned int mask = (unsigned int)CSIMessageGeneratorsByHash_.size() - 1;
+    
+    for (unsigned int i = hashedGenerator.hash & mask; ; i = (i + 1) & mask)
+    {
+        HashedMessageGenerator &slot = CSIMessageGeneratorsByHash_[i];
+        
+        if ( ! slot.isUsed)
+        {
+            slot = hashedGenerator;
+            numHashedMessageGenerators_++;
+            return;
+        }
+        
+        if (slot.hash == hashedGenerator.hash)
+        {
+            if (slot.generator == NULL || hashedGenerator.generator == NULL || strcmp(slot.address, hashedGenerator.address))
+                slot.generator = NULL; // a second address with this hash, both go through the string lookup
+            else
+                slot.generator = hashedGenerator.generator; // the address was given a new generator
+            return;
+        }
+    }
+}
+
+const OSC_ControlSurface::HashedMessageGenerator *OSC_ControlSurface::GetHashedMessageGenerator(unsigned int hash)
+{
+    if (CSIMessageGeneratorsByHash_.empty())
+        return NULL;
+    
+    unsigned int mask = (unsigned int)CSIMessageGeneratorsByHash_.size() - 1;
+    
+    for (unsigned int i = hash & mask; CSIMessageGeneratorsByHash_[i].isUsed; i = (i + 1) & mask)
+        if (CSIMessageGeneratorsByHash_[i].hash == hash)
+            return &CSIMessageGeneratorsByHash_[i];
+    
+    return NULL;
+}
+
+void OSC_ControlSurface::ProcessOSCMessage(const char *message, unsigned int addressHash, double value)
+{
+    const HashedMessageGenerator *hashedGenerator = GetHashedMessageGenerator(addressHash);
+    
+    if (hashedGenerator == NULL)
+    {
+        if (g_surfaceInDisplay)
+            ProcessOSCMessage(message, value); // unknown address, let the string lookup do the logging
+    }
+    else if (hashedGenerator->generator == NULL || g_surfaceInDisplay)
+        ProcessOSCMessage(message, value); // hash collision, or logging is on
+    else if ( ! strcmp(hashedGenerator->address, message))
+        hashedGenerator->generator->ProcessMessage(value);
+}
+
 void OSC_ControlSurface::SendOSCMessage(const char *zoneName)
 {
     string oscAddress(zoneName);
@@ -4035,6 +6042,7 @@ void OSC_ControlSurface::SendOSCMessage(const char *zoneName)
     oscAddress = "/" + oscAddress;
 
     surfaceIO_->SendOSCMessage(oscAddress.c_str());
+    profiledMessages_++;
         
     if (g_surfaceOutDisplay)
     {
@@ -4047,6 +6055,7 @@ void OSC_ControlSurface::SendOSCMessage(const char *zoneName)
 void OSC_ControlSurface::SendOSCMessage(const char *oscAddress, int value)
 {
     surfaceIO_->SendOSCMessage(oscAddress, value);
+    profiledMessages_++;
         
     if (g_surfaceOutDisplay)
     {
@@ -4059,6 +6068,7 @@ void OSC_ControlSurface::SendOSCMessage(const char *oscAddress, int value)
 void OSC_ControlSurface::SendOSCMessage(const char *oscAddress, double value)
 {
     surfaceIO_->SendOSCMessage(oscAddress, value);
+    profiledMessages_++;
         
     if (g_surfaceOutDisplay)
     {
@@ -4071,6 +6081,7 @@ void OSC_ControlSurface::SendOSCMessage(const char *oscAddress, double value)
 void OSC_ControlSurface::SendOSCMessage(const char *oscAddress, const char *value)
 {
     surfaceIO_->SendOSCMessage(oscAddress, value);
+    profiledMessages_++;
         
     if (g_surfaceOutDisplay)
     {
@@ -4083,6 +6094,7 @@ void OSC_ControlSurface::SendOSCMessage(const char *oscAddress, const char *valu
 void OSC_ControlSurface::SendOSCMessage(OSC_FeedbackProcessor *feedbackProcessor, const char *oscAddress, double value)
 {
     surfaceIO_->SendOSCMessage(oscAddress, value);
+    profiledMessages_++;
     
     if (g_surfaceOutDisplay)
     {
@@ -4095,6 +6107,7 @@ void OSC_ControlSurface::SendOSCMessage(OSC_FeedbackProcessor *feedbackProcessor
 void OSC_ControlSurface::SendOSCMessage(OSC_FeedbackProcessor *feedbackProcessor, const char *oscAddress, int value)
 {
     surfaceIO_->SendOSCMessage(oscAddress, value);
+    profiledMessages_++;
 
     if (g_surfaceOutDisplay)
     {
@@ -4107,6 +6120,7 @@ void OSC_ControlSurface::SendOSCMessage(OSC_FeedbackProcessor *feedbackProcessor
 void OSC_ControlSurface::SendOSCMessage(OSC_FeedbackProcessor *feedbackProcessor, const char *oscAddress, const char *value)
 {
     surfaceIO_->SendOSCMessage(oscAddress, value);
+    profiledMessages_++;
 
     if (g_surfaceOutDisplay)
     {
@@ -4229,8 +6243,14 @@ CSurfIntegrator::~CSurfIntegrator()
 {
     Shutdown();
 
+    for (auto midiSurfaceIO : midiSurfacesIO_)
+        midiSurfaceIO->StopIOThread();
+    
     midiSurfacesIO_.clear();
     
+    for (auto oscSurfaceIO : oscSurfacesIO_)
+        oscSurfaceIO->StopReceiveThread();
+    
     oscSurfacesIO_.clear();
             
     pages_.clear();
@@ -4263,9 +6283,14 @@ int CSurfIntegrator::Extended(int call, void *parm1, void *parm2, void *parm3)
     
     if (call == CSURF_EXT_RESET)
     {
+       BuildVolumeTable(); // ahead of Init, which only runs once
        Init();
+       trackPropertyChanges_.InvalidateAll();
     }
     
+    if (call == CSURF_EXT_RESET || call == CSURF_EXT_SETFXCHANGE || call == CSURF_EXT_SETMIXERSCROLL || call == CSURF_EXT_SETLASTTOUCHEDTRACK)
+        InvalidateTrackLists();
+    
     if (call == CSURF_EXT_SETFXCHANGE)
     {
         // parm1=(MediaTrack*)track, whenever FX are added, deleted, or change order
@@ -26,6 +26,7 @@
 #include <fstream>
 #include <sstream>
 #include <iomanip>
+#include <string_view>
 #include <math.h>
 
 #ifdef _WIN32
@@ -35,10 +36,15 @@
 
 #include <filesystem>
 #include <map>
+#include <algorithm>
+#include <chrono>
+#include <atomic>
+#include <thread>
 
 #include "../WDL/win32_utf8.h"
 #include "../WDL/ptrlist.h"
 #include "../WDL/queue.h"
+#include "../WDL/fnv64.h"
 
 #include "control_surface_integrator_Reaper.h"
 
@@ -98,6 +104,28 @@ static char *format_number(double v, char *buf, int bufsz)
 
 extern void GetTokens(vector<string> &tokens, const string &line);
 extern void GetTokens(vector<string> &tokens, const string &line, char delimiter);
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+class LineTokenizer
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+{
+    // Splits a line in one pass into views of a buffer it owns and reuses, so parsing a file allocates nothing per line once the
+    // buffer has grown to the longest line. Every token is NUL terminated in the buffer, so data() can be handed to C string APIs.
+    // The views stay valid until the next Tokenize() or Split().
+private:
+    string buffer_;
+    vector<string_view> tokens_;
+    
+public:
+    // whitespace separated, "quoted tokens" may contain spaces and \" or \\ escapes -- the same tokens istream >> quoted() gives
+    const vector<string_view> &Tokenize(string_view line);
+    
+    // getline() semantics, an empty last field is dropped
+    const vector<string_view> &Split(string_view line, char delimiter);
+    
+    const vector<string_view> &GetTokens() const { return tokens_; }
+};
+
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 enum PropertyType {
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -135,15 +163,23 @@ enum PropertyType {
   D(MidiOutput) \
   D(MIDISurfaceRefreshRate) \
   D(MaxMIDIMesssagesPerRun) \
+  D(MIDIIOThread) \
+  D(MaxMIDIBytesPerSecond) \
   D(ReceiveOnPort) \
   D(TransmitToPort) \
   D(TransmitToIPAddress) \
   D(MaxPacketsPerRun) \
+  D(OSCReceiveThread) \
+  D(MaxBundleSize) \
   D(PageName) \
   D(PageFollowsMCP) \
   D(SynchPages) \
   D(ScrollLink) \
   D(ScrollSynch) \
+  D(ChangeDrivenFeedback) \
+  D(MeterDecay) \
+  D(MeterPeakHold) \
+  D(FeedbackBudget) \
   D(Broadcaster) \
   D(Listener) \
   D(Surface) \
@@ -183,6 +219,23 @@ class PropertyList
 
   public:
     PropertyList() : nprops_(0) { }
+    PropertyList(const PropertyList &other) : nprops_(0)
+    {
+        for (int x = 0; x < other.nprops_; ++x)
+        {
+            props_[x] = other.props_[x];
+            
+            char *rec = &vals_[x][0];
+            memcpy(rec, &other.vals_[x][0], RECLEN);
+            if (char *v = get_item_ptr(rec))
+            {
+                v = strdup(v);
+                memcpy(rec, &v, sizeof(v));
+            }
+        }
+        nprops_ = other.nprops_;
+    }
+    PropertyList &operator=(const PropertyList &) = delete;
     ~PropertyList()
     {
         for (int x = 0; x < nprops_; ++x) free(get_item_ptr(&vals_[x][0]));
@@ -302,6 +355,528 @@ class ActionContext;
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+// Track properties REAPER pushes to control surfaces via the IReaperControlSurface SetSurface* / SetTrackTitle callbacks
+enum TrackProperty
+{
+    TrackProperty_None,
+    TrackProperty_Volume,
+    TrackProperty_Pan,
+    TrackProperty_Mute,
+    TrackProperty_Solo,
+    TrackProperty_Selected,
+    TrackProperty_RecordArm,
+    TrackProperty_Name,
+};
+
+static const DWORD s_changeDrivenFeedbackResyncInterval = 1000;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+class TrackPropertyChanges
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+{
+private:
+    struct Change
+    {
+        MediaTrack *track;      // NULL means every track
+        TrackProperty property; // TrackProperty_None means every property
+    };
+
+    enum { NUM_CHANGES = 256 };
+    Change changes_[NUM_CHANGES];
+    unsigned int generation_ = 0;
+
+public:
+    unsigned int GetGeneration() { return generation_; }
+
+    void AddChange(MediaTrack *track, TrackProperty property)
+    {
+        changes_[generation_ % NUM_CHANGES].track = track;
+        changes_[generation_ % NUM_CHANGES].property = property;
+        generation_++;
+    }
+
+    void InvalidateAll() { AddChange(NULL, TrackProperty_None); }
+
+    bool HasChanged(MediaTrack *track, TrackProperty property, unsigned int sinceGeneration)
+    {
+        if (generation_ - sinceGeneration > NUM_CHANGES) // log overran, assume the worst
+            return true;
+
+        for (unsigned int i = sinceGeneration; i != generation_; ++i)
+        {
+            const Change &change = changes_[i % NUM_CHANGES];
+
+            if ((change.track == NULL || change.track == track) && (change.property == TrackProperty_None || change.property == property))
+                return true;
+        }
+
+        return false;
+    }
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+class TrackStateCache
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+{
+    // Track state read by feedback, fetched from REAPER at most once per tick however many contexts ask for it.
+    // Page::Run() invalidates it before input and again before the surfaces update (free when input fetched nothing), and the SetSurface* callbacks
+    // invalidate a track as soon as REAPER reports a change, so a Do() followed by a read in the same tick sees the new value.
+public:
+    enum Field { Field_VolPan, Field_PanMode, Field_Mute, Field_Solo, Field_RecordArm, Field_Selected, Field_AutoMode, Field_Name, NUM_FIELDS };
+    
+private:
+    map<MediaTrack *, int> indexByTrack_;
+    unsigned int generation_ = 1;
+    vector<unsigned int> fieldGenerations_; // NUM_FIELDS per track, the field is valid when it equals generation_
+    vector<double> volumes_;
+    vector<double> pans_;
+    vector<int> panModes_;
+    vector<char> isMuted_;
+    vector<char> isSoloed_;
+    vector<char> isRecordArmed_;
+    vector<char> isSelected_;
+    vector<int> autoModes_;
+    vector<string> names_;
+    bool isFetchedSinceInvalidate_ = false;
+    unsigned int fetchCount_ = 0; // REAPER calls, running totals for the profiler
+    unsigned int readCount_ = 0;
+    
+    // returns the track's index, and whether field has to be fetched
+    int Lookup(MediaTrack *track, Field field, bool &needsFetch)
+    {
+        readCount_++;
+        
+        int index;
+        auto it = indexByTrack_.find(track);
+        
+        if (it != indexByTrack_.end())
+            index = it->second;
+        else
+        {
+            index = (int)indexByTrack_.size();
+            indexByTrack_[track] = index;
+            fieldGenerations_.resize(fieldGenerations_.size() + NUM_FIELDS, 0);
+            volumes_.push_back(0.0);
+            pans_.push_back(0.0);
+            panModes_.push_back(0);
+            isMuted_.push_back(false);
+            isSoloed_.push_back(false);
+            isRecordArmed_.push_back(false);
+            isSelected_.push_back(false);
+            autoModes_.push_back(0);
+            names_.push_back("");
+        }
+        
+        needsFetch = fieldGenerations_[index * NUM_FIELDS + field] != generation_;
+        
+        if (needsFetch)
+        {
+            fieldGenerations_[index * NUM_FIELDS + field] = generation_;
+            isFetchedSinceInvalidate_ = true;
+            fetchCount_++;
+        }
+        
+        return index;
+    }
+    
+public:
+    void Invalidate()
+    {
+        if (isFetchedSinceInvalidate_) // otherwise no field is valid anyway
+        {
+            generation_++;
+            isFetchedSinceInvalidate_ = false;
+        }
+    }
+    
+    void InvalidateTrack(MediaTrack *track) // NULL = every track
+    {
+        if (track == NULL)
+        {
+            Invalidate();
+            return;
+        }
+        
+        auto it = indexByTrack_.find(track);
+        
+        if (it != indexByTrack_.end())
+            for (int field = 0; field < NUM_FIELDS; ++field)
+                fieldGenerations_[it->second * NUM_FIELDS + field] = 0;
+    }
+    
+    void Clear() // track list changed, forget the pointers
+    {
+        indexByTrack_.clear();
+        fieldGenerations_.clear();
+        volumes_.clear();
+        pans_.clear();
+        panModes_.clear();
+        isMuted_.clear();
+        isSoloed_.clear();
+        isRecordArmed_.clear();
+        isSelected_.clear();
+        autoModes_.clear();
+        names_.clear();
+    }
+    
+    unsigned int GetFetchCount() { return fetchCount_; }
+    unsigned int GetReadCount() { return readCount_; }
+    
+    double GetVolume(MediaTrack *track)
+    {
+        bool needsFetch;
+        int index = Lookup(track, Field_VolPan, needsFetch);
+        if (needsFetch)
+            GetTrackUIVolPan(track, &volumes_[index], &pans_[index]);
+        return volumes_[index];
+    }
+    
+    double GetPan(MediaTrack *track)
+    {
+        bool needsFetch;
+        int index = Lookup(track, Field_VolPan, needsFetch);
+        if (needsFetch)
+            GetTrackUIVolPan(track, &volumes_[index], &pans_[index]);
+        return pans_[index];
+    }
+    
+    int GetPanMode(MediaTrack *track)
+    {
+        bool needsFetch;
+        int index = Lookup(track, Field_PanMode, needsFetch);
+        if (needsFetch)
+        {
+            double pan1, pan2 = 0.0;
+            GetTrackUIPan(track, &pan1, &pan2, &panModes_[index]);
+        }
+        return panModes_[index];
+    }
+    
+    bool GetIsMuted(MediaTrack *track)
+    {
+        bool needsFetch;
+        int index = Lookup(track, Field_Mute, needsFetch);
+        if (needsFetch)
+        {
+            bool mute = false;
+            GetTrackUIMute(track, &mute);
+            isMuted_[index] = mute;
+        }
+        return isMuted_[index] != 0;
+    }
+    
+    bool GetIsSoloed(MediaTrack *track)
+    {
+        bool needsFetch;
+        int index = Lookup(track, Field_Solo, needsFetch);
+        if (needsFetch)
+            isSoloed_[index] = GetMediaTrackInfo_Value(track, "I_SOLO") > 0;
+        return isSoloed_[index] != 0;
+    }
+    
+    bool GetIsRecordArmed(MediaTrack *track)
+    {
+        bool needsFetch;
+        int index = Lookup(track, Field_RecordArm, needsFetch);
+        if (needsFetch)
+            isRecordArmed_[index] = GetMediaTrackInfo_Value(track, "I_RECARM") != 0;
+        return isRecordArmed_[index] != 0;
+    }
+    
+    bool GetIsSelected(MediaTrack *track)
+    {
+        bool needsFetch;
+        int index = Lookup(track, Field_Selected, needsFetch);
+        if (needsFetch)
+            isSelected_[index] = GetMediaTrackInfo_Value(track, "I_SELECTED") != 0;
+        return isSelected_[index] != 0;
+    }
+    
+    int GetAutoMode(MediaTrack *track)
+    {
+        bool needsFetch;
+        int index = Lookup(track, Field_AutoMode, needsFetch);
+        if (needsFetch)
+            autoModes_[index] = (int)GetMediaTrackInfo_Value(track, "I_AUTOMODE");
+        return autoModes_[index];
+    }
+    
+    const char *GetName(MediaTrack *track)
+    {
+        bool needsFetch;
+        int index = Lookup(track, Field_Name, needsFetch);
+        if (needsFetch)
+        {
+            char buf[MEDBUF];
+            GetTrackName(track, buf, sizeof(buf));
+            names_[index] = buf;
+        }
+        return names_[index].c_str();
+    }
+};
+
+static const DWORD s_trackColorExpiry = 1000; // milliseconds a track's color is polled after the last request for it
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+class TrackColors
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+{
+    // REAPER doesn't report color edits, so the colors of the tracks the surfaces show are polled once per tick in Refresh(),
+    // and the contexts and track color feedback processors only push a color when it, or the track they show, has changed.
+    // A track nobody has asked for in s_trackColorExpiry is dropped, it is read again if it comes back into view; surfaces refreshing
+    // slower than REAPER ticks keep theirs between refreshes, so a color that didn't change isn't reported as changed.
+private:
+    struct Entry
+    {
+        rgba_color color;
+        unsigned int changeGeneration = 0;
+        DWORD requestTime = 0;
+    };
+    
+    map<MediaTrack *, Entry> entries_;
+    unsigned int generation_ = 1;
+    bool hasChanges_ = false;
+    DWORD refreshTime_ = 0;
+    
+    Entry &GetEntry(MediaTrack *track)
+    {
+        auto it = entries_.find(track);
+        if (it != entries_.end())
+        {
+            it->second.requestTime = refreshTime_;
+            return it->second;
+        }
+        
+        Entry &entry = entries_[track];
+        entry.color = DAW::GetTrackColor(track);
+        entry.changeGeneration = generation_;
+        entry.requestTime = refreshTime_;
+        return entry;
+    }
+    
+public:
+    void Refresh()
+    {
+        generation_++;
+        hasChanges_ = false;
+        refreshTime_ = GetTickCount();
+        
+        for (auto it = entries_.begin(); it != entries_.end(); )
+        {
+            if (refreshTime_ - it->second.requestTime > s_trackColorExpiry)
+            {
+                it = entries_.erase(it);
+                continue;
+            }
+            
+            rgba_color color = DAW::GetTrackColor(it->first);
+            if (color != it->second.color)
+            {
+                it->second.color = color;
+                it->second.changeGeneration = generation_;
+                hasChanges_ = true;
+            }
+            
+            ++it;
+        }
+    }
+    
+    // track pointers may have gone stale
+    void Clear()
+    {
+        entries_.clear();
+        generation_++;
+        hasChanges_ = true;
+    }
+    
+    unsigned int GetGeneration() { return generation_; }
+    bool GetHasChanges() { return hasChanges_; } // in the last Refresh()
+    
+    rgba_color GetColor(MediaTrack *track) { return GetEntry(track).color; }
+    
+    bool HasChanged(MediaTrack *track, unsigned int sinceGeneration) { return GetEntry(track).changeGeneration > sinceGeneration; }
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+class ProfileHistogram
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+{
+private:
+    // log-linear buckets of microseconds or counts -- exact below 8, then 8 sub-buckets per power of two (~12% resolution)
+    enum { NUM_SUB_BUCKETS = 8, NUM_BUCKETS = 32 * NUM_SUB_BUCKETS };
+    unsigned int counts_[NUM_BUCKETS];
+    unsigned int count_ = 0;
+    double total_ = 0.0;
+    unsigned int max_ = 0;
+    
+    static int GetBucket(unsigned int microseconds)
+    {
+        if (microseconds < NUM_SUB_BUCKETS)
+            return microseconds;
+        
+        int exponent = 3;
+        while (exponent < 31 && (microseconds >> (exponent + 1)) != 0)
+            exponent++;
+        
+        return (exponent - 2) * NUM_SUB_BUCKETS + ((microseconds >> (exponent - 3)) & (NUM_SUB_BUCKETS - 1));
+    }
+    
+    static unsigned int GetBucketUpperBound(int bucket)
+    {
+        if (bucket < NUM_SUB_BUCKETS)
+            return bucket;
+        
+        int exponent = bucket / NUM_SUB_BUCKETS + 2;
+        
+        return (((unsigned int)(NUM_SUB_BUCKETS + bucket % NUM_SUB_BUCKETS + 1)) << (exponent - 3)) - 1;
+    }
+    
+public:
+    ProfileHistogram() { Reset(); }
+    
+    void Reset()
+    {
+        memset(counts_, 0, sizeof(counts_));
+        count_ = 0;
+        total_ = 0.0;
+        max_ = 0;
+    }
+    
+    void Add(unsigned int microseconds)
+    {
+        counts_[GetBucket(microseconds)]++;
+        count_++;
+        total_ += microseconds;
+        if (microseconds > max_)
+            max_ = microseconds;
+    }
+    
+    unsigned int GetCount() { return count_; }
+    unsigned int GetMax() { return max_; }
+    double GetMean() { return count_ ? total_ / count_ : 0.0; }
+    
+    unsigned int GetPercentile(double percentile) // upper bound of the bucket holding the given percentile
+    {
+        if (count_ == 0)
+            return 0;
+        
+        double target = percentile * count_;
+        unsigned int accumulated = 0;
+        
+        for (int i = 0; i < NUM_BUCKETS; ++i)
+        {
+            accumulated += counts_[i];
+            if (accumulated >= target)
+                return wdl_min(GetBucketUpperBound(i), max_);
+        }
+        
+        return max_;
+    }
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+class CSIProfiler
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+{
+private:
+    bool isEnabled_ = false;
+    map<string, ProfileHistogram *> histograms_; // owns the histograms, never erased so callers may cache the pointers
+    map<string, string> notes_; // one-off measurements such as startup time, kept when profiling is switched on
+    DWORD lastDumpTime_ = 0;
+
+public:
+    ~CSIProfiler()
+    {
+        for (auto &histogram : histograms_)
+            delete histogram.second;
+    }
+    
+    static long long GetMicroseconds() { return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count(); }
+    
+    bool GetIsEnabled() { return isEnabled_; }
+    
+    void SetIsEnabled(bool isEnabled)
+    {
+        if (isEnabled && ! isEnabled_)
+        {
+            for (auto &histogram : histograms_)
+                histogram.second->Reset();
+            
+            lastDumpTime_ = GetTickCount();
+        }
+        
+        isEnabled_ = isEnabled;
+    }
+    
+    ProfileHistogram *GetHistogram(const string &name)
+    {
+        ProfileHistogram *&histogram = histograms_[name];
+        if (histogram == NULL)
+            histogram = new ProfileHistogram();
+        return histogram;
+    }
+    
+    // returns NULL when profiling is off so the result can be handed straight to ProfileScope, builds the key only on first use
+    ProfileHistogram *GetHistogram(ProfileHistogram *&cache, const char *category, const char *owner, const char *item)
+    {
+        if ( ! isEnabled_)
+            return NULL;
+        
+        if (cache == NULL)
+            cache = GetHistogram(string(category) + "/" + owner + "/" + item);
+        
+        return cache;
+    }
+    
+    void SetNote(const string &name, const string &text) { notes_[name] = text; }
+    
+    DWORD GetLastDumpTime() { return lastDumpTime_; }
+    
+    void Dump(const char *filePath)
+    {
+        lastDumpTime_ = GetTickCount();
+        
+        FILE *profileFile = fopenUTF8(filePath, "wb");
+        if ( ! profileFile)
+            return;
+        
+        for (auto &note : notes_)
+            fprintf(profileFile, "%-72s %s\n", note.first.c_str(), note.second.c_str());
+        
+        if (notes_.size() > 0)
+            fprintf(profileFile, "\n");
+        
+        fprintf(profileFile, "%-72s %10s %10s %10s %10s %10s\n", "microseconds, or per tick for *PerTick", "count", "mean", "p50", "p99", "max");
+        
+        for (auto &histogram : histograms_)
+        {
+            ProfileHistogram *h = histogram.second;
+            if (h->GetCount() > 0)
+                fprintf(profileFile, "%-72s %10u %10.1f %10u %10u %10u\n", histogram.first.c_str(), h->GetCount(), h->GetMean(), h->GetPercentile(0.5), h->GetPercentile(0.99), h->GetMax());
+        }
+        
+        fclose(profileFile);
+    }
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+class ProfileScope
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+{
+private:
+    ProfileHistogram *const histogram_;
+    long long const start_;
+
+public:
+    ProfileScope(ProfileHistogram *histogram) : histogram_(histogram), start_(histogram ? CSIProfiler::GetMicroseconds() : 0) {} // pass NULL when profiling is off
+    
+    ~ProfileScope()
+    {
+        if (histogram_)
+            histogram_->Add((unsigned int)(CSIProfiler::GetMicroseconds() - start_));
+    }
+};
+
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 class Action
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -317,6 +892,13 @@ public:
     virtual double GetCurrentNormalizedValue(ActionContext *context) { return 0.0; }
     virtual double GetCurrentDBValue(ActionContext *context) { return 0.0; }
 
+    // Actions whose feedback depends solely on one pushed TrackProperty of the context's track may skip polling in ChangeDrivenFeedback mode
+    virtual TrackProperty GetTrackProperty() { return TrackProperty_None; }
+
+    // shared by every ActionContext using this Action, set up lazily by ActionContext when profiling is enabled
+    ProfileHistogram *requestUpdateHistogram_ = NULL;
+    ProfileHistogram *doHistogram_ = NULL;
+
     int GetPanMode(MediaTrack *track)
     {
         double pan1, pan2 = 0.0;
@@ -452,7 +1034,7 @@ private:
     CSurfIntegrator *const csi_;
     Action *action_;
     Widget  *const widget_;
-    Zone  *const zone_;
+    Zone  *zone_; // only set by the constructors, see the ZoneTemplate one
 
     int intParam_;
     
@@ -491,13 +1073,26 @@ private:
     bool provideFeedback_;
 
     PropertyList widgetProperties_;
+
+    // ChangeDrivenFeedback bookkeeping, see RequestUpdate()
+    MediaTrack *lastUpdateTrack_ = NULL;
+    unsigned int lastUpdateChangeGeneration_ = 0;
+    int lastUpdateWidgetSerial_ = -1;
+    DWORD lastUpdateTime_ = 0;
+    
+    // UpdateTrackColor() bookkeeping
+    MediaTrack *lastColorTrack_ = NULL;
+    unsigned int lastColorGeneration_ = 0;
+    int lastColorWidgetSerial_ = -1;
         
     void UpdateTrackColor();
+    void RefreshWidget();
     void GetSteppedValues(Widget *widget, Action *action,  Zone *zone, int paramNumber, const vector<string> &params, const PropertyList &widgetProperties, double &deltaValue, vector<double> &acceleratedDeltaValues, double &rangeMinimum, double &rangeMaximum, vector<double> &steppedValues, vector<int> &acceleratedTickValues);
     void SetColor(const vector<string> &params, bool &supportsColor, bool &supportsTrackColor, vector<rgba_color> &colorValues);
     void GetColorValues(vector<rgba_color> &colorValues, const vector<string> &colors);
 public:
     ActionContext(CSurfIntegrator *const csi, Action *action, Widget *widget, Zone *zone, int paramIndex, const vector<string> &params, const string *stringParam);
+    ActionContext(const ActionContext &prototype, Zone *zone) : ActionContext(prototype) { zone_ = zone; } // see ZoneManager::ZoneTemplate
 
     virtual ~ActionContext() {}
     
@@ -677,39 +1272,119 @@ public:
 };
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-class Zone
+class ZoneArena
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 {
-protected:
-    ZoneManager  *const zoneManager_;
-    CSurfIntegrator *const csi_;
-    Navigator *navigator_;
-    int slotIndex_;
-    string const name_;
-    string const alias_;
-    string const sourceFilePath_;
+    // Bump allocator for what a Zone owns -- its ActionContexts, and with them their PropertyLists. Nothing is freed one at a time,
+    // Release() runs the destructors, newest first, and frees the blocks in one go when the Zone is deleted.
+private:
+    enum { BLOCK_SIZE = 16384 };
     
-    bool isActive_= false;
+    struct Destructor
+    {
+        void *object;
+        void (*destroy)(void *object);
+    };
+    
+    vector<char *> blocks_;
+    size_t blockUsed_ = BLOCK_SIZE; // of blocks_.back()
+    size_t bytesUsed_ = 0;
+    size_t bytesReserved_ = 0;
+    vector<Destructor> destructors_;
+    
+    void *Allocate(size_t size, size_t alignment);
+    
+public:
+    ZoneArena() {}
+    ZoneArena(const ZoneArena &) = delete;
+    ZoneArena &operator=(const ZoneArena &) = delete;
+    ~ZoneArena() { Release(); }
+    
+    template <typename T, typename... Args> T *New(Args &&... args)
+    {
+        T *object = new (Allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        destructors_.push_back({ object, [](void *p) { ((T *)p)->~T(); } });
+        return object;
+    }
+    
+    void Release();
+    
+    int GetNumObjects() { return (int)destructors_.size(); }
+    size_t GetBytesUsed() { return bytesUsed_; }
+    size_t GetBytesReserved() { return bytesReserved_; }
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+struct ZoneMemoryUsage
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+{
+    int numZones = 0;
+    int numActionContexts = 0;
+    size_t arenaBytesUsed = 0;
+    size_t arenaBytesReserved = 0;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+class Zone
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+{
+protected:
+    ZoneManager  *const zoneManager_;
+    CSurfIntegrator *const csi_;
+    Navigator *navigator_;
+    int slotIndex_;
+    string const name_;
+    string const alias_;
+    string const sourceFilePath_;
+    
+    bool isActive_= false;
     
     // these do not own the widgets, ultimately the ControlSurface contains the list of widgets
     vector<Widget *> widgets_;
       
     vector<ActionContext *> emptyContexts_;
-    map<Widget *, int> currentActionContextModifiers_;
     map<Widget *, map<int, vector<ActionContext*> > > actionContextDictionary_;
+    
+    // Resolved from actionContextDictionary_ for the current modifier, indexed by Widget::GetIndex().
+    // contexts[] is indexed by the channel touched (1) and toggled (2) bits, with the modifier + 1/2/3 fallbacks already applied.
+    struct CurrentActionContexts
+    {
+        bool isResolved = false;
+        int modifier = 0;
+        const vector<ActionContext *> *contexts[4] = { NULL, NULL, NULL, NULL };
+    };
+    vector<CurrentActionContexts> currentActionContexts_;
 
-    vector<Zone *> includedZones_;
+    vector<Zone *> includedZones_; // owned
 
-    vector<Zone *> subZones_;
+    vector<Zone *> subZones_; // owned
+    
+    ZoneArena arena_; // the ActionContexts in actionContextDictionary_
+    
+    ProfileHistogram *requestUpdateHistogram_ = NULL; // see CSIProfiler
 
+    static int numLiveZones_; // in the process, see ReportMemoryUsage
+    
     void UpdateCurrentActionContextModifier(Widget *widget);
     
 public:
-    Zone(CSurfIntegrator *const csi, ZoneManager  *const zoneManager, Navigator *navigator, int slotIndex, const string &name, const string &alias, const string &sourceFilePath): csi_(csi), zoneManager_(zoneManager), navigator_(navigator), slotIndex_(slotIndex), name_(name), alias_(alias), sourceFilePath_(sourceFilePath) {}
+    Zone(CSurfIntegrator *const csi, ZoneManager  *const zoneManager, Navigator *navigator, int slotIndex, const string &name, const string &alias, const string &sourceFilePath): csi_(csi), zoneManager_(zoneManager), navigator_(navigator), slotIndex_(slotIndex), name_(name), alias_(alias), sourceFilePath_(sourceFilePath)
+    {
+        numLiveZones_++;
+    }
 
     virtual ~Zone()
     {
+        numLiveZones_--;
+        
+        for (auto includedZone : includedZones_)
+            delete includedZone;
+        
         includedZones_.clear();
+        
+        for (auto subZone : subZones_)
+            delete subZone;
+        
         subZones_.clear();
     }
     
@@ -724,10 +1399,12 @@ public:
     void AddWidget(Widget *widget);
     void Activate();
     void Deactivate();
-    void DoAction(Widget *widget, bool &isUsed, double value);
-    void DoRelativeAction(Widget *widget, bool &isUsed, double delta);
-    void DoRelativeAction(Widget *widget, bool &isUsed, int accelerationIndex, double delta);
-    void DoTouch(Widget *widget, const char *widgetName, bool &isUsed, double value);
+    Zone *GetOwningZone(Widget *widget);
+    void DoAction(Widget *widget, double value);
+    void DoRelativeAction(Widget *widget, double delta);
+    void DoRelativeAction(Widget *widget, int accelerationIndex, double delta);
+    void DoTouch(Widget *widget, double value);
+    void OnTrackDeselection();
     void RequestUpdate();
     const vector<Widget *> &GetWidgets() { return widgets_; }
 
@@ -760,10 +1437,13 @@ public:
             return name_.c_str();
     }
             
-    void AddActionContext(Widget *widget, int modifier, ActionContext *actionContext)
-    {
-        actionContextDictionary_[widget][modifier].push_back(actionContext);
-    }
+    ZoneArena &GetArena() { return arena_; }
+    void AddMemoryUsage(ZoneMemoryUsage &usage);
+    void AddZones(vector<Zone *> &zones); // this one, its included zones and subzones
+    
+    static int GetNumLiveZones() { return numLiveZones_; }
+    
+    void AddActionContext(Widget *widget, int modifier, ActionContext *actionContext); // actionContext must come from GetArena()
     
     const vector<ActionContext *> &GetActionContexts(Widget *widget, int modifier)
     {
@@ -773,14 +1453,6 @@ public:
             return emptyContexts_;
     }
     
-    void OnTrackDeselection()
-    {
-        isActive_ = true;
-        
-        for (int i = 0; i < includedZones_.size(); ++i)
-            includedZones_[i]->Activate();
-    }
-
     void RequestUpdateWidget(Widget *widget)
     {
         for (auto actionContext : GetActionContexts(widget))
@@ -832,6 +1504,7 @@ protected:
     ControlSurface *const surface_;
     string const name_;
     vector<FeedbackProcessor *> feedbackProcessors_; // owns the objects
+    int const index_; // dense index of this Widget within its ControlSurface
     int channelNumber_ = 0;
     int lastIncomingMessageTime_ = GetTickCount() - 30000;
     double lastIncomingDelta_ = 0.0;
@@ -843,9 +1516,23 @@ protected:
     
     bool isTwoState_ = false;
     
+    int feedbackSerial_ = 0; // bumped on every write to the feedback processors
+    int colorSerial_ = 0;    // bumped on every write that can change the color the widget shows
+    bool isRefreshing_ = false; // a context is refreshing its own feedback, see ActionContext::RefreshWidget()
+    
+    void CountWrite(bool canChangeColor)
+    {
+        if (isRefreshing_)
+            return;
+        
+        feedbackSerial_++;
+        if (canChangeColor)
+            colorSerial_++;
+    }
+    
 public:
     // all Widgets are owned by their ControlSurface!
-    Widget(CSurfIntegrator *const csi,  ControlSurface *surface, const char *name) : csi_(csi), surface_(surface), name_(name)
+    Widget(CSurfIntegrator *const csi,  ControlSurface *surface, const char *name, int widgetIndex) : csi_(csi), surface_(surface), name_(name), index_(widgetIndex)
     {
         int index = (int)strlen(name) - 1;
         if (isdigit(name[index]))
@@ -859,16 +1546,18 @@ public:
         }
     }
     
-    ~Widget()
-    {
-      feedbackProcessors_.clear();
-    }
+    ~Widget();
     
     void ClearHasBeenUsedByUpdate() { hasBeenUsedByUpdate_ = false; }
     void SetHasBeenUsedByUpdate() { hasBeenUsedByUpdate_ = true; }
     bool GetHasBeenUsedByUpdate() { return hasBeenUsedByUpdate_; }
     
+    int GetFeedbackSerial() { return feedbackSerial_; }
+    int GetColorSerial() { return colorSerial_; }
+    void SetIsRefreshing(bool isRefreshing) { isRefreshing_ = isRefreshing; }
+    
     const char *GetName() { return name_.c_str(); }
+    int GetIndex() { return index_; }
     ControlSurface *GetSurface() { return surface_; }
     ZoneManager *GetZoneManager();
     int GetChannelNumber() { return channelNumber_; }
@@ -893,9 +1582,11 @@ public:
     void ForceValue(const PropertyList &properties, const char * const &value);
     void RunDeferredActions();
     void UpdateColorValue(const rgba_color &color);
+    bool GetIsMotorized();
     void SetXTouchDisplayColors(const char *colors);
     void RestoreXTouchDisplayColors();
     void ForceClear();
+    void ResetFeedbackDedup();
     void LogInput(double value);
     
     void AddFeedbackProcessor(FeedbackProcessor *feedbackProcessor) // takes ownership of feedbackProcessor
@@ -909,7 +1600,9 @@ public:
 // For Zone Manager
 ////////////////////////////
 
+void GetPropertyFromToken(const char *token, PropertyList &properties);
 void GetPropertiesFromTokens(int start, int finish, const vector<string> &tokens, PropertyList &properties);
+void GetPropertiesFromTokens(int start, int finish, const vector<string_view> &tokens, PropertyList &properties); // NUL terminated views, as LineTokenizer makes
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 struct CSIZoneInfo
@@ -919,6 +1612,108 @@ struct CSIZoneInfo
     string alias;
 };
 
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+class ZoneFileIndex
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+{
+    // The Zone line of every .zon file, per folder, shared by all the ZoneManagers -- MCU + XTs, or the same surface on several pages,
+    // scan a folder once. The headers are read on a few threads, and a rescan after Init() only rereads files whose mtime has changed.
+public:
+    struct ZoneFileHeader
+    {
+        string filePath;
+        string name; // empty if the file doesn't start with a Zone line
+        string alias;
+        filesystem::file_time_type modifiedTime;
+        bool hasError = false;
+    };
+    
+private:
+    struct Folder
+    {
+        vector<ZoneFileHeader> headers; // in directory order
+        bool isCurrent = false;
+    };
+    
+    map<string, Folder> folders_;
+    
+    int numFilesListed_ = 0;
+    int numFilesRead_ = 0;
+    
+    static void ReadHeader(ZoneFileHeader &header);
+    
+public:
+    // zone files (recursively) in folder, scans on the first call after Invalidate()
+    const vector<ZoneFileHeader> &GetHeaders(const string &folder);
+    
+    // rescan on next use, e.g. the user has edited zone files and reloaded
+    void Invalidate()
+    {
+        for (auto &folder : folders_)
+            folder.second.isCurrent = false;
+        
+        numFilesListed_ = 0;
+        numFilesRead_ = 0;
+    }
+    
+    int GetNumFilesListed() { return numFilesListed_; } // since Invalidate()
+    int GetNumFilesRead() { return numFilesRead_; }
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+struct TokenizedLine
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+{
+    int lineNumber;
+    string line;              // after TrimLine()
+    vector<string> tokens;    // of line
+    vector<string> rawTokens; // of the untrimmed line, only when TrimLine() dropped something -- OSC addresses start with '/'
+    
+    const vector<string> &GetRawTokens() const { return rawTokens.size() > 0 ? rawTokens : tokens; }
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+struct TokenizedFile
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+{
+    long long size = -1;
+    long long modifiedTime = 0;
+    WDL_UINT64 contentHash = 0;
+    vector<TokenizedLine> lines; // blank and comment lines left out
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+class TokenizedFileCache
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+{
+    // Surface templates and zone files, trimmed and tokenized. Kept in memory for the next Init(), and written to CSI/Cache
+    // so a cold start skips the text parse as well. An entry is used only if the source's size and mtime match, or,
+    // failing the mtime, its content hash does -- anything else, including a damaged cache file, falls back to parsing the source.
+private:
+    map<string, TokenizedFile> files_;
+    string cacheFolder_;
+    
+    int numParsed_ = 0;
+    int numLoaded_ = 0;
+    int numReused_ = 0;
+    
+    string GetCacheFilePath(const string &filePath);
+    static bool ReadSource(const string &filePath, string &contents);
+    static void Tokenize(const string &contents, TokenizedFile &file);
+    bool ReadCacheFile(const string &filePath, TokenizedFile &file);
+    void WriteCacheFile(const string &filePath, const TokenizedFile &file);
+    
+public:
+    void SetCacheFolder(const string &cacheFolder) { cacheFolder_ = cacheFolder; }
+    
+    const TokenizedFile &GetFile(const string &filePath);
+    
+    void ResetCounts() { numParsed_ = numLoaded_ = numReused_ = 0; }
+    int GetNumParsed() { return numParsed_; }
+    int GetNumLoaded() { return numLoaded_; } // from CSI/Cache
+    int GetNumReused() { return numReused_; } // still in memory
+};
+
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 class ZoneManager
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -943,7 +1738,7 @@ private:
 
     vector<ZoneManager *> listeners_;
     
-    vector<Zone *> zonesToBeDeleted_;
+    vector<Zone *> zonesToBeDeleted_; // retired, see DeleteRetiredZones()
     
     bool listensToGoHome_ = false;
     bool listensToSends_ = false;
@@ -968,10 +1763,66 @@ private:
     int selectedTrackReceiveOffset_ = 0;
     int selectedTrackFXMenuOffset_ = 0;
     int masterTrackFXMenuOffset_ = 0;
+    
+    // The zone that wins an input for each widget, indexed by Widget::GetIndex().
+    // Resolved on first use and thrown away whenever zone activation, zone membership or the modifiers change.
+    struct WidgetOwner
+    {
+        int generation = -1;
+        Zone *zone = NULL;      // DoAction, DoRelativeAction
+        Zone *touchZone = NULL; // DoTouch doesn't route to the Learn zone
+    };
+    
+    vector<WidgetOwner> widgetOwners_;
+    int widgetOwnersGeneration_ = 0;
+    
+    const WidgetOwner &GetWidgetOwner(Widget *widget);
+    
+    // A zone file as parsed for this surface and widget suffix -- widgets looked up, modifiers decoded and one prototype ActionContext per binding.
+    // Loading the zone again, e.g. on every FX focus change, only clones the prototypes. Rebuilt when the file's size or mtime changes.
+    struct ZoneTemplate
+    {
+        struct Step
+        {
+            enum Type { Binding, SubZones, IncludedZones } type = Binding;
+            int lineNumber = 0;
+            Widget *widget = NULL;
+            int modifier = 0;
+            ActionContext *prototype = NULL; // NULL for legacy NullDisplay lines
+            vector<string> zoneNames;        // SubZones, IncludedZones
+        };
+        
+        long long size = -1;
+        long long modifiedTime = 0;
+        vector<Step> steps; // in file order
+        
+        ~ZoneTemplate()
+        {
+            for (auto &step : steps)
+                delete step.prototype;
+        }
+    };
+    
+    map<string, ZoneTemplate *> zoneTemplates_; // by file path and widget suffix, owns the templates
+    
+    ProfileHistogram *fxZoneActivationHistogram_ = NULL; // see CSIProfiler
+    
+    ZoneTemplate *GetZoneTemplate(const char *filePath, const char *widgetSuffix);
+    
+    // the Zone may be running the action that retired it, so it lives until the end of the tick
+    void RetireZone(Zone *zone)
+    {
+        if (find(zonesToBeDeleted_.begin(), zonesToBeDeleted_.end(), zone) == zonesToBeDeleted_.end())
+            zonesToBeDeleted_.push_back(zone);
+        
+        InvalidateWidgetOwners();
+    }
+    
+    Zone *ActivateFXZone(Navigator *navigator, int fxSlot, const char *fxName); // fxName must be in zoneInfo_
 
     void GoFXSlot(MediaTrack *track, Navigator *navigator, int fxSlot);
     void GoSelectedTrackFX();
-    void GetWidgetNameAndModifiers(const string &line, string &baseWidgetName, int &modifier, bool &isValueInverted, bool &isFeedbackInverted, double &holdDelayAmount,
+    void GetWidgetNameAndModifiers(string_view line, string &baseWidgetName, int &modifier, bool &isValueInverted, bool &isFeedbackInverted, double &holdDelayAmount,
                                    bool &isDecrease, bool &isIncrease);
     void GetNavigatorsForZone(const char *zoneName, const char *navigatorName, vector<Navigator *> &navigators);
     void LoadZones(vector<Zone *> &zones, vector<string> &zoneList);
@@ -981,39 +1832,7 @@ private:
     void DoRelativeAction(Widget *widget, int accelerationIndex, double delta, bool &isUsed);
     void DoTouch(Widget *widget, double value, bool &isUsed);
     
-    void LoadZoneMetadata(const char *filePath, vector<string> &metadata)
-    {
-        int lineNumber = 0;
-        
-        try
-        {
-            ifstream file(filePath);
-            
-            for (string line; getline(file, line) ; )
-            {
-                TrimLine(line);
-                
-                lineNumber++;
-                
-                if (line == "" || (line.size() > 0 && line[0] == '/')) // ignore blank lines and comment lines
-                    continue;
-                
-                vector<string> tokens;
-                GetTokens(tokens, line);
-                
-                if (tokens[0] == "Zone" || tokens[0] == "ZoneEnd")
-                    continue;
-                
-                metadata.push_back(line);
-            }
-        }
-        catch (exception)
-        {
-            char buffer[250];
-            snprintf(buffer, sizeof(buffer), "Trouble in %s, around line %d\n", filePath, lineNumber);
-            ShowConsoleMsg(buffer);
-        }
-    }
+    void LoadZoneMetadata(const char *filePath, vector<string> &metadata);
     
     void AdjustBank(int &bankOffset, int amount)
     {
@@ -1100,6 +1919,7 @@ private:
     void ToggleEnableLastTouchedFXParamMapping()
     {
         isLastTouchedFXParamMappingEnabled_ = ! isLastTouchedFXParamMappingEnabled_;
+        InvalidateWidgetOwners();
         
         if (lastTouchedFXParamZone_ != NULL)
         {
@@ -1131,7 +1951,7 @@ private:
         if (focusedFXZone_ != NULL)
         {
             focusedFXZone_->Deactivate();
-            zonesToBeDeleted_.push_back(focusedFXZone_);
+            RetireZone(focusedFXZone_);
             focusedFXZone_ = NULL;
         }
     }
@@ -1141,8 +1961,11 @@ private:
         for (auto selectedTrackFXZone : selectedTrackFXZones_)
         {
             selectedTrackFXZone->Deactivate();
-            zonesToBeDeleted_.push_back(selectedTrackFXZone);
+            RetireZone(selectedTrackFXZone);
         }
+        
+        selectedTrackFXZones_.clear();
+        InvalidateWidgetOwners();
     }
     
     void ClearFXSlot()
@@ -1150,7 +1973,7 @@ private:
         if (fxSlotZone_ != NULL)
         {
             fxSlotZone_->Deactivate();
-            zonesToBeDeleted_.push_back(fxSlotZone_);
+            RetireZone(fxSlotZone_);
             fxSlotZone_ = NULL;
             ReactivateFXMenuZone();
         }
@@ -1199,11 +2022,24 @@ public:
             learnFocusedFXZone_ = NULL;
         }
             
+        for (auto goZone : goZones_)
+            delete goZone;
+        
         goZones_.clear();
 
+        for (auto selectedTrackFXZone : selectedTrackFXZones_)
+            delete selectedTrackFXZone;
+        
         selectedTrackFXZones_.clear();
         
+        DeleteRetiredZones();
+        
         zoneInfo_.clear();
+        
+        for (auto &zoneTemplate : zoneTemplates_)
+            delete zoneTemplate.second;
+        
+        zoneTemplates_.clear();
     }
     
     void Initialize();
@@ -1225,11 +2061,11 @@ public:
     int  GetNumChannels();
     
     void PreProcessZones();
-    void PreProcessZoneFile(const string &filePath);
     void LoadZoneFile(Zone *zone, const char *widgetSuffix);
     void LoadZoneFile(Zone *zone, const char *filePath, const char *widgetSuffix);
 
     void UpdateCurrentActionContextModifiers();
+    void InvalidateWidgetOwners() { widgetOwnersGeneration_++; }
     void CheckFocusedFXState();
 
     void DoAction(Widget *widget, double value);
@@ -1319,20 +2155,17 @@ public:
         if (learnFocusedFXZone_ != NULL)
         {
             learnFocusedFXZone_->Deactivate();
-            zonesToBeDeleted_.push_back(learnFocusedFXZone_);
+            RetireZone(learnFocusedFXZone_);
             learnFocusedFXZone_ = NULL;
         }
     }
     
     void LoadLearnFocusedFXZone(MediaTrack *track, const char *fxName, int fxIndex)
     {
+        ClearLearnFocusedFXZone();
+        
         if (zoneInfo_.find(fxName) != zoneInfo_.end())
-        {
-            learnFocusedFXZone_ = new Zone(csi_, this, GetNavigatorForTrack(track), fxIndex, fxName, zoneInfo_[fxName].alias, zoneInfo_[fxName].filePath);
-            LoadZoneFile(learnFocusedFXZone_, "");
-            
-            learnFocusedFXZone_->Activate();
-        }
+            learnFocusedFXZone_ = ActivateFXZone(GetNavigatorForTrack(track), fxIndex, fxName);
         else
         {
             char alias[BUFSIZ];
@@ -1496,7 +2329,11 @@ public:
     {
         ResetSelectedTrackOffsets();
         
+        for (auto selectedTrackFXZone : selectedTrackFXZones_)
+            RetireZone(selectedTrackFXZone);
+        
         selectedTrackFXZones_.clear();
+        InvalidateWidgetOwners();
         
         for (int i = 0; i < goZones_.size(); ++i)
         {
@@ -1524,6 +2361,7 @@ public:
     void DisableLastTouchedFXParamMapping()
     {
         isLastTouchedFXParamMappingEnabled_ = false;
+        InvalidateWidgetOwners();
     }
     
     void DeclareToggleEnableFocusedFXMapping()
@@ -1623,9 +2461,13 @@ public:
 
         if (homeZone_ != NULL)
             homeZone_->RequestUpdate();
-        
-        zonesToBeDeleted_.clear();
     }
+    
+    void DeleteRetiredZones();
+    void GetZones(vector<Zone *> &zones); // every zone the manager holds, retired ones too until they are deleted
+    void GetWidgetOwnerZones(vector<Zone *> &zones); // the zones cached in widgetOwners_, whatever their generation
+    void GetMemoryUsage(ZoneMemoryUsage &usage);
+    int GetNumZoneTemplates() { return (int)zoneTemplates_.size(); }
 };
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -1707,18 +2549,18 @@ private:
       return 4 << (int) m;
     }
     
-    static Modifiers modifierFromString(const char *s)
+    static Modifiers modifierFromString(string_view s)
     {
-         if (!strcmp(s,"Shift")) return Shift;
-         if (!strcmp(s,"Option")) return Option;
-         if (!strcmp(s,"Control")) return Control;
-         if (!strcmp(s,"Alt")) return Alt;
-         if (!strcmp(s,"Flip")) return Flip;
-         if (!strcmp(s,"Global")) return Global;
-         if (!strcmp(s,"Marker")) return Marker;
-         if (!strcmp(s,"Nudge")) return Nudge;
-         if (!strcmp(s,"Zoom")) return Zoom;
-         if (!strcmp(s,"Scrub")) return Scrub;
+         if (s == "Shift") return Shift;
+         if (s == "Option") return Option;
+         if (s == "Control") return Control;
+         if (s == "Alt") return Alt;
+         if (s == "Flip") return Flip;
+         if (s == "Global") return Global;
+         if (s == "Marker") return Marker;
+         if (s == "Nudge") return Nudge;
+         if (s == "Zoom") return Zoom;
+         if (s == "Scrub") return Scrub;
          return ErrorModifier;
     }
 
@@ -1817,21 +2659,23 @@ public:
         return buf;
     }
 
-    int GetModifierValue(const char *modifierString)
-    {
-        vector<string> modifierTokens;
-        GetTokens(modifierTokens, modifierString, '+');
-        return GetModifierValue(modifierTokens);
-    }
-    
-    int GetModifierValue(const vector<string> &tokens)
+    // "Shift+Control" style, walked in place rather than split into tokens
+    int GetModifierValue(string_view modifierString)
     {
         int modifierValue = 0;
-        for (int i = 0; i < tokens.size(); ++i)
+        
+        while (modifierString.size() > 0)
         {
-            Modifiers m = modifierFromString(tokens[i].c_str());
+            size_t plus = modifierString.find('+');
+            
+            Modifiers m = modifierFromString(modifierString.substr(0, plus));
             if (m != ErrorModifier)
                 modifierValue |= maskFromModifier(m);
+            
+            if (plus == string_view::npos)
+                break;
+            
+            modifierString.remove_prefix(plus + 1);
         }
         
         return modifierValue;
@@ -1968,6 +2812,113 @@ struct ChannelToggle
     ChannelToggle() {}
 };
 
+static WDL_UINT64 GetTextHash64(const char *text) // FNV-1a, 64 bit
+{
+    WDL_UINT64 hash = WDL_FNV64_IV;
+    while (*text)
+    {
+        hash ^= (unsigned char)*text++;
+        hash *= WDL_UINT64_CONST(0x00000100000001B3);
+    }
+    return hash;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+class RestrictedTextCache
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+{
+    // the same few track, FX and param names get abbreviated every tick, so remember the last few hundred.
+    // A fixed table: a text can sit in any of MAX_PROBES slots from its hash, and takes one of them over when they are all in use.
+private:
+    enum { NUM_SLOTS = 256, MAX_PROBES = 4, MAX_TEXT = 64, MAX_RESTRICTED_TEXT = 32 };
+    
+    struct Entry
+    {
+        WDL_UINT64 hash;
+        int length; // -1 for an empty slot
+        char text[MAX_TEXT];
+        char restrictedText[MAX_RESTRICTED_TEXT];
+    };
+    
+    vector<Entry> entries_; // NUM_SLOTS, allocated on first use
+    unsigned int numReplaced_ = 0;
+    
+    static void Abbreviate(const char *textc, int length, char *buf, int bufsz)
+    {
+        static const char * const filter_lists[3] = {
+          " \t\r\n",
+          " \t\r\n`~!@#$%^&*:()_|=?;:'\",",
+          " \t\r\n`~!@#$%^&*:()_|=?;:'\",aeiou"
+        };
+
+        for (int pass = 0; pass < 3; ++pass)
+        {
+            const char *rd = textc;
+            int l = 0;
+            while (*rd && l < bufsz-1 && l <= length)
+            {
+                 if (!l || !strchr(filter_lists[pass], *rd))
+                     buf[l++] = *rd;
+                 rd++;
+            }
+            if (pass < 2 && l > length) continue; // keep filtering
+
+            buf[wdl_min(length, l)] = 0;
+            return;
+        }
+    }
+    
+public:
+    // abbreviates textc to at most length characters, into buf, and returns buf
+    const char *Get(const char *textc, int length, char *buf, int bufsz)
+    {
+        int textLength = (int)strlen(textc);
+        
+        if (textLength >= MAX_TEXT || length + 2 > MAX_RESTRICTED_TEXT) // too long to keep, Abbreviate() looks at up to length + 1 characters
+        {
+            char restrictedText[MEDBUF];
+            Abbreviate(textc, length, restrictedText, sizeof(restrictedText));
+            lstrcpyn_safe(buf, restrictedText, bufsz);
+            return buf;
+        }
+        
+        if (entries_.empty())
+        {
+            entries_.resize(NUM_SLOTS);
+            for (auto &entry : entries_)
+                entry.length = -1;
+        }
+        
+        WDL_UINT64 hash = GetTextHash64(textc);
+        int first = (int)(((hash + length) * WDL_UINT64_CONST(0x9E3779B97F4A7C15)) >> 56); // NUM_SLOTS is 1 << 8
+        Entry *freeEntry = NULL;
+        
+        for (int probe = 0; probe < MAX_PROBES; ++probe)
+        {
+            Entry &entry = entries_[(first + probe) & (NUM_SLOTS - 1)];
+            
+            if (entry.length == length && entry.hash == hash && ! strcmp(entry.text, textc))
+            {
+                lstrcpyn_safe(buf, entry.restrictedText, bufsz);
+                return buf;
+            }
+            
+            if (entry.length < 0 && freeEntry == NULL)
+                freeEntry = &entry;
+        }
+        
+        Entry &entry = freeEntry ? *freeEntry : entries_[(first + numReplaced_++ % MAX_PROBES) & (NUM_SLOTS - 1)];
+        
+        entry.hash = hash;
+        entry.length = length;
+        memcpy(entry.text, textc, textLength + 1);
+        Abbreviate(textc, length, entry.restrictedText, sizeof(entry.restrictedText));
+        
+        lstrcpyn_safe(buf, entry.restrictedText, bufsz);
+        return buf;
+    }
+};
+
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 class ControlSurface
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -1981,6 +2932,7 @@ private:
     
     bool isTextLengthRestricted_ = false;
     int restrictedTextLength_ = 6;
+    RestrictedTextCache restrictedTextCache_;
     
     bool usesLocalModifiers_ = false;
     bool listensToModifiers_ = false;
@@ -1988,9 +2940,38 @@ private:
     int latchTime_ = 100;
         
     vector<FeedbackProcessor *> trackColorFeedbackProcessors_; // does not own pointers
+    vector<rgba_color> lastChannelColors_; // what trackColorFeedbackProcessors_ were last told, see UpdateTrackColors()
     
     vector<ChannelTouch> channelTouches_;
     vector<ChannelToggle> channelToggles_;
+    
+    // see CSIProfiler
+    ProfileHistogram *handleExternalInputHistogram_ = NULL;
+    ProfileHistogram *requestUpdateHistogram_ = NULL;
+    ProfileHistogram *tickHistogram_ = NULL;
+    ProfileHistogram *actionUpdatesHistogram_ = NULL;
+    ProfileHistogram *messagesHistogram_ = NULL;
+    ProfileHistogram *suppressedMessagesHistogram_ = NULL;
+    ProfileHistogram *deferredUpdatesHistogram_ = NULL;
+    long long profiledInputTime_ = 0;
+    int profiledActionUpdates_ = 0;
+    int profiledDeferredUpdates_ = 0;
+    
+    // FeedbackBudget -- with a budget the Zones queue their Widgets here instead of updating them straight away, see RunWidgetUpdates()
+    int feedbackBudget_ = 0; // microseconds per tick, 0 = update every Widget every tick
+    
+    struct WidgetUpdate
+    {
+        Zone *zone;
+        Widget *widget;
+    };
+    
+    vector<WidgetUpdate> priorityUpdates_;
+    vector<WidgetUpdate> deferrableUpdates_;
+    int nextDeferrableUpdate_ = 0; // round-robin position in deferrableUpdates_
+    
+    bool GetIsPriorityUpdate(Widget *widget);
+    void RunWidgetUpdates();
 
 protected:
     map<const string, double> stepSize_;
@@ -2019,6 +3000,9 @@ protected:
     map<const string, CSIMessageGenerator*> CSIMessageGeneratorsByMessage_;
 
     bool speedX5_ = false;
+    
+    int profiledMessages_ = 0; // outgoing MIDI / OSC messages since the last profiled tick
+    int profiledSuppressedMessages_ = 0; // dropped because the device already shows them, see MidiOutputShadow
 
     ControlSurface(CSurfIntegrator *const csi, Page *page, const string &name, int numChannels, int channelOffset) : csi_(csi), page_(page), name_(name), numChannels_(numChannels), channelOffset_(channelOffset), modifierManager_(new ModifierManager(csi_, NULL, this))
     {
@@ -2132,6 +3116,10 @@ public:
     virtual void RequestUpdate();
     void ForceClearTrack(int trackNum);
     void ForceUpdateTrackColors();
+    void UpdateTrackColors();
+    void RequestWidgetUpdate(Zone *zone, Widget *widget);
+    int GetFeedbackBudget() { return feedbackBudget_; }
+    void SetFeedbackBudget(int feedbackBudget) { feedbackBudget_ = feedbackBudget < 0 ? 0 : feedbackBudget; }
     void OnTrackSelection(MediaTrack *track);
     virtual void SendOSCMessage(const char *zoneName) {}
     virtual void SendOSCMessage(const char *zoneName, int value) {}
@@ -2139,6 +3127,18 @@ public:
     virtual void SendOSCMessage(const char *zoneName, const char *value) {}
 
     virtual void HandleExternalInput() {}
+    void ProfileHandleExternalInput(); // HandleExternalInput() / RequestUpdate(), timed when profiling is on
+    void ProfileRequestUpdate();
+    void CountProfiledActionUpdate() { profiledActionUpdates_++; }
+    
+    // the counters run whether or not profiling is on, so start from zero when it is switched on
+    void ResetProfiledCounts()
+    {
+        profiledActionUpdates_ = 0;
+        profiledMessages_ = 0;
+        profiledSuppressedMessages_ = 0;
+        profiledDeferredUpdates_ = 0;
+    }
     virtual void UpdateTimeDisplay() {}
     virtual void FlushIO() {}
     
@@ -2203,40 +3203,31 @@ public:
            return emptyAccelerationMap_;
     }
     
+    // channelTouches_ and channelToggles_ hold channels 1..numChannels in order
     void TouchChannel(int channelNum, bool isTouched)
     {
-        for (auto &channelTouch : channelTouches_)
-            if (channelTouch.channelNum == channelNum)
-            {
-                channelTouch.isTouched = isTouched;
-                break;
-            }
+        if (channelNum > 0 && channelNum <= channelTouches_.size())
+            channelTouches_[channelNum - 1].isTouched = isTouched;
     }
     
     bool GetIsChannelTouched(int channelNum)
     {
-        for (auto &channelTouch : channelTouches_)
-            if (channelTouch.channelNum == channelNum)
-                return channelTouch.isTouched;
+        if (channelNum > 0 && channelNum <= channelTouches_.size())
+            return channelTouches_[channelNum - 1].isTouched;
 
         return false;
     }
        
     void ToggleChannel(int channelNum)
     {
-        for (auto &channelToggle : channelToggles_)
-            if (channelToggle.channelNum == channelNum)
-            {
-                channelToggle.isToggled = ! channelToggle.isToggled;
-                break;
-            }
+        if (channelNum > 0 && channelNum <= channelToggles_.size())
+            channelToggles_[channelNum - 1].isToggled = ! channelToggles_[channelNum - 1].isToggled;
     }
     
     bool GetIsChannelToggled(int channelNum)
     {
-        for (auto &channelToggle : channelToggles_)
-            if (channelToggle.channelNum == channelNum)
-                return channelToggle.isToggled;
+        if (channelNum > 0 && channelNum <= channelToggles_.size())
+            return channelToggles_[channelNum - 1].isToggled;
 
         return false;
     }
@@ -2250,31 +3241,8 @@ public:
     const char *GetRestrictedLengthText(const char *textc, char *buf, int bufsz) // may return textc if not restricted
     {
         if (isTextLengthRestricted_ && strlen(textc) > restrictedTextLength_ && restrictedTextLength_ >= 0)
-        {
-            static const char * const filter_lists[3] = {
-              " \t\r\n",
-              " \t\r\n`~!@#$%^&*:()_|=?;:'\",",
-              " \t\r\n`~!@#$%^&*:()_|=?;:'\",aeiou"
-            };
-
-            for (int pass = 0; pass < 3; ++pass)
-            {
-                const char *rd = textc;
-                int l = 0;
-                while (*rd && l < bufsz-1 && l <= restrictedTextLength_)
-                {
-                     if (!l || !strchr(filter_lists[pass], *rd))
-                         buf[l++] = *rd;
-                     rd++;
-                }
-                if (pass < 2 && l > restrictedTextLength_) continue; // keep filtering
-
-                buf[wdl_min(restrictedTextLength_, l)] = 0;
-                return buf;
-            }
-        }
+            return restrictedTextCache_.Get(textc, restrictedTextLength_, buf, bufsz);
         return textc;
-
     }
            
     void AddTrackColorFeedbackProcessor(FeedbackProcessor *feedbackProcessor) // does not own this pointer
@@ -2290,6 +3258,18 @@ public:
         
         FlushIO();
     }
+    
+    // device reconnect or project switch -- forget what the device is assumed to show and send everything again
+    virtual void ForceResync()
+    {
+        for (auto widget : widgets_)
+        {
+            widget->ForceClear();
+            widget->ResetFeedbackDedup();
+        }
+        
+        lastChannelColors_.clear();
+    }
            
     void TrackFXListChanged(MediaTrack *track)
     {
@@ -2360,7 +3340,7 @@ public:
     {
         if (widgetsByName_.count(string(widgetName)) == 0)
         {
-            widgetsByName_.insert(std::make_pair(widgetName, std::make_unique<Widget>(csi_, surface, widgetName)));
+            widgetsByName_.insert(std::make_pair(widgetName, std::make_unique<Widget>(csi_, surface, widgetName, (int)widgets_.size())));
             
             if (widgetsByName_.count(widgetName) > 0)
                 widgets_.push_back(GetWidgetByName(widgetName));
@@ -2375,7 +3355,7 @@ public:
             return NULL;
     }
     
-    void AddCSIMessageGenerator(const string &message, CSIMessageGenerator *messageGenerator)
+    virtual void AddCSIMessageGenerator(const string &message, CSIMessageGenerator *messageGenerator)
     {
         if (messageGenerator != NULL)
             CSIMessageGeneratorsByMessage_[message] = messageGenerator;
@@ -2401,6 +3381,46 @@ public:
     }
 };
 
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+class FeedbackText
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+{
+    // the text a feedback processor last sent -- inline so updates never allocate, and compared by hash first
+private:
+    WDL_UINT64 hash_;
+    bool isStale_; // the device may no longer show text_, so nothing matches until the next Set()
+    bool isTruncated_;
+    char text_[128]; // truncated if longer, the hash still covers all of it
+    
+public:
+    FeedbackText() { Set(""); }
+    
+    bool Matches(const char *text, WDL_UINT64 hash) const
+    {
+        if (isStale_ || hash_ != hash)
+            return false;
+        
+        return isTruncated_ || ! strcmp(text_, text); // longer texts go by the hash alone
+    }
+    
+    bool Matches(const char *text) const { return Matches(text, GetTextHash64(text)); }
+    
+    void Set(const char *text, WDL_UINT64 hash)
+    {
+        hash_ = hash;
+        isStale_ = false;
+        isTruncated_ = strlen(text) >= sizeof(text_);
+        lstrcpyn_safe(text_, text, sizeof(text_));
+    }
+    
+    void Invalidate() { isStale_ = true; }
+    
+    void Set(const char *text) { Set(text, GetTextHash64(text)); }
+    
+    const char *Get() const { return text_; }
+    bool IsEmpty() const { return text_[0] == 0; }
+};
+
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 class FeedbackProcessor
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -2410,7 +3430,7 @@ protected:
     Widget  *const widget_;
 
     double lastDoubleValue_ = 0.0;
-    string lastStringValue_;
+    FeedbackText lastStringValue_;
     rgba_color lastColor_;
     
 public:
@@ -2425,9 +3445,19 @@ public:
     virtual void ForceUpdateTrackColors() {}
     virtual void RunDeferredActions() {}
     virtual void ForceClear() {}
+    virtual bool GetIsMotorized() { return false; }
+    
+    // after a resync the device shows whatever ForceClear() sent, so the next SetValue()/SetColorValue() must go out even if unchanged
+    virtual void ResetDedup()
+    {
+        lastDoubleValue_ = NAN; // compares unequal to every value
+        lastStringValue_.Invalidate();
+        lastColor_.r = -1;      // no real color
+    }
     
     virtual void SetXTouchDisplayColors(const char *colors) {}
     virtual void RestoreXTouchDisplayColors() {}
+    virtual bool GetIsTrackColorsUpdatePrevented() { return false; } // SetXTouchDisplayColors() is in effect
 
     virtual void SetColorValue(const rgba_color &color) {}
 
@@ -2442,9 +3472,11 @@ public:
     
     virtual void SetValue(const PropertyList &properties, const char * const & value)
     {
-        if (lastStringValue_ != value)
+        WDL_UINT64 hash = GetTextHash64(value);
+        
+        if ( ! lastStringValue_.Matches(value, hash))
         {
-            lastStringValue_ = value;
+            lastStringValue_.Set(value, hash);
             ForceValue(properties, value);
         }
     }
@@ -2503,6 +3535,487 @@ public:
 void ReleaseMidiInput(midi_Input *input);
 void ReleaseMidiOutput(midi_Output *output);
 
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+class MidiEventRing
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+{
+    // Lock-free single producer / single consumer byte ring of timestamped MIDI messages, used to hand events
+    // between the main thread and a Midi_ControlSurfaceIO thread. Each record is a RecordHeader followed by the message bytes.
+private:
+    struct RecordHeader
+    {
+        long long timestamp; // CSIProfiler::GetMicroseconds() when queued
+        int size;
+    };
+    
+    enum { CAPACITY = 1 << 16 }; // must be a power of two
+    unsigned char buffer_[CAPACITY];
+    std::atomic<unsigned int> writePosition_;
+    std::atomic<unsigned int> readPosition_;
+    
+    void CopyIn(unsigned int position, const void *source, int size)
+    {
+        unsigned int offset = position & (CAPACITY - 1);
+        int firstPart = wdl_min(size, (int)(CAPACITY - offset));
+        memcpy(buffer_ + offset, source, firstPart);
+        memcpy(buffer_, (const unsigned char *)source + firstPart, size - firstPart);
+    }
+    
+    void CopyOut(unsigned int position, void *destination, int size)
+    {
+        unsigned int offset = position & (CAPACITY - 1);
+        int firstPart = wdl_min(size, (int)(CAPACITY - offset));
+        memcpy(destination, buffer_ + offset, firstPart);
+        memcpy((unsigned char *)destination + firstPart, buffer_, size - firstPart);
+    }
+    
+public:
+    enum { MAX_MESSAGE_SIZE = 1024 };
+    
+    MidiEventRing() : writePosition_(0), readPosition_(0) {}
+    
+    // producer side, returns false and drops the message if the ring is full
+    bool Write(const unsigned char *message, int size, long long timestamp)
+    {
+        if (size < 0 || size > MAX_MESSAGE_SIZE)
+            return false;
+        
+        unsigned int writePosition = writePosition_.load(std::memory_order_relaxed);
+        unsigned int needed = sizeof(RecordHeader) + size;
+        
+        if (CAPACITY - (writePosition - readPosition_.load(std::memory_order_acquire)) < needed)
+            return false;
+        
+        RecordHeader header = { timestamp, size };
+        CopyIn(writePosition, &header, sizeof(header));
+        CopyIn(writePosition + sizeof(header), message, size);
+        
+        writePosition_.store(writePosition + needed, std::memory_order_release);
+        return true;
+    }
+    
+    // consumer side, evt must have room for MAX_MESSAGE_SIZE bytes of midi_message
+    bool Read(MIDI_event_ex_t *evt, long long &timestamp)
+    {
+        unsigned int readPosition = readPosition_.load(std::memory_order_relaxed);
+        
+        if (readPosition == writePosition_.load(std::memory_order_acquire))
+            return false;
+        
+        RecordHeader header;
+        CopyOut(readPosition, &header, sizeof(header));
+        CopyOut(readPosition + sizeof(header), evt->midi_message, header.size);
+        
+        evt->frame_offset = 0;
+        evt->size = header.size;
+        timestamp = header.timestamp;
+        
+        readPosition_.store(readPosition + sizeof(header) + header.size, std::memory_order_release);
+        return true;
+    }
+    
+    bool IsEmpty() { return readPosition_.load(std::memory_order_acquire) == writePosition_.load(std::memory_order_acquire); }
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+class MidiOutputShadow
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+{
+    // The last state sent to one output port, shared by every surface and feedback processor on it, so a message that
+    // would not change anything on the device can be dropped. Covers channel voice messages and MCU style display text
+    // (one character per display position), any other sysex always goes out. Invalidate() forgets everything, for a
+    // resync; InvalidateFromInput() forgets one target when the device reports changing it itself (a fader moved by hand).
+private:
+    enum { UNKNOWN = -1 };
+    
+    short noteValues_[16][128];
+    short controllerValues_[16][128];
+    short polyPressureValues_[16][128];
+    short programValues_[16];
+    short channelPressureValues_[16];
+    int pitchBendValues_[16];
+    
+    struct DisplayShadow
+    {
+        unsigned char text[0x80];
+        bool isKnown[0x80];
+    };
+    
+    map<int, DisplayShadow> displays_; // displayType << 8 | displayRow
+    
+    static bool UpdateValue(short &shadowValue, int value)
+    {
+        if (shadowValue == value)
+            return false;
+        shadowValue = (short)value;
+        return true;
+    }
+    
+public:
+    MidiOutputShadow() { Invalidate(); }
+    
+    void Invalidate()
+    {
+        for (int channel = 0; channel < 16; ++channel)
+        {
+            for (int i = 0; i < 128; ++i)
+            {
+                noteValues_[channel][i] = UNKNOWN;
+                controllerValues_[channel][i] = UNKNOWN;
+                polyPressureValues_[channel][i] = UNKNOWN;
+            }
+            
+            programValues_[channel] = UNKNOWN;
+            channelPressureValues_[channel] = UNKNOWN;
+            pitchBendValues_[channel] = UNKNOWN;
+        }
+        
+        displays_.clear();
+    }
+    
+    void InvalidateFromInput(int first, int second)
+    {
+        int channel = first & 0x0F;
+        second &= 0x7F;
+        
+        switch (first & 0xF0)
+        {
+            case 0x80:
+            case 0x90: noteValues_[channel][second] = UNKNOWN; break;
+            case 0xA0: polyPressureValues_[channel][second] = UNKNOWN; break;
+            case 0xB0: controllerValues_[channel][second] = UNKNOWN; break;
+            case 0xC0: programValues_[channel] = UNKNOWN; break;
+            case 0xD0: channelPressureValues_[channel] = UNKNOWN; break;
+            case 0xE0: pitchBendValues_[channel] = UNKNOWN; break;
+        }
+    }
+    
+    // records the message and returns false if the device already shows it
+    bool Update(int first, int second, int third)
+    {
+        int channel = first & 0x0F;
+        second &= 0x7F;
+        third &= 0x7F;
+        
+        switch (first & 0xF0)
+        {
+            case 0x80: return UpdateValue(noteValues_[channel][second], 0); // same LED as a note on with velocity 0
+            case 0x90: return UpdateValue(noteValues_[channel][second], third);
+            case 0xA0: return UpdateValue(polyPressureValues_[channel][second], third);
+            case 0xB0: return UpdateValue(controllerValues_[channel][second], third);
+            case 0xC0: return UpdateValue(programValues_[channel], second);
+            case 0xD0: return UpdateValue(channelPressureValues_[channel], second);
+            case 0xE0:
+            {
+                int value = second | (third << 7);
+                if (pitchBendValues_[channel] == value)
+                    return false;
+                pitchBendValues_[channel] = value;
+                return true;
+            }
+            default: return true;
+        }
+    }
+    
+    bool UpdateSysEx(const unsigned char *message, int size)
+    {
+        // F0 00 00 66 <display type> <row> <position> <characters...> F7
+        if (size < 9 || message[1] != 0x00 || message[2] != 0x00 || message[3] != 0x66 || message[size - 1] != 0xF7)
+            return true;
+        
+        int row = message[5];
+        if (row != 0x12 && (row < 0x30 || row > 0x37)) // LCD rows, 0x30-0x37 are the C4 rows
+            return true;
+        
+        int position = message[6];
+        int length = size - 8;
+        if (position + length > 0x80)
+            return true;
+        
+        DisplayShadow &display = displays_[(message[4] << 8) | row];
+        bool isChanged = false;
+        
+        for (int i = 0; i < length; ++i)
+        {
+            if ( ! display.isKnown[position + i] || display.text[position + i] != message[7 + i])
+            {
+                display.text[position + i] = message[7 + i];
+                display.isKnown[position + i] = true;
+                isChanged = true;
+            }
+        }
+        
+        return isChanged;
+    }
+    
+    // a message recorded by Update() / UpdateSysEx() that never reached the device, its target has to be sent again
+    void Forget(const unsigned char *message, int size)
+    {
+        if (message[0] != 0xF0)
+        {
+            InvalidateFromInput(message[0], message[1]);
+            return;
+        }
+        
+        if (size < 9 || message[1] != 0x00 || message[2] != 0x00 || message[3] != 0x66)
+            return;
+        
+        map<int, DisplayShadow>::iterator it = displays_.find((message[4] << 8) | message[5]);
+        if (it == displays_.end())
+            return;
+        
+        for (int position = message[6]; position < message[6] + size - 8 && position < 0x80; ++position)
+            it->second.isKnown[position] = false;
+    }
+};
+
+MidiOutputShadow *GetMidiOutputShadow(midi_Output *output); // owned by the port, NULL for a port not opened through GetMidiOutputForPort
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+class MidiOutputScheduler
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+{
+    // Byte budgeted MIDI output for slow links (MaxMIDIBytesPerSecond, a 31.25 kbaud DIN port moves ~3125 bytes per second).
+    // Messages wait in priority lanes and each target holds at most one of them -- a newer message for the same
+    // note / controller / display position replaces the queued one and moves to the back of its lane.
+    // SysEx only has a target for the layouts GetKey knows, any other SysEx is sent as queued, none of it replaced.
+public:
+    enum Lane { ControlLane, MeterLane, DisplayLane, NUM_LANES }; // in priority order
+    
+private:
+    struct QueuedRecord // followed by the message bytes in order_
+    {
+        unsigned long long key; // 0 for a message without a known target
+        unsigned int sequence;
+        int size;
+    };
+    
+    struct Slot // the latest queued sequence for a target, key 0 is a free slot
+    {
+        unsigned long long key;
+        unsigned int sequence;
+    };
+    
+    enum { NUM_SLOTS = 1024, MAX_USED_SLOTS = NUM_SLOTS * 3 / 4 }; // past that, messages for new targets go unkeyed
+    
+    WDL_Queue order_[NUM_LANES]; // QueuedRecords in arrival order, superseded ones are skipped when popped
+    Slot slots_[NUM_SLOTS] = {};
+    int numUsedSlots_ = 0;
+    int queueDepth_[NUM_LANES] = {};
+    unsigned int sequence_ = 0;
+    
+    double const bytesPerSecond_;
+    double const maxByteCredit_;
+    double byteCredit_;
+    DWORD lastRefillTime_;
+    int supersededCount_ = 0;
+    
+    static Lane GetLane(const unsigned char *message)
+    {
+        if (message[0] == 0xF0)
+            return DisplayLane;
+        else if ((message[0] & 0xF0) == 0xD0) // channel pressure, MCU style meters
+            return MeterLane;
+        else
+            return ControlLane;
+    }
+    
+    static unsigned long long GetSysExKey(const unsigned char *m, int size)
+    {
+        // the tag in the top byte keeps the layouts apart from each other and from channel messages
+        if (size >= 8 && m[1] == 0x00 && m[2] == 0x00 && m[3] == 0x66 && (m[5] == 0x12 || (m[5] >= 0x30 && m[5] <= 0x37))) // MCU LCD: model, row, position and the length
+            return (0xF1ULL << 56) | (m[4] << 24) | (m[5] << 16) | (m[6] << 8) | (size & 0xFF);
+        
+        if (m[1] == 0x00 && m[2] == 0x01 && m[3] == 0x06) // Faderport
+        {
+            if (size >= 9 && m[5] == 0x12) // scribble strip text: model, channel and row
+                return (0xF2ULL << 56) | (m[4] << 24) | (m[5] << 16) | (m[6] << 8) | m[7];
+            if (size >= 8 && m[5] == 0x13) // scribble strip mode: model and channel
+                return (0xF2ULL << 56) | (m[4] << 24) | (m[5] << 16) | (m[6] << 8);
+        }
+        
+        if (size >= 13 && m[1] == 0x00 && m[2] == 0x20 && m[3] == 0x29 && m[5] == 0x0D && m[6] == 0x03 && m[7] == 0x03) // Launchpad RGB: model and pad
+            return (0xF3ULL << 56) | (m[4] << 8) | m[8];
+        
+        return 0;
+    }
+    
+    static unsigned long long GetKey(const unsigned char *message, int size)
+    {
+        if (message[0] == 0xF0)
+            return GetSysExKey(message, size);
+        
+        int status = message[0];
+        
+        if ((status & 0xF0) == 0x80) // note off and note on address the same LED
+            status = 0x90 | (status & 0x0F);
+        
+        switch (status & 0xF0)
+        {
+            case 0xD0: return (status << 8) | (message[1] >> 4); // MCU meters carry the channel in the high nibble
+            case 0xC0:
+            case 0xE0: return status << 8;
+            default:   return (status << 8) | message[1];
+        }
+    }
+    
+    static int GetSlotIndex(unsigned long long key) { return (int)((key * 0x9E3779B97F4A7C15ULL) >> 54); } // the top 10 bits, NUM_SLOTS
+    
+    Slot *FindSlot(unsigned long long key)
+    {
+        for (int i = GetSlotIndex(key); slots_[i].key != 0; i = (i + 1) & (NUM_SLOTS - 1))
+            if (slots_[i].key == key)
+                return &slots_[i];
+        return NULL;
+    }
+    
+    Slot *AddSlot(unsigned long long key)
+    {
+        if (numUsedSlots_ >= MAX_USED_SLOTS)
+            return NULL;
+        
+        int i = GetSlotIndex(key);
+        while (slots_[i].key != 0)
+            i = (i + 1) & (NUM_SLOTS - 1);
+        
+        slots_[i].key = key;
+        numUsedSlots_++;
+        return &slots_[i];
+    }
+    
+    void RemoveSlot(Slot *slot)
+    {
+        // linear probing without tombstones -- pull back any later entry whose home is at or before the hole
+        int hole = (int)(slot - slots_);
+        
+        for (int i = (hole + 1) & (NUM_SLOTS - 1); slots_[i].key != 0; i = (i + 1) & (NUM_SLOTS - 1))
+        {
+            int home = GetSlotIndex(slots_[i].key);
+            
+            if (((i - home) & (NUM_SLOTS - 1)) >= ((i - hole) & (NUM_SLOTS - 1)))
+            {
+                slots_[hole] = slots_[i];
+                hole = i;
+            }
+        }
+        
+        slots_[hole].key = 0;
+        numUsedSlots_--;
+    }
+    
+    void Refill()
+    {
+        DWORD now = GetTickCount();
+        byteCredit_ = wdl_min(maxByteCredit_, byteCredit_ + (now - lastRefillTime_) * bytesPerSecond_ / 1000.0);
+        lastRefillTime_ = now;
+    }
+    
+public:
+    MidiOutputScheduler(int bytesPerSecond, int burstMilliseconds) : bytesPerSecond_(bytesPerSecond), maxByteCredit_(bytesPerSecond * burstMilliseconds / 1000.0), byteCredit_(maxByteCredit_), lastRefillTime_(GetTickCount()) {}
+    
+    void Queue(const unsigned char *message, int size)
+    {
+        if (size < 1)
+            return;
+        
+        Lane lane = GetLane(message);
+        QueuedRecord record = { GetKey(message, size), ++sequence_, size };
+        
+        if (record.key != 0)
+        {
+            Slot *slot = FindSlot(record.key);
+            
+            if (slot != NULL)
+                supersededCount_++;
+            else if ((slot = AddSlot(record.key)) != NULL)
+                queueDepth_[lane]++;
+            else
+            {
+                record.key = 0; // no room left to track it, send it as it is
+                queueDepth_[lane]++;
+            }
+            
+            if (slot != NULL)
+                slot->sequence = record.sequence;
+        }
+        else
+            queueDepth_[lane]++;
+        
+        order_[lane].Add(&record, sizeof(record));
+        order_[lane].Add(message, size);
+    }
+    
+private:
+    template <typename SendFunc> int DrainLanes(Lane lastLane, int maxMessages, bool isPaced, SendFunc send)
+    {
+        int numSent = 0;
+        
+        for (int lane = 0; lane <= lastLane; ++lane)
+        {
+            while (( ! isPaced || byteCredit_ > 0) && (maxMessages == 0 || numSent < maxMessages) && order_[lane].Available() >= (int)sizeof(QueuedRecord))
+            {
+                QueuedRecord record;
+                memcpy(&record, order_[lane].Get(), sizeof(record));
+                const unsigned char *message = (const unsigned char *)order_[lane].Get() + sizeof(record);
+                
+                if (record.key != 0)
+                {
+                    Slot *slot = FindSlot(record.key);
+                    
+                    if (slot == NULL || slot->sequence != record.sequence)
+                    {
+                        order_[lane].Advance(sizeof(record) + record.size);
+                        continue; // superseded
+                    }
+                    
+                    RemoveSlot(slot);
+                }
+                
+                send(message, record.size);
+                byteCredit_ -= record.size; // may go negative for a message larger than the remaining credit, it is paid back before the next one
+                order_[lane].Advance(sizeof(record) + record.size);
+                queueDepth_[lane]--;
+                numSent++;
+            }
+            
+            order_[lane].Compact();
+        }
+        
+        return numSent;
+    }
+    
+public:
+    // hands queued messages to send(message, size) while there is byte credit, lanes up to and including lastLane, highest priority first
+    template <typename SendFunc> int Drain(Lane lastLane, int maxMessages, SendFunc send)
+    {
+        Refill();
+        return DrainLanes(lastLane, maxMessages, true, send);
+    }
+    
+    // everything still queued, regardless of the byte budget -- for a flush that cannot wait any longer
+    template <typename SendFunc> int DrainUnpaced(SendFunc send)
+    {
+        return DrainLanes((Lane)(NUM_LANES - 1), 0, false, send);
+    }
+    
+    bool IsEmpty()
+    {
+        for (int lane = 0; lane < NUM_LANES; ++lane)
+            if (queueDepth_[lane] != 0)
+                return false;
+        return true;
+    }
+    
+    int GetQueueDepth(Lane lane) { return queueDepth_[lane]; }
+    
+    int GetAndResetSupersededCount()
+    {
+        int supersededCount = supersededCount_;
+        supersededCount_ = 0;
+        return supersededCount;
+    }
+};
+
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 class Midi_ControlSurfaceIO
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -2515,18 +4028,71 @@ protected:
     midi_Output *const midiOutput_;
     WDL_Queue messageQueue_;
     const int maxMesssagesPerRun_;
+    int feedbackBudget_ = 0; // FeedbackBudget from CSI.ini, for each ControlSurface using this device
+    
+    // optional I/O thread (MIDIIOThread=Yes) -- owns the devices while running, the main thread only talks to it through the rings
+    struct MidiEventBuffer
+    {
+        MIDI_event_ex_t evt;
+        char data[MidiEventRing::MAX_MESSAGE_SIZE];
+    };
+    
+    MidiEventRing *inputRing_ = NULL;
+    MidiEventRing *outputRing_ = NULL;
+    MidiEventRing *sysExOutputRing_ = NULL;
+    std::thread ioThread_;
+    std::atomic<bool> isIOThreadRunning_;
+    std::atomic<bool> isFlushRequested_; // the thread sends its rings without pacing while set
+    bool isIOThreadRequested_ = false;
+    ProfileHistogram *inputLatencyHistogram_ = NULL;
+    
+    // a full ring -- output waits here, in order, until the thread makes room, input is dropped and counted
+    WDL_Queue outputOverflow_;
+    WDL_Queue sysExOutputOverflow_;
+    std::atomic<int> numInputDrops_;
+    int numOutputDrops_ = 0;
+    ProfileHistogram *inputDropsHistogram_ = NULL;
+    ProfileHistogram *outputDropsHistogram_ = NULL;
+    
+    MidiOutputShadow *outputShadow_; // the port's, or our own when there is no output port
+    MidiOutputShadow *ownedOutputShadow_ = NULL;
+    
+    // optional byte budget (MaxMIDIBytesPerSecond) -- when set every outgoing message goes through the scheduler
+    MidiOutputScheduler *outputScheduler_ = NULL;
+    ProfileHistogram *queueDepthHistograms_[MidiOutputScheduler::NUM_LANES] = { NULL };
+    ProfileHistogram *supersededHistogram_ = NULL;
     
     void SendMidiSysexMessage(MIDI_event_ex_t *midiMessage)
     {
         if (midiOutput_)
             midiOutput_->SendMsg(midiMessage, -1);
     }
+    
+    void SendScheduledMessage(const unsigned char *message, int size);
+    void SendRingMessage(MIDI_event_ex_t *evt); // I/O thread side of outputRing_
+    void WriteRing(MidiEventRing *ring, WDL_Queue &overflow, const unsigned char *message, int size);
+    bool WriteOverflow(MidiEventRing *ring, WDL_Queue &overflow);
+    
+    void RunIOThread();
 
 public:
-    Midi_ControlSurfaceIO(CSurfIntegrator *csi, const char *name, int channelCount, midi_Input *midiInput, midi_Output *midiOutput, int surfaceRefreshRate, int maxMesssagesPerRun) : csi_(csi), name_(name), channelCount_(channelCount), midiInput_(midiInput), midiOutput_(midiOutput), surfaceRefreshRate_(surfaceRefreshRate), maxMesssagesPerRun_(maxMesssagesPerRun) {}
+    Midi_ControlSurfaceIO(CSurfIntegrator *csi, const char *name, int channelCount, midi_Input *midiInput, midi_Output *midiOutput, int surfaceRefreshRate, int maxMesssagesPerRun, int maxBytesPerSecond) : csi_(csi), name_(name), channelCount_(channelCount), midiInput_(midiInput), midiOutput_(midiOutput), surfaceRefreshRate_(surfaceRefreshRate), maxMesssagesPerRun_(maxMesssagesPerRun), isIOThreadRunning_(false), isFlushRequested_(false), numInputDrops_(0)
+    {
+        if (maxBytesPerSecond > 0) // let a full refresh period's worth of credit build up, at least 100ms
+            outputScheduler_ = new MidiOutputScheduler(maxBytesPerSecond, max(100, 2000 / max(surfaceRefreshRate, 1)));
+        
+        outputShadow_ = midiOutput_ ? GetMidiOutputShadow(midiOutput_) : NULL;
+        if (outputShadow_ == NULL)
+            outputShadow_ = ownedOutputShadow_ = new MidiOutputShadow();
+    }
 
     ~Midi_ControlSurfaceIO()
     {
+        StopIOThread();
+        
+        delete outputScheduler_;
+        delete ownedOutputShadow_;
+        
         if (midiInput_) ReleaseMidiInput(midiInput_);
         if (midiOutput_) ReleaseMidiOutput(midiOutput_);
     }
@@ -2535,76 +4101,147 @@ public:
 
     const char *GetName() { return name_.c_str(); }
     
-    const int GetChannelCount() { return channelCount_; }
+    const int GetChannelCount() { return channelCount_; }
+    
+    int GetFeedbackBudget() { return feedbackBudget_; }
+    void SetFeedbackBudget(int feedbackBudget) { feedbackBudget_ = feedbackBudget; }
+
+    // MIDIIOThread=Yes -- started once all surfaces have their ports, StartIOThread() refuses a port shared with another surface
+    void RequestIOThread() { isIOThreadRequested_ = true; }
+    bool GetIsIOThreadRequested() { return isIOThreadRequested_; }
+    void StartIOThread();
+    void StopIOThread();
+    
+    void HandleExternalInput(Midi_ControlSurface *surface);
+    
+    MidiOutputShadow &GetOutputShadow() { return *outputShadow_; }
+    
+    void QueueMidiSysExMessage(MIDI_event_ex_t *midiMessage)
+    {
+        if (WDL_NOT_NORMALLY(midiMessage->size > 255)) return;
+
+        if (outputScheduler_)
+        {
+            outputScheduler_->Queue(midiMessage->midi_message, midiMessage->size);
+            return;
+        }
+        
+        if (sysExOutputRing_)
+        {
+            WriteRing(sysExOutputRing_, sysExOutputOverflow_, midiMessage->midi_message, midiMessage->size);
+            return;
+        }
+        
+        unsigned char size = (unsigned char)midiMessage->size;
+        messageQueue_.Add(&size, 1);
+        messageQueue_.Add(midiMessage->midi_message, midiMessage->size);
+    }
+
+    void SendMidiMessage(int first, int second, int third)
+    {
+        if (outputScheduler_) // faders and LEDs go out right away while the budget allows, otherwise ahead of everything else in Run()
+        {
+            unsigned char message[3] = { (unsigned char)first, (unsigned char)second, (unsigned char)third };
+            outputScheduler_->Queue(message, 3);
+            outputScheduler_->Drain(MidiOutputScheduler::ControlLane, 0, [this](const unsigned char *queued, int size) { SendScheduledMessage(queued, size); });
+        }
+        else if (outputRing_)
+        {
+            unsigned char message[3] = { (unsigned char)first, (unsigned char)second, (unsigned char)third };
+            WriteRing(outputRing_, outputOverflow_, message, 3);
+        }
+        else if (midiOutput_)
+            midiOutput_->Send(first, second, third, -1);
+    }
+    
+    void Run();
+    
+    void Flush();
+};
 
-    void HandleExternalInput(Midi_ControlSurface *surface);
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+class Midi_CSIMessageDispatchTable
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+{
+    // Dense lookup of (status, data1, data2) -> generator, filled in as the .mst file is read.
+    // Rows are only allocated for status bytes and (status, data1) pairs the surface actually uses.
+private:
+    enum { NUM_DATA_VALUES = 128 }; // data bytes are 7 bit
     
-    void QueueMidiSysExMessage(MIDI_event_ex_t *midiMessage)
+    int data1Rows_[256];                             // per status byte, index of its row in data2Rows_, or -1
+    vector<int> data2Rows_;                          // per (status, data1), index of its row in generators_, or -1
+    vector<Midi_CSIMessageGenerator *> generators_;  // per (status, data1, data2)
+    
+    Midi_CSIMessageGenerator *Find(int status, int data1, int data2) const
     {
-        if (WDL_NOT_NORMALLY(midiMessage->size > 255)) return;
-
-        unsigned char size = (unsigned char)midiMessage->size;
-        messageQueue_.Add(&size, 1);
-        messageQueue_.Add(midiMessage->midi_message, midiMessage->size);
+        int data1Row = data1Rows_[status];
+        
+        if (data1Row < 0)
+            return NULL;
+        
+        int data2Row = data2Rows_[data1Row * NUM_DATA_VALUES + data1];
+        
+        if (data2Row < 0)
+            return NULL;
+        
+        return generators_[data2Row * NUM_DATA_VALUES + data2];
     }
-
-    void SendMidiMessage(int first, int second, int third)
+    
+public:
+    Midi_CSIMessageDispatchTable()
     {
-        if (midiOutput_)
-            midiOutput_->Send(first, second, third, -1);
+        for (int i = 0; i < NUM_ELEM(data1Rows_); ++i)
+            data1Rows_[i] = -1;
     }
     
-    void Run()
+    void AddGenerator(int messageKey, Midi_CSIMessageGenerator *messageGenerator)
     {
-        int numSent = 0;
+        int status = (messageKey >> 16) & 0xff;
+        int data1 = (messageKey >> 8) & 0xff;
+        int data2 = messageKey & 0xff;
+        
+        if (data1 >= NUM_DATA_VALUES || data2 >= NUM_DATA_VALUES) // could never match an incoming message
+            return;
         
-        while ((maxMesssagesPerRun_ == 0 || numSent < maxMesssagesPerRun_) && messageQueue_.Available() >= 1)
+        if (data1Rows_[status] < 0)
         {
-            const unsigned char *msg = (const unsigned char *)messageQueue_.Get();
-            const int msg_len = (int) *msg;
-            if (WDL_NOT_NORMALLY(messageQueue_.Available() < 1 + msg_len)) // not enough data in queue, should not happen
-                break;
-            
-            struct
-            {
-                MIDI_event_ex_t evt;
-                char data[256];
-            } midiSysExData;
-
-            midiSysExData.evt.frame_offset = 0;
-            midiSysExData.evt.size = msg_len;
-            memcpy(midiSysExData.evt.midi_message, msg + 1, msg_len);
-            messageQueue_.Advance(1 + msg_len);
-            SendMidiSysexMessage(&midiSysExData.evt);
-            numSent++;
+            data1Rows_[status] = (int)(data2Rows_.size() / NUM_DATA_VALUES);
+            data2Rows_.resize(data2Rows_.size() + NUM_DATA_VALUES, -1);
         }
         
-        messageQueue_.Compact();
+        int &data2Row = data2Rows_[data1Rows_[status] * NUM_DATA_VALUES + data1];
+        
+        if (data2Row < 0)
+        {
+            data2Row = (int)(generators_.size() / NUM_DATA_VALUES);
+            generators_.resize(generators_.size() + NUM_DATA_VALUES, NULL);
+        }
+        
+        generators_[data2Row * NUM_DATA_VALUES + data2] = messageGenerator;
     }
     
-    void Flush()
+    Midi_CSIMessageGenerator *GetGenerator(const MIDI_event_ex_t *evt) const
     {
-        while (messageQueue_.Available() >= 1)
-        {
-            Sleep(2);
-            
-            const unsigned char *msg = (const unsigned char *)messageQueue_.Get();
-            const int msg_len = (int) *msg;
-            if (WDL_NOT_NORMALLY(messageQueue_.Available() < 1 + msg_len)) // not enough data in queue, should not happen
-                break;
-            
-            struct
-            {
-                MIDI_event_ex_t evt;
-                char data[256];
-            } midiSysExData;
-
-            midiSysExData.evt.frame_offset = 0;
-            midiSysExData.evt.size = msg_len;
-            memcpy(midiSysExData.evt.midi_message, msg + 1, msg_len);
-            messageQueue_.Advance(1 + msg_len);
-            SendMidiSysexMessage(&midiSysExData.evt);
-        }
+        int status = evt->midi_message[0];
+        int data1 = evt->midi_message[1];
+        int data2 = evt->midi_message[2];
+        
+        if (data1 >= NUM_DATA_VALUES)
+            return Find(status, 0, 0);
+        
+        // At this point we don't know how much of the message comprises the key, so try all three
+        Midi_CSIMessageGenerator *messageGenerator = NULL;
+        
+        if (data2 < NUM_DATA_VALUES)
+            messageGenerator = Find(status, data1, data2);
+        
+        if (messageGenerator == NULL)
+            messageGenerator = Find(status, data1, 0);
+        
+        if (messageGenerator == NULL)
+            messageGenerator = Find(status, 0, 0);
+        
+        return messageGenerator;
     }
 };
 
@@ -2615,11 +4252,11 @@ class Midi_ControlSurface : public ControlSurface
 private:
     Midi_ControlSurfaceIO *const surfaceIO_;
     
-    map<int, Midi_CSIMessageGenerator*> Midi_CSIMessageGeneratorsByMessage_;
+    Midi_CSIMessageDispatchTable Midi_CSIMessageGenerators_;
 
     DWORD lastRun_ = 0;
 
-    void ProcessMidiWidget(int &lineNumber, ifstream &surfaceTemplateFile, const vector<string> &in_tokens);
+    void ProcessMidiWidget(const vector<TokenizedLine> &lines, int &lineIndex, const vector<string> &in_tokens);
     
     void ProcessMIDIWidgetFile(const string &filePath, Midi_ControlSurface *surface);
     
@@ -2643,12 +4280,40 @@ private:
 
     void SendSysexInitData(int line[], int numElem);
     
+    // MCU style displays accept a start position followed by any number of characters,
+    // so the cells that change during a tick are collected here and go out as one sysex per contiguous span
+    struct MCUDisplayFrame
+    {
+        int displayType;
+        int displayRow;
+        char text[0x80];
+        bool isKnown[0x80]; // written at least once, so it can be resent as part of a wider span
+        bool isDirty[0x80];
+        bool hasDirty;
+    };
+    
+    vector<MCUDisplayFrame *> mcuDisplayFrames_;
+    vector<FeedbackProcessor *> pendingTrackColorsFeedbackProcessors_; // X-Touch color strip refresh, deferred to the flush
+    
+    void SendMCUDisplayText(int displayType, int displayRow, int position, const char *text, int length);
+    
 public:
     Midi_ControlSurface(CSurfIntegrator *const csi, Page *page, const char *name, int channelOffset, const char *surfaceFile, const char *zoneFolder, const char *fxZoneFolder, Midi_ControlSurfaceIO *surfaceIO);
 
-    virtual ~Midi_ControlSurface() {}
+    virtual ~Midi_ControlSurface()
+    {
+        for (auto frame : mcuDisplayFrames_)
+            delete frame;
+    }
     
     void ProcessMidiMessage(const MIDI_event_ex_t *evt);
+    void QueueMCUDisplayText(int displayType, int displayRow, int position, const char *text, int length);
+    void QueueTrackColorsUpdate(FeedbackProcessor *feedbackProcessor)
+    {
+        if (find(pendingTrackColorsFeedbackProcessors_.begin(), pendingTrackColorsFeedbackProcessors_.end(), feedbackProcessor) == pendingTrackColorsFeedbackProcessors_.end())
+            pendingTrackColorsFeedbackProcessors_.push_back(feedbackProcessor);
+    }
+    void FlushMCUDisplayFrames();
     virtual void SendMidiSysExMessage(MIDI_event_ex_t *midiMessage) override;
     virtual void SendMidiMessage(int first, int second, int third) override;
 
@@ -2663,15 +4328,22 @@ public:
         surfaceIO_->HandleExternalInput(this);
     }
         
+    virtual void ForceResync() override
+    {
+        surfaceIO_->GetOutputShadow().Invalidate();
+        ControlSurface::ForceResync();
+    }
+    
     virtual void FlushIO() override
     {
+        FlushMCUDisplayFrames();
         surfaceIO_->Flush();
     }
     
     void AddCSIMessageGenerator(int messageKey, Midi_CSIMessageGenerator *messageGenerator)
     {
         if (messageGenerator != NULL)
-            Midi_CSIMessageGeneratorsByMessage_[messageKey] = messageGenerator;
+            Midi_CSIMessageGenerators_.AddGenerator(messageKey, messageGenerator);
     }
     
     virtual void RequestUpdate() override
@@ -2683,6 +4355,8 @@ public:
         surfaceIO_->Run();
         
         ControlSurface::RequestUpdate();
+        
+        FlushMCUDisplayFrames();
     }
 };
 
@@ -2720,6 +4394,55 @@ public:
     virtual void ForceClear() override;
 };
 
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+template <typename T> class SPSCQueue
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+{
+    // Lock-free single producer / single consumer queue of fixed size slots.
+    // The producer fills the slot from BeginWrite() and publishes it with EndWrite(), the consumer mirrors that with BeginRead() / EndRead().
+private:
+    vector<T> slots_;
+    unsigned int const mask_;
+    std::atomic<unsigned int> writePosition_;
+    std::atomic<unsigned int> readPosition_;
+    
+public:
+    SPSCQueue(int capacity) : slots_(capacity), mask_(capacity - 1), writePosition_(0), readPosition_(0) { WDL_ASSERT((capacity & (capacity - 1)) == 0); } // capacity must be a power of two
+    
+    T *BeginWrite() // NULL when full
+    {
+        unsigned int writePosition = writePosition_.load(std::memory_order_relaxed);
+        if (writePosition - readPosition_.load(std::memory_order_acquire) >= slots_.size())
+            return NULL;
+        return &slots_[writePosition & mask_];
+    }
+    
+    void EndWrite() { writePosition_.store(writePosition_.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+    
+    T *BeginRead() // NULL when empty
+    {
+        unsigned int readPosition = readPosition_.load(std::memory_order_relaxed);
+        if (readPosition == writePosition_.load(std::memory_order_acquire))
+            return NULL;
+        return &slots_[readPosition & mask_];
+    }
+    
+    void EndRead() { readPosition_.store(readPosition_.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+};
+
+static const int s_oscMaxBundleSize = 1472; // 1500 byte Ethernet MTU less the IPv4 and UDP headers, larger bundles would be fragmented
+
+static unsigned int GetOSCAddressHash(const char *address) // FNV-1a
+{
+    unsigned int hash = 2166136261u;
+    while (*address)
+    {
+        hash ^= (unsigned char)*address++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 class OSC_ControlSurfaceIO
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -2733,27 +4456,69 @@ protected:
     oscpkt::PacketReader packetReader_;
     oscpkt::PacketWriter packetWriter_;
     oscpkt::Storage storageTmp_;
-    int maxBundleSize_ = 0; // 0 = no bundles (would only be useful if the destination doesn't support bundles)
+    int maxBundleSize_ = 0; // 0 = no bundles, otherwise MaxBundleSize from CSI.ini capped at s_oscMaxBundleSize
     int maxPacketsPerRun_; // 0 = no limit
+    int feedbackBudget_ = 0; // FeedbackBudget from CSI.ini, for each ControlSurface using this device
     int sentPacketCount_= 0; // count of packets sent this Run() slice, after maxPacketsPerRun_ packtees go into packetQueue_
     WDL_Queue packetQueue_;
+    bool isInRun_ = false; // between BeginRun() and Run() packets are only queued, Run() hands them to the socket in one batch
+    int sendCallCount_ = 0; // socket calls this Run() slice, for the profiler
+    ProfileHistogram *sendCallsHistogram_ = NULL;
+    ProfileHistogram *packetsHistogram_ = NULL;
+    
+    void SendQueuedPackets();
+    string inputAddress_;
+    
+    // optional receive thread (OSCReceiveThread=Yes) -- reads and parses datagrams, the main thread only dispatches the results
+    struct OSCInputMessage
+    {
+        unsigned int addressHash;
+        double value;
+        long long timestamp; // CSIProfiler::GetMicroseconds() when received
+        char address[128];
+    };
+    
+    SPSCQueue<OSCInputMessage> *inputQueue_ = NULL;
+    std::thread receiveThread_;
+    std::atomic<bool> isReceiveThreadRunning_;
+    ProfileHistogram *inputLatencyHistogram_ = NULL;
+    
+    // receive thread side, what didn't fit into a full inputQueue_ -- one message per address, the newest value wins
+    enum { MAX_PENDING_INPUT = 256 };
+    vector<OSCInputMessage> pendingInput_;
+    std::atomic<int> numInputDrops_; // values replaced or thrown away while the main thread was behind
+    ProfileHistogram *inputDropsHistogram_ = NULL;
+    
+    void RunReceiveThread();
+    void QueueInputPacket(oscpkt::PacketReader &packetReader, string &address, const void *packetData, int packetSize);
+    bool WritePendingInput();
+    
+    // turns one incoming message into an (address, value) pair, false to ignore it -- may be called on the receive thread
+    virtual bool DecodeMessage(oscpkt::Message *message, string &address, double &value);
     
 public:
-    OSC_ControlSurfaceIO(CSurfIntegrator *const csi, const char *name, int channelCount, const char *receiveOnPort, const char *transmitToPort, const char *transmitToIpAddress, int maxPacketsPerRun);
+    OSC_ControlSurfaceIO(CSurfIntegrator *const csi, const char *name, int channelCount, const char *receiveOnPort, const char *transmitToPort, const char *transmitToIpAddress, int maxPacketsPerRun, int maxBundleSize);
     virtual ~OSC_ControlSurfaceIO();
 
     const char *GetName() { return name_.c_str(); }
 
     const int GetChannelCount() { return channelCount_; }
     
-    virtual void HandleExternalInput(OSC_ControlSurface *surface);
+    int GetFeedbackBudget() { return feedbackBudget_; }
+    void SetFeedbackBudget(int feedbackBudget) { feedbackBudget_ = feedbackBudget; }
+    
+    // note: an input port shared by several surfaces must not be given a receive thread, the thread consumes every datagram on the socket
+    void StartReceiveThread();
+    void StopReceiveThread();
+    
+    void HandleExternalInput(OSC_ControlSurface *surface);
 
     void QueuePacket(const void *p, int sz)
     {
         if (WDL_NOT_NORMALLY(!outSocket_)) return;
         if (WDL_NOT_NORMALLY(!p || sz < 1)) return;
         if (WDL_NOT_NORMALLY(packetQueue_.GetSize() > 32*1024*1024)) return; // drop packets after 32MB queued
-        if (maxPacketsPerRun_ != 0 && sentPacketCount_ >= maxPacketsPerRun_)
+        if (isInRun_ || (maxPacketsPerRun_ != 0 && sentPacketCount_ >= maxPacketsPerRun_))
         {
             void *wr = packetQueue_.Add(NULL,sz + sizeof(int));
             if (WDL_NORMALLY(wr != NULL))
@@ -2766,6 +4531,7 @@ public:
         {
             outSocket_->sendPacket(p, sz);
             sentPacketCount_++;
+            sendCallCount_++;
         }
     }
 
@@ -2854,38 +4620,8 @@ public:
         }
     }
     
-    void BeginRun()
-    {
-        sentPacketCount_ = 0;
-        // send any latent packets first
-        while (packetQueue_.GetSize()>=sizeof(int))
-        {
-            int sza;
-            if (maxPacketsPerRun_ != 0 && sentPacketCount_ >= maxPacketsPerRun_) break;
-
-            memcpy(&sza, packetQueue_.Get(), sizeof(int));
-            packetQueue_.Advance(sizeof(int));
-            if (WDL_NOT_NORMALLY(sza < 0 || packetQueue_.GetSize() < sza))
-            {
-                packetQueue_.Clear();
-            }
-            else
-            {
-                if (WDL_NORMALLY(outSocket_ != NULL))
-                {
-                    outSocket_->sendPacket(packetQueue_.Get(), sza);
-                }
-                packetQueue_.Advance(sza);
-                sentPacketCount_++;
-            }
-        }
-        packetQueue_.Compact();
-    }
-
-    virtual void Run()
-    {
-        QueueOSCMessage(NULL); // flush any latent bundles
-    }
+    void BeginRun();
+    virtual void Run();
 };
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -2897,10 +4633,10 @@ protected:
     DWORD X32HeartBeatLastRefreshTime_ = GetTickCount() - 30000;
     
 public:
-    OSC_X32ControlSurfaceIO(CSurfIntegrator *const csi, const char *name, int channelCount, const char *receiveOnPort, const char *transmitToPort, const char *transmitToIpAddress, int maxPacketsPerRun);
-    virtual ~OSC_X32ControlSurfaceIO() {}
+    OSC_X32ControlSurfaceIO(CSurfIntegrator *const csi, const char *name, int channelCount, const char *receiveOnPort, const char *transmitToPort, const char *transmitToIpAddress, int maxPacketsPerRun, int maxBundleSize);
+    virtual ~OSC_X32ControlSurfaceIO() { StopReceiveThread(); } // before our DecodeMessage override goes away
 
-    virtual void HandleExternalInput(OSC_ControlSurface *surface) override;
+    virtual bool DecodeMessage(oscpkt::Message *message, string &address, double &value) override;
 
     void Run() override
     {
@@ -2922,14 +4658,32 @@ class OSC_ControlSurface : public ControlSurface
 {
 private:
     OSC_ControlSurfaceIO *const surfaceIO_;
-    void ProcessOSCWidget(int &lineNumber, ifstream &surfaceTemplateFile, const vector<string> &in_tokens);
+    struct HashedMessageGenerator
+    {
+        unsigned int hash;
+        bool isUsed;
+        const char *address; // the key in CSIMessageGeneratorsByMessage_, an unknown address can share the hash
+        CSIMessageGenerator *generator; // NULL marks a hash collision between two known addresses
+    };
+    
+    // open addressed with linear probing, kept at most half full, filled as the generators are added
+    vector<HashedMessageGenerator> CSIMessageGeneratorsByHash_;
+    int numHashedMessageGenerators_ = 0;
+    
+    void AddHashedMessageGenerator(const HashedMessageGenerator &hashedGenerator);
+    const HashedMessageGenerator *GetHashedMessageGenerator(unsigned int hash);
+    
+    void ProcessOSCWidget(const vector<TokenizedLine> &lines, int &lineIndex, const vector<string> &in_tokens);
     void ProcessOSCWidgetFile(const string &filePath);
 public:
     OSC_ControlSurface(CSurfIntegrator *const csi, Page *page, const char *name, int channelOffset, const char *templateFilename, const char *zoneFolder, const char *fxZoneFolder, OSC_ControlSurfaceIO *surfaceIO);
 
     virtual ~OSC_ControlSurface() {}
     
+    virtual void AddCSIMessageGenerator(const string &message, CSIMessageGenerator *messageGenerator) override;
+    
     void ProcessOSCMessage(const char *message, double value);
+    void ProcessOSCMessage(const char *message, unsigned int addressHash, double value);
     void SendOSCMessage(OSC_FeedbackProcessor *feedbackProcessor, const char *oscAddress, double value);
     void SendOSCMessage(OSC_FeedbackProcessor *feedbackProcessor, const char *oscAddress, int value);
     void SendOSCMessage(OSC_FeedbackProcessor *feedbackProcessor, const char *oscAddress, const char *value);
@@ -2951,6 +4705,10 @@ public:
     }
 };
 
+static const DWORD s_trackListResyncInterval = 1000; // milliseconds between safety rebuilds when REAPER has not notified us of any change
+static const int s_trackListResyncTracks = 256; // per s_trackListResyncInterval, larger projects resync less often so a tick's share of the walk stays flat
+static const DWORD s_maxTrackListResyncInterval = 2000; // however large the project, a change REAPER didn't report shows up within this
+
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 class TrackNavigationManager
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -2981,6 +4739,13 @@ protected:
     vector<MediaTrack *> folderParentTracks_;
     vector<MediaTrack *> folderSpillTracks_;
     map<MediaTrack*, vector<MediaTrack*>> folderDictionary_;
+    
+    // the track lists above are only rebuilt when trackListGeneration_ moves past builtTrackListGeneration_
+    int trackListGeneration_ = 0;
+    int builtTrackListGeneration_ = -1;
+    int builtNumTracks_ = -1;
+    DWORD lastTrackListResyncTime_ = 0;
+    ProfileHistogram *rebuildHistogram_ = NULL; // see CSIProfiler
  
     vector<Navigator *> fixedTrackNavigators_;
     vector<Navigator *> trackNavigators_;
@@ -3020,6 +4785,18 @@ protected:
         }
     }
     
+    // A list built for the current generation was checked against the project when it was built, and REAPER sends SetTrackListChange
+    // when a track goes away, so only lists gone stale since need ValidatePtr on each lookup
+    MediaTrack *GetListedTrack(const vector<MediaTrack *> &tracks, int index)
+    {
+        if (index < 0 || index >= tracks.size())
+            return NULL;
+        else if (builtTrackListGeneration_ == trackListGeneration_ || DAW::ValidateTrackPtr(tracks[index]))
+            return tracks[index];
+        else
+            return NULL;
+    }
+    
 public:
     TrackNavigationManager(CSurfIntegrator *const csi, Page *page, bool followMCP,  bool synchPages, bool isScrollLinkEnabled, bool isScrollSynchEnabled) :
     csi_(csi),
@@ -3044,7 +4821,10 @@ public:
     
     void RebuildTracks();
     void RebuildSelectedTracks();
+    void RebuildTrackListsIfNeeded();
     void AdjustSelectedTrackBank(int amount);
+    void InvalidateTrackList() { trackListGeneration_++; }
+    int GetTrackListGeneration() { return trackListGeneration_; }
     bool GetSynchPages() { return synchPages_; }
     bool GetScrollLink() { return isScrollLinkEnabled_; }
     bool GetFollowMCP() { return followMCP_; }
@@ -3061,16 +4841,19 @@ public:
     void VCAModeActivated()
     {
         currentTrackVCAFolderMode_ = 1;
+        InvalidateTrackList();
     }
     
     void FolderModeActivated()
     {
         currentTrackVCAFolderMode_ = 2;
+        InvalidateTrackList();
     }
     
     void SelectedTracksModeActivated()
     {
         currentTrackVCAFolderMode_ = 3;
+        InvalidateTrackList();
     }
     
     void VCAModeDeactivated()
@@ -3337,8 +5120,8 @@ public:
         {
             channelNumber += trackOffset_;
             
-            if (channelNumber < GetNumTracks() && channelNumber < tracks_.size() && DAW::ValidateTrackPtr(tracks_[channelNumber]))
-                return tracks_[channelNumber];
+            if (builtTrackListGeneration_ == trackListGeneration_ || channelNumber < GetNumTracks())
+                return GetListedTrack(tracks_, channelNumber);
             else
                 return NULL;
         }
@@ -3347,47 +5130,24 @@ public:
             channelNumber += vcaTrackOffset_;
 
             if (vcaLeadTrack_ == NULL)
-            {
-                if (channelNumber < vcaTopLeadTracks_.size() && DAW::ValidateTrackPtr(vcaTopLeadTracks_[channelNumber]))
-                    return vcaTopLeadTracks_[channelNumber];
-                else
-                    return NULL;
-            }
+                return GetListedTrack(vcaTopLeadTracks_, channelNumber);
             else
-            {
-                if (channelNumber < vcaSpillTracks_.size() && DAW::ValidateTrackPtr(vcaSpillTracks_[channelNumber]))
-                    return vcaSpillTracks_[channelNumber];
-                else
-                    return NULL;
-            }
+                return GetListedTrack(vcaSpillTracks_, channelNumber);
         }
         else if (currentTrackVCAFolderMode_ == 2)
         {
             channelNumber += folderTrackOffset_;
 
             if (folderParentTrack_ == NULL)
-            {
-                if (channelNumber < folderTopParentTracks_.size() && DAW::ValidateTrackPtr(folderTopParentTracks_[channelNumber]))
-                    return folderTopParentTracks_[channelNumber];
-                else
-                    return NULL;
-            }
+                return GetListedTrack(folderTopParentTracks_, channelNumber);
             else
-            {
-                if (channelNumber < folderSpillTracks_.size() && DAW::ValidateTrackPtr(folderSpillTracks_[channelNumber]))
-                    return folderSpillTracks_[channelNumber];
-                else
-                    return NULL;
-            }
+                return GetListedTrack(folderSpillTracks_, channelNumber);
         }
         else if (currentTrackVCAFolderMode_ == 3)
         {
             channelNumber += selectedTracksOffset_;
             
-            if (channelNumber < selectedTracks_.size() && DAW::ValidateTrackPtr(selectedTracks_[channelNumber]))
-                return selectedTracks_[channelNumber];
-            else
-                return NULL;
+            return GetListedTrack(selectedTracks_, channelNumber);
         }
         
         return NULL;
@@ -3443,6 +5203,7 @@ public:
             vcaLeadTrack_ = track;
        
         vcaTrackOffset_ = 0;
+        InvalidateTrackList();
     }
 
     bool GetIsFolderSpilled(MediaTrack *track)
@@ -3485,6 +5246,7 @@ public:
             folderParentTrack_ = track;
        
         folderTrackOffset_ = 0;
+        InvalidateTrackList();
     }
     
     void ToggleSynchPages()
@@ -3495,6 +5257,7 @@ public:
     void ToggleFollowMCP()
     {
         followMCP_ = ! followMCP_;
+        InvalidateTrackList();
     }
     
     void ToggleScrollLink(int targetChannel)
@@ -3518,18 +5281,24 @@ public:
        
     void OnTrackSelection()
     {
+        InvalidateTrackList();
+        
         if (isScrollLinkEnabled_ && tracks_.size() > trackNavigators_.size())
             ForceScrollLink();
     }
     
     void OnTrackListChange()
     {
+        InvalidateTrackList();
+        
         if (isScrollLinkEnabled_ && tracks_.size() > trackNavigators_.size())
             ForceScrollLink();
     }
 
     void OnTrackSelectionBySurface(MediaTrack *track)
     {
+        InvalidateTrackList();
+        
         if (isScrollLinkEnabled_)
         {
             if (IsTrackVisible(track, true))
@@ -3702,6 +5471,56 @@ public:
     }
 };
 
+static const DWORD s_meterTrackExpiry = 1000; // milliseconds a metered track is sampled after the last request for it
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+class TrackMeterSampler
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+{
+    // Reads each metered track's L/R peaks and solo state once per tick for every meter action on the page.
+    // Tracks asked for during a tick are sampled together at the start of the next one, decay and peak hold are applied,
+    // and the whole snapshot is converted to normalized values in one pass. A track nobody has asked for in s_meterTrackExpiry is dropped,
+    // so surfaces refreshing slower than REAPER ticks keep their tracks, and the meters their ballistics, between refreshes.
+private:
+    enum { NUM_PEAKS = 2, NUM_VALUES = 4 }; // L, R -- normalized L, R, average LR, max peak LR
+    
+    map<MediaTrack *, int> indexByTrack_;
+    vector<MediaTrack *> tracks_;
+    vector<DWORD> requestTimes_; // lastSampleTime_ of the tick each track was last asked for
+    vector<char> isSilencedBySolo_;
+    vector<double> peaks_;       // NUM_PEAKS per track, linear, straight from REAPER
+    vector<double> decayLevels_; // NUM_PEAKS per track, peaks_ with decay applied
+    vector<double> holdLevels_;  // NUM_PEAKS per track
+    vector<DWORD> holdTimes_;    // NUM_PEAKS per track
+    vector<double> levels_;      // NUM_PEAKS per track, what the meters show
+    vector<double> normalized_;  // NUM_VALUES per track
+    
+    bool isAnyTrackSoloed_ = false;
+    DWORD lastSampleTime_ = 0;
+    double decayDBPerSecond_ = 0.0; // 0 = follow the peaks
+    int peakHoldMilliseconds_ = 0;  // 0 = no hold
+    
+    int GetIndex(MediaTrack *track);
+    void ReadTracks(int first, int last);
+    void ApplyBallistics(int first, int last, DWORD now, double elapsedSeconds);
+    void Normalize(int first, int last);
+    
+public:
+    void SetBallistics(double decayDBPerSecond, int peakHoldMilliseconds)
+    {
+        decayDBPerSecond_ = decayDBPerSecond < 0.0 ? 0.0 : decayDBPerSecond;
+        peakHoldMilliseconds_ = peakHoldMilliseconds < 0 ? 0 : peakHoldMilliseconds;
+    }
+    
+    void Sample(); // once per tick, before the surfaces update
+    void Clear();  // track list or project changed, the pointers may be stale
+    
+    bool GetIsSilencedBySolo(MediaTrack *track) { return isSilencedBySolo_[GetIndex(track)] != 0; }
+    double GetNormalizedPeak(MediaTrack *track, int channel);
+    double GetNormalizedAverageLR(MediaTrack *track) { return normalized_[GetIndex(track) * NUM_VALUES + 2]; }
+    double GetNormalizedMaxPeakLR(MediaTrack *track) { return normalized_[GetIndex(track) * NUM_VALUES + 3]; }
+};
+
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 class Page
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -3712,9 +5531,13 @@ protected:
     TrackNavigationManager *trackNavigationManager_;
     ModifierManager *modifierManager_;
     vector<ControlSurface *> surfaces_;
+    bool const isChangeDrivenFeedback_;
+    TrackMeterSampler meterSampler_;
+    ProfileHistogram *trackStateFetchesHistogram_ = NULL;
+    ProfileHistogram *trackStateReadsHistogram_ = NULL;
     
 public:
-    Page(CSurfIntegrator *const csi, const char *name, bool followMCP,  bool synchPages, bool isScrollLinkEnabled, bool isScrollSynchEnabled) : csi_(csi), name_(name), trackNavigationManager_(new TrackNavigationManager(csi_, this, followMCP, synchPages, isScrollLinkEnabled, isScrollSynchEnabled)), modifierManager_(new ModifierManager(csi_, this, NULL)) {}
+    Page(CSurfIntegrator *const csi, const char *name, bool followMCP,  bool synchPages, bool isScrollLinkEnabled, bool isScrollSynchEnabled, bool isChangeDrivenFeedback) : csi_(csi), name_(name), trackNavigationManager_(new TrackNavigationManager(csi_, this, followMCP, synchPages, isScrollLinkEnabled, isScrollSynchEnabled)), modifierManager_(new ModifierManager(csi_, this, NULL)), isChangeDrivenFeedback_(isChangeDrivenFeedback) {}
 
     ~Page()
     {
@@ -3725,6 +5548,10 @@ public:
         
     const char *GetName() { return name_.c_str(); }
     
+    bool GetIsChangeDrivenFeedback() { return isChangeDrivenFeedback_; }
+    
+    TrackMeterSampler &GetMeterSampler() { return meterSampler_; }
+    
     ModifierManager *GetModifierManager() { return modifierManager_; }
     
     const vector<ControlSurface *> &GetSurfaces() { return surfaces_; }
@@ -3753,11 +5580,14 @@ public:
             surface->ForceClearTrack(trackNum);
     }
     
-    void ForceUpdateTrackColors()
+    void ForceResync()
     {
+        meterSampler_.Clear();
+        
         for (auto surface : surfaces_)
-            surface->ForceUpdateTrackColors();
+            surface->ForceResync();
     }
+    
       
     bool GetTouchState(MediaTrack *track, int touchedControl)
     {
@@ -3774,6 +5604,7 @@ public:
     
     void OnTrackListChange()
     {
+        meterSampler_.Clear();
         trackNavigationManager_->OnTrackListChange();
     }
     
@@ -3793,6 +5624,7 @@ public:
     
     void EnterPage()
     {
+        trackNavigationManager_->InvalidateTrackList();
         trackNavigationManager_->EnterPage();
         
         for (auto surface : surfaces_)
@@ -3889,6 +5721,7 @@ public:
     void ToggleSynchPages() { trackNavigationManager_->ToggleSynchPages(); }
     void ToggleFollowMCP() { trackNavigationManager_->ToggleFollowMCP(); }
     void SetTrackOffset(int offset) { trackNavigationManager_->SetTrackOffset(offset); }
+    void InvalidateTrackList() { trackNavigationManager_->InvalidateTrackList(); }
     MediaTrack *GetSelectedTrack() { return trackNavigationManager_->GetSelectedTrack(); }
     void NextInputMonitorMode(MediaTrack *track) { trackNavigationManager_->NextInputMonitorMode(track); }
     const char *GetAutoModeDisplayName(int modeIndex) { return trackNavigationManager_->GetAutoModeDisplayName(modeIndex); }
@@ -3896,90 +5729,11 @@ public:
     const char *GetCurrentInputMonitorMode(MediaTrack *track) { return trackNavigationManager_->GetCurrentInputMonitorMode(track); }
     const vector<MediaTrack *> &GetSelectedTracks() { return trackNavigationManager_->GetSelectedTracks(); }
     
-    
-    /*
-    int repeats = 0;
-    
-    void Run()
-    {
-        int start = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now().time_since_epoch()).count();
-                
-        repeats++;
-         
-        if (repeats > 50)
-        {
-            repeats = 0;
-            
-            int totalDuration = 0;
-
-            start = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now().time_since_epoch()).count();
-            trackNavigationManager_->RebuildTracks();
-            trackNavigationManager_->RebuildVCASpill();
-            trackNavigationManager_->RebuildFolderTracks();
-            int duration = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now().time_since_epoch()).count() - start;
-            totalDuration += duration;
-            ShowDuration("Rebuild Track/VCA/Folder List", duration);
-            
-            for (int i = 0; i < surfaces_.size(); ++i)
-            {
-                start = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now().time_since_epoch()).count();
-                surfaces_[i]->HandleExternalInput();
-                duration = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now().time_since_epoch()).count() - start;
-                totalDuration += duration;
-                ShowDuration(surfaces_[i]->GetName(), "HandleExternalInput", duration);
-            }
-            
-            for (int i = 0; i < surfaces_.size(); ++i)
-            {
-                start = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now().time_since_epoch()).count();
-                surfaces_[i]->RequestUpdate();
-                duration = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now().time_since_epoch()).count() - start;
-                totalDuration += duration;
-                ShowDuration(surfaces_[i]->GetName(), "Request Update", duration);
-            }
-            
-            char msgBuffer[250];
-            
-            snprintf(msgBuffer, sizeof(msgBuffer), "Total duration = %d\n\n\n", totalDuration);
-            ShowConsoleMsg(msgBuffer);
-        }
-    }
-    
-    
-    void ShowDuration(string item, int duration)
-    {
-        char msgBuffer[250];
-        
-        snprintf(msgBuffer, sizeof(msgBuffer), "%s - %d microseconds\n", item.c_str(), duration);
-        ShowConsoleMsg(msgBuffer);
-    }
-    
-    void ShowDuration(string surface, string item, int duration)
-    {
-        char msgBuffer[250];
-        
-        snprintf(msgBuffer, sizeof(msgBuffer), "%s - %s - %d microseconds\n", surface.c_str(), item.c_str(), duration);
-        ShowConsoleMsg(msgBuffer);
-    }
-   */
-
-//*
-    void Run()
-    {
-        trackNavigationManager_->RebuildTracks();
-        trackNavigationManager_->RebuildVCASpill();
-        trackNavigationManager_->RebuildFolderTracks();
-        trackNavigationManager_->RebuildSelectedTracks();
-        
-        for (auto surface : surfaces_)
-            surface->HandleExternalInput();
-        
-        for (auto surface : surfaces_)
-            surface->RequestUpdate();
-    }
-//*/
+    void Run();
 };
 
+static const DWORD s_profileDumpInterval = 10000;
+
 static const int s_tickCounts_[] = { 250, 235, 220, 205, 190, 175, 160, 145, 130, 115, 100, 90, 80, 70, 60, 50, 45, 40, 35, 30, 25, 20, 20, 20 };
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -4004,6 +5758,14 @@ private:
     
     ReaProject* currentProject_ = NULL;
     
+    TrackPropertyChanges trackPropertyChanges_;
+    TrackStateCache trackStateCache_;
+    TrackColors trackColors_;
+    ZoneFileIndex zoneFileIndex_;
+    TokenizedFileCache tokenizedFileCache_;
+    
+    CSIProfiler profiler_;
+    
     // these are offsets to be passed to projectconfig_var_addr() when needed in order to get the actual pointers
     int timeModeOffs_;
     int timeMode2Offs_;
@@ -4133,26 +5895,131 @@ public:
     }
     // End direct calls
     
+    // in zone's arena, so owned by zone -- or on the heap for a NULL zone, see ZoneManager::ZoneTemplate
     ActionContext *GetActionContext(const char *actionName, Widget *widget, Zone *zone, const vector<string> &params)
     {
-        if (actions_.find(actionName) != actions_.end())
-            return new ActionContext(this, actions_[actionName], widget, zone, 0, params, NULL);
+        Action *action = actions_.find(actionName) != actions_.end() ? actions_[actionName] : actions_["NoAction"];
+        
+        if (zone != NULL)
+            return zone->GetArena().New<ActionContext>(this, action, widget, zone, 0, params, (const string *)NULL);
         else
-            return new ActionContext(this, actions_["NoAction"], widget, zone, 0, params, NULL);
+            return new ActionContext(this, action, widget, zone, 0, params, NULL);
     }
 
+    void InvalidateTrackLists()
+    {
+        for (auto page : pages_)
+            page->InvalidateTrackList();
+    }
+    
     void OnTrackSelection(MediaTrack *track) override
     {
+        InvalidateTrackLists();
+        
         if (pages_.size() > currentPageIndex_ && pages_[currentPageIndex_])
             pages_[currentPageIndex_]->OnTrackSelection(track);
     }
     
     void SetTrackListChange() override
     {
+        InvalidateTrackLists();
+        trackPropertyChanges_.InvalidateAll();
+        trackStateCache_.Clear();
+        trackColors_.Clear();
+        
         if (pages_.size() > currentPageIndex_ && pages_[currentPageIndex_])
             pages_[currentPageIndex_]->OnTrackListChange();
     }
     
+    Page *GetCurrentPage() { return pages_.size() > currentPageIndex_ ? pages_[currentPageIndex_] : NULL; }
+    
+    TrackPropertyChanges &GetTrackPropertyChanges() { return trackPropertyChanges_; }
+    
+    TrackStateCache &GetTrackStateCache() { return trackStateCache_; }
+    
+    TrackColors &GetTrackColors() { return trackColors_; }
+    
+    ZoneFileIndex &GetZoneFileIndex() { return zoneFileIndex_; }
+    
+    TokenizedFileCache &GetTokenizedFileCache() { return tokenizedFileCache_; }
+    
+    CSIProfiler &GetProfiler() { return profiler_; }
+    
+    string GetProfileFilePath() { return string(GetResourcePath()) + "/CSI/CSIProfile.txt"; }
+    
+    void ForceResync()
+    {
+        trackPropertyChanges_.InvalidateAll();
+        trackStateCache_.Clear();
+        trackColors_.Clear();
+        
+        if (pages_.size() > currentPageIndex_ && pages_[currentPageIndex_])
+            pages_[currentPageIndex_]->ForceResync();
+    }
+    
+    void ToggleProfiling()
+    {
+        if (profiler_.GetIsEnabled())
+        {
+            profiler_.Dump(GetProfileFilePath().c_str());
+            profiler_.SetIsEnabled(false);
+            
+            char buffer[250];
+            snprintf(buffer, sizeof(buffer), "CSI profile written to %s\n", GetProfileFilePath().c_str());
+            ShowConsoleMsg(buffer);
+        }
+        else
+        {
+            for (auto page : pages_)
+                for (auto surface : page->GetSurfaces())
+                    surface->ResetProfiledCounts();
+            
+            profiler_.SetIsEnabled(true);
+        }
+    }
+    
+    void ShowMemoryUsage()
+    {
+        for (auto page : pages_)
+        {
+            for (auto surface : page->GetSurfaces())
+            {
+                ZoneMemoryUsage usage;
+                surface->GetZoneManager()->GetMemoryUsage(usage);
+                
+                char buffer[500];
+                snprintf(buffer, sizeof(buffer), "CSI memory %s/%s: %d zones, %d action contexts, %zu arena bytes used (%zu reserved), %d zone templates\n",
+                         page->GetName(), surface->GetName(), usage.numZones, usage.numActionContexts, usage.arenaBytesUsed, usage.arenaBytesReserved, surface->GetZoneManager()->GetNumZoneTemplates());
+                ShowConsoleMsg(buffer);
+            }
+        }
+        
+        char buffer[100];
+        snprintf(buffer, sizeof(buffer), "CSI memory: %d zones live in all\n", Zone::GetNumLiveZones()); // more than the above means zones leaked
+        ShowConsoleMsg(buffer);
+    }
+    
+    void SetSurfaceVolume(MediaTrack *track, double volume) override { OnTrackPropertyChange(track, TrackProperty_Volume); }
+    void SetSurfacePan(MediaTrack *track, double pan) override { OnTrackPropertyChange(track, TrackProperty_Pan); }
+    void SetSurfaceMute(MediaTrack *track, bool mute) override { OnTrackPropertyChange(track, TrackProperty_Mute); }
+    void SetSurfaceSelected(MediaTrack *track, bool selected) override { OnTrackPropertyChange(track, TrackProperty_Selected); }
+    void SetSurfaceRecArm(MediaTrack *track, bool recarm) override { OnTrackPropertyChange(track, TrackProperty_RecordArm); }
+    void SetTrackTitle(MediaTrack *track, const char *title) override { OnTrackPropertyChange(track, TrackProperty_Name); }
+    
+    void SetSurfaceSolo(MediaTrack *track, bool solo) override
+    {
+        if (track == GetMasterTrack(NULL)) // master means "any solo" -- the solo state of other tracks may have changed too
+            OnTrackPropertyChange(NULL, TrackProperty_Solo);
+        else
+            OnTrackPropertyChange(track, TrackProperty_Solo);
+    }
+    
+    void OnTrackPropertyChange(MediaTrack *track, TrackProperty property)
+    {
+        trackPropertyChanges_.AddChange(track, property);
+        trackStateCache_.InvalidateTrack(track);
+    }
+    
     void NextTimeDisplayMode()
     {
         int *tmodeptr = GetTimeMode2Ptr();
@@ -4292,37 +6159,23 @@ public:
         return buf;
     }
         
-    //int repeats = 0;
-    
     void Run() override
     {
-        //int start = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now().time_since_epoch()).count();
-        
         ReaProject* currentProject = (*EnumProjects)(-1, NULL, 0);
 
         if (currentProject_ != currentProject)
         {
             currentProject_ = currentProject;
+            InvalidateTrackLists();
+            ForceResync();
             DAW::SendCommandMessage(41743);
         }
         
         if (shouldRun_ && pages_.size() > currentPageIndex_ && pages_[currentPageIndex_])
             pages_[currentPageIndex_]->Run();
-        /*
-         repeats++;
-         
-         if (repeats > 50)
-         {
-         repeats = 0;
-         
-         int duration = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now().time_since_epoch()).count() - start;
-         
-         char msgBuffer[250];
-         
-         snprintf(msgBuffer, sizeof(msgBuffer), "%d microseconds\n", duration);
-         ShowConsoleMsg(msgBuffer);
-         }
-        */
+        
+        if (profiler_.GetIsEnabled() && GetTickCount() - profiler_.GetLastDumpTime() > s_profileDumpInterval)
+            profiler_.Dump(GetProfileFilePath().c_str());
     }
 };
 
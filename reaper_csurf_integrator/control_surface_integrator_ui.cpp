@@ -328,8 +328,6 @@ static unsigned int &GetButtonColorForID(unsigned int id)
     return s_buttonColors[0][2];
 }
 
-static ActionContext *context = NULL;
-
 static WDL_DLGRET dlgProcEditAdvanced(HWND hwndDlg, UINT uMsg, WPARAM wParam, LPARAM lParam)
 {
     SurfaceFXTemplate *t = GetSurfaceFXTemplate(s_hwndLearnFXDlg);
@@ -353,7 +351,7 @@ static WDL_DLGRET dlgProcEditAdvanced(HWND hwndDlg, UINT uMsg, WPARAM wParam, LP
     {
         case WM_INITDIALOG:
         {
-            context = GetFirstContext(zoneManager, widget, modifier);
+            ActionContext *context = GetFirstContext(zoneManager, widget, modifier);
             
             if (context == NULL)
                 break;
@@ -420,6 +418,9 @@ static WDL_DLGRET dlgProcEditAdvanced(HWND hwndDlg, UINT uMsg, WPARAM wParam, LP
                 case IDOK:
                     if (HIWORD(wParam) == BN_CLICKED)
                     {
+                        // looked up again, the Learn zone may have been replaced while the dialog was up
+                        ActionContext *context = GetFirstContext(zoneManager, widget, modifier);
+                        
                         if (context == NULL)
                         {
                             s_dlgResult = IDCANCEL;
@@ -2467,6 +2468,11 @@ struct SurfaceLine
     int surfaceRefreshRate;
     int surfaceMaxPacketsPerRun;
     int surfaceMaxSysExMessagesPerRun;
+    bool useMIDIIOThread;
+    int midiMaxBytesPerSecond;
+    bool useOSCReceiveThread;
+    int oscMaxBundleSize;
+    int feedbackBudget;
     string remoteDeviceIP;
     
     SurfaceLine()
@@ -2477,6 +2483,11 @@ struct SurfaceLine
         surfaceRefreshRate = s_surfaceDefaultRefreshRate;
         surfaceMaxPacketsPerRun = s_surfaceDefaultMaxPacketsPerRun;
         surfaceMaxSysExMessagesPerRun = s_surfaceDefaultMaxSysExMessagesPerRun;
+        useMIDIIOThread = false;
+        midiMaxBytesPerSecond = 0;
+        useOSCReceiveThread = false;
+        oscMaxBundleSize = 0;
+        feedbackBudget = 0;
     }
 };
 
@@ -2532,6 +2543,9 @@ struct PageLine
     bool synchPages;
     bool isScrollLinkEnabled;
     bool isScrollSynchEnabled;
+    bool isChangeDrivenFeedback;
+    double meterDecay;
+    int meterPeakHold;
     vector<PageSurfaceLine *> surfaces;
     vector<Broadcaster *> broadcasters;
     
@@ -2541,6 +2555,9 @@ struct PageLine
         synchPages = true;
         isScrollLinkEnabled = false;
         isScrollSynchEnabled = false;
+        isChangeDrivenFeedback = false;
+        meterDecay = 0.0;
+        meterPeakHold = 0;
     }
 };
 
@@ -3734,6 +3751,8 @@ WDL_DLGRET dlgProcMainConfig(HWND hwndDlg, UINT uMsg, WPARAM wParam, LPARAM lPar
             
             int lineNumber = 0;
             
+            LineTokenizer tokenizer;
+            
             for (string line; getline(iniFile, line) ; )
             {
                 TrimLine(line);
@@ -3743,9 +3762,7 @@ WDL_DLGRET dlgProcMainConfig(HWND hwndDlg, UINT uMsg, WPARAM wParam, LPARAM lPar
                 if (lineNumber == 1)
                 {
                     PropertyList pList;
-                    vector<string> properties;
-                    properties.push_back(line.c_str());
-                    GetPropertiesFromTokens(0, 1, properties, pList);
+                    GetPropertyFromToken(line.c_str(), pList);
 
                     const char *versionProp = pList.get_prop(PropertyType_Version);
                     if (versionProp)
@@ -3765,12 +3782,9 @@ WDL_DLGRET dlgProcMainConfig(HWND hwndDlg, UINT uMsg, WPARAM wParam, LPARAM lPar
                 
                 if (line[0] != '\r' && line[0] != '/' && line != "") // ignore comment lines and blank lines
                 {
-                    vector<string> tokens;
-                    GetTokens(tokens, line.c_str());
+                    const vector<string_view> &tokens = tokenizer.Tokenize(line);
                     
                     PropertyList pList;
-                    vector<string> properties;
-                    properties.push_back(line.c_str());
                     GetPropertiesFromTokens(0, tokens.size(), tokens, pList);
 
                     if (const char *surfaceTypeProp = pList.get_prop(PropertyType_SurfaceType))
@@ -3785,7 +3799,7 @@ WDL_DLGRET dlgProcMainConfig(HWND hwndDlg, UINT uMsg, WPARAM wParam, LPARAM lPar
                                 surface->name = surfaceNameProp;
                                 surface->channelCount = atoi(surfaceChannelCountProp);
                                 
-                                if ( ! strcmp(surfaceTypeProp, s_MidiSurfaceToken) && tokens.size() == 7)
+                                if ( ! strcmp(surfaceTypeProp, s_MidiSurfaceToken) && tokens.size() >= 7 && tokens.size() <= 10)
                                 {
                                     if (pList.get_prop(PropertyType_MidiInput) != NULL &&
                                         pList.get_prop(PropertyType_MidiOutput) != NULL &&
@@ -3796,13 +3810,22 @@ WDL_DLGRET dlgProcMainConfig(HWND hwndDlg, UINT uMsg, WPARAM wParam, LPARAM lPar
                                         surface->outPort = atoi(pList.get_prop(PropertyType_MidiOutput));
                                         surface->surfaceRefreshRate = atoi(pList.get_prop(PropertyType_MIDISurfaceRefreshRate));
                                         surface->surfaceMaxSysExMessagesPerRun = atoi(pList.get_prop(PropertyType_MaxMIDIMesssagesPerRun));
+                                        
+                                        if (const char *midiIOThreadProp = pList.get_prop(PropertyType_MIDIIOThread))
+                                            surface->useMIDIIOThread = ! strcmp(midiIOThreadProp, "Yes");
+
+                                        if (const char *maxMIDIBytesPerSecondProp = pList.get_prop(PropertyType_MaxMIDIBytesPerSecond))
+                                            surface->midiMaxBytesPerSecond = atoi(maxMIDIBytesPerSecondProp);
+
+                                        if (const char *feedbackBudgetProp = pList.get_prop(PropertyType_FeedbackBudget))
+                                            surface->feedbackBudget = atoi(feedbackBudgetProp);
 
                                         s_surfaces.push_back(surface);
                                         
                                         AddListEntry(hwndDlg, surface->name, IDC_LIST_Surfaces);
                                     }
                                 }
-                                else if (( ! strcmp(surfaceTypeProp, s_OSCSurfaceToken) || ! strcmp(surfaceTypeProp, s_OSCX32SurfaceToken)) && tokens.size() == 7)
+                                else if (( ! strcmp(surfaceTypeProp, s_OSCSurfaceToken) || ! strcmp(surfaceTypeProp, s_OSCX32SurfaceToken)) && tokens.size() >= 7 && tokens.size() <= 10)
                                 {
                                     if (pList.get_prop(PropertyType_ReceiveOnPort) != NULL &&
                                         pList.get_prop(PropertyType_TransmitToPort) != NULL &&
@@ -3814,6 +3837,15 @@ WDL_DLGRET dlgProcMainConfig(HWND hwndDlg, UINT uMsg, WPARAM wParam, LPARAM lPar
                                         surface->remoteDeviceIP = pList.get_prop(PropertyType_TransmitToIPAddress);
                                         surface->surfaceMaxPacketsPerRun = atoi(pList.get_prop(PropertyType_MaxPacketsPerRun));
                                         
+                                        if (const char *oscReceiveThreadProp = pList.get_prop(PropertyType_OSCReceiveThread))
+                                            surface->useOSCReceiveThread = ! strcmp(oscReceiveThreadProp, "Yes");
+
+                                        if (const char *maxBundleSizeProp = pList.get_prop(PropertyType_MaxBundleSize))
+                                            surface->oscMaxBundleSize = atoi(maxBundleSizeProp);
+
+                                        if (const char *feedbackBudgetProp = pList.get_prop(PropertyType_FeedbackBudget))
+                                            surface->feedbackBudget = atoi(feedbackBudgetProp);
+
                                         s_surfaces.push_back(surface);
                                         
                                         AddListEntry(hwndDlg, surface->name, IDC_LIST_Surfaces);
@@ -3829,6 +3861,7 @@ WDL_DLGRET dlgProcMainConfig(HWND hwndDlg, UINT uMsg, WPARAM wParam, LPARAM lPar
                         bool synchPages = true;
                         bool isScrollLinkEnabled = false;
                         bool isScrollSynchEnabled = false;
+                        bool isChangeDrivenFeedback = false;
 
                         if (const char *pageFollowsMCPProp = pList.get_prop(PropertyType_PageFollowsMCP))
                         {
@@ -3854,13 +3887,26 @@ WDL_DLGRET dlgProcMainConfig(HWND hwndDlg, UINT uMsg, WPARAM wParam, LPARAM lPar
                                 isScrollSynchEnabled = true;
                         }
 
+                        if (const char *changeDrivenFeedbackProp = pList.get_prop(PropertyType_ChangeDrivenFeedback))
+                        {
+                            if ( ! strcmp(changeDrivenFeedbackProp, "Yes"))
+                                isChangeDrivenFeedback = true;
+                        }
+
                         PageLine *page = new PageLine();
                         page->name = pageNameProp;
                         page->followMCP = followMCP;
                         page->synchPages = synchPages;
                         page->isScrollLinkEnabled = isScrollLinkEnabled;
                         page->isScrollSynchEnabled = isScrollSynchEnabled;
- 
+                        page->isChangeDrivenFeedback = isChangeDrivenFeedback;
+                        
+                        if (const char *meterDecayProp = pList.get_prop(PropertyType_MeterDecay))
+                            page->meterDecay = atof(meterDecayProp);
+                        
+                        if (const char *meterPeakHoldProp = pList.get_prop(PropertyType_MeterPeakHold))
+                            page->meterPeakHold = atoi(meterPeakHoldProp);
+                        
                         s_pages.push_back(page);
                         
                         AddListEntry(hwndDlg, page->name, IDC_LIST_Pages);
@@ -4017,6 +4063,12 @@ WDL_DLGRET dlgProcMainConfig(HWND hwndDlg, UINT uMsg, WPARAM wParam, LPARAM lPar
                         
                         int maxSysExMessagesPerRun = surface->surfaceMaxSysExMessagesPerRun < 1 ? s_surfaceDefaultMaxSysExMessagesPerRun : surface->surfaceMaxSysExMessagesPerRun;
                         fprintf(iniFile, "%s=%d ", plist.string_from_prop(PropertyType_MaxMIDIMesssagesPerRun), maxSysExMessagesPerRun);
+                        
+                        if (surface->useMIDIIOThread)
+                            fprintf(iniFile, "%s=%s ", plist.string_from_prop(PropertyType_MIDIIOThread), "Yes");
+                        
+                        if (surface->midiMaxBytesPerSecond > 0)
+                            fprintf(iniFile, "%s=%d ", plist.string_from_prop(PropertyType_MaxMIDIBytesPerSecond), surface->midiMaxBytesPerSecond);
                     }
                     
                     else if (type == s_OSCSurfaceToken || type == s_OSCX32SurfaceToken)
@@ -4033,7 +4085,16 @@ WDL_DLGRET dlgProcMainConfig(HWND hwndDlg, UINT uMsg, WPARAM wParam, LPARAM lPar
                         int maxPacketsPerRun = surface->surfaceMaxPacketsPerRun < 0 ? s_surfaceDefaultMaxPacketsPerRun : surface->surfaceMaxPacketsPerRun;
                         
                         fprintf(iniFile, "%s=%d ", plist.string_from_prop(PropertyType_MaxPacketsPerRun), maxPacketsPerRun);
+                        
+                        if (surface->useOSCReceiveThread)
+                            fprintf(iniFile, "%s=%s ", plist.string_from_prop(PropertyType_OSCReceiveThread), "Yes");
+                        
+                        if (surface->oscMaxBundleSize > 0)
+                            fprintf(iniFile, "%s=%d ", plist.string_from_prop(PropertyType_MaxBundleSize), surface->oscMaxBundleSize);
                     }
+                    
+                    if (surface->feedbackBudget > 0)
+                        fprintf(iniFile, "%s=%d ", plist.string_from_prop(PropertyType_FeedbackBudget), surface->feedbackBudget);
 
                     fprintf(iniFile, "\n");
                 }
@@ -4052,6 +4113,15 @@ WDL_DLGRET dlgProcMainConfig(HWND hwndDlg, UINT uMsg, WPARAM wParam, LPARAM lPar
                                         
                     fprintf(iniFile, " %s=%s", plist.string_from_prop(PropertyType_ScrollSynch), page->isScrollSynchEnabled == true ? "Yes" : "No");
 
+                    if (page->isChangeDrivenFeedback)
+                        fprintf(iniFile, " %s=%s", plist.string_from_prop(PropertyType_ChangeDrivenFeedback), "Yes");
+
+                    if (page->meterDecay > 0.0)
+                        fprintf(iniFile, " %s=%g", plist.string_from_prop(PropertyType_MeterDecay), page->meterDecay);
+
+                    if (page->meterPeakHold > 0)
+                        fprintf(iniFile, " %s=%d", plist.string_from_prop(PropertyType_MeterPeakHold), page->meterPeakHold);
+
                     fprintf(iniFile, "\n");
 
                     for (auto surface : page->surfaces)
@@ -289,6 +289,56 @@ public:
     }
 };
 
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+class ToggleProfiler : public Action
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+{
+public:
+    virtual const char *GetName() override { return "ToggleProfiler"; }
+    
+    void RequestUpdate(ActionContext *context) override
+    {
+        context->UpdateWidgetValue(context->GetCSI()->GetProfiler().GetIsEnabled());
+    }
+    
+    void Do(ActionContext *context, double value) override
+    {
+        if (value == 0.0) return; // ignore button releases
+        
+        context->GetCSI()->ToggleProfiling();
+    }
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+class ReportMemoryUsage : public Action
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+{
+public:
+    virtual const char *GetName() override { return "ReportMemoryUsage"; }
+    
+    void Do(ActionContext *context, double value) override
+    {
+        if (value == 0.0) return; // ignore button releases
+        
+        context->GetCSI()->ShowMemoryUsage();
+    }
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+class ResyncSurfaces : public Action
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+{
+public:
+    virtual const char *GetName() override { return "ResyncSurfaces"; }
+    
+    void Do(ActionContext *context, double value) override
+    {
+        if (value == 0.0) return; // ignore button releases
+        
+        context->GetCSI()->ForceResync(); // e.g. after a surface has been power cycled
+    }
+};
+
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 class CSINameDisplay : public Action
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
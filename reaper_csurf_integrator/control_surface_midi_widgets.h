@@ -438,7 +438,6 @@ private:
     int topMargin_;
     int bottomMargin_;
     int font_;
-    string lastStringSent_;
     rgba_color lastTextColorSent_;
     rgba_color lastBackgroundColorSent_;
 
@@ -447,7 +446,6 @@ public:
     SCE24OLED_Midi_FeedbackProcessor(CSurfIntegrator *const csi, Midi_ControlSurface *surface, Widget *widget, MIDI_event_ex_t *feedback1, int topMargin, int bottomMargin, int font) :
       Midi_FeedbackProcessor(csi, surface, widget, feedback1), topMargin_(topMargin), bottomMargin_(bottomMargin), font_(font)
     {
-        lastStringSent_ = "";
     }
 
     virtual const char *GetName() override { return "SCE24OLED_Midi_FeedbackProcessor"; }
@@ -576,14 +574,12 @@ private:
     int topMargin_;
     int bottomMargin_;
     int font_;
-    string lastStringSent_;
 
 public:
     virtual ~SCE24Text_Midi_FeedbackProcessor() {}
     SCE24Text_Midi_FeedbackProcessor(CSurfIntegrator *const csi, Midi_ControlSurface *surface, Widget *widget, MIDI_event_ex_t *feedback1, int topMargin, int bottomMargin, int font) :
       Midi_FeedbackProcessor(csi, surface, widget, feedback1),  topMargin_(topMargin), bottomMargin_(bottomMargin), font_(font)
     {
-        lastStringSent_ = "";
     }
     virtual const char *GetName() override { return "SCE24Text_Midi_FeedbackProcessor"; }
     
@@ -623,13 +619,13 @@ public:
 
     virtual void SetValue(const PropertyList &properties, const char * const &inputText) override
     {
-        if (strcmp(inputText, lastStringSent_.c_str()))
+        if (! lastStringValue_.Matches(inputText))
             ForceValue(properties, inputText);
     }
     
     virtual void ForceValue(const PropertyList &properties, const char * const &inputText) override
     {
-        lastStringSent_ = inputText;
+        lastStringValue_.Set(inputText);
 
         char tmp[MEDBUF];
         const char *displayText = GetWidget()->GetSurface()->GetRestrictedLengthText(inputText, tmp, sizeof(tmp));
@@ -1090,6 +1086,7 @@ public:
     }
     
     virtual const char *GetName() override { return "Fader14Bit_Midi_FeedbackProcessor"; }
+    virtual bool GetIsMotorized() override { return true; }
 
     virtual void ForceClear() override
     {
@@ -1145,6 +1142,7 @@ public:
     }
     
     virtual const char *GetName() override { return "FaderportClassicFader14Bit_Midi_FeedbackProcessor"; }
+    virtual bool GetIsMotorized() override { return true; }
 
     virtual void ForceClear() override
     {
@@ -1204,6 +1202,7 @@ public:
     Fader7Bit_Midi_FeedbackProcessor(CSurfIntegrator *const csi, Midi_ControlSurface *surface, Widget *widget, MIDI_event_ex_t *feedback1) : Midi_FeedbackProcessor(csi, surface, widget, feedback1) { }
     
     virtual const char *GetName() override { return "Fader7Bit_Midi_FeedbackProcessor"; }
+    virtual bool GetIsMotorized() override { return true; }
 
     virtual void ForceClear() override
     {
@@ -1698,7 +1697,6 @@ private:
     int displayType_;
     int displayRow_;
     int channel_;
-    string lastStringSent_;
 
 public:
     virtual ~MCUDisplay_Midi_FeedbackProcessor() {}
@@ -1716,42 +1714,24 @@ public:
 
     virtual void SetValue(const PropertyList &properties, const char * const &inputText) override
     {
-        if (strcmp(inputText, lastStringSent_.c_str())) // changes since last send
+        if (! lastStringValue_.Matches(inputText)) // changes since last send
             ForceValue(properties, inputText);
     }
     
     virtual void ForceValue(const PropertyList &properties, const char * const &inputText) override
     {
-        lastStringSent_ = inputText;
+        lastStringValue_.Set(inputText);
         
         char tmp[MEDBUF];
         const char *text = GetWidget()->GetSurface()->GetRestrictedLengthText(inputText, tmp, sizeof(tmp));
 
         if (!strcmp(text,"-150.00")) text="";
 
-        struct
-        {
-            MIDI_event_ex_t evt;
-            char data[256];
-        } midiSysExData;
-        midiSysExData.evt.frame_offset=0;
-        midiSysExData.evt.size=0;
-        midiSysExData.evt.midi_message[midiSysExData.evt.size++] = 0xF0;
-        midiSysExData.evt.midi_message[midiSysExData.evt.size++] = 0x00;
-        midiSysExData.evt.midi_message[midiSysExData.evt.size++] = 0x00;
-        midiSysExData.evt.midi_message[midiSysExData.evt.size++] = 0x66;
-        midiSysExData.evt.midi_message[midiSysExData.evt.size++] = displayType_;
-        midiSysExData.evt.midi_message[midiSysExData.evt.size++] = displayRow_;
-        
-        midiSysExData.evt.midi_message[midiSysExData.evt.size++] = channel_  *7 + offset_;
+        char cell[7];
+        for (int i = 0; i < 7; ++i)
+            cell[i] = *text ? *text++ : ' ';
         
-        int cnt = 0;
-        while (cnt++ < 7)
-            midiSysExData.evt.midi_message[midiSysExData.evt.size++] = *text ? *text++ : ' ';
-        
-        midiSysExData.evt.midi_message[midiSysExData.evt.size++] = 0xF7;
-        
-        SendMidiSysExMessage(&midiSysExData.evt);
+        surface_->QueueMCUDisplayText(displayType_, displayRow_, channel_  *7 + offset_, cell, sizeof(cell)); // sent with the rest of the row at the end of the tick
     }
 };
 
@@ -1766,7 +1746,6 @@ private:
     int displayType_;
     int displayRow_;
     int channel_;
-    string lastStringSent_;
 
 public:
     virtual ~IconDisplay_Midi_FeedbackProcessor() {}
@@ -1784,13 +1763,13 @@ public:
 
     virtual void SetValue(const PropertyList &properties, const char * const &inputText) override
     {
-        if (strcmp(inputText, lastStringSent_.c_str())) // changes since last send
+        if (! lastStringValue_.Matches(inputText)) // changes since last send
             ForceValue(properties, inputText);
     }
     
     virtual void ForceValue(const PropertyList &properties, const char * const &inputText) override
     {
-        lastStringSent_ = inputText;
+        lastStringValue_.Set(inputText);
         
         char tmp[MEDBUF];
         const char *text = GetWidget()->GetSurface()->GetRestrictedLengthText(inputText, tmp, sizeof(tmp));
@@ -1832,7 +1811,6 @@ private:
     int displayType_;
     int displayTextType_;
     int channel_;
-    string lastStringSent_;
 
 public:
     virtual ~AsparionDisplay_Midi_FeedbackProcessor() {}
@@ -1850,13 +1828,13 @@ public:
 
     virtual void SetValue(const PropertyList &properties, const char * const &inputText) override
     {
-        if (strcmp(inputText, lastStringSent_.c_str())) // changes since last send
+        if (! lastStringValue_.Matches(inputText)) // changes since last send
             ForceValue(properties, inputText);
     }
     
     virtual void ForceValue(const PropertyList &properties, const char * const  &inputText) override
     {
-        lastStringSent_ = inputText;
+        lastStringValue_.Set(inputText);
         
         char tmp[MEDBUF];
         const char *text = GetWidget()->GetSurface()->GetRestrictedLengthText(inputText, tmp, sizeof(tmp));
@@ -1906,7 +1884,6 @@ private:
     int displayRow_;
     int channel_;
     int preventUpdateTrackColors_;
-    string lastStringSent_;
     vector<rgba_color> currentTrackColors_;
     
     static int colorFromString(const char *str)
@@ -1986,46 +1963,30 @@ public:
         preventUpdateTrackColors_ = false;
     }
     
+    virtual bool GetIsTrackColorsUpdatePrevented() override { return preventUpdateTrackColors_ != 0; }
+    
     virtual void SetValue(const PropertyList &properties, const char * const &inputText) override
     {
-        if (strcmp(inputText, lastStringSent_.c_str())) // changes since last send
+        if (! lastStringValue_.Matches(inputText)) // changes since last send
             ForceValue(properties, inputText);
     }
     
     virtual void ForceValue(const PropertyList &properties, const char * const &inputText) override
     {
-        lastStringSent_ = inputText;
+        lastStringValue_.Set(inputText);
         
         char tmp[MEDBUF];
         const char *text = GetWidget()->GetSurface()->GetRestrictedLengthText(inputText, tmp, sizeof(tmp));
 
         if (!strcmp(text, "-150.00")) text = "";
 
-        struct
-        {
-            MIDI_event_ex_t evt;
-            char data[256];
-        } midiSysExData;
-        midiSysExData.evt.frame_offset=0;
-        midiSysExData.evt.size=0;
-        midiSysExData.evt.midi_message[midiSysExData.evt.size++] = 0xF0;
-        midiSysExData.evt.midi_message[midiSysExData.evt.size++] = 0x00;
-        midiSysExData.evt.midi_message[midiSysExData.evt.size++] = 0x00;
-        midiSysExData.evt.midi_message[midiSysExData.evt.size++] = 0x66;
-        midiSysExData.evt.midi_message[midiSysExData.evt.size++] = displayType_;
-        midiSysExData.evt.midi_message[midiSysExData.evt.size++] = displayRow_;
+        char cell[7];
+        for (int i = 0; i < 7; ++i)
+            cell[i] = *text ? *text++ : ' ';
         
-        midiSysExData.evt.midi_message[midiSysExData.evt.size++] = channel_  * 7 + offset_;
-        
-        int cnt = 0;
-        while (cnt++ < 7)
-            midiSysExData.evt.midi_message[midiSysExData.evt.size++] = *text ? *text++ : ' ';
-        
-        midiSysExData.evt.midi_message[midiSysExData.evt.size++] = 0xF7;
-        
-        SendMidiSysExMessage(&midiSysExData.evt);
+        surface_->QueueMCUDisplayText(displayType_, displayRow_, channel_  * 7 + offset_, cell, sizeof(cell)); // sent with the rest of the row at the end of the tick
         
-        ForceUpdateTrackColors();
+        surface_->QueueTrackColorsUpdate(this); // one color strip refresh per tick instead of one per cell
     }
     
     virtual void ForceUpdateTrackColors() override
@@ -2054,7 +2015,7 @@ public:
 
         for (int i = 0; i < trackColors.size(); ++i)
         {
-            if (lastStringSent_ == "")
+            if (lastStringValue_.IsEmpty())
             {
                 midiSysExData.evt.midi_message[midiSysExData.evt.size++] = 0x07; // White
             }
@@ -2104,7 +2065,6 @@ private:
     int displayType_;
     int displayRow_;
     int channel_;
-    string lastStringSent_;
     
     int GetTextAlign(const PropertyList &properties)
     {
@@ -2134,7 +2094,7 @@ public:
     virtual ~FPDisplay_Midi_FeedbackProcessor() {}
     FPDisplay_Midi_FeedbackProcessor(CSurfIntegrator *const csi, Midi_ControlSurface *surface, Widget *widget, int displayType, int channel, int displayRow) : Midi_FeedbackProcessor(csi, surface, widget), displayType_(displayType), channel_(channel), displayRow_(displayRow)
     {
-        lastStringSent_ = " ";
+        lastStringValue_.Set(" ");
     }
     
     virtual const char *GetName() override { return "FPDisplay_Midi_FeedbackProcessor"; }
@@ -2147,13 +2107,13 @@ public:
     
     virtual void SetValue(const PropertyList &properties, const char * const &inputText) override
     {
-        if (strcmp(inputText, lastStringSent_.c_str())) // changes since last send
+        if (! lastStringValue_.Matches(inputText)) // changes since last send
             ForceValue(properties, inputText);
     }
     
     virtual void ForceValue(const PropertyList &properties, const char * const &inputText) override
     {
-        lastStringSent_ = inputText;
+        lastStringValue_.Set(inputText);
         
         char tmp[MEDBUF];
         const char *text = GetWidget()->GetSurface()->GetRestrictedLengthText(inputText, tmp, sizeof(tmp));
@@ -2161,7 +2121,7 @@ public:
         if (text[0] == 0)
             text = "                            ";
         
-        int invert = lastStringSent_ == "" ? 0 : GetTextInvert(properties); // prevent empty inverted lines
+        int invert = lastStringValue_.IsEmpty() ? 0 : GetTextInvert(properties); // prevent empty inverted lines
         int align = 0x0000000 + invert + GetTextAlign(properties);
 
         struct
@@ -2287,7 +2247,6 @@ private:
     int displayType_;
     int displayRow_;
     int channel_;
-    string lastStringSent_;
     
 public:
     virtual ~QConLiteDisplay_Midi_FeedbackProcessor() {}
@@ -2305,13 +2264,13 @@ public:
     
     virtual void SetValue(const PropertyList &properties, const char * const &inputText) override
     {
-        if (strcmp(inputText, lastStringSent_.c_str())) // changes since last send
+        if (! lastStringValue_.Matches(inputText)) // changes since last send
             ForceValue(properties, inputText);
     }
     
     virtual void ForceValue(const PropertyList &properties, const char * const &inputText) override
     {
-        lastStringSent_ = inputText;
+        lastStringValue_.Set(inputText);
         
         char tmp[MEDBUF];
         const char *text = GetWidget()->GetSurface()->GetRestrictedLengthText(inputText, tmp, sizeof(tmp));
@@ -20,20 +20,119 @@ static double int14ToNormalized(unsigned char msb, unsigned char lsb)
     return normalizedVal;
 }
 
+// Fader law lookup -- SLIDER2DB/DB2SLIDER are calls into REAPER plus a log or exp each way, and they run per fader per tick.
+// The table holds the volume for each of the 16384 positions a 14 bit fader can send, so those inputs are exact.
+// In between, volume is interpolated linearly; the inverse is a search of the same table, also interpolated,
+// so volToNormalized is never off by more than one table step (1/16383, well under what a 14 bit fader can resolve).
+// A plain binary search of 128K of doubles costs more than the REAPER call it replaces, so the search starts from
+// a bucket picked by the volume's exponent and leading mantissa bits -- about 0.1 dB wide, a few dozen entries at most.
+struct VolumeTable
+{
+    enum { SIZE = 16384, BUCKET_MANTISSA_BITS = 6, NUM_BUCKETS = 4096 }; // 64 buckets per octave, 64 octaves
+    
+    double vols[SIZE];
+    unsigned short bucketStarts[NUM_BUCKETS + 1]; // first index at or above each bucket, SIZE - 1 past the top
+    int minBucketKey = 0;
+    bool isBuilt = false;
+};
+
+static inline int GetVolumeBucketKey(double vol) // grows with vol, for vol >= 0
+{
+    unsigned long long bits;
+    memcpy(&bits, &vol, sizeof(bits));
+    return (int)(bits >> (52 - VolumeTable::BUCKET_MANTISSA_BITS));
+}
+
+inline VolumeTable &GetVolumeTable()
+{
+    static VolumeTable table;
+    return table;
+}
+
+// REAPER's fader range is a preference, so CSurfIntegrator rebuilds the table on every CSURF_EXT_RESET
+static void BuildVolumeTable()
+{
+    VolumeTable &table = GetVolumeTable();
+    
+    for (int i = 0; i < VolumeTable::SIZE; ++i)
+        table.vols[i] = DB2VAL(SLIDER2DB(i * 1000.0 / (VolumeTable::SIZE - 1)));
+    
+    for (int i = 1; i < VolumeTable::SIZE; ++i) // the search below relies on this
+        if (table.vols[i] < table.vols[i - 1])
+            table.vols[i] = table.vols[i - 1];
+    
+    table.minBucketKey = GetVolumeBucketKey(table.vols[VolumeTable::SIZE - 1]) - (VolumeTable::NUM_BUCKETS - 1);
+    
+    int index = 0;
+    for (int bucket = 0; bucket <= VolumeTable::NUM_BUCKETS; ++bucket)
+    {
+        while (index < VolumeTable::SIZE - 1 && GetVolumeBucketKey(table.vols[index]) < table.minBucketKey + bucket)
+            index++;
+        
+        table.bucketStarts[bucket] = (unsigned short)index;
+    }
+    
+    table.isBuilt = true;
+}
+
 static double normalizedToVol(double val)
 {
-    double pos=val*1000.0;
-    pos=SLIDER2DB(pos);
-    return DB2VAL(pos);
+    VolumeTable &table = GetVolumeTable();
+    
+    if ( ! table.isBuilt)
+        BuildVolumeTable();
+    
+    if (val <= 0.0)
+        return table.vols[0];
+    if (val >= 1.0)
+        return table.vols[VolumeTable::SIZE - 1];
+    
+    double pos = val * (VolumeTable::SIZE - 1);
+    int index = (int)pos;
+    double fraction = pos - index;
+    
+    if (fraction == 0.0)
+        return table.vols[index];
+    
+    return table.vols[index] + (table.vols[index + 1] - table.vols[index]) * fraction;
 }
 
 static double volToNormalized(double vol)
 {
-    double d=(DB2SLIDER(VAL2DB(vol))/1000.0);
-    if (d<0.0)d=0.0;
-    else if (d>1.0)d=1.0;
+    VolumeTable &table = GetVolumeTable();
+    
+    if ( ! table.isBuilt)
+        BuildVolumeTable();
+    
+    if (vol <= table.vols[0])
+        return 0.0;
+    if (vol >= table.vols[VolumeTable::SIZE - 1])
+        return 1.0;
+    
+    int bucket = GetVolumeBucketKey(vol) - table.minBucketKey;
+    if (bucket < 0)
+        bucket = 0;
+    
+    // everything below the bucket is below vol, and the answer is at most the next bucket's start
+    int first = bucket > 0 && table.bucketStarts[bucket] > 0 ? table.bucketStarts[bucket] - 1 : 0;
+    int last = table.bucketStarts[bucket + 1];
+    
+    // vols[low] < vol <= vols[low + 1], written so the compiler can use a conditional move -- meter values are too
+    // scattered for a branch predictor
+    const double *base = table.vols + first;
+    for (int count = last - first; count > 1; )
+    {
+        int half = count / 2;
+        base = base[half] < vol ? base + half : base;
+        count -= half;
+    }
+    
+    int low = (int)(base - table.vols);
+    int high = low + 1;
+    
+    double fraction = (vol - table.vols[low]) / (table.vols[high] - table.vols[low]);
     
-    return d;
+    return (low + fraction) / (VolumeTable::SIZE - 1);
 }
 
 static double normalizedToPan(double val)